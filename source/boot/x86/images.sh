@@ -82,11 +82,38 @@ menuentry "Escape - Test" {
 	module /sbin/initloader initloader
 	boot
 }
+
+menuentry "Escape - AHCI" {
+	multiboot /boot/escape$suffix escape root=/dev/ext2-sda1 swapdev=/dev/sda3
+	module /sbin/initloader initloader
+	module /sbin/pci pci /dev/pci
+	module /sbin/ahci ahci /sys/dev/ahci
+	module /sbin/ext2 ext2 /dev/ext2-sda1 /dev/sda1
+	boot
+}
+
+menuentry "Escape - virtio" {
+	multiboot /boot/escape$suffix escape root=/dev/ext2-vda1 swapdev=/dev/vda3
+	module /sbin/initloader initloader
+	module /sbin/pci pci /dev/pci
+	module /sbin/virtioblk virtioblk /sys/dev/virtioblk
+	module /sbin/ext2 ext2 /dev/ext2-vda1 /dev/vda1
+	boot
+}
 EOF
 
 	sudo ./boot/perms.sh $dir
-	./tools/disk.py create --offset 2048 --part ext2r0 128 "$dir" --part ext2r0 4 - --part nofs 8 - "$dst" 1>&2
-	sudo rm -Rf $dir
+
+	# the second partition tests ext2 with dir_index and filetype (see libctest)
+	htree=`mktemp -d`
+	mkdir $htree/indexed
+	for i in `seq 0 63`; do
+		touch $htree/indexed/`printf "entry-with-a-fairly-long-name-for-the-index-%04d" $i`
+	done
+
+	./tools/disk.py create --offset 2048 --part ext2r0 128 "$dir" --part ext2 4 "$htree" \
+		--part nofs 8 - "$dst" 1>&2
+	sudo rm -Rf $dir $htree
 }
 
 create_fsimg() {
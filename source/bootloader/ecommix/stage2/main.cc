@@ -173,7 +173,7 @@ static ino_t searchDir(ino_t dirIno,Ext2Inode *dir,const char *name,size_t nameL
 		/* search the directory-entries */
 		while(rem > 0 && le32tocpu(entry->inode) != 0) {
 			/* found a match? */
-			if(nameLen == le16tocpu(entry->nameLen) && strncmp(entry->name,name,nameLen) == 0)
+			if(nameLen == entry->nameLen && strncmp(entry->name,name,nameLen) == 0)
 				return le32tocpu(entry->inode);
 
 			/* to next dir-entry */
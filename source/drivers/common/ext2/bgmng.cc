@@ -34,7 +34,7 @@
 
 using namespace fs;
 
-Ext2BGMng::Ext2BGMng(Ext2FileSystem *fs) : _dirty(false), _groups(), _fs(fs) {
+Ext2BGMng::Ext2BGMng(Ext2FileSystem *fs) : _dirty(false), _groups(), _hints(), _fs(fs) {
 	/* read block-group-descriptors */
 	int res;
 	size_t bcount = _fs->bytesToBlocks(_fs->getBlockGroupCount());
@@ -45,6 +45,11 @@ Ext2BGMng::Ext2BGMng(Ext2FileSystem *fs) : _dirty(false), _groups(), _fs(fs) {
 		free(_groups);
 		VTHROWE("Unable to read group-table",res);
 	}
+	_hints = (Hint*)calloc(_fs->getBlockGroupCount(),sizeof(Hint));
+	if(_hints == NULL) {
+		free(_groups);
+		VTHROWE("Unable to allocate memory for blockgroup hints",-ENOMEM);
+	}
 }
 
 void Ext2BGMng::update() {
@@ -39,6 +39,7 @@ public:
 	 * Destroys the blockgroups
 	 */
 	~Ext2BGMng() {
+		free(_hints);
 		free(_groups);
 	}
 
@@ -50,6 +51,25 @@ public:
 		return _groups + i;
 	}
 
+	/**
+	 * The hints are relative to the block group and are only kept in memory. All bits in the
+	 * bitmap below the hint are known to be in use.
+	 *
+	 * @param i the block group number
+	 * @return the hint for the first free block in group <i>
+	 */
+	uint32_t &blockHint(size_t i) {
+		return _hints[i].block;
+	}
+
+	/**
+	 * @param i the block group number
+	 * @return the hint for the first free inode in group <i>
+	 */
+	uint32_t &inodeHint(size_t i) {
+		return _hints[i].inode;
+	}
+
 	/**
 	 * Marks the superblock as dirty
 	 */
@@ -75,7 +95,13 @@ private:
 #endif
 
 private:
+	struct Hint {
+		uint32_t block;
+		uint32_t inode;
+	};
+
 	bool _dirty;
 	fs::Ext2BlockGrp *_groups;
+	Hint *_hints;
 	Ext2FileSystem *_fs;
 };
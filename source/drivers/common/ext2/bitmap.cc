@@ -17,10 +17,12 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <esc/util.h>
 #include <fs/blockcache.h>
 #include <fs/fsdev.h>
 #include <sys/common.h>
 #include <sys/endian.h>
+#include <sys/stat.h>
 #include <sys/thread.h>
 #include <assert.h>
 
@@ -30,27 +32,67 @@
 
 using namespace fs;
 
+/**
+ * Searches for the first bit in [<start>,<end>) that is set (<set> = true) or clear, by looking at
+ * 32 bits at once. The bitmap has to be 4-byte-aligned and its size a multiple of 4.
+ *
+ * @return the index of the bit or <end> if there is none
+ */
+static size_t findBit(const uint8_t *bitmap,size_t start,size_t end,bool set) {
+	const uint32_t *words = reinterpret_cast<const uint32_t*>(bitmap);
+	size_t i = start;
+	while(i < end) {
+		uint32_t word = le32tocpu(words[i / 32]);
+		if(!set)
+			word = ~word;
+		word &= ~0U << (i % 32);
+		if(word != 0)
+			return esc::Util::min<size_t>((i & ~(size_t)31) + __builtin_ctz(word),end);
+		i = (i & ~(size_t)31) + 32;
+	}
+	return end;
+}
+
+/**
+ * Searches for <count> free bits in a row, beginning in [<start>,<end>). The range may extend up
+ * to <limit>.
+ *
+ * @return the index of the first bit or <end> if there is none
+ */
+static size_t findRun(const uint8_t *bitmap,size_t start,size_t end,size_t limit,size_t count) {
+	size_t i = findBit(bitmap,start,end,false);
+	while(i < end) {
+		size_t used = findBit(bitmap,i,esc::Util::min(i + count,limit),true);
+		if(used - i >= count)
+			return i;
+		i = findBit(bitmap,used,end,false);
+	}
+	return end;
+}
+
+static void setBits(uint8_t *bitmap,size_t start,size_t count,bool set) {
+	for(size_t i = start; i < start + count; ++i) {
+		if(set)
+			bitmap[i / 8] |= 1 << (i % 8);
+		else
+			bitmap[i / 8] &= ~(1 << (i % 8));
+	}
+}
+
 ino_t Ext2Bitmap::allocInode(Ext2FileSystem *e,Ext2CInode *dirInode,bool isDir) {
 	size_t gcount = e->getBlockGroupCount();
-	block_t block = e->getBlockOfInode(dirInode->inodeNo);
-	block_t i,group = e->getGroupOfBlock(block);
+	block_t group = e->getGroupOfInode(dirInode->inodeNo);
 	ino_t ino = 0;
-	uint32_t inodesPerGroup = le32tocpu(e->sb.get()->inodesPerGroup);
 
 	sassert(tpool_lock(EXT2_SUPERBLOCK_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
 	if(le32tocpu(e->sb.get()->freeInodeCount) == 0)
 		goto done;
 
-	/* first try to find a block in the block-group of the inode */
-	ino = allocInodeIn(e,group * inodesPerGroup,e->bgs.get(group),isDir);
-	if(ino != 0)
-		goto done;
-
-	/* now try the other block-groups */
-	for(i = group + 1; i != group; i = (i + 1) % gcount) {
-		ino = allocInodeIn(e,i * inodesPerGroup,e->bgs.get(i),isDir);
+	/* first try to find an inode in the block-group of the directory, then the other ones */
+	for(size_t i = 0; i < gcount; ++i) {
+		ino = allocInodeIn(e,(group + i) % gcount,isDir);
 		if(ino != 0)
-			goto done;
+			break;
 	}
 
 done:
@@ -76,7 +118,9 @@ int Ext2Bitmap::freeInode(Ext2FileSystem *e,ino_t ino,bool isDir) {
 	ino--;
 	ino %= le32tocpu(e->sb.get()->inodesPerGroup);
 	bitmapbuf = (uint8_t*)bitmap->buffer;
-	bitmapbuf[ino / 8] &= ~(1 << (ino % 8));
+	setBits(bitmapbuf,ino,1,false);
+	if((uint32_t)ino < e->bgs.inodeHint(group))
+		e->bgs.inodeHint(group) = ino;
 
 	freeInodeCount = le16tocpu(e->bgs.get(group)->freeInodeCount);
 	e->bgs.get(group)->freeInodeCount = cputole16(freeInodeCount + 1);
@@ -96,12 +140,14 @@ int Ext2Bitmap::freeInode(Ext2FileSystem *e,ino_t ino,bool isDir) {
 	return 0;
 }
 
-ino_t Ext2Bitmap::allocInodeIn(Ext2FileSystem *e,block_t groupStart,Ext2BlockGrp *group,bool isDir) {
-	size_t i,j;
-	ino_t ino;
+ino_t Ext2Bitmap::allocInodeIn(Ext2FileSystem *e,block_t groupNo,bool isDir) {
+	Ext2BlockGrp *group = e->bgs.get(groupNo);
+	uint32_t inodesPerGroup = le32tocpu(e->sb.get()->inodesPerGroup);
 	CBlock *bitmap;
 	uint8_t *bitmapbuf;
 	uint32_t sFreeInodeCount;
+	uint16_t freeInodeCount;
+	size_t bit;
 	if(le16tocpu(group->freeInodeCount) == 0)
 		return 0;
 
@@ -110,57 +156,81 @@ ino_t Ext2Bitmap::allocInodeIn(Ext2FileSystem *e,block_t groupStart,Ext2BlockGrp
 	if(bitmap == NULL)
 		return 0;
 
-	ino = 0;
+	/* all inodes below the hint are in use */
 	bitmapbuf = (uint8_t*)bitmap->buffer;
-	for(i = 0; i < e->blockSize(); i++) {
-		for(j = 1; j < 256; ino++, j <<= 1) {
-			if(ino >= (ino_t)le32tocpu(e->sb.get()->inodeCount)) {
-				e->blockCache.release(bitmap);
-				return 0;
-			}
-			if(!(bitmapbuf[i] & j)) {
-				uint16_t freeInodeCount = le16tocpu(group->freeInodeCount);
-				group->freeInodeCount = cputole16(freeInodeCount - 1);
-				if(isDir) {
-					uint16_t usedDirCount = le16tocpu(group->usedDirCount);
-					group->usedDirCount = cputole16(usedDirCount + 1);
-				}
-				e->bgs.markDirty();
-				bitmapbuf[i] |= j;
-				sFreeInodeCount = le32tocpu(e->sb.get()->freeInodeCount);
-				e->sb.get()->freeInodeCount = cputole32(sFreeInodeCount - 1);
-				e->sb.markDirty();
-				e->blockCache.markDirty(bitmap);
-				e->blockCache.release(bitmap);
-				return ino + groupStart + 1;
-			}
-		}
+	bit = findBit(bitmapbuf,e->bgs.inodeHint(groupNo),inodesPerGroup,false);
+	e->bgs.inodeHint(groupNo) = bit;
+	if(bit == inodesPerGroup ||
+			groupNo * inodesPerGroup + bit >= le32tocpu(e->sb.get()->inodeCount)) {
+		e->blockCache.release(bitmap);
+		return 0;
 	}
+
+	setBits(bitmapbuf,bit,1,true);
+	e->bgs.inodeHint(groupNo) = bit + 1;
+	freeInodeCount = le16tocpu(group->freeInodeCount);
+	group->freeInodeCount = cputole16(freeInodeCount - 1);
+	if(isDir) {
+		uint16_t usedDirCount = le16tocpu(group->usedDirCount);
+		group->usedDirCount = cputole16(usedDirCount + 1);
+	}
+	e->bgs.markDirty();
+	sFreeInodeCount = le32tocpu(e->sb.get()->freeInodeCount);
+	e->sb.get()->freeInodeCount = cputole32(sFreeInodeCount - 1);
+	e->sb.markDirty();
+	e->blockCache.markDirty(bitmap);
 	e->blockCache.release(bitmap);
-	return 0;
+	return groupNo * inodesPerGroup + bit + 1;
 }
 
 block_t Ext2Bitmap::allocBlock(Ext2FileSystem *e,Ext2CInode *inode) {
+	block_t bno,goal;
+	size_t count;
+
+	/* use the preallocated blocks first */
+	if(inode->preallocCount > 0) {
+		inode->preallocCount--;
+		inode->lastBlock = inode->preallocBlock++;
+		return inode->lastBlock;
+	}
+
+	/* continue behind the last block of this inode, if possible */
+	if(inode->lastBlock != 0)
+		goal = inode->lastBlock + 1;
+	else
+		goal = e->getFirstBlockOfGroup(e->getGroupOfInode(inode->inodeNo));
+
+	count = 1;
+	if(S_ISREG(le16tocpu(inode->inode.mode)))
+		count += EXT2_PREALLOC_BLOCKS;
+
+	bno = allocBlocks(e,goal,&count);
+	if(bno != 0) {
+		inode->lastBlock = bno;
+		inode->preallocBlock = bno + 1;
+		inode->preallocCount = count - 1;
+	}
+	return bno;
+}
+
+block_t Ext2Bitmap::allocBlocks(Ext2FileSystem *e,block_t goal,size_t *count) {
 	size_t gcount = e->getBlockGroupCount();
-	block_t block = e->getBlockOfInode(inode->inodeNo);
-	block_t i,group = e->getGroupOfBlock(block);
-	block_t bno = 0;
-	uint32_t blocksPerGroup = le32tocpu(e->sb.get()->blocksPerGroup);
+	block_t group,bno = 0;
 
 	sassert(tpool_lock(EXT2_SUPERBLOCK_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
 	if(le32tocpu(e->sb.get()->freeBlockCount) == 0)
 		goto done;
 
-	/* first try to find a block in the block-group of the inode */
-	bno = allocBlockIn(e,group * blocksPerGroup,e->bgs.get(group));
-	if(bno != 0)
-		goto done;
+	if(goal < le32tocpu(e->sb.get()->firstDataBlock) || goal >= le32tocpu(e->sb.get()->blockCount))
+		goal = le32tocpu(e->sb.get()->firstDataBlock);
+	group = e->getGroupOfBlock(goal);
 
-	/* now try the other block-groups */
-	for(i = group + 1; i != group; i = (i + 1) % gcount) {
-		bno = allocBlockIn(e,i * blocksPerGroup,e->bgs.get(i));
+	/* first try to find blocks in the block-group of the goal, then the other ones */
+	for(size_t i = 0; i < gcount; ++i) {
+		block_t g = (group + i) % gcount;
+		bno = allocBlocksIn(e,g,i == 0 ? goal - e->getFirstBlockOfGroup(g) : 0,count);
 		if(bno != 0)
-			goto done;
+			break;
 	}
 
 done:
@@ -168,8 +238,8 @@ done:
 	return bno;
 }
 
-int Ext2Bitmap::freeBlock(Ext2FileSystem *e,block_t blockNo) {
-	block_t group = e->getGroupOfBlock(blockNo);
+int Ext2Bitmap::freeBlocks(Ext2FileSystem *e,block_t start,size_t count) {
+	block_t group = e->getGroupOfBlock(start);
 	CBlock *bitmap;
 	uint8_t *bitmapbuf;
 	uint16_t freeBlockCount;
@@ -183,15 +253,17 @@ int Ext2Bitmap::freeBlock(Ext2FileSystem *e,block_t blockNo) {
 	}
 
 	/* mark free in bitmap */
-	blockNo--;
-	blockNo %= le32tocpu(e->sb.get()->blocksPerGroup);
+	start -= e->getFirstBlockOfGroup(group);
 	bitmapbuf = (uint8_t*)bitmap->buffer;
-	bitmapbuf[blockNo / 8] &= ~(1 << (blockNo % 8));
+	setBits(bitmapbuf,start,count,false);
+	if(start < e->bgs.blockHint(group))
+		e->bgs.blockHint(group) = start;
+
 	freeBlockCount = le16tocpu(e->bgs.get(group)->freeBlockCount);
-	e->bgs.get(group)->freeBlockCount = cputole16(freeBlockCount + 1);
+	e->bgs.get(group)->freeBlockCount = cputole16(freeBlockCount + count);
 	e->bgs.markDirty();
 	sFreeBlockCount = le32tocpu(e->sb.get()->freeBlockCount);
-	e->sb.get()->freeBlockCount = cputole32(sFreeBlockCount + 1);
+	e->sb.get()->freeBlockCount = cputole32(sFreeBlockCount + count);
 	e->sb.markDirty();
 	e->blockCache.markDirty(bitmap);
 	e->blockCache.release(bitmap);
@@ -199,13 +271,24 @@ int Ext2Bitmap::freeBlock(Ext2FileSystem *e,block_t blockNo) {
 	return 0;
 }
 
-block_t Ext2Bitmap::allocBlockIn(Ext2FileSystem *e,block_t groupStart,Ext2BlockGrp *group) {
-	size_t i,j;
-	block_t bno;
+int Ext2Bitmap::discardPrealloc(Ext2FileSystem *e,Ext2CInode *inode) {
+	if(inode->preallocCount == 0)
+		return 0;
+	int res = freeBlocks(e,inode->preallocBlock,inode->preallocCount);
+	inode->preallocCount = 0;
+	return res;
+}
+
+block_t Ext2Bitmap::allocBlocksIn(Ext2FileSystem *e,block_t groupNo,size_t goal,size_t *count) {
+	Ext2BlockGrp *group = e->bgs.get(groupNo);
+	block_t first = e->getFirstBlockOfGroup(groupNo);
+	size_t bits = esc::Util::min<size_t>(le32tocpu(e->sb.get()->blocksPerGroup),
+		le32tocpu(e->sb.get()->blockCount) - first);
+	size_t start,end,hint;
 	CBlock *bitmap;
 	uint8_t *bitmapbuf;
+	uint16_t freeBlockCount;
 	uint32_t sFreeBlockCount;
-	uint32_t blockCount = le32tocpu(e->sb.get()->blockCount);
 	if(le16tocpu(group->freeBlockCount) == 0)
 		return 0;
 
@@ -214,28 +297,41 @@ block_t Ext2Bitmap::allocBlockIn(Ext2FileSystem *e,block_t groupStart,Ext2BlockG
 	if(bitmap == NULL)
 		return 0;
 
-	bno = 0;
+	/* all blocks below the hint are in use */
 	bitmapbuf = (uint8_t*)bitmap->buffer;
-	for(i = 0; i < e->blockSize(); i++) {
-		for(j = 1; j < 256; bno++, j <<= 1) {
-			if(bno >= blockCount) {
-				e->blockCache.release(bitmap);
-				return 0;
-			}
-			if(!(bitmapbuf[i] & j)) {
-				uint16_t freeBlockCount = le16tocpu(group->freeBlockCount);
-				group->freeBlockCount = cputole16(freeBlockCount - 1);
-				e->bgs.markDirty();
-				bitmapbuf[i] |= j;
-				sFreeBlockCount = le32tocpu(e->sb.get()->freeBlockCount);
-				e->sb.get()->freeBlockCount = cputole32(sFreeBlockCount - 1);
-				e->sb.markDirty();
-				e->blockCache.markDirty(bitmap);
-				e->blockCache.release(bitmap);
-				return bno + groupStart + 1;
-			}
-		}
+	hint = findBit(bitmapbuf,e->bgs.blockHint(groupNo),bits,false);
+	e->bgs.blockHint(groupNo) = hint;
+	if(hint == bits) {
+		e->blockCache.release(bitmap);
+		return 0;
 	}
+
+	/* take the goal, if it's free. otherwise search for a free range behind the goal, then before
+	 * it. if there is none, take the first free block */
+	goal = esc::Util::max(goal,hint);
+	if(goal < bits && !(bitmapbuf[goal / 8] & (1 << (goal % 8))))
+		start = goal;
+	else {
+		start = findRun(bitmapbuf,goal,bits,bits,*count);
+		if(start == bits)
+			start = findRun(bitmapbuf,hint,goal,bits,*count);
+		if(start == goal)
+			start = hint;
+	}
+
+	end = findBit(bitmapbuf,start,esc::Util::min(start + *count,bits),true);
+	setBits(bitmapbuf,start,end - start,true);
+	if(start == hint)
+		e->bgs.blockHint(groupNo) = end;
+	*count = end - start;
+
+	freeBlockCount = le16tocpu(group->freeBlockCount);
+	group->freeBlockCount = cputole16(freeBlockCount - *count);
+	e->bgs.markDirty();
+	sFreeBlockCount = le32tocpu(e->sb.get()->freeBlockCount);
+	e->sb.get()->freeBlockCount = cputole32(sFreeBlockCount - *count);
+	e->sb.markDirty();
+	e->blockCache.markDirty(bitmap);
 	e->blockCache.release(bitmap);
-	return 0;
+	return first + start;
 }
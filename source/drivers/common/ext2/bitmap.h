@@ -49,8 +49,9 @@ public:
 	static int freeInode(Ext2FileSystem *e,ino_t ino,bool isDir);
 
 	/**
-	 * Allocates a new block for the given inode. It will be tried to allocate a block in the same
-	 * block-group.
+	 * Allocates a new block for the given inode. The block directly following the last one that
+	 * has been allocated for the inode is preferred. For regular files, a few more blocks are
+	 * preallocated behind it, which are handed out by the next calls.
 	 *
 	 * @param e the ext2-fs
 	 * @param inode the inode
@@ -58,6 +59,18 @@ public:
 	 */
 	static block_t allocBlock(Ext2FileSystem *e,Ext2CInode *inode);
 
+	/**
+	 * Allocates up to <*count> contiguous blocks, preferably starting at <goal>. If that's not
+	 * possible, a free range of <*count> blocks is searched, starting in the block-group of <goal>.
+	 * If there is none, the first free block is used.
+	 *
+	 * @param e the ext2-fs
+	 * @param goal the preferred block-number
+	 * @param count the number of blocks to allocate; will be set to the number of allocated ones
+	 * @return the first block-number or 0 if failed
+	 */
+	static block_t allocBlocks(Ext2FileSystem *e,block_t goal,size_t *count);
+
 	/**
 	 * Free's the given block-number
 	 *
@@ -65,9 +78,30 @@ public:
 	 * @param blockNo the block-number
 	 * @return 0 on success
 	 */
-	static int freeBlock(Ext2FileSystem *e,block_t blockNo);
+	static int freeBlock(Ext2FileSystem *e,block_t blockNo) {
+		return freeBlocks(e,blockNo,1);
+	}
+
+	/**
+	 * Free's the <count> blocks starting at <start>, which have to be in the same block-group
+	 *
+	 * @param e the ext2-fs
+	 * @param start the first block-number
+	 * @param count the number of blocks
+	 * @return 0 on success
+	 */
+	static int freeBlocks(Ext2FileSystem *e,block_t start,size_t count);
+
+	/**
+	 * Free's the blocks that have been preallocated for the given inode, but not used
+	 *
+	 * @param e the ext2-fs
+	 * @param inode the inode
+	 * @return 0 on success
+	 */
+	static int discardPrealloc(Ext2FileSystem *e,Ext2CInode *inode);
 
 private:
-	static ino_t allocInodeIn(Ext2FileSystem *e,block_t groupStart,fs::Ext2BlockGrp *group,bool isDir);
-	static block_t allocBlockIn(Ext2FileSystem *e,block_t groupStart,fs::Ext2BlockGrp *group);
+	static ino_t allocInodeIn(Ext2FileSystem *e,block_t group,bool isDir);
+	static block_t allocBlocksIn(Ext2FileSystem *e,block_t group,size_t goal,size_t *count);
 };
@@ -0,0 +1,168 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include <fs/common.h>
+#include <sys/common.h>
+#include <sys/debug.h>
+#include <string.h>
+
+#include "dentrycache.h"
+#include "ext2.h"
+
+Ext2DentryCache::Ext2DentryCache(size_t size)
+		: _size(size), _entries(new Entry[size]()), _hashmap(), _lruFirst(), _lruLast(),
+		  _freeList(), _hits(), _negHits(), _misses() {
+	for(size_t i = 0; i < _size; ++i) {
+		_entries[i].next = _freeList;
+		_freeList = _entries + i;
+	}
+}
+
+bool Ext2DentryCache::lookup(ino_t dir,const char *name,size_t nameLen,ino_t *ino) {
+	sassert(tpool_lock(EXT2_DCACHE_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+	Entry *e = find(dir,name,nameLen);
+	if(e == NULL) {
+		_misses++;
+		sassert(tpool_unlock(EXT2_DCACHE_LOCK) == 0);
+		return false;
+	}
+
+	lruRemove(e);
+	lruPrepend(e);
+	if(e->ino < 0)
+		_negHits++;
+	else
+		_hits++;
+	*ino = e->ino;
+	sassert(tpool_unlock(EXT2_DCACHE_LOCK) == 0);
+	return true;
+}
+
+void Ext2DentryCache::insert(ino_t dir,const char *name,size_t nameLen,ino_t ino) {
+	/* longer names are not cached */
+	if(nameLen == 0 || nameLen > NAME_LEN)
+		return;
+
+	sassert(tpool_lock(EXT2_DCACHE_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+	Entry *e = find(dir,name,nameLen);
+	if(e == NULL) {
+
+		/* take a free entry or the least recently used one */
+		if(_freeList) {
+			e = _freeList;
+			_freeList = e->next;
+		}
+		else {
+			e = _lruLast;
+			lruRemove(e);
+			unhash(e);
+		}
+
+		e->dir = dir;
+		e->nameLen = nameLen;
+		memcpy(e->name,name,nameLen);
+		Entry **list = _hashmap + hash(dir,name,nameLen);
+		e->hnext = *list;
+		*list = e;
+	}
+	else
+		lruRemove(e);
+
+	e->ino = ino;
+	lruPrepend(e);
+	sassert(tpool_unlock(EXT2_DCACHE_LOCK) == 0);
+}
+
+void Ext2DentryCache::removeDir(ino_t dir) {
+	sassert(tpool_lock(EXT2_DCACHE_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+	for(size_t i = 0; i < _size; ++i) {
+		Entry *e = _entries + i;
+		if(e->nameLen > 0 && e->dir == dir) {
+			lruRemove(e);
+			unhash(e);
+			e->next = _freeList;
+			_freeList = e;
+		}
+	}
+	sassert(tpool_unlock(EXT2_DCACHE_LOCK) == 0);
+}
+
+void Ext2DentryCache::print(FILE *f) {
+	size_t used = 0;
+	sassert(tpool_lock(EXT2_DCACHE_LOCK,0) == 0);
+	for(Entry *e = _lruFirst; e != NULL; e = e->next)
+		used++;
+	sassert(tpool_unlock(EXT2_DCACHE_LOCK) == 0);
+	fprintf(f,"\tTotal entries: %zu\n",_size);
+	fprintf(f,"\tUsed entries: %zu\n",used);
+	fprintf(f,"\tHits: %zu\n",_hits);
+	fprintf(f,"\tNegative hits: %zu\n",_negHits);
+	fprintf(f,"\tMisses: %zu\n",_misses);
+}
+
+Ext2DentryCache::Entry *Ext2DentryCache::find(ino_t dir,const char *name,size_t nameLen) {
+	if(nameLen == 0 || nameLen > NAME_LEN)
+		return NULL;
+
+	for(Entry *e = _hashmap[hash(dir,name,nameLen)]; e != NULL; e = e->hnext) {
+		if(e->dir == dir && e->nameLen == nameLen && memcmp(e->name,name,nameLen) == 0)
+			return e;
+	}
+	return NULL;
+}
+
+void Ext2DentryCache::unhash(Entry *e) {
+	Entry **list = _hashmap + hash(e->dir,e->name,e->nameLen);
+	Entry *i = *list, *p = NULL;
+	while(i != NULL) {
+		if(i == e) {
+			if(p)
+				p->hnext = i->hnext;
+			else
+				*list = i->hnext;
+			break;
+		}
+		p = i;
+		i = i->hnext;
+	}
+	/* mark it unused */
+	e->nameLen = 0;
+}
+
+void Ext2DentryCache::lruRemove(Entry *e) {
+	if(e->prev)
+		e->prev->next = e->next;
+	else
+		_lruFirst = e->next;
+	if(e->next)
+		e->next->prev = e->prev;
+	else
+		_lruLast = e->prev;
+}
+
+void Ext2DentryCache::lruPrepend(Entry *e) {
+	e->prev = NULL;
+	e->next = _lruFirst;
+	if(_lruFirst)
+		_lruFirst->prev = e;
+	else
+		_lruLast = e;
+	_lruFirst = e;
+}
@@ -0,0 +1,118 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#pragma once
+
+#include <sys/common.h>
+#include <stdio.h>
+
+/**
+ * Caches the results of directory lookups, i.e. the mapping of (directory,name) to the inode
+ * number. Failed lookups are cached as well (negative entries), so that repeated lookups of
+ * non-existing files, like searching through PATH, don't scan the directory over and over
+ * again. Ext2Link updates the cache whenever it changes a directory. The cache is used by all
+ * threads of the filesystem and is protected by EXT2_DCACHE_LOCK.
+ */
+class Ext2DentryCache {
+	static const size_t HASH_SIZE	= 256;
+	/* longer names are not cached */
+	static const size_t NAME_LEN	= 40;
+
+	struct Entry {
+		ino_t dir;
+		/* the inode number or -ENOENT for negative entries */
+		ino_t ino;
+		size_t nameLen;
+		char name[NAME_LEN];
+		Entry *hnext;
+		Entry *prev;
+		Entry *next;
+	};
+
+public:
+	/**
+	 * Creates a dentry cache with <size> entries
+	 *
+	 * @param size the number of entries
+	 */
+	explicit Ext2DentryCache(size_t size);
+	~Ext2DentryCache() {
+		delete[] _entries;
+	}
+
+	/**
+	 * Looks up <name> in <dir>.
+	 *
+	 * @param dir the directory inode number
+	 * @param name the name
+	 * @param nameLen the length of the name
+	 * @param ino will be set to the inode number or -ENOENT on a hit
+	 * @return true if it was found in the cache
+	 */
+	bool lookup(ino_t dir,const char *name,size_t nameLen,ino_t *ino);
+
+	/**
+	 * Caches the result of a lookup of <name> in <dir>. Replaces an existing entry.
+	 *
+	 * @param dir the directory inode number
+	 * @param name the name
+	 * @param nameLen the length of the name
+	 * @param ino the inode number or -ENOENT
+	 */
+	void insert(ino_t dir,const char *name,size_t nameLen,ino_t ino);
+
+	/**
+	 * Removes all entries of the given directory, which is necessary if it is deleted.
+	 *
+	 * @param dir the directory inode number
+	 */
+	void removeDir(ino_t dir);
+
+	/**
+	 * Prints statistics about the cache into the given file
+	 *
+	 * @param f the file
+	 */
+	void print(FILE *f);
+
+private:
+	static size_t hash(ino_t dir,const char *name,size_t nameLen) {
+		/* FNV-1a */
+		size_t h = 2166136261u ^ dir;
+		for(size_t i = 0; i < nameLen; ++i)
+			h = (h ^ (uchar)name[i]) * 16777619u;
+		return h % HASH_SIZE;
+	}
+	Entry *find(ino_t dir,const char *name,size_t nameLen);
+	void unhash(Entry *e);
+	void lruRemove(Entry *e);
+	void lruPrepend(Entry *e);
+
+	size_t _size;
+	Entry *_entries;
+	Entry *_hashmap[HASH_SIZE];
+	/* all used entries, from the most to the least recently used one */
+	Entry *_lruFirst;
+	Entry *_lruLast;
+	Entry *_freeList;
+	size_t _hits;
+	size_t _negHits;
+	size_t _misses;
+};
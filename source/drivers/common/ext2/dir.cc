@@ -28,6 +28,7 @@
 #include "dir.h"
 #include "ext2.h"
 #include "file.h"
+#include "htree.h"
 #include "inodecache.h"
 #include "link.h"
 
@@ -72,6 +73,20 @@ ino_t Ext2Dir::find(Ext2FileSystem *e,Ext2CInode *dir,const char *name,size_t na
 	ino_t ino;
 	size_t size = le32tocpu(dir->inode.size);
 	int res;
+
+	if(e->dentryCache.lookup(dir->inodeNo,name,nameLen,&ino))
+		return ino;
+
+	/* use the index, if there is a usable one */
+	if(Ext2HTree::isIndexed(e,dir)) {
+		ino = Ext2HTree::find(e,dir,name,nameLen);
+		if(ino != -ENOTSUP) {
+			if(ino >= 0 || ino == -ENOENT)
+				e->dentryCache.insert(dir->inodeNo,name,nameLen,ino);
+			return ino;
+		}
+	}
+
 	Ext2DirEntry *buffer = (Ext2DirEntry*)malloc(size);
 	if(buffer == NULL)
 		return -ENOMEM;
@@ -82,7 +97,9 @@ ino_t Ext2Dir::find(Ext2FileSystem *e,Ext2CInode *dir,const char *name,size_t na
 		return res;
 	}
 
+	/* remember the result, no matter whether it exists or not */
 	ino = findIn(buffer,size,name,nameLen);
+	e->dentryCache.insert(dir->inodeNo,name,nameLen,ino);
 	free(buffer);
 	return ino;
 }
@@ -91,10 +108,11 @@ ino_t Ext2Dir::findIn(Ext2DirEntry *buffer,size_t bufSize,const char *name,size_
 	ssize_t rem = bufSize;
 	Ext2DirEntry *entry = buffer;
 
-	/* search the directory-entries */
-	while(rem > 0 && le32tocpu(entry->inode) != 0) {
+	/* search the directory-entries. skip free ones, which have an inode number of 0 */
+	while(rem > 0 && le16tocpu(entry->recLen) > 0) {
 		/* found a match? */
-		if(nameLen == le16tocpu(entry->nameLen) && strncmp(entry->name,name,nameLen) == 0) {
+		if(le32tocpu(entry->inode) != 0 && nameLen == entry->nameLen &&
+				strncmp(entry->name,name,nameLen) == 0) {
 			ino_t ino = le32tocpu(entry->inode);
 			return ino;
 		}
@@ -131,6 +149,7 @@ int Ext2Dir::remove(Ext2FileSystem *e,User *u,Ext2CInode *dir,const char *name)
 		goto errorPerm;
 
 	/* read the directory */
+	size = le32tocpu(delIno->inode.size);
 	buffer = (Ext2DirEntry*)malloc(size);
 	if(buffer == NULL) {
 		res = -ENOMEM;
@@ -141,10 +160,10 @@ int Ext2Dir::remove(Ext2FileSystem *e,User *u,Ext2CInode *dir,const char *name)
 
 	/* search for other entries than '.' and '..' */
 	entry = buffer;
-	while(size > 0 && entry->inode != 0) {
-		uint16_t namelen = le16tocpu(entry->nameLen);
+	while(size > 0 && le16tocpu(entry->recLen) > 0) {
+		uint16_t namelen = entry->nameLen;
 		/* found a match? */
-		if(namelen != 1 && namelen != 2 &&
+		if(entry->inode != 0 && namelen != 1 && namelen != 2 &&
 				strncmp(entry->name,".",namelen) != 0 &&
 				strncmp(entry->name,"..",namelen) != 0) {
 			res = -ENOTEMPTY;
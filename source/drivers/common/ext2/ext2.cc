@@ -26,6 +26,7 @@
 #include <sys/proc.h>
 #include <dirent.h>
 #include <errno.h>
+#include <getopt.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -49,18 +50,43 @@ static void sigTermHndl(int) {
 	fsdev->stop();
 }
 
+static void usage(const char *name) {
+	fprintf(stderr,"Usage: %s [-i <inodes>] [-t <threads>] <fsPath> <devicePath>\n",name);
+	fprintf(stderr,"    -i <inodes>: the initial size of the inode cache (%zu by default).\n",
+		EXT2_ICACHE_SIZE);
+	fprintf(stderr,"                 It grows if all inodes are in use.\n");
+	fprintf(stderr,"    -t <threads>: the number of threads that serve requests (%zu by default).\n",
+		EXT2_THREADS);
+	exit(EXIT_FAILURE);
+}
+
 int main(int argc,char *argv[]) {
-	if(argc != 3)
-		error("Usage: %s <fsPath> <devicePath>",argv[0]);
+	size_t icacheSize = EXT2_ICACHE_SIZE;
+	size_t threads = EXT2_THREADS;
+
+	int opt;
+	while((opt = getopt(argc,argv,"i:t:")) != -1) {
+		switch(opt) {
+			case 'i': icacheSize = strtoul(optarg,NULL,0); break;
+			case 't': threads = strtoul(optarg,NULL,0); break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if(optind + 2 != argc || icacheSize == 0 || threads == 0)
+		usage(argv[0]);
+
+	const char *fsPath = argv[optind];
+	const char *devPath = argv[optind + 1];
 
 	/* the backend has to be a block device */
-	if(!isblock(argv[2]))
-		error("'%s' is neither a block-device nor a regular file",argv[2]);
+	if(!isblock(devPath))
+		error("'%s' is neither a block-device nor a regular file",devPath);
 
 	if(signal(SIGTERM,sigTermHndl) == SIG_ERR)
 		error("Unable to set signal-handler for SIGTERM");
 
-	fsdev = new fs::FSDevice<fs::OpenFile>(new Ext2FileSystem(argv[2]),argv[1]);
+	fsdev = new fs::FSDevice<fs::OpenFile>(new Ext2FileSystem(devPath,icacheSize),fsPath,threads);
 	fsdev->loop();
 	return 0;
 }
@@ -80,13 +106,20 @@ static int open_device(const char *path) {
 	return fd;
 }
 
-Ext2FileSystem::Ext2FileSystem(const char *device)
+Ext2FileSystem::Ext2FileSystem(const char *device,size_t icacheSize)
 		: fd(open_device(device)), sb(this), bgs(this),
-		  inodeCache(this), blockCache(this) {
+		  inodeCache(this,icacheSize), blockCache(this), dentryCache(EXT2_DCACHE_SIZE) {
+	if(blockCache.startFlusher() < 0)
+		printe("Unable to start flusher thread");
+	if(blockCache.startPrefetcher() < 0)
+		printe("Unable to start prefetcher thread");
 }
 
 Ext2FileSystem::~Ext2FileSystem() {
-	/* write pending changes */
+	blockCache.stopPrefetcher();
+	blockCache.stopFlusher();
+	/* write pending changes, including the bitmaps without the preallocated blocks */
+	inodeCache.discardPrealloc();
 	sync();
 	::close(fd);
 }
@@ -209,7 +242,7 @@ int Ext2FileSystem::truncate(fs::OpenFile *file,off_t length) {
 }
 
 ssize_t Ext2FileSystem::read(fs::OpenFile *file,void *buffer,off_t offset,size_t count) {
-	return Ext2File::read(this,file->ino,buffer,offset,count);
+	return Ext2File::read(this,file->ino,buffer,offset,count,&file->readahead);
 }
 
 ssize_t Ext2FileSystem::write(fs::OpenFile *file,const void *buffer,off_t offset,size_t count) {
@@ -217,18 +250,37 @@ ssize_t Ext2FileSystem::write(fs::OpenFile *file,const void *buffer,off_t offset
 }
 
 int Ext2FileSystem::link(fs::OpenFile *dst,fs::OpenFile *dir,const char *name) {
+	/* directories can't be linked. the type of an inode never changes, so that we can check it
+	 * before we lock the inodes for the link */
+	Ext2CInode *cdst = inodeCache.request(dst->ino,IMODE_READ);
+	if(cdst == NULL)
+		return -ENOBUFS;
+	bool isdir = S_ISDIR(le16tocpu(cdst->inode.mode));
+	inodeCache.release(cdst);
+	if(isdir)
+		return -EISDIR;
 	return linkIno(dst->ino,dir,name,false);
 }
 
 int Ext2FileSystem::linkIno(ino_t dst,fs::OpenFile *dir,const char *name,bool isdir) {
 	int res;
 	Ext2CInode *cdir,*cdst;
-	cdir = inodeCache.request(dir->ino,IMODE_WRITE);
-	cdst = inodeCache.request(dst,IMODE_WRITE);
+	/* a directory can't be put into itself */
+	if(dst == dir->ino)
+		return -EINVAL;
+
+	/* a directory is always locked before the inodes in it, as Ext2Link::remove does. but if we
+	 * move a directory, there is no such relation, so that we lock them by their number */
+	if(isdir && dst < dir->ino) {
+		cdst = inodeCache.request(dst,IMODE_WRITE);
+		cdir = inodeCache.request(dir->ino,IMODE_WRITE);
+	}
+	else {
+		cdir = inodeCache.request(dir->ino,IMODE_WRITE);
+		cdst = inodeCache.request(dst,IMODE_WRITE);
+	}
 	if(cdir == NULL || cdst == NULL)
 		res = -ENOBUFS;
-	else if(!isdir && S_ISDIR(le16tocpu(cdst->inode.mode)))
-		res = -EISDIR;
 	else
 		res = Ext2Link::create(this,&dir->user,cdir,cdst,name);
 	inodeCache.release(cdir);
@@ -339,6 +391,8 @@ void Ext2FileSystem::print(FILE *f) {
 	blockCache.printStats(f);
 	fprintf(f,"Inode cache:\n");
 	inodeCache.print(f);
+	fprintf(f,"Dentry cache:\n");
+	dentryCache.print(f);
 }
 
 int Ext2FileSystem::hasPermission(Ext2CInode *cnode,fs::User *u,uint perms) {
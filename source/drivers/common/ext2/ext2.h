@@ -27,15 +27,28 @@
 #include <sys/endian.h>
 
 #include "bgmng.h"
+#include "dentrycache.h"
 #include "dir.h"
 #include "inodecache.h"
 #include "sbmng.h"
 
 static const size_t DISK_SECTOR_SIZE		= 512;
-static const size_t EXT2_ICACHE_SIZE		= 64;
+/* the default initial size of the inode cache */
+static const size_t EXT2_ICACHE_SIZE		= 256;
 static const size_t EXT2_BCACHE_SIZE		= 2048;
-
+static const size_t EXT2_DCACHE_SIZE		= 1024;
+/* the default number of threads that serve requests */
+static const size_t EXT2_THREADS			= 4;
+/* the number of blocks that are reserved for a regular file in addition to the requested one */
+static const size_t EXT2_PREALLOC_BLOCKS	= 7;
+
+/* protects the hashmap and the lists of the inode cache */
+static const uint EXT2_ICACHE_LOCK			= 0xF7180001;
 static const uint EXT2_SUPERBLOCK_LOCK		= 0xF7180002;
+/* serializes seek+read/write on the device */
+static const uint EXT2_DISK_LOCK			= 0xF7180003;
+/* protects the dentry cache */
+static const uint EXT2_DCACHE_LOCK			= 0xF7180004;
 
 class Ext2FileSystem : public fs::FileSystem<fs::OpenFile> {
 public:
@@ -52,7 +65,7 @@ public:
 		Ext2FileSystem *_fs;
 	};
 
-	explicit Ext2FileSystem(const char *device);
+	explicit Ext2FileSystem(const char *device,size_t icacheSize = EXT2_ICACHE_SIZE);
 	virtual ~Ext2FileSystem();
 
 	ino_t open(fs::User *u,const char *path,ssize_t *pos,ino_t root,uint flags,mode_t mode,int fd,
@@ -134,25 +147,24 @@ public:
 	}
 
 	/**
-	 * Determines the block of the given inode
+	 * Determines the block-group of the given block
 	 *
 	 * @param e the ext2-data
-	 * @param inodeNo the inode-number
-	 * @return the block-number
+	 * @param block the block-number
+	 * @return the block-group-number
 	 */
-	block_t getBlockOfInode(ino_t inodeNo) {
-		return (inodeNo - 1) / le32tocpu(sb.get()->inodesPerGroup);
+	block_t getGroupOfBlock(block_t block) {
+		return (block - le32tocpu(sb.get()->firstDataBlock)) / le32tocpu(sb.get()->blocksPerGroup);
 	}
 
 	/**
-	 * Determines the block-group of the given block
+	 * Determines the first block of the given block-group
 	 *
-	 * @param e the ext2-data
-	 * @param block the block-number
-	 * @return the block-group-number
+	 * @param group the block-group-number
+	 * @return the block-number
 	 */
-	block_t getGroupOfBlock(block_t block) {
-		return block / le32tocpu(sb.get()->blocksPerGroup);
+	block_t getFirstBlockOfGroup(block_t group) {
+		return le32tocpu(sb.get()->firstDataBlock) + group * le32tocpu(sb.get()->blocksPerGroup);
 	}
 
 	/**
@@ -163,7 +175,7 @@ public:
 	 * @return the block-group-number
 	 */
 	block_t getGroupOfInode(ino_t inodeNo) {
-		return inodeNo / le32tocpu(sb.get()->inodesPerGroup);
+		return (inodeNo - 1) / le32tocpu(sb.get()->inodesPerGroup);
 	}
 
 	/**
@@ -216,4 +228,5 @@ public:
 	/* caches */
 	Ext2INodeCache inodeCache;
 	Ext2BlockCache blockCache;
+	Ext2DentryCache dentryCache;
 };
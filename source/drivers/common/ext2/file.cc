@@ -83,6 +83,12 @@ int Ext2File::truncate(Ext2FileSystem *e,Ext2CInode *cnode,bool del) {
 	if(S_ISLNK(le16tocpu(cnode->inode.mode)) && le32tocpu(cnode->inode.size) < 60)
 		return 0;
 
+	/* the preallocated blocks would follow the old end of the file */
+	if((res = Ext2Bitmap::discardPrealloc(e,cnode)) < 0)
+		return res;
+	cnode->lastBlock = 0;
+	Ext2INode::clearExtents(cnode);
+
 	/* free direct blocks */
 	for(i = 0; i < EXT2_DIRBLOCK_COUNT; i++) {
 		if(le32tocpu(cnode->inode.dBlocks[i]) == 0)
@@ -140,7 +146,8 @@ int Ext2File::truncate(Ext2FileSystem *e,Ext2CInode *cnode,bool del) {
 	return 0;
 }
 
-ssize_t Ext2File::read(Ext2FileSystem *e,ino_t inodeNo,void *buffer,off_t offset,size_t count) {
+ssize_t Ext2File::read(Ext2FileSystem *e,ino_t inodeNo,void *buffer,off_t offset,size_t count,
+		fs::ReadAhead *ra) {
 	Ext2CInode *cnode;
 	ssize_t res;
 
@@ -150,7 +157,7 @@ ssize_t Ext2File::read(Ext2FileSystem *e,ino_t inodeNo,void *buffer,off_t offset
 		return -ENOBUFS;
 
 	/* read */
-	res = readIno(e,cnode,buffer,offset,count);
+	res = readIno(e,cnode,buffer,offset,count,ra);
 	if(res <= 0) {
 		e->inodeCache.release(cnode);
 		return res;
@@ -164,7 +171,8 @@ ssize_t Ext2File::read(Ext2FileSystem *e,ino_t inodeNo,void *buffer,off_t offset
 	return res;
 }
 
-ssize_t Ext2File::readIno(Ext2FileSystem *e,const Ext2CInode *cnode,void *buffer,off_t offset,size_t count) {
+ssize_t Ext2File::readIno(Ext2FileSystem *e,const Ext2CInode *cnode,void *buffer,off_t offset,
+		size_t count,fs::ReadAhead *ra) {
 	/* nothing left to read? */
 	int32_t inoSize = le32tocpu(cnode->inode.size);
 	if((int32_t)offset < 0 || (int32_t)offset >= inoSize)
@@ -193,9 +201,23 @@ ssize_t Ext2File::readIno(Ext2FileSystem *e,const Ext2CInode *cnode,void *buffer
 		/* use the offset in the first block; after the first one the offset is 0 anyway */
 		leftBytes = count;
 		bufWork = (uint8_t*)buffer;
+		block_t block = 0;
+		size_t run = 0;
 		for(i = 0; i < blockCount; i++) {
-			/* request block */
-			block_t block = Ext2INode::getDataBlock(e,cnode,startBlock + i);
+			/* fetch the following blocks at once */
+			if(blockCount > 1 && i % BlockCache::MAX_BATCH == 0) {
+				prefetch(e,cnode,startBlock + i,
+					esc::Util::min(blockCount - i,BlockCache::MAX_BATCH),false);
+			}
+
+			/* request block; resolve the following blocks as well, if they are contiguous */
+			if(run == 0) {
+				run = blockCount - i;
+				block = Ext2INode::getDataBlocks(e,cnode,startBlock + i,&run);
+			}
+			else
+				block++;
+			run--;
 			CBlock *tmpBuffer = e->blockCache.request(block,BlockCache::READ);
 			if(tmpBuffer == NULL)
 				return -ENOBUFS;
@@ -213,10 +235,40 @@ ssize_t Ext2File::readIno(Ext2FileSystem *e,const Ext2CInode *cnode,void *buffer
 			/* offset is always 0 for additional blocks */
 			offset = 0;
 		}
+
+		/* read the next window in the background, if the reader has reached the marker. but
+		 * don't go beyond the end of the file */
+		block_t rastart = 0;
+		size_t ahead = ra ? ra->access(startBlock,blockCount,&rastart) : 0;
+		size_t fileBlocks = (inoSize + blockSize - 1) / blockSize;
+		if(ahead > 0 && rastart < fileBlocks)
+			prefetch(e,cnode,rastart,esc::Util::min(ahead,fileBlocks - rastart),true);
 	}
 	return count;
 }
 
+void Ext2File::prefetch(Ext2FileSystem *e,const Ext2CInode *cnode,block_t first,size_t count,
+		bool async) {
+	block_t blocks[BlockCache::MAX_BATCH];
+	while(count > 0) {
+		size_t n = esc::Util::min(count,BlockCache::MAX_BATCH);
+		for(size_t i = 0; i < n; ) {
+			/* resolve contiguous blocks at once */
+			size_t run = n - i;
+			block_t bno = Ext2INode::getDataBlocks(e,cnode,first + i,&run);
+			for(size_t j = 0; j < run; ++j)
+				blocks[i + j] = bno + j;
+			i += run;
+		}
+		if(async)
+			e->blockCache.prefetchAsync(blocks,n);
+		else
+			e->blockCache.prefetch(blocks,n);
+		first += n;
+		count -= n;
+	}
+}
+
 ssize_t Ext2File::write(Ext2FileSystem *e,ino_t inodeNo,const void *buffer,off_t offset,size_t count) {
 	/* at first we need the inode */
 	Ext2CInode *cnode = e->inodeCache.request(inodeNo,IMODE_WRITE);
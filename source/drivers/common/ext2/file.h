@@ -69,9 +69,11 @@ public:
 	 * 	not copied anywhere
 	 * @param offset the offset
 	 * @param count the number of bytes to read
+	 * @param ra the readahead-state of the open file (NULL = no readahead)
 	 * @return the number of read bytes
 	 */
-	static ssize_t read(Ext2FileSystem *e,ino_t inodeNo,void *buffer,off_t offset,size_t count);
+	static ssize_t read(Ext2FileSystem *e,ino_t inodeNo,void *buffer,off_t offset,size_t count,
+		fs::ReadAhead *ra = NULL);
 
 	/**
 	 * Reads <count> bytes at <offset> into <buffer> from the given cached inode. It will not
@@ -83,9 +85,11 @@ public:
 	 * 	not copied anywhere
 	 * @param offset the offset
 	 * @param count the number of bytes to read
+	 * @param ra the readahead-state of the open file (NULL = no readahead)
 	 * @return the number of read bytes
 	 */
-	static ssize_t readIno(Ext2FileSystem *e,const Ext2CInode *cnode,void *buffer,off_t offset,size_t count);
+	static ssize_t readIno(Ext2FileSystem *e,const Ext2CInode *cnode,void *buffer,off_t offset,
+		size_t count,fs::ReadAhead *ra = NULL);
 
 	/**
 	 * Writes <count> bytes at <offset> from <buffer> to the inode with given number. Will
@@ -122,4 +126,10 @@ private:
 	 * Free's the given singly-indirect-block
 	 */
 	static int freeIndirBlock(Ext2FileSystem *e,block_t blockNo);
+	/**
+	 * Brings the blocks <first> .. <first>+<count>-1 of the given inode into the block cache. If
+	 * <async> is true, the blocks are only resolved here and read by the prefetcher thread.
+	 */
+	static void prefetch(Ext2FileSystem *e,const Ext2CInode *cnode,block_t first,size_t count,
+		bool async);
 };
@@ -0,0 +1,653 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include <fs/blockcache.h>
+#include <sys/common.h>
+#include <sys/endian.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ext2.h"
+#include "file.h"
+#include "htree.h"
+#include "inode.h"
+#include "inodecache.h"
+#include "link.h"
+
+using namespace fs;
+
+/* the offset of the root info in the first block, behind "." and ".." */
+static const size_t ROOT_INFO_OFF		= 24;
+/* the offset of the entries in the other index blocks, behind the empty directory entry */
+static const size_t NODE_ENTRIES_OFF	= 8;
+/* the upper bits of block numbers in index entries are reserved */
+static const uint32_t BLOCK_MASK		= 0x0FFFFFFF;
+/* the hash that marks the end of the directory in Linux' readdir; it's never used */
+static const uint32_t HASH_EOF			= 0x7FFFFFFF;
+
+/* the hash, position and size of a directory entry, used to split leaf blocks */
+struct EntryMap {
+	uint32_t hash;
+	uint16_t off;
+	uint16_t size;
+};
+
+static int compareEntries(const void *a,const void *b) {
+	uint32_t h1 = static_cast<const EntryMap*>(a)->hash;
+	uint32_t h2 = static_cast<const EntryMap*>(b)->hash;
+	return h1 < h2 ? -1 : (h1 > h2 ? 1 : 0);
+}
+
+static inline uint32_t rol32(uint32_t word,uint shift) {
+	return (word << shift) | (word >> (32 - shift));
+}
+
+static void teaTransform(uint32_t buf[4],const uint32_t in[4]) {
+	uint32_t sum = 0;
+	uint32_t b0 = buf[0], b1 = buf[1];
+	uint32_t a = in[0], b = in[1], c = in[2], d = in[3];
+	for(int n = 0; n < 16; ++n) {
+		sum += 0x9E3779B9;
+		b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+		b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+	}
+	buf[0] += b0;
+	buf[1] += b1;
+}
+
+#define F(x,y,z)				((z) ^ ((x) & ((y) ^ (z))))
+#define G(x,y,z)				(((x) & (y)) + (((x) ^ (y)) & (z)))
+#define H(x,y,z)				((x) ^ (y) ^ (z))
+#define ROUND(f,a,b,c,d,x,s)	(a += f(b,c,d) + (x), a = rol32(a,s))
+#define K1						0
+#define K2						013240474631U
+#define K3						015666365641U
+
+static void halfMD4Transform(uint32_t buf[4],const uint32_t in[8]) {
+	uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+	ROUND(F,a,b,c,d,in[0] + K1,3);
+	ROUND(F,d,a,b,c,in[1] + K1,7);
+	ROUND(F,c,d,a,b,in[2] + K1,11);
+	ROUND(F,b,c,d,a,in[3] + K1,19);
+	ROUND(F,a,b,c,d,in[4] + K1,3);
+	ROUND(F,d,a,b,c,in[5] + K1,7);
+	ROUND(F,c,d,a,b,in[6] + K1,11);
+	ROUND(F,b,c,d,a,in[7] + K1,19);
+
+	ROUND(G,a,b,c,d,in[1] + K2,3);
+	ROUND(G,d,a,b,c,in[3] + K2,5);
+	ROUND(G,c,d,a,b,in[5] + K2,9);
+	ROUND(G,b,c,d,a,in[7] + K2,13);
+	ROUND(G,a,b,c,d,in[0] + K2,3);
+	ROUND(G,d,a,b,c,in[2] + K2,5);
+	ROUND(G,c,d,a,b,in[4] + K2,9);
+	ROUND(G,b,c,d,a,in[6] + K2,13);
+
+	ROUND(H,a,b,c,d,in[3] + K3,3);
+	ROUND(H,d,a,b,c,in[7] + K3,9);
+	ROUND(H,c,d,a,b,in[2] + K3,11);
+	ROUND(H,b,c,d,a,in[6] + K3,15);
+	ROUND(H,a,b,c,d,in[1] + K3,3);
+	ROUND(H,d,a,b,c,in[5] + K3,9);
+	ROUND(H,c,d,a,b,in[0] + K3,11);
+	ROUND(H,b,c,d,a,in[4] + K3,15);
+
+	buf[0] += a;
+	buf[1] += b;
+	buf[2] += c;
+	buf[3] += d;
+}
+
+/* the original hash of the htree implementation. Linux hashed the chars signed or unsigned,
+ * depending on the architecture. */
+template<typename CHAR>
+static uint32_t legacyHash(const char *name,size_t len) {
+	uint32_t hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+	const CHAR *cp = reinterpret_cast<const CHAR*>(name);
+	while(len-- > 0) {
+		hash = hash1 + (hash0 ^ (uint32_t)((int)*cp++ * 7152373));
+		if(hash & 0x80000000)
+			hash -= 0x7fffffff;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+	return hash0 << 1;
+}
+
+/* converts the name into <num> words for TEA and half-MD4 */
+template<typename CHAR>
+static void strToHashBuf(const char *msg,size_t len,uint32_t *buf,int num) {
+	const CHAR *cp = reinterpret_cast<const CHAR*>(msg);
+	uint32_t pad = (uint32_t)len | ((uint32_t)len << 8);
+	pad |= pad << 16;
+
+	uint32_t val = pad;
+	if(len > (size_t)num * 4)
+		len = num * 4;
+	for(size_t i = 0; i < len; i++) {
+		val = (uint32_t)(int)cp[i] + (val << 8);
+		if((i % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if(--num >= 0)
+		*buf++ = val;
+	while(--num >= 0)
+		*buf++ = pad;
+}
+
+uint32_t Ext2HTree::hash(Ext2FileSystem *e,uint version,const char *name,size_t nameLen) {
+	uint32_t buf[4] = {0x67452301,0xefcdab89,0x98badcfe,0x10325476};
+	uint32_t in[8];
+	uint32_t hash;
+
+	/* use the seed from the superblock, unless it's zero */
+	const Ext2SuperBlock *sb = e->sb.get();
+	if(sb->hashSeed[0] || sb->hashSeed[1] || sb->hashSeed[2] || sb->hashSeed[3]) {
+		for(size_t i = 0; i < 4; ++i)
+			buf[i] = le32tocpu(sb->hashSeed[i]);
+	}
+
+	switch(version) {
+		case EXT2_HASH_LEGACY:
+			hash = legacyHash<signed char>(name,nameLen);
+			break;
+		case EXT2_HASH_LEGACY_UNSIGNED:
+			hash = legacyHash<unsigned char>(name,nameLen);
+			break;
+
+		case EXT2_HASH_HALF_MD4:
+		case EXT2_HASH_HALF_MD4_UNSIGNED:
+			for(ssize_t len = nameLen; len > 0; len -= 32, name += 32) {
+				if(version == EXT2_HASH_HALF_MD4)
+					strToHashBuf<signed char>(name,len,in,8);
+				else
+					strToHashBuf<unsigned char>(name,len,in,8);
+				halfMD4Transform(buf,in);
+			}
+			hash = buf[1];
+			break;
+
+		case EXT2_HASH_TEA:
+		case EXT2_HASH_TEA_UNSIGNED:
+			for(ssize_t len = nameLen; len > 0; len -= 16, name += 16) {
+				if(version == EXT2_HASH_TEA)
+					strToHashBuf<signed char>(name,len,in,4);
+				else
+					strToHashBuf<unsigned char>(name,len,in,4);
+				teaTransform(buf,in);
+			}
+			hash = buf[0];
+			break;
+
+		default:
+			return 0;
+	}
+
+	/* the lowest bit is used to mark collisions in the index */
+	hash &= ~1;
+	if(hash == (HASH_EOF << 1))
+		hash = (HASH_EOF - 1) << 1;
+	return hash;
+}
+
+bool Ext2HTree::isIndexed(Ext2FileSystem *e,const Ext2CInode *dir) {
+	return (le32tocpu(e->sb.get()->featureCompat) & EXT2_FEATURE_COMPAT_DIR_INDEX) &&
+		(le32tocpu(dir->inode.flags) & EXT2_INDEX_FL);
+}
+
+void Ext2HTree::dropIndex(Ext2FileSystem *e,Ext2CInode *dir) {
+	dir->inode.flags = cputole32(le32tocpu(dir->inode.flags) & ~EXT2_INDEX_FL);
+	e->inodeCache.markDirty(dir);
+}
+
+ino_t Ext2HTree::find(Ext2FileSystem *e,Ext2CInode *dir,const char *name,size_t nameLen) {
+	Frame frames[MAX_LEVELS + 1];
+	size_t levels;
+	uint version;
+	uint32_t hash;
+	ino_t ino;
+
+	/* "." and ".." are always in the first block */
+	if(nameLen <= 2 && name[0] == '.' && (nameLen == 1 || name[1] == '.')) {
+		CBlock *first = getBlock(e,dir,0,BlockCache::READ);
+		if(first == NULL)
+			return -ENOBUFS;
+		ino = findInBlock((uint8_t*)first->buffer,e->blockSize(),name,nameLen);
+		e->blockCache.release(first);
+		return ino;
+	}
+
+	int res = probe(e,dir,name,nameLen,BlockCache::READ,frames,&levels,&version,&hash);
+	if(res < 0)
+		return res;
+
+	do {
+		Frame *f = frames + levels;
+		CBlock *leaf = getBlock(e,dir,le32tocpu(f->entries[f->pos].block) & BLOCK_MASK,
+			BlockCache::READ);
+		if(leaf == NULL) {
+			ino = -ENOBUFS;
+			break;
+		}
+		ino = findInBlock((uint8_t*)leaf->buffer,e->blockSize(),name,nameLen);
+		e->blockCache.release(leaf);
+	}
+	/* entries with the same hash might continue in the next block */
+	while(ino == -ENOENT && nextLeaf(e,dir,frames,levels,hash));
+
+	release(e,frames,levels);
+	return ino;
+}
+
+int Ext2HTree::add(Ext2FileSystem *e,Ext2CInode *dir,const char *name,size_t nameLen,ino_t ino,
+		uint8_t type) {
+	Frame frames[MAX_LEVELS + 1];
+	size_t levels;
+	uint version;
+	uint32_t hash;
+	size_t bsize = e->blockSize();
+
+	int res = probe(e,dir,name,nameLen,BlockCache::WRITE,frames,&levels,&version,&hash);
+	if(res < 0)
+		return res;
+
+	Frame *f = frames + levels;
+	CBlock *leaf = getBlock(e,dir,le32tocpu(f->entries[f->pos].block) & BLOCK_MASK,
+		BlockCache::WRITE);
+	if(leaf == NULL) {
+		release(e,frames,levels);
+		return -ENOBUFS;
+	}
+
+	/* if it fits into the leaf, we're done */
+	if(insertInBlock((uint8_t*)leaf->buffer,bsize,name,nameLen,ino,type)) {
+		e->blockCache.markDirty(leaf);
+		goto done;
+	}
+
+	/* otherwise, we need a new leaf and thus room in the index for it */
+	if((res = makeRoom(e,dir,frames,&levels)) < 0)
+		goto done;
+	f = frames + levels;
+
+	{
+		/* sort the entries of the leaf by hash */
+		uint8_t *old = (uint8_t*)malloc(bsize * 2);
+		EntryMap *map = (EntryMap*)malloc(sizeof(EntryMap) * (bsize / 12 + 1));
+		if(!old || !map) {
+			free(old);
+			free(map);
+			res = -ENOMEM;
+			goto done;
+		}
+		uint8_t *nblock = old + bsize;
+		memcpy(old,leaf->buffer,bsize);
+
+		size_t count = 0;
+		for(size_t off = 0; off + sizeof(Ext2DirEntry) <= bsize; ) {
+			Ext2DirEntry *de = (Ext2DirEntry*)(old + off);
+			size_t recLen = le16tocpu(de->recLen);
+			if(recLen < sizeof(Ext2DirEntry) || off + recLen > bsize)
+				break;
+			if(de->inode != 0) {
+				size_t len = de->nameLen;
+				map[count].hash = Ext2HTree::hash(e,version,de->name,len);
+				map[count].off = off;
+				/* don't copy beyond the record, if the name length is bogus */
+				map[count].size = MIN(Ext2Link::getDirESize(len),recLen);
+				count++;
+			}
+			off += recLen;
+		}
+		qsort(map,count,sizeof(EntryMap),compareEntries);
+
+		/* move entries from the end into the new block until it is half full. splitting by the
+		 * number of entries could leave one half too full for the new entry, if the names differ
+		 * in length. if the hash continues there, mark that in the index entry, so that lookups
+		 * continue in the next block */
+		size_t split = count, moved = 0;
+		while(split > 1 && moved + map[split - 1].size <= bsize / 2)
+			moved += map[--split].size;
+		uint32_t hash2 = split < count ? map[split].hash : hash;
+		if(split > 0 && split < count && map[split - 1].hash == hash2)
+			hash2 |= 1;
+
+		uint8_t *blocks[] = {nblock,(uint8_t*)leaf->buffer};
+		size_t ranges[][2] = {{split,count},{0,split}};
+		for(size_t b = 0; b < 2; ++b) {
+			size_t total = 0;
+			for(size_t i = ranges[b][0]; i < ranges[b][1]; ++i)
+				total += map[i].size;
+			/* the entries have been in one block before, so this is just a sanity check */
+			if(total > bsize) {
+				free(map);
+				free(old);
+				res = -ENOTSUP;
+				goto done;
+			}
+		}
+		for(size_t b = 0; b < 2; ++b) {
+			size_t off = 0;
+			Ext2DirEntry *last = NULL;
+			for(size_t i = ranges[b][0]; i < ranges[b][1]; ++i) {
+				last = (Ext2DirEntry*)(blocks[b] + off);
+				memcpy(last,old + map[i].off,map[i].size);
+				last->recLen = cputole16(map[i].size);
+				off += map[i].size;
+			}
+			if(last == NULL) {
+				last = (Ext2DirEntry*)blocks[b];
+				last->inode = 0;
+				last->nameLen = 0;
+				last->fileType = EXT2_FT_UNKNOWN;
+				off = 0;
+			}
+			else
+				off -= le16tocpu(last->recLen);
+			last->recLen = cputole16(bsize - off);
+		}
+
+		/* now there should be enough space for the new entry in one of them. write the new
+		 * block first and restore the old one on failure */
+		uint8_t *target = hash >= hash2 ? nblock : (uint8_t*)leaf->buffer;
+		block_t nblockNo;
+		if(!insertInBlock(target,bsize,name,nameLen,ino,type))
+			res = -ENOTSUP;
+		else
+			res = appendBlock(e,dir,nblock,&nblockNo);
+		if(res < 0)
+			memcpy(leaf->buffer,old,bsize);
+		else {
+			e->blockCache.markDirty(leaf);
+			insertEntry(e,f,hash2,nblockNo);
+		}
+		free(map);
+		free(old);
+	}
+
+done:
+	e->blockCache.release(leaf);
+	release(e,frames,levels);
+	return res;
+}
+
+int Ext2HTree::probe(Ext2FileSystem *e,Ext2CInode *dir,const char *name,size_t nameLen,uint mode,
+		Frame *frames,size_t *levels,uint *version,uint32_t *hash) {
+	CBlock *block = getBlock(e,dir,0,mode);
+	if(block == NULL)
+		return -ENOBUFS;
+
+	/* check whether we support this index */
+	Ext2DxRootInfo *info = (Ext2DxRootInfo*)((uint8_t*)block->buffer + ROOT_INFO_OFF);
+	*version = info->hashVersion;
+	if(*version <= EXT2_HASH_TEA && (le32tocpu(e->sb.get()->flags) & EXT2_FLAGS_UNSIGNED_HASH))
+		*version += EXT2_HASH_LEGACY_UNSIGNED;
+	if(info->reservedZero != 0 || *version > EXT2_HASH_TEA_UNSIGNED ||
+			info->indirectLevels > MAX_LEVELS || info->infoLength < sizeof(Ext2DxRootInfo)) {
+		e->blockCache.release(block);
+		return -ENOTSUP;
+	}
+
+	*hash = Ext2HTree::hash(e,*version,name,nameLen);
+	*levels = info->indirectLevels;
+
+	Ext2DxEntry *entries = (Ext2DxEntry*)((uint8_t*)info + info->infoLength);
+	for(size_t l = 0; ; ++l) {
+		Ext2DxCountLimit *cl = (Ext2DxCountLimit*)entries;
+		size_t count = le16tocpu(cl->count);
+		if(count == 0 || count > le16tocpu(cl->limit)) {
+			e->blockCache.release(block);
+			if(l > 0)
+				release(e,frames,l - 1);
+			return -ENOTSUP;
+		}
+
+		/* search for the last entry whose hash is <= ours. the first one has no hash */
+		size_t lo = 1, hi = count;
+		while(lo < hi) {
+			size_t mid = (lo + hi) / 2;
+			if(le32tocpu(entries[mid].hash) > *hash)
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+
+		frames[l].block = block;
+		frames[l].entries = entries;
+		frames[l].pos = lo - 1;
+		if(l == *levels)
+			break;
+
+		block = getBlock(e,dir,le32tocpu(entries[lo - 1].block) & BLOCK_MASK,mode);
+		if(block == NULL) {
+			release(e,frames,l);
+			return -ENOBUFS;
+		}
+		entries = (Ext2DxEntry*)((uint8_t*)block->buffer + NODE_ENTRIES_OFF);
+	}
+	return 0;
+}
+
+bool Ext2HTree::nextLeaf(Ext2FileSystem *e,Ext2CInode *dir,Frame *frames,size_t levels,
+		uint32_t hash) {
+	/* go up until there is a next entry */
+	ssize_t l = levels;
+	while(l >= 0) {
+		Ext2DxCountLimit *cl = (Ext2DxCountLimit*)frames[l].entries;
+		if(frames[l].pos + 1 < le16tocpu(cl->count))
+			break;
+		l--;
+	}
+	if(l < 0)
+		return false;
+
+	frames[l].pos++;
+	if((le32tocpu(frames[l].entries[frames[l].pos].hash) & ~1) != hash)
+		return false;
+
+	/* and down again to the first entry */
+	for(++l; l <= (ssize_t)levels; ++l) {
+		block_t no = le32tocpu(frames[l - 1].entries[frames[l - 1].pos].block) & BLOCK_MASK;
+		CBlock *block = getBlock(e,dir,no,BlockCache::READ);
+		if(block == NULL)
+			return false;
+		e->blockCache.release(frames[l].block);
+		frames[l].block = block;
+		frames[l].entries = (Ext2DxEntry*)((uint8_t*)block->buffer + NODE_ENTRIES_OFF);
+		frames[l].pos = 0;
+	}
+	return true;
+}
+
+void Ext2HTree::release(Ext2FileSystem *e,Frame *frames,size_t levels) {
+	for(ssize_t l = levels; l >= 0; --l)
+		e->blockCache.release(frames[l].block);
+}
+
+int Ext2HTree::makeRoom(Ext2FileSystem *e,Ext2CInode *dir,Frame *frames,size_t *levels) {
+	size_t bsize = e->blockSize();
+	Frame *f = frames + *levels;
+	Ext2DxCountLimit *cl = (Ext2DxCountLimit*)f->entries;
+	size_t count = le16tocpu(cl->count);
+	if(count < le16tocpu(cl->limit))
+		return 0;
+
+	/* don't go beyond the levels that are supported by other implementations */
+	if(*levels == MAX_LEVELS) {
+		Ext2DxCountLimit *rcl = (Ext2DxCountLimit*)frames[0].entries;
+		if(le16tocpu(rcl->count) >= le16tocpu(rcl->limit))
+			return -ENOTSUP;
+	}
+
+	uint8_t *buf = (uint8_t*)calloc(1,bsize);
+	if(!buf)
+		return -ENOMEM;
+	Ext2DirEntry *de = (Ext2DirEntry*)buf;
+	de->recLen = cputole16(bsize);
+	Ext2DxEntry *nentries = (Ext2DxEntry*)(buf + NODE_ENTRIES_OFF);
+	Ext2DxCountLimit *ncl = (Ext2DxCountLimit*)nentries;
+
+	int res;
+	block_t nodeNo;
+	/* the root is full: move all entries into a new index block below it */
+	if(*levels == 0) {
+		memcpy(nentries,f->entries,count * sizeof(Ext2DxEntry));
+		ncl->limit = cputole16((bsize - NODE_ENTRIES_OFF) / sizeof(Ext2DxEntry));
+		ncl->count = cputole16(count);
+		if((res = appendBlock(e,dir,buf,&nodeNo)) < 0)
+			goto error;
+
+		CBlock *node = getBlock(e,dir,nodeNo,BlockCache::WRITE);
+		if(node == NULL) {
+			res = -ENOBUFS;
+			goto error;
+		}
+
+		uint8_t *root = (uint8_t*)frames[0].block->buffer;
+		((Ext2DxRootInfo*)(root + ROOT_INFO_OFF))->indirectLevels = 1;
+		cl->count = cputole16(1);
+		f->entries[0].block = cputole32(nodeNo);
+		e->blockCache.markDirty(frames[0].block);
+
+		frames[1].block = node;
+		frames[1].entries = (Ext2DxEntry*)((uint8_t*)node->buffer + NODE_ENTRIES_OFF);
+		frames[1].pos = frames[0].pos;
+		frames[0].pos = 0;
+		*levels = 1;
+	}
+	/* split the index block and add the new one to the root */
+	else {
+		size_t half = count / 2;
+		memcpy(nentries,f->entries + half,(count - half) * sizeof(Ext2DxEntry));
+		ncl->limit = cl->limit;
+		ncl->count = cputole16(count - half);
+		if((res = appendBlock(e,dir,buf,&nodeNo)) < 0)
+			goto error;
+
+		uint32_t key = le32tocpu(f->entries[half].hash);
+		cl->count = cputole16(half);
+		e->blockCache.markDirty(f->block);
+		insertEntry(e,frames,key,nodeNo);
+
+		/* continue in the new one, if our position has been moved */
+		if(f->pos >= half) {
+			CBlock *node = getBlock(e,dir,nodeNo,BlockCache::WRITE);
+			if(node == NULL) {
+				res = -ENOBUFS;
+				goto error;
+			}
+			e->blockCache.release(f->block);
+			f->block = node;
+			f->entries = (Ext2DxEntry*)((uint8_t*)node->buffer + NODE_ENTRIES_OFF);
+			f->pos -= half;
+			frames[0].pos++;
+		}
+	}
+	res = 0;
+
+error:
+	free(buf);
+	return res;
+}
+
+void Ext2HTree::insertEntry(Ext2FileSystem *e,Frame *frame,uint32_t hash,uint32_t block) {
+	Ext2DxCountLimit *cl = (Ext2DxCountLimit*)frame->entries;
+	size_t count = le16tocpu(cl->count);
+	assert(count < le16tocpu(cl->limit));
+	Ext2DxEntry *pos = frame->entries + frame->pos + 1;
+	memmove(pos + 1,pos,(count - frame->pos - 1) * sizeof(Ext2DxEntry));
+	pos->hash = cputole32(hash);
+	pos->block = cputole32(block);
+	cl->count = cputole16(count + 1);
+	e->blockCache.markDirty(frame->block);
+}
+
+int Ext2HTree::appendBlock(Ext2FileSystem *e,Ext2CInode *dir,const void *buffer,block_t *block) {
+	size_t bsize = e->blockSize();
+	int32_t size = le32tocpu(dir->inode.size);
+	*block = size / bsize;
+	ssize_t res = Ext2File::writeIno(e,dir,buffer,size,bsize);
+	if(res != (ssize_t)bsize)
+		return res < 0 ? res : -ENOSPC;
+	return 0;
+}
+
+CBlock *Ext2HTree::getBlock(Ext2FileSystem *e,const Ext2CInode *dir,block_t block,uint mode) {
+	if(block >= e->bytesToBlocks(le32tocpu(dir->inode.size)))
+		return NULL;
+	block_t no = Ext2INode::getDataBlock(e,dir,block);
+	if(no == 0)
+		return NULL;
+	return e->blockCache.request(no,mode);
+}
+
+ino_t Ext2HTree::findInBlock(const uint8_t *buffer,size_t size,const char *name,size_t nameLen) {
+	for(size_t off = 0; off + sizeof(Ext2DirEntry) <= size; ) {
+		const Ext2DirEntry *de = (const Ext2DirEntry*)(buffer + off);
+		size_t recLen = le16tocpu(de->recLen);
+		if(recLen < sizeof(Ext2DirEntry) || off + recLen > size)
+			break;
+		if(de->inode != 0 && nameLen == de->nameLen &&
+				memcmp(de->name,name,nameLen) == 0)
+			return le32tocpu(de->inode);
+		off += recLen;
+	}
+	return -ENOENT;
+}
+
+bool Ext2HTree::insertInBlock(uint8_t *buffer,size_t size,const char *name,size_t nameLen,
+		ino_t ino,uint8_t type) {
+	size_t tlen = Ext2Link::getDirESize(nameLen);
+	for(size_t off = 0; off + sizeof(Ext2DirEntry) <= size; ) {
+		Ext2DirEntry *de = (Ext2DirEntry*)(buffer + off);
+		size_t recLen = le16tocpu(de->recLen);
+		if(recLen < sizeof(Ext2DirEntry) || off + recLen > size)
+			break;
+
+		/* use an empty entry or the unused space behind an entry */
+		Ext2DirEntry *nde = NULL;
+		if(de->inode == 0 && recLen >= tlen)
+			nde = de;
+		else {
+			size_t elen = Ext2Link::getDirESize(de->nameLen);
+			if(de->inode != 0 && recLen >= elen + tlen) {
+				de->recLen = cputole16(elen);
+				nde = (Ext2DirEntry*)((uint8_t*)de + elen);
+				nde->recLen = cputole16(recLen - elen);
+			}
+		}
+
+		if(nde) {
+			nde->inode = cputole32(ino);
+			nde->nameLen = nameLen;
+			nde->fileType = type;
+			memcpy(nde->name,name,nameLen);
+			return true;
+		}
+		off += recLen;
+	}
+	return false;
+}
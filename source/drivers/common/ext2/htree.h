@@ -0,0 +1,115 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#pragma once
+
+#include <fs/blockcache.h>
+#include <fs/ext2/ext2.h>
+#include <sys/common.h>
+
+struct Ext2CInode;
+class Ext2FileSystem;
+
+/**
+ * Support for hash-indexed directories (dir_index). The names are hashed and the index maps hash
+ * ranges to directory blocks, so that lookups and inserts only need to look at one leaf block.
+ * Errors of -ENOTSUP mean that the index can't be used (unknown format) or can't grow anymore. In
+ * this case, the directory should be treated as a linear one and the index should be dropped
+ * before the directory is changed.
+ */
+class Ext2HTree {
+	Ext2HTree() = delete;
+
+	/* the maximum number of index levels below the root */
+	static const size_t MAX_LEVELS	= 1;
+
+	struct Frame {
+		fs::CBlock *block;
+		fs::Ext2DxEntry *entries;
+		size_t pos;
+	};
+
+public:
+	/**
+	 * @param e the ext2-fs
+	 * @param dir the directory
+	 * @return true if <dir> has an index that we should use
+	 */
+	static bool isIndexed(Ext2FileSystem *e,const Ext2CInode *dir);
+
+	/**
+	 * Removes the index flag from the given directory, so that it is treated as a linear one.
+	 *
+	 * @param e the ext2-fs
+	 * @param dir the directory (requested for writing!)
+	 */
+	static void dropIndex(Ext2FileSystem *e,Ext2CInode *dir);
+
+	/**
+	 * Finds the inode-number to the entry <name> in <dir>, using the index
+	 *
+	 * @param e the ext2-fs
+	 * @param dir the directory
+	 * @param name the name of the entry to find
+	 * @param nameLen the length of the name
+	 * @return the inode-number, -ENOENT if not found or -ENOTSUP if the index is not usable
+	 */
+	static ino_t find(Ext2FileSystem *e,Ext2CInode *dir,const char *name,size_t nameLen);
+
+	/**
+	 * Adds the entry <name> for <ino> to <dir> and updates the index. The caller has to make sure
+	 * that the name does not exist yet.
+	 *
+	 * @param e the ext2-fs
+	 * @param dir the directory (requested for writing!)
+	 * @param name the name of the entry
+	 * @param nameLen the length of the name
+	 * @param ino the inode-number
+	 * @param type the file type to store in the entry (EXT2_FT_*)
+	 * @return 0 on success, -ENOTSUP if the index is not usable or full
+	 */
+	static int add(Ext2FileSystem *e,Ext2CInode *dir,const char *name,size_t nameLen,ino_t ino,
+		uint8_t type);
+
+	/**
+	 * Calculates the hash of given name, as it is stored in the index
+	 *
+	 * @param e the ext2-fs
+	 * @param version the hash version (EXT2_HASH_*)
+	 * @param name the name
+	 * @param nameLen the length of the name
+	 * @return the hash
+	 */
+	static uint32_t hash(Ext2FileSystem *e,uint version,const char *name,size_t nameLen);
+
+private:
+	static int probe(Ext2FileSystem *e,Ext2CInode *dir,const char *name,size_t nameLen,uint mode,
+		Frame *frames,size_t *levels,uint *version,uint32_t *hash);
+	static bool nextLeaf(Ext2FileSystem *e,Ext2CInode *dir,Frame *frames,size_t levels,
+		uint32_t hash);
+	static void release(Ext2FileSystem *e,Frame *frames,size_t levels);
+	static int makeRoom(Ext2FileSystem *e,Ext2CInode *dir,Frame *frames,size_t *levels);
+	static void insertEntry(Ext2FileSystem *e,Frame *frame,uint32_t hash,uint32_t block);
+	static int appendBlock(Ext2FileSystem *e,Ext2CInode *dir,const void *buffer,block_t *block);
+	static fs::CBlock *getBlock(Ext2FileSystem *e,const Ext2CInode *dir,block_t block,uint mode);
+	static ino_t findInBlock(const uint8_t *buffer,size_t size,const char *name,size_t nameLen);
+	static bool insertInBlock(uint8_t *buffer,size_t size,const char *name,size_t nameLen,
+		ino_t ino,uint8_t type);
+};
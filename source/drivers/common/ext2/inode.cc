@@ -17,6 +17,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <esc/util.h>
 #include <fs/blockcache.h>
 #include <fs/permissions.h>
 #include <sys/common.h>
@@ -146,7 +147,7 @@ int Ext2INode::destroy(Ext2FileSystem *e,Ext2CInode *cnode) {
 }
 
 block_t Ext2INode::accessIndirBlock(Ext2FileSystem *e,Ext2CInode *cnode,block_t *indir,block_t i,
-		bool req,int level,block_t div) {
+		bool req,int level,block_t div,block_t block) {
 	bool added = false;
 	uint bmode = req ? BlockCache::WRITE : BlockCache::READ;
 	size_t blockSize = e->blockSize();
@@ -187,6 +188,9 @@ block_t Ext2INode::accessIndirBlock(Ext2FileSystem *e,Ext2CInode *cnode,block_t
 			cnode->inode.blocks = cputole32(le32tocpu(cnode->inode.blocks) + e->blocksToSecs(1));
 			e->blockCache.markDirty(cblock);
 		}
+		/* remember the run around it, while we have the indirect-block at hand */
+		else
+			addExtent(e,cnode,blockNos,i,block);
 		bno = le32tocpu(blockNos[i]);
 	}
 	/* otherwise let the callee write the block-number into cblock */
@@ -195,7 +199,7 @@ block_t Ext2INode::accessIndirBlock(Ext2FileSystem *e,Ext2CInode *cnode,block_t
 		/* mark the block dirty, if the callee will write to it */
 		if(req && !*subIndir)
 			e->blockCache.markDirty(cblock);
-		bno = accessIndirBlock(e,cnode,subIndir,i % div,req,level - 1,div / blocksPerBlock);
+		bno = accessIndirBlock(e,cnode,subIndir,i % div,req,level - 1,div / blocksPerBlock,block);
 	}
 
 error:
@@ -203,9 +207,71 @@ error:
 	return bno;
 }
 
+block_t Ext2INode::getDataBlocks(Ext2FileSystem *e,const Ext2CInode *cnode,block_t block,
+		size_t *count) {
+	block_t bno = getDataBlock(e,cnode,block);
+	size_t n = 1;
+	if(bno != 0) {
+		if(block < EXT2_DIRBLOCK_COUNT) {
+			while(n < *count && block + n < EXT2_DIRBLOCK_COUNT &&
+					le32tocpu(cnode->inode.dBlocks[block + n]) == bno + n)
+				n++;
+		}
+		else {
+			/* getDataBlock has put the run into the cache, if it wasn't already there */
+			Ext2Extent ext;
+			if(findExtent(cnode,block,&ext))
+				n = esc::Util::min<size_t>(*count,ext.count - (block - ext.logical));
+		}
+	}
+	*count = n;
+	return bno;
+}
+
+void Ext2INode::clearExtents(Ext2CInode *cnode) {
+	for(size_t i = 0; i < EXT2_EXTENT_COUNT; ++i)
+		cnode->extents[i].count = 0;
+	cnode->nextExtent = 0;
+}
+
+bool Ext2INode::findExtent(const Ext2CInode *cnode,block_t block,Ext2Extent *ext) {
+	bool res = false;
+	sassert(tpool_lock((ulong)cnode->extents,LOCK_EXCLUSIVE) == 0);
+	for(size_t i = 0; i < EXT2_EXTENT_COUNT; ++i) {
+		const Ext2Extent *e = cnode->extents + i;
+		if(block >= e->logical && block - e->logical < e->count) {
+			*ext = *e;
+			res = true;
+			break;
+		}
+	}
+	sassert(tpool_unlock((ulong)cnode->extents) == 0);
+	return res;
+}
+
+void Ext2INode::addExtent(Ext2FileSystem *e,Ext2CInode *cnode,const block_t *blockNos,block_t i,
+		block_t block) {
+	size_t blocksPerBlock = e->blockSize() / sizeof(block_t);
+	block_t start = i, end = i + 1;
+	while(start > 0 && blockNos[start - 1] != 0 &&
+			le32tocpu(blockNos[start - 1]) + 1 == le32tocpu(blockNos[start]))
+		start--;
+	while(end < blocksPerBlock && le32tocpu(blockNos[end]) == le32tocpu(blockNos[end - 1]) + 1)
+		end++;
+
+	sassert(tpool_lock((ulong)cnode->extents,LOCK_EXCLUSIVE) == 0);
+	Ext2Extent *ext = cnode->extents + cnode->nextExtent;
+	ext->logical = block - (i - start);
+	ext->physical = le32tocpu(blockNos[start]);
+	ext->count = end - start;
+	cnode->nextExtent = (cnode->nextExtent + 1) % EXT2_EXTENT_COUNT;
+	sassert(tpool_unlock((ulong)cnode->extents) == 0);
+}
+
 block_t Ext2INode::doGetDataBlock(Ext2FileSystem *e,Ext2CInode *cnode,block_t block,bool req) {
 	size_t blockSize = e->blockSize();
 	size_t blocksPerBlock = blockSize / sizeof(block_t);
+	block_t lblock = block;
 
 	if(block < EXT2_DIRBLOCK_COUNT) {
 		block_t bno = le32tocpu(cnode->inode.dBlocks[block]);
@@ -220,18 +286,25 @@ block_t Ext2INode::doGetDataBlock(Ext2FileSystem *e,Ext2CInode *cnode,block_t bl
 		return bno;
 	}
 
+	/* the mapping of allocated blocks never changes, so that we can use the cached runs */
+	Ext2Extent ext;
+	if(findExtent(cnode,lblock,&ext))
+		return ext.physical + (lblock - ext.logical);
+
 	block -= EXT2_DIRBLOCK_COUNT;
 	if(block < blocksPerBlock)
-		return accessIndirBlock(e,cnode,&cnode->inode.singlyIBlock,block,req,0,1);
+		return accessIndirBlock(e,cnode,&cnode->inode.singlyIBlock,block,req,0,1,lblock);
 
 	block -= blocksPerBlock;
-	if(block < blocksPerBlock * blocksPerBlock)
-		return accessIndirBlock(e,cnode,&cnode->inode.doublyIBlock,block,req,1,blocksPerBlock);
+	if(block < blocksPerBlock * blocksPerBlock) {
+		return accessIndirBlock(e,cnode,&cnode->inode.doublyIBlock,block,req,1,blocksPerBlock,
+			lblock);
+	}
 
 	block -= blocksPerBlock * blocksPerBlock;
 	if(block < blocksPerBlock * blocksPerBlock * blocksPerBlock) {
 		return accessIndirBlock(e,cnode,&cnode->inode.triplyIBlock,block,req,2,
-			blocksPerBlock * blocksPerBlock);
+			blocksPerBlock * blocksPerBlock,lblock);
 	}
 
 	/* too large */
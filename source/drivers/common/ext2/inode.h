@@ -116,6 +116,27 @@ public:
 		return doGetDataBlock(e,(Ext2CInode*)cnode,block,false);
 	}
 
+	/**
+	 * Like getDataBlock, but determines how many of the following blocks are stored contiguously on
+	 * disk as well. This allows callers to resolve the blocks of a range at once.
+	 *
+	 * @param e the ext2-handle
+	 * @param cnode the cached inode
+	 * @param block the linear-block-number
+	 * @param count the maximum number of blocks; will be set to the number of contiguous blocks
+	 * @return the block to fetch from disk for <block>
+	 */
+	static block_t getDataBlocks(Ext2FileSystem *e,const Ext2CInode *cnode,block_t block,
+		size_t *count);
+
+	/**
+	 * Forgets all cached block mappings of the given inode. This is required whenever blocks are
+	 * removed from the inode.
+	 *
+	 * @param cnode the cached inode
+	 */
+	static void clearExtents(Ext2CInode *cnode);
+
 #if DEBUGGING
 
 	/**
@@ -132,7 +153,20 @@ private:
 	 * Accesses the block-number of the indirect-block in level <level>.
 	 */
 	static block_t accessIndirBlock(Ext2FileSystem *e,Ext2CInode *cnode,block_t *indir,block_t i,
-		bool req,int level,block_t div);
+		bool req,int level,block_t div,block_t block);
+	/**
+	 * Searches the cached mappings of <cnode> for <block> and copies the mapping to <ext>. The
+	 * mappings are changed by readers as well and are therefore protected by their own lock.
+	 *
+	 * @return true if found
+	 */
+	static bool findExtent(const Ext2CInode *cnode,block_t block,Ext2Extent *ext);
+	/**
+	 * Caches the run of contiguous blocks in the indirect-block <blockNos> around index <i>, which
+	 * belongs to the logical block <block>.
+	 */
+	static void addExtent(Ext2FileSystem *e,Ext2CInode *cnode,const block_t *blockNos,block_t i,
+		block_t block);
 	/**
 	 * Performs the actual get-block-request. If <req> is true, it will allocate a new block, if
 	 * necessary. In this case cnode may be changed. Otherwise no changes will be made.
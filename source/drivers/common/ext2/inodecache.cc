@@ -28,137 +28,237 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "bitmap.h"
 #include "ext2.h"
 #include "file.h"
+#include "inode.h"
 #include "inodecache.h"
 #include "rw.h"
 
 using namespace fs;
 
-Ext2INodeCache::Ext2INodeCache(Ext2FileSystem *fs)
-		: _hits(), _misses(), _cache(new Ext2CInode[EXT2_ICACHE_SIZE]), _fs(fs) {
-	size_t i;
-	Ext2CInode *inode = _cache;
-	for(i = 0; i < EXT2_ICACHE_SIZE; i++) {
-		inode->inodeNo = EXT2_BAD_INO;
-		inode->refs = 0;
-		inode->dirty = false;
-		inode++;
-	}
+Ext2INodeCache::Ext2INodeCache(Ext2FileSystem *fs,size_t size)
+		: _hits(), _misses(), _evictions(), _chunks(), _total(),
+		  _chunkSize(esc::Util::max<size_t>(size,1)), _hashmap(), _hashSize(1), _used(), _lruFirst(), _lruLast(), _freeList(), _fs(fs) {
+	while(_hashSize < _chunkSize)
+		_hashSize *= 2;
+	_hashmap = new Ext2CInode*[_hashSize]();
+	grow(_chunkSize);
+}
+
+Ext2INodeCache::~Ext2INodeCache() {
+	for(auto it = _chunks.begin(); it != _chunks.end(); ++it)
+		delete[] *it;
+	delete[] _hashmap;
 }
 
 void Ext2INodeCache::flush() {
-	Ext2CInode *inode,*end = _cache + EXT2_ICACHE_SIZE;
-	for(inode = _cache; inode < end; inode++) {
-		if(inode->dirty) {
-			sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
-			acquire(inode,IMODE_READ);
-			write(inode);
-			release(inode);
+	/* collect the dirty inodes and reference them, so that they stay in the cache */
+	sassert(tpool_lock(EXT2_ICACHE_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+	Ext2CInode **inodes = new Ext2CInode*[_used];
+	size_t count = 0;
+	for(size_t i = 0; i < _hashSize; ++i) {
+		for(Ext2CInode *inode = _hashmap[i]; inode != NULL; inode = inode->hnext) {
+			if(inode->dirty) {
+				if(inode->refs++ == 0 && (inode->prev != NULL || _lruFirst == inode))
+					lruRemove(inode);
+				inodes[count++] = inode;
+			}
 		}
 	}
+	sassert(tpool_unlock(EXT2_ICACHE_LOCK) == 0);
+
+	for(size_t i = 0; i < count; ++i) {
+		sassert(tpool_lock((ulong)inodes[i],0) == 0);
+		if(inodes[i]->dirty)
+			write(inodes[i]);
+		release(inodes[i]);
+	}
+	delete[] inodes;
 }
 
 Ext2CInode *Ext2INodeCache::request(ino_t no,uint mode) {
-	/* search for the inode. perhaps it's already in cache */
-	Ext2CInode *startNode = _cache + (no & (EXT2_ICACHE_SIZE - 1));
-	Ext2CInode *iend = _cache + EXT2_ICACHE_SIZE;
 	Ext2CInode *inode;
 	if(no <= EXT2_BAD_INO)
 		return NULL;
 
 	/* tpool_lock the request of an inode */
-	sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+	sassert(tpool_lock(EXT2_ICACHE_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
 
-	for(inode = startNode; inode < iend; inode++) {
+	/* search for the inode. perhaps it's already in cache */
+	for(inode = _hashmap[no & (_hashSize - 1)]; inode != NULL; inode = inode->hnext) {
 		if(inode->inodeNo == no) {
-			acquire(inode,mode);
 			_hits++;
+			acquire(inode,mode);
 			return inode;
 		}
 	}
-	/* look in 0 .. startNode; separate it to make the average-case fast */
-	if(inode == iend) {
-		for(inode = _cache; inode < startNode; inode++) {
-			if(inode->inodeNo == no) {
-				acquire(inode,mode);
-				_hits++;
-				return inode;
-			}
-		}
-	}
-
-	/* ok, not in cache. so we start again at the position to find a usable node */
-	/* if we have to load it from disk anyway I think we can waste a few cycles more
-	 * to reduce the number of cycles in the cache-lookup. therefore
-	 * we don't collect the information in the loops above. */
-	for(inode = startNode; inode < iend; inode++) {
-		if(inode->inodeNo == EXT2_BAD_INO || inode->refs == 0)
-			break;
-	}
-	if(inode == iend) {
-		for(inode = _cache; inode < startNode; inode++) {
-			if(inode->inodeNo == EXT2_BAD_INO || inode->refs == 0)
-				break;
-		}
-
-		if(inode == startNode) {
-			printf("NO FREE INODE-CACHE-SLOT! What to to??");
-			return NULL;
-		}
-	}
-
-	/* write the old inode back, if necessary */
-	if(inode->dirty && inode->inodeNo != EXT2_BAD_INO) {
-		acquire(inode,IMODE_READ);
-		write(inode);
-		doRelease(inode,false);
-	}
 
 	/* build node */
+	inode = getEntry();
 	inode->inodeNo = no;
 	inode->dirty = false;
-	/* first for writing because we have to load it */
-	acquire(inode,IMODE_WRITE);
+	inode->lastBlock = 0;
+	inode->preallocBlock = 0;
+	inode->preallocCount = 0;
+	Ext2INode::clearExtents(inode);
+	Ext2CInode **list = _hashmap + (no & (_hashSize - 1));
+	inode->hnext = *list;
+	*list = inode;
+	if(++_used > _hashSize)
+		rehash();
+
+	/* first for writing because we have to load it. nobody uses the entry yet, so that we can
+	 * lock it before others can find it in the hashmap */
+	inode->refs++;
+	_misses++;
+	sassert(tpool_lock((ulong)inode,LOCK_EXCLUSIVE) == 0);
+	sassert(tpool_unlock(EXT2_ICACHE_LOCK) == 0);
 
 	read(inode);
 
-	/* now use for the requested mode */
+	/* now use for the requested mode. don't release it in between, because the entry would be
+	 * freed again, if the inode has no links */
 	if(mode != IMODE_WRITE) {
-		doRelease(inode,false);
-		acquire(inode,mode);
+		sassert(tpool_unlock((ulong)inode) == 0);
+		sassert(tpool_lock((ulong)inode,0) == 0);
 	}
-
-	_misses++;
 	return inode;
 }
 
+void Ext2INodeCache::discardPrealloc() {
+	sassert(tpool_lock(EXT2_ICACHE_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+	for(size_t i = 0; i < _hashSize; ++i) {
+		for(Ext2CInode *inode = _hashmap[i]; inode != NULL; inode = inode->hnext)
+			Ext2Bitmap::discardPrealloc(_fs,inode);
+	}
+	sassert(tpool_unlock(EXT2_ICACHE_LOCK) == 0);
+}
+
 void Ext2INodeCache::print(FILE *f) {
 	float hitrate;
-	size_t used = 0,dirty = 0;
-	Ext2CInode *inode,*end = _cache + EXT2_ICACHE_SIZE;
-	for(inode = _cache; inode < end; inode++) {
-		if(inode->inodeNo != EXT2_BAD_INO)
-			used++;
-		if(inode->dirty)
-			dirty++;
+	size_t dirty = 0;
+	sassert(tpool_lock(EXT2_ICACHE_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+	for(size_t i = 0; i < _hashSize; ++i) {
+		for(Ext2CInode *inode = _hashmap[i]; inode != NULL; inode = inode->hnext) {
+			if(inode->dirty)
+				dirty++;
+		}
 	}
-	fprintf(f,"\tTotal entries: %zu\n",EXT2_ICACHE_SIZE);
-	fprintf(f,"\tUsed entries: %zu\n",used);
+	fprintf(f,"\tTotal entries: %zu\n",_total);
+	fprintf(f,"\tUsed entries: %zu\n",_used);
 	fprintf(f,"\tDirty entries: %zu\n",dirty);
+	fprintf(f,"\tHashmap size: %zu\n",_hashSize);
 	fprintf(f,"\tHits: %zu\n",_hits);
 	fprintf(f,"\tMisses: %zu\n",_misses);
+	fprintf(f,"\tEvictions: %zu\n",_evictions);
 	if(_hits == 0)
 		hitrate = 0;
 	else
 		hitrate = 100.0f / ((float)(_misses + _hits) / _hits);
 	fprintf(f,"\tHitrate: %.3f%%\n",hitrate);
+	sassert(tpool_unlock(EXT2_ICACHE_LOCK) == 0);
+}
+
+void Ext2INodeCache::grow(size_t count) {
+	Ext2CInode *inodes = new Ext2CInode[count];
+	for(size_t i = 0; i < count; i++) {
+		inodes[i].inodeNo = EXT2_BAD_INO;
+		inodes[i].refs = 0;
+		inodes[i].dirty = false;
+		inodes[i].hnext = NULL;
+		inodes[i].prev = NULL;
+		inodes[i].next = _freeList;
+		_freeList = inodes + i;
+	}
+	_chunks.push_back(inodes);
+	_total += count;
+}
+
+void Ext2INodeCache::rehash() {
+	size_t nsize = _hashSize * 2;
+	Ext2CInode **nmap = new Ext2CInode*[nsize]();
+	for(size_t i = 0; i < _hashSize; ++i) {
+		Ext2CInode *next;
+		for(Ext2CInode *inode = _hashmap[i]; inode != NULL; inode = next) {
+			next = inode->hnext;
+			Ext2CInode **list = nmap + (inode->inodeNo & (nsize - 1));
+			inode->hnext = *list;
+			*list = inode;
+		}
+	}
+	delete[] _hashmap;
+	_hashmap = nmap;
+	_hashSize = nsize;
+}
+
+Ext2CInode *Ext2INodeCache::getEntry() {
+	/* if all inodes are in use, we need more */
+	if(_freeList == NULL && _lruLast == NULL)
+		grow(_chunkSize);
+
+	Ext2CInode *inode = _freeList;
+	if(inode != NULL) {
+		_freeList = inode->next;
+		inode->next = NULL;
+		return inode;
+	}
+
+	/* take the least recently used one, but prefer a clean one, which can be reused for free */
+	inode = _lruLast;
+	for(size_t i = 0; i < EVICT_SCAN && inode && inode->dirty; ++i)
+		inode = inode->prev;
+	if(!inode || inode->dirty)
+		inode = _lruLast;
+	lruRemove(inode);
+
+	/* write the old inode back, if necessary. it is unreferenced, i.e. nobody else uses it */
+	if(inode->dirty)
+		write(inode);
+	/* the preallocated blocks are only known here; give them back */
+	Ext2Bitmap::discardPrealloc(_fs,inode);
+
+	unhash(inode);
+	_used--;
+	_evictions++;
+	return inode;
+}
+
+void Ext2INodeCache::unhash(Ext2CInode *inode) {
+	Ext2CInode **list = _hashmap + (inode->inodeNo & (_hashSize - 1));
+	Ext2CInode *i = *list, *p = NULL;
+	while(i != NULL) {
+		if(i == inode) {
+			if(p)
+				p->hnext = i->hnext;
+			else
+				*list = i->hnext;
+			break;
+		}
+		p = i;
+		i = i->hnext;
+	}
+	inode->hnext = NULL;
+}
+
+void Ext2INodeCache::lruRemove(Ext2CInode *inode) {
+	if(inode->prev)
+		inode->prev->next = inode->next;
+	else
+		_lruFirst = inode->next;
+	if(inode->next)
+		inode->next->prev = inode->prev;
+	else
+		_lruLast = inode->prev;
+	inode->prev = inode->next = NULL;
 }
 
 void Ext2INodeCache::acquire(Ext2CInode *inode,A_UNUSED uint mode) {
-	inode->refs++;
-	sassert(tpool_unlock(ALLOC_LOCK) == 0);
-	sassert(tpool_lock((uint)inode,(mode & IMODE_WRITE) ? LOCK_EXCLUSIVE : 0) == 0);
+	/* unreferenced inodes are in the LRU list; remove it from there */
+	if(inode->refs++ == 0 && (inode->prev != NULL || _lruFirst == inode))
+		lruRemove(inode);
+	sassert(tpool_unlock(EXT2_ICACHE_LOCK) == 0);
+	sassert(tpool_lock((ulong)inode,(mode & IMODE_WRITE) ? LOCK_EXCLUSIVE : 0) == 0);
 }
 
 void Ext2INodeCache::doRelease(Ext2CInode *ino,bool unlockAlloc) {
@@ -167,19 +267,33 @@ void Ext2INodeCache::doRelease(Ext2CInode *ino,bool unlockAlloc) {
 
 	/* don't write dirty blocks back here, because this would lead to too many writes. */
 	/* skipping it until the inode-cache-entry should be reused, is better */
-	sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
-	/* if there are no references and no links anymore, we have to delete the file */
+	sassert(tpool_lock(EXT2_ICACHE_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
 	if(--ino->refs == 0) {
+		/* if there are no references and no links anymore, we have to delete the file */
 		if(ino->inode.linkCount == 0) {
 			Ext2File::remove(_fs,ino);
 			/* ensure that we don't use the cached inode again */
+			unhash(ino);
+			_used--;
 			ino->inodeNo = EXT2_BAD_INO;
 			ino->dirty = false;
+			ino->next = _freeList;
+			_freeList = ino;
+		}
+		/* otherwise, keep it for later use */
+		else {
+			ino->prev = NULL;
+			ino->next = _lruFirst;
+			if(_lruFirst)
+				_lruFirst->prev = ino;
+			else
+				_lruLast = ino;
+			_lruFirst = ino;
 		}
 	}
 	if(unlockAlloc)
-		sassert(tpool_unlock(ALLOC_LOCK) == 0);
-	sassert(tpool_unlock((uint)ino) == 0);
+		sassert(tpool_unlock(EXT2_ICACHE_LOCK) == 0);
+	sassert(tpool_unlock((ulong)ino) == 0);
 }
 
 void Ext2INodeCache::read(Ext2CInode *inode) {
@@ -209,4 +323,5 @@ void Ext2INodeCache::write(Ext2CInode *inode) {
 			sizeof(Ext2Inode));
 	_fs->blockCache.markDirty(block);
 	_fs->blockCache.release(block);
+	inode->dirty = false;
 }
@@ -21,15 +21,42 @@
 
 #include <sys/common.h>
 #include <stdio.h>
+#include <vector>
 
 #include "inode.h"
 
 class Ext2FileSystem;
 
+/* the number of cached mappings of contiguous blocks per inode */
+static const size_t EXT2_EXTENT_COUNT	= 4;
+
+/**
+ * Maps <count> logical blocks, starting at <logical>, to the physical blocks starting at <physical>
+ */
+struct Ext2Extent {
+	block_t logical;
+	block_t physical;
+	block_t count;
+};
+
 struct Ext2CInode {
 	ino_t inodeNo;
 	ushort dirty;
 	ushort refs;
+	/* the next one in the hashmap bucket */
+	Ext2CInode *hnext;
+	/* the LRU list of unreferenced inodes or the freelist */
+	Ext2CInode *prev;
+	Ext2CInode *next;
+	/* the last block that has been allocated for this inode */
+	block_t lastBlock;
+	/* blocks that are marked as used in the bitmap, but are not yet part of the file. they are
+	 * kept as long as the inode is cached and given back on truncate or eviction */
+	block_t preallocBlock;
+	size_t preallocCount;
+	/* mappings of indirect blocks, which are replaced round-robin */
+	Ext2Extent extents[EXT2_EXTENT_COUNT];
+	size_t nextExtent;
 	fs::Ext2Inode inode;
 };
 
@@ -38,21 +65,36 @@ enum {
 	IMODE_WRITE	= 0x2,
 };
 
+/**
+ * The inode cache finds inodes via a hashmap. Inodes without references are kept in a LRU list,
+ * from which the least recently used one is reused. If all inodes are referenced, the cache grows,
+ * so that an arbitrary number of files can be open at the same time.
+ */
 class Ext2INodeCache {
+	/* the number of unreferenced inodes we look at to find a clean one */
+	static const size_t EVICT_SCAN	= 8;
+
 public:
 	/**
 	 * Inits the inode-cache
+	 *
+	 * @param fs the filesystem
+	 * @param size the initial number of inodes in the cache
 	 */
-	explicit Ext2INodeCache(Ext2FileSystem *fs);
-	~Ext2INodeCache() {
-		delete[] _cache;
-	}
+	explicit Ext2INodeCache(Ext2FileSystem *fs,size_t size);
+	~Ext2INodeCache();
 
 	/**
 	 * Writes all dirty inodes to disk
 	 */
 	void flush();
 
+	/**
+	 * Gives the preallocated blocks of all cached inodes back. This has to be done before the
+	 * filesystem is unmounted.
+	 */
+	void discardPrealloc();
+
 	/**
 	 * Marks the given inode dirty
 	 *
@@ -92,14 +134,34 @@ public:
 
 private:
 	/**
-	 * Aquires the tpool_lock for given mode and inode. Assumes that ALLOC_LOCK is acquired and releases
-	 * it at the end.
+	 * Aquires the tpool_lock for given mode and inode. Assumes that EXT2_ICACHE_LOCK is acquired and
+	 * releases it at the end.
 	 */
 	void acquire(Ext2CInode *inode,uint mode);
 	/**
 	 * Releases the given inode
 	 */
 	void doRelease(Ext2CInode *ino,bool unlockAlloc);
+	/**
+	 * Allocates <count> new entries and puts them on the freelist
+	 */
+	void grow(size_t count);
+	/**
+	 * Doubles the size of the hashmap
+	 */
+	void rehash();
+	/**
+	 * Fetches an unused cache entry and removes it from the hashmap
+	 */
+	Ext2CInode *getEntry();
+	/**
+	 * Removes <inode> from the hashmap
+	 */
+	void unhash(Ext2CInode *inode);
+	/**
+	 * Removes <inode> from the LRU list
+	 */
+	void lruRemove(Ext2CInode *inode);
 	/**
 	 * Reads the inode from block-cache. Requires inode->inodeNo to be valid!
 	 */
@@ -111,6 +173,18 @@ private:
 
 	size_t _hits;
 	size_t _misses;
-	Ext2CInode *_cache;
+	size_t _evictions;
+	/* all entries, allocated in chunks to keep their addresses stable */
+	std::vector<Ext2CInode*> _chunks;
+	size_t _total;
+	size_t _chunkSize;
+	/* the hashmap, whose size is a power of 2 */
+	Ext2CInode **_hashmap;
+	size_t _hashSize;
+	size_t _used;
+	/* unreferenced inodes, from the most to the least recently used one */
+	Ext2CInode *_lruFirst;
+	Ext2CInode *_lruLast;
+	Ext2CInode *_freeList;
 	Ext2FileSystem *_fs;
 };
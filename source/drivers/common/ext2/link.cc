@@ -27,6 +27,7 @@
 #include "dir.h"
 #include "ext2.h"
 #include "file.h"
+#include "htree.h"
 #include "inodecache.h"
 #include "link.h"
 
@@ -45,10 +46,26 @@ int Ext2Link::create(Ext2FileSystem *e,User *u,Ext2CInode *dir,Ext2CInode *cnode
 	if((res = e->hasPermission(dir,u,MODE_WRITE)) < 0)
 		return res;
 
+	/* in indexed directories, we only need to look at one block */
+	if(Ext2HTree::isIndexed(e,dir)) {
+		res = Ext2HTree::find(e,dir,name,len);
+		if(res >= 0)
+			return -EEXIST;
+		if(res == -ENOENT)
+			res = Ext2HTree::add(e,dir,name,len,cnode->inodeNo,getFileType(e,cnode));
+		if(res == 0)
+			goto done;
+		if(res != -ENOTSUP)
+			return res;
+		/* the index is unusable or full; continue with a linear directory */
+		Ext2HTree::dropIndex(e,dir);
+		dirSize = le32tocpu(dir->inode.size);
+	}
+
 	/* TODO we don't have to read the whole directory at once */
 
 	/* read directory-entries */
-	buf = static_cast<uint8_t*>(malloc(dirSize + tlen));
+	buf = static_cast<uint8_t*>(malloc(dirSize + e->blockSize()));
 	if(buf == NULL)
 		return -ENOMEM;
 	if((res = Ext2File::readIno(e,dir,buf,0,dirSize)) != dirSize) {
@@ -66,7 +83,7 @@ int Ext2Link::create(Ext2FileSystem *e,User *u,Ext2CInode *dir,Ext2CInode *cnode
 	dire = (Ext2DirEntry*)buf;
 	while((uint8_t*)dire < buf + dirSize) {
 		/* does our entry fit? */
-		size_t elen = getDirESize(le16tocpu(dire->nameLen));
+		size_t elen = getDirESize(dire->nameLen);
 		uint16_t orgRecLen = le16tocpu(dire->recLen);
 		if(elen < orgRecLen && orgRecLen - elen >= tlen) {
 			recLen = orgRecLen - elen;
@@ -81,12 +98,14 @@ int Ext2Link::create(Ext2FileSystem *e,User *u,Ext2CInode *dir,Ext2CInode *cnode
 	if(recLen == 0) {
 		dire = (Ext2DirEntry*)(buf + dirSize);
 		recLen = e->blockSize();
+		memset(dire,0,recLen);
 		dirSize += recLen;
 	}
 
 	/* build entry */
 	dire->inode = cputole32(cnode->inodeNo);
-	dire->nameLen = cputole16(len);
+	dire->nameLen = len;
+	dire->fileType = getFileType(e,cnode);
 	dire->recLen = cputole16(recLen);
 	memcpy(dire->name,name,len);
 
@@ -97,6 +116,9 @@ int Ext2Link::create(Ext2FileSystem *e,User *u,Ext2CInode *dir,Ext2CInode *cnode
 	}
 	free(buf);
 
+done:
+	e->dentryCache.insert(dir->inodeNo,name,len,cnode->inodeNo);
+
 	/* increase link-count */
 	cnode->inode.linkCount = cputole16(le16tocpu(cnode->inode.linkCount) + 1);
 	e->inodeCache.markDirty(cnode);
@@ -131,7 +153,9 @@ int Ext2Link::remove(Ext2FileSystem *e,User *u,Ext2CInode *pdir,Ext2CInode *dir,
 	prev = NULL;
 	dire = (Ext2DirEntry*)buf;
 	while((uint8_t*)dire < buf + dirSize) {
-		if(nameLen == le16tocpu(dire->nameLen) && strncmp(dire->name,name,nameLen) == 0) {
+		/* entries at the beginning of a block are removed by clearing the inode number only */
+		if(le32tocpu(dire->inode) != 0 && nameLen == dire->nameLen &&
+				strncmp(dire->name,name,nameLen) == 0) {
 			ino = le32tocpu(dire->inode);
 			if(pdir && ino == pdir->inodeNo)
 				cnode = pdir;
@@ -167,9 +191,11 @@ int Ext2Link::remove(Ext2FileSystem *e,User *u,Ext2CInode *pdir,Ext2CInode *dir,
 			break;
 		}
 
-		/* to next */
+		/* to next. entries can't span blocks, so we can't merge with the previous block */
 		prev = dire;
 		dire = (Ext2DirEntry*)((uintptr_t)dire + le16tocpu(dire->recLen));
+		if(((uint8_t*)dire - buf) % e->blockSize() == 0)
+			prev = NULL;
 	}
 
 	/* no match? */
@@ -186,6 +212,7 @@ int Ext2Link::remove(Ext2FileSystem *e,User *u,Ext2CInode *pdir,Ext2CInode *dir,
 		return res;
 	}
 	free(buf);
+	e->dentryCache.insert(dir->inodeNo,name,nameLen,-ENOENT);
 
 	/* update inode */
 	if(cnode != NULL) {
@@ -194,6 +221,9 @@ int Ext2Link::remove(Ext2FileSystem *e,User *u,Ext2CInode *pdir,Ext2CInode *dir,
 		e->inodeCache.markDirty(cnode);
 		linkCount = le16tocpu(cnode->inode.linkCount) - 1;
 		cnode->inode.linkCount = cputole16(linkCount);
+		/* the inode number might be reused for a different directory */
+		if(linkCount == 0 && S_ISDIR(le16tocpu(cnode->inode.mode)))
+			e->dentryCache.removeDir(cnode->inodeNo);
 		/* don't delete the file here if linkCount is 0. we'll do that later when the last reference
 		 * is gone */
 		if(cnode != pdir && cnode != dir)
@@ -208,3 +238,26 @@ size_t Ext2Link::getDirESize(size_t namelen) {
 		tlen += EXT2_DIRENTRY_PAD - (tlen % EXT2_DIRENTRY_PAD);
 	return tlen;
 }
+
+uint8_t Ext2Link::getFileType(Ext2FileSystem *e,const Ext2CInode *cnode) {
+	if(!(le32tocpu(e->sb.get()->featureInCompat) & EXT2_FEATURE_INCOMPAT_FILETYPE))
+		return EXT2_FT_UNKNOWN;
+
+	switch(le16tocpu(cnode->inode.mode) & EXT2_S_IFMT) {
+		case EXT2_S_IFREG:
+			return EXT2_FT_REG_FILE;
+		case EXT2_S_IFDIR:
+			return EXT2_FT_DIR;
+		case EXT2_S_IFLNK:
+			return EXT2_FT_SYMLINK;
+		case EXT2_S_IFCHR:
+			return EXT2_FT_CHRDEV;
+		case EXT2_S_IFBLK:
+			return EXT2_FT_BLKDEV;
+		case EXT2_S_IFIFO:
+			return EXT2_FT_FIFO;
+		case EXT2_S_IFSOCK:
+			return EXT2_FT_SOCK;
+	}
+	return EXT2_FT_UNKNOWN;
+}
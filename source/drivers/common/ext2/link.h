@@ -54,9 +54,17 @@ public:
 	static int remove(Ext2FileSystem *e,fs::User *u,Ext2CInode *pdir,Ext2CInode *dir,const char *name,
 		bool delDir);
 
-private:
 	/**
 	 * Calculates the total size of a dir-entry, including padding
 	 */
 	static size_t getDirESize(size_t namelen);
+
+	/**
+	 * Determines the file type that is stored in dir-entries for the given inode
+	 *
+	 * @param e the ext2-data
+	 * @param cnode the cached inode
+	 * @return the file type (EXT2_FT_*); EXT2_FT_UNKNOWN if the fs does not store it
+	 */
+	static uint8_t getFileType(Ext2FileSystem *e,const Ext2CInode *cnode);
 };
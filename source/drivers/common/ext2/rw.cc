@@ -19,6 +19,7 @@
 
 #include <fs/fsdev.h>
 #include <sys/common.h>
+#include <sys/debug.h>
 #include <sys/io.h>
 #include <sys/messages.h>
 #include <sys/thread.h>
@@ -28,13 +29,17 @@
 #include "rw.h"
 
 int Ext2RW::readSectors(Ext2FileSystem *e,void *buffer,uint64_t lba,size_t secCount) {
+	/* the flusher and the prefetcher access the device as well */
+	sassert(tpool_lock(EXT2_DISK_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
 	off_t off = seek(e->fd,lba * DISK_SECTOR_SIZE,SEEK_SET);
 	if(off < 0) {
+		sassert(tpool_unlock(EXT2_DISK_LOCK) == 0);
 		printe("Unable to seek to %x",lba * DISK_SECTOR_SIZE);
 		return off;
 	}
 
 	ssize_t res = IGNSIGS(read(e->fd,buffer,secCount * DISK_SECTOR_SIZE));
+	sassert(tpool_unlock(EXT2_DISK_LOCK) == 0);
 	if(res != (ssize_t)(secCount * DISK_SECTOR_SIZE)) {
 		printe("Unable to read %d sectors @ %x",secCount,lba * DISK_SECTOR_SIZE);
 		return res;
@@ -44,13 +49,16 @@ int Ext2RW::readSectors(Ext2FileSystem *e,void *buffer,uint64_t lba,size_t secCo
 }
 
 int Ext2RW::writeSectors(Ext2FileSystem *e,const void *buffer,uint64_t lba,size_t secCount) {
+	sassert(tpool_lock(EXT2_DISK_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
 	off_t off = seek(e->fd,lba * DISK_SECTOR_SIZE,SEEK_SET);
 	if(off < 0) {
+		sassert(tpool_unlock(EXT2_DISK_LOCK) == 0);
 		printe("Unable to seek to %x",lba * DISK_SECTOR_SIZE);
 		return off;
 	}
 
 	ssize_t res = write(e->fd,buffer,secCount * DISK_SECTOR_SIZE);
+	sassert(tpool_unlock(EXT2_DISK_LOCK) == 0);
 	if(res != (ssize_t)(secCount * DISK_SECTOR_SIZE)) {
 		printe("Unable to write %d sectors @ %x",secCount,lba * DISK_SECTOR_SIZE);
 		return res;
@@ -72,6 +72,8 @@ static const struct {
 } bootModUsers[] = {
 	{"pci",		USER_BUS,		2, {GROUP_BUS,GROUP_DRIVER,0,0}},
 	{"ata",		USER_STORAGE,	3, {GROUP_STORAGE,GROUP_DRIVER,GROUP_BUS,0}},
+	{"ahci",	USER_STORAGE,	3, {GROUP_STORAGE,GROUP_DRIVER,GROUP_BUS,0}},
+	{"virtioblk",USER_STORAGE,	3, {GROUP_STORAGE,GROUP_DRIVER,GROUP_BUS,0}},
 	{"disk",	USER_STORAGE,	2, {GROUP_STORAGE,GROUP_DRIVER,0,0}},
 	{"ramdisk",	USER_STORAGE,	2, {GROUP_STORAGE,GROUP_DRIVER,0,0}},
 	{"iso9660",	USER_FS,		3, {GROUP_FS,GROUP_STORAGE,GROUP_DRIVER,0}},
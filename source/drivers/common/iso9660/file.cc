@@ -31,7 +31,8 @@
 #include "iso9660.h"
 #include "rw.h"
 
-ssize_t ISO9660File::read(ISO9660FileSystem *h,ino_t inodeNo,void *buffer,off_t offset,size_t count) {
+ssize_t ISO9660File::read(ISO9660FileSystem *h,ino_t inodeNo,void *buffer,off_t offset,size_t count,
+		fs::ReadAhead *ra) {
 	const ISOCDirEntry *e;
 	fs::CBlock *blk;
 	uint8_t *bufWork;
@@ -52,15 +53,21 @@ ssize_t ISO9660File::read(ISO9660FileSystem *h,ino_t inodeNo,void *buffer,off_t
 
 	blockSize = h->blockSize();
 	startBlock = e->entry.extentLoc.littleEndian + offset / blockSize;
-	offset %= blockSize;
-	blockCount = (offset + count + blockSize - 1) / blockSize;
+	blockCount = (offset % blockSize + count + blockSize - 1) / blockSize;
 
-	/* TODO try to read multiple blocks at once */
+	block_t fileBlock = offset / blockSize;
+	offset %= blockSize;
 
 	/* use the offset in the first block; after the first one the offset is 0 anyway */
 	leftBytes = count;
 	bufWork = (uint8_t*)buffer;
 	for(i = 0; i < blockCount; i++) {
+		/* fetch the following blocks at once */
+		if(blockCount > 1 && i % fs::BlockCache::MAX_BATCH == 0) {
+			prefetch(h,startBlock + i,
+				esc::Util::min(blockCount - i,fs::BlockCache::MAX_BATCH),false);
+		}
+
 		/* read block */
 		blk = h->blockCache.request(startBlock + i,fs::BlockCache::READ);
 		if(blk == NULL)
@@ -85,9 +92,35 @@ ssize_t ISO9660File::read(ISO9660FileSystem *h,ino_t inodeNo,void *buffer,off_t
 		offset = 0;
 	}
 
+	/* read the next window in the background, if the reader has reached the marker. but don't go
+	 * beyond the end of the file */
+	block_t rastart = 0;
+	size_t fileBlocks = (e->entry.extentSize.littleEndian + blockSize - 1) / blockSize;
+	size_t ahead = ra ? ra->access(fileBlock,blockCount,&rastart) : 0;
+	if(ahead > 0 && rastart < fileBlocks) {
+		prefetch(h,e->entry.extentLoc.littleEndian + rastart,
+			esc::Util::min(ahead,fileBlocks - rastart),true);
+	}
+
 	return count;
 }
 
+void ISO9660File::prefetch(ISO9660FileSystem *h,block_t first,size_t count,bool async) {
+	/* the extents are contiguous on disk */
+	block_t blocks[fs::BlockCache::MAX_BATCH];
+	while(count > 0) {
+		size_t n = esc::Util::min(count,fs::BlockCache::MAX_BATCH);
+		for(size_t i = 0; i < n; ++i)
+			blocks[i] = first + i;
+		if(async)
+			h->blockCache.prefetchAsync(blocks,n);
+		else
+			h->blockCache.prefetch(blocks,n);
+		first += n;
+		count -= n;
+	}
+}
+
 void ISO9660File::buildDirEntries(ISO9660FileSystem *h,block_t lba,uint8_t *dst,const uint8_t *src,
 		off_t offset,size_t count) {
 	const ISODirEntry *e;
@@ -36,11 +36,14 @@ public:
 	 * 	not copied anywhere
 	 * @param offset the offset
 	 * @param count the number of bytes to read
+	 * @param ra the readahead-state of the open file (NULL = no readahead)
 	 * @return the number of read bytes
 	 */
-	static ssize_t read(ISO9660FileSystem *fs,ino_t id,void *buffer,off_t offset,size_t count);
+	static ssize_t read(ISO9660FileSystem *fs,ino_t id,void *buffer,off_t offset,size_t count,
+		fs::ReadAhead *ra = NULL);
 
 private:
+	static void prefetch(ISO9660FileSystem *h,block_t first,size_t count,bool async);
 	static void buildDirEntries(ISO9660FileSystem *h,block_t lba,uint8_t *dst,const uint8_t *src,
 		off_t offset,size_t count);
 };
@@ -91,6 +91,8 @@ bool ISO9660FileSystem::ISO9660BlockCache::writeBlocks(const void *,size_t,size_
 ISO9660FileSystem::ISO9660FileSystem(const char *device)
 		: FileSystem(), fd(::open(device,O_RDONLY)), primary(), dummy(initPrimaryVol(this,device)),
 		  dirCache(this), blockCache(this) {
+	if(blockCache.startPrefetcher() < 0)
+		printe("Unable to start prefetcher thread");
 }
 
 int ISO9660FileSystem::initPrimaryVol(ISO9660FileSystem *fs,const char *device) {
@@ -156,7 +158,7 @@ int ISO9660FileSystem::stat(fs::OpenFile *file,struct stat *info) {
 }
 
 ssize_t ISO9660FileSystem::read(fs::OpenFile *file,void *buffer,off_t offset,size_t count) {
-	return ISO9660File::read(this,file->ino,buffer,offset,count);
+	return ISO9660File::read(this,file->ino,buffer,offset,count,&file->readahead);
 }
 
 ssize_t ISO9660FileSystem::write(fs::OpenFile *,const void *,off_t,size_t) {
@@ -34,6 +34,9 @@ static const size_t ISO_DIRE_CACHE_SIZE		= 128;
 
 static const int ISO_VOL_DESC_START			= 0x10;
 
+/* serializes seek+read on the device */
+static const uint ISO_DISK_LOCK				= 0xF7180010;
+
 enum {
 	ISO_VOL_TYPE_BOOTRECORD		= 0,
 	ISO_VOL_TYPE_PRIMARY		= 1,
@@ -178,6 +181,7 @@ public:
 
 	explicit ISO9660FileSystem(const char *device);
 	virtual ~ISO9660FileSystem() {
+		blockCache.stopPrefetcher();
 		::close(fd);
 	}
 
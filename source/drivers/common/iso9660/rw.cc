@@ -19,6 +19,7 @@
 
 #include <fs/fsdev.h>
 #include <sys/common.h>
+#include <sys/debug.h>
 #include <sys/io.h>
 #include <sys/thread.h>
 #include <stdio.h>
@@ -29,13 +30,17 @@
 int ISO9660RW::readSectors(ISO9660FileSystem *fs,void *buffer,uint64_t lba,size_t secCount) {
 	int fd = fs->fd;
 
+	/* the prefetcher accesses the device as well */
+	sassert(tpool_lock(ISO_DISK_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
 	off_t off = seek(fd,lba * ATAPI_SECTOR_SIZE,SEEK_SET);
 	if(off < 0) {
+		sassert(tpool_unlock(ISO_DISK_LOCK) == 0);
 		printe("Unable to seek to %x",lba * ATAPI_SECTOR_SIZE);
 		return off;
 	}
 
 	ssize_t res = IGNSIGS(read(fd,buffer,secCount * ATAPI_SECTOR_SIZE));
+	sassert(tpool_unlock(ISO_DISK_LOCK) == 0);
 	if(res != (ssize_t)(secCount * ATAPI_SECTOR_SIZE)) {
 		printe("Unable to read %d sectors @ %x: %zd",secCount,lba * ATAPI_SECTOR_SIZE,res);
 		return res;
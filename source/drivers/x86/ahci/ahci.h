@@ -0,0 +1,240 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+
+#include <sys/common.h>
+
+#define AHCI_DEBUG			0
+
+#if AHCI_DEBUG > 0
+#	define AHCI_PR1(fmt,...)	print(fmt,## __VA_ARGS__)
+#else
+#	define AHCI_PR1(...)
+#endif
+
+#if AHCI_DEBUG > 1
+#	define AHCI_PR2(fmt,...)	print(fmt,## __VA_ARGS__)
+#else
+#	define AHCI_PR2(...)
+#endif
+
+/* the PCI class and subclass of AHCI controllers */
+static const uchar AHCI_PCI_CLASS		= 0x01;
+static const uchar AHCI_PCI_SUBCLASS	= 0x06;
+/* the BAR that contains the HBA registers (ABAR) */
+static const size_t AHCI_ABAR			= 5;
+
+static const size_t AHCI_MAX_PORTS		= 32;
+static const size_t AHCI_MAX_SLOTS		= 32;
+/* the number of PRDs per command table; limits the size of a single transfer */
+static const size_t AHCI_MAX_PRDS		= 128;
+/* the maximum number of bytes a single PRD can describe */
+static const size_t AHCI_MAX_PRD_BYTES	= 4 * 1024 * 1024;
+
+/* the generic host control registers */
+struct HBARegs {
+	uint32_t cap;			/* host capabilities */
+	uint32_t ghc;			/* global host control */
+	uint32_t is;			/* interrupt status */
+	uint32_t pi;			/* ports implemented */
+	uint32_t vs;			/* version */
+	uint32_t cccCtl;		/* command completion coalescing control */
+	uint32_t cccPorts;		/* command completion coalsecing ports */
+	uint32_t emLoc;			/* enclosure management location */
+	uint32_t emCtl;			/* enclosure management control */
+	uint32_t cap2;			/* host capabilities extended */
+	uint32_t bohc;			/* BIOS/OS handoff control and status */
+	uint8_t reserved[0x100 - 0x2C];
+};
+
+/* the registers of one port */
+struct PortRegs {
+	uint32_t clb;			/* command list base address */
+	uint32_t clbu;			/* command list base address upper 32 bits */
+	uint32_t fb;			/* FIS base address */
+	uint32_t fbu;			/* FIS base address upper 32 bits */
+	uint32_t is;			/* interrupt status */
+	uint32_t ie;			/* interrupt enable */
+	uint32_t cmd;			/* command and status */
+	uint32_t reserved0;
+	uint32_t tfd;			/* task file data */
+	uint32_t sig;			/* signature */
+	uint32_t ssts;			/* serial ATA status (SStatus) */
+	uint32_t sctl;			/* serial ATA control (SControl) */
+	uint32_t serr;			/* serial ATA error (SError) */
+	uint32_t sact;			/* serial ATA active (SActive) */
+	uint32_t ci;			/* command issue */
+	uint32_t sntf;			/* serial ATA notification */
+	uint32_t fbs;			/* FIS-based switching control */
+	uint32_t reserved1[15];
+};
+
+enum {
+	CAP_NP_MASK			= 0x1F,			/* number of ports - 1 */
+	CAP_NCS_SHIFT		= 8,			/* number of command slots - 1 */
+	CAP_NCS_MASK		= 0x1F << 8,
+	CAP_SNCQ			= 1 << 30,		/* supports native command queuing */
+	CAP_S64A			= 1U << 31,		/* supports 64-bit addressing */
+};
+
+enum {
+	GHC_HR				= 1 << 0,		/* HBA reset */
+	GHC_IE				= 1 << 1,		/* interrupt enable */
+	GHC_AE				= 1U << 31,		/* AHCI enable */
+};
+
+enum {
+	PxCMD_ST			= 1 << 0,		/* start */
+	PxCMD_SUD			= 1 << 1,		/* spin-up device */
+	PxCMD_POD			= 1 << 2,		/* power on device */
+	PxCMD_FRE			= 1 << 4,		/* FIS receive enable */
+	PxCMD_FR			= 1 << 14,		/* FIS receive running */
+	PxCMD_CR			= 1 << 15,		/* command list running */
+};
+
+enum {
+	PxIS_DHRS			= 1 << 0,		/* device to host register FIS interrupt */
+	PxIS_PSS			= 1 << 1,		/* PIO setup FIS interrupt */
+	PxIS_DSS			= 1 << 2,		/* DMA setup FIS interrupt */
+	PxIS_SDBS			= 1 << 3,		/* set device bits interrupt */
+	PxIS_DPS			= 1 << 5,		/* descriptor processed */
+	PxIS_IFS			= 1 << 27,		/* interface fatal error */
+	PxIS_HBDS			= 1 << 28,		/* host bus data error */
+	PxIS_HBFS			= 1 << 29,		/* host bus fatal error */
+	PxIS_TFES			= 1 << 30,		/* task file error */
+	PxIS_ERRORS			= PxIS_IFS | PxIS_HBDS | PxIS_HBFS | PxIS_TFES,
+	PxIS_DONE			= PxIS_DHRS | PxIS_PSS | PxIS_DSS | PxIS_SDBS | PxIS_DPS,
+};
+
+enum {
+	PxTFD_ERR			= 1 << 0,
+	PxTFD_DRQ			= 1 << 3,
+	PxTFD_BSY			= 1 << 7,
+};
+
+enum {
+	SSTS_DET_MASK		= 0xF,
+	SSTS_DET_PRESENT	= 0x3,			/* device present and communication established */
+};
+
+enum {
+	SIG_ATA				= 0x00000101,
+	SIG_ATAPI			= 0xEB140101,
+};
+
+enum {
+	FIS_TYPE_REG_H2D	= 0x27,
+};
+
+/* a host to device register FIS */
+struct FISRegH2D {
+	uint8_t type;
+	uint8_t flags;			/* bit 7: command (1) or control (0) */
+	uint8_t command;
+	uint8_t featureLow;
+	uint8_t lba0;
+	uint8_t lba1;
+	uint8_t lba2;
+	uint8_t device;
+	uint8_t lba3;
+	uint8_t lba4;
+	uint8_t lba5;
+	uint8_t featureHigh;
+	uint8_t countLow;
+	uint8_t countHigh;
+	uint8_t icc;
+	uint8_t control;
+	uint32_t reserved;
+} A_PACKED;
+
+/* the area the HBA stores the received FISs in */
+struct ReceivedFIS {
+	uint8_t dsfis[0x1C];
+	uint8_t reserved0[0x04];
+	uint8_t psfis[0x14];
+	uint8_t reserved1[0x0C];
+	uint8_t rfis[0x14];
+	uint8_t reserved2[0x04];
+	uint8_t sdbfis[0x08];
+	uint8_t ufis[0x40];
+	uint8_t reserved3[0x60];
+} A_PACKED;
+
+enum {
+	CMDH_CFL_MASK		= 0x1F,			/* length of the command FIS in dwords */
+	CMDH_ATAPI			= 1 << 5,
+	CMDH_WRITE			= 1 << 6,
+	CMDH_PREFETCH		= 1 << 7,
+	CMDH_CLEAR_BUSY		= 1 << 10,
+	CMDH_PRDTL_SHIFT	= 16,
+};
+
+/* an entry in the command list */
+struct CommandHeader {
+	uint32_t flags;			/* see CMDH_* */
+	uint32_t prdbc;			/* PRD byte count (written by the HBA) */
+	uint32_t ctba;			/* command table base address (128-byte aligned) */
+	uint32_t ctbau;
+	uint32_t reserved[4];
+} A_PACKED;
+
+enum {
+	PRD_INTR			= 1U << 31,		/* interrupt on completion */
+};
+
+/* a physical region descriptor */
+struct PRD {
+	uint32_t dba;			/* data base address (word aligned) */
+	uint32_t dbau;
+	uint32_t reserved;
+	uint32_t dbc;			/* byte count - 1 (bit 0 has to be 1) and PRD_INTR */
+} A_PACKED;
+
+/* the command table that is referenced by a command header */
+struct CommandTable {
+	uint8_t cfis[0x40];
+	uint8_t acmd[0x10];
+	uint8_t reserved[0x30];
+	PRD prdt[AHCI_MAX_PRDS];
+} A_PACKED;
+
+static_assert(sizeof(HBARegs) == 0x100,"HBARegs has wrong size");
+static_assert(sizeof(PortRegs) == 0x80,"PortRegs has wrong size");
+static_assert(sizeof(ReceivedFIS) == 0x100,"ReceivedFIS has wrong size");
+static_assert(sizeof(CommandHeader) == 0x20,"CommandHeader has wrong size");
+static_assert((sizeof(CommandTable) & 0x7F) == 0,"CommandTable is not 128-byte aligned");
+
+enum {
+	ATA_CMD_IDENTIFY			= 0xEC,
+	ATA_CMD_READ_DMA			= 0xC8,
+	ATA_CMD_WRITE_DMA			= 0xCA,
+	ATA_CMD_READ_LOG_EXT		= 0x2F,
+	ATA_CMD_READ_DMA_EXT		= 0x25,
+	ATA_CMD_WRITE_DMA_EXT		= 0x35,
+	ATA_CMD_READ_FPDMA_QUEUED	= 0x60,
+	ATA_CMD_WRITE_FPDMA_QUEUED	= 0x61,
+};
+
+enum {
+	ATA_DEV_LBA					= 1 << 6,
+};
+
+/* the log page that reports (and clears) NCQ errors */
+static const uint8_t ATA_LOG_NCQ_ERROR	= 0x10;
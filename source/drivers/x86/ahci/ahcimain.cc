@@ -0,0 +1,81 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <blkdev/partdevice.h>
+#include <esc/proto/pci.h>
+#include <sys/common.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "ahci.h"
+#include "hba.h"
+#include "port.h"
+
+using namespace esc;
+
+/* the AHCI programming interface of the mass storage/SATA class */
+static const uchar AHCI_PCI_PROGIF	= 0x01;
+
+int main(int argc,char **argv) {
+	if(argc < 2) {
+		printe("Usage: %s <wait>",argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	/* detect and init all controllers */
+	std::vector<HBA*> hbas;
+	{
+		PCI pci("/dev/pci");
+		PCI::Device dev;
+		for(int no = 0; pci.tryByClass(dev,AHCI_PCI_CLASS,AHCI_PCI_SUBCLASS,no) == 0; ++no) {
+			if(dev.progInterface != AHCI_PCI_PROGIF)
+				continue;
+
+			print("Using PCI-device %d.%d.%d: vendor=%hx, device=%hx",
+				dev.bus,dev.dev,dev.func,dev.vendorId,dev.deviceId);
+			try {
+				hbas.push_back(new HBA(pci,dev));
+			}
+			catch(const std::exception &e) {
+				printe("Unable to use AHCI controller: %s",e.what());
+			}
+		}
+	}
+
+	/* the ports with a usable disk are named sda, sdb, ... in this order */
+	std::vector<blkdev::Disk*> disks;
+	for(auto it = hbas.begin(); it != hbas.end(); ++it) {
+		for(size_t i = 0; i < AHCI_MAX_PORTS; ++i) {
+			Port *port = (*it)->port(i);
+			if(port != NULL) {
+				print("Port %u: disk sd%c",port->no(),static_cast<char>('a' + disks.size()));
+				disks.push_back(port);
+			}
+		}
+		(*it)->start();
+	}
+
+	blkdev::serve(disks,"sd",argv[1]);
+
+	/* clean up */
+	for(auto it = hbas.begin(); it != hbas.end(); ++it)
+		delete *it;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <esc/vthrow.h>
+#include <sys/common.h>
+#include <sys/irq.h>
+#include <sys/mman.h>
+#include <sys/sync.h>
+#include <sys/thread.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include "hba.h"
+#include "port.h"
+
+HBA::HBA(esc::PCI &pci,const esc::PCI::Device &dev)
+		: _regs(), _cap(), _irqsem(-1), _ports() {
+	const esc::PCI::Bar &bar = dev.bars[AHCI_ABAR];
+	if(bar.addr == 0 || bar.type != esc::PCI::Bar::BAR_MEM)
+		VTHROW("AHCI controller has no memory BAR " << AHCI_ABAR);
+
+	uintptr_t phys = bar.addr;
+	_regs = reinterpret_cast<volatile HBARegs*>(mmapphys(&phys,bar.size,0,MAP_PHYS_MAP));
+	if(_regs == NULL)
+		VTHROWE("Unable to map ABAR " << (void*)phys,-errno);
+	AHCI_PR1("Mapped ABAR %p..%p @ %p",phys,phys + bar.size - 1,_regs);
+
+	// ensure that the controller is the bus master and may access memory
+	uint32_t statusCmd = pci.read(dev.bus,dev.dev,dev.func,0x04);
+	pci.write(dev.bus,dev.dev,dev.func,0x04,(statusCmd & ~0x400) | 0x6);
+
+	reset();
+
+	// create the IRQ sem before the ports are started to not miss an interrupt
+	if(pci.hasCap(dev.bus,dev.dev,dev.func,esc::PCI::CAP_MSI)) {
+		AHCI_PR1("Using MSIs (%u)",dev.irq);
+		uint64_t msiaddr;
+		uint32_t msival;
+		_irqsem = semcrtirq(dev.irq,"AHCI",&msiaddr,&msival);
+		if(_irqsem >= 0)
+			pci.enableMSIs(dev.bus,dev.dev,dev.func,msiaddr,msival);
+	}
+	else {
+		AHCI_PR1("Using legacy IRQs (%u)",dev.irq);
+		_irqsem = semcrtirq(dev.irq,"AHCI",NULL,NULL);
+	}
+	if(_irqsem < 0)
+		VTHROWE("Unable to create irq-semaphore",_irqsem);
+
+	uint32_t pi = _regs->pi;
+	volatile PortRegs *ports = reinterpret_cast<volatile PortRegs*>(_regs + 1);
+	for(size_t i = 0; i < AHCI_MAX_PORTS; ++i) {
+		if(~pi & (1U << i))
+			continue;
+
+		Port *port = new Port(*this,i,ports + i);
+		if(port->init())
+			_ports[i] = port;
+		else
+			delete port;
+	}
+}
+
+HBA::~HBA() {
+	_regs->ghc &= ~GHC_IE;
+	for(size_t i = 0; i < AHCI_MAX_PORTS; ++i)
+		delete _ports[i];
+	if(_irqsem >= 0)
+		semdestr(_irqsem);
+	munmap(const_cast<HBARegs*>(_regs));
+}
+
+void HBA::reset() {
+	// take the controller over from the BIOS, if necessary
+	if((_regs->cap2 & 0x1) && (_regs->bohc & 0x1)) {
+		_regs->bohc |= 0x2;
+		if(!waitUntil(&_regs->bohc,0x1,0,2000))
+			print("BIOS does not release the AHCI controller; continuing anyway");
+	}
+
+	// AHCI has to be enabled before the reset can be requested
+	_regs->ghc |= GHC_AE;
+	_regs->ghc |= GHC_HR;
+	if(!waitUntil(&_regs->ghc,GHC_HR,0,1000))
+		VTHROW("AHCI controller reset timed out");
+
+	_regs->ghc |= GHC_AE;
+	_cap = _regs->cap;
+	print("AHCI %x.%x: %u ports, %u slots, NCQ=%d, 64-bit=%d",
+		_regs->vs >> 16,_regs->vs & 0xFFFF,(_cap & CAP_NP_MASK) + 1,
+		((_cap & CAP_NCS_MASK) >> CAP_NCS_SHIFT) + 1,!!(_cap & CAP_SNCQ),!!(_cap & CAP_S64A));
+}
+
+void HBA::start() {
+	_regs->is = _regs->is;
+	_regs->ghc |= GHC_IE;
+
+	if(startthread(irqThread,this) < 0)
+		error("Unable to start IRQ-thread");
+}
+
+bool HBA::waitUntil(volatile uint32_t *reg,uint32_t mask,uint32_t value,uint ms) {
+	for(uint i = 0; i < ms; ++i) {
+		if((*reg & mask) == value)
+			return true;
+		usleep(1000);
+	}
+	return (*reg & mask) == value;
+}
+
+int HBA::irqThread(void *arg) {
+	HBA *hba = reinterpret_cast<HBA*>(arg);
+	while(1) {
+		semdown(hba->_irqsem);
+
+		// the port interrupt status has to be cleared before the global one
+		uint32_t is = hba->_regs->is;
+		for(size_t i = 0; i < AHCI_MAX_PORTS; ++i) {
+			if((is & (1U << i)) && hba->_ports[i])
+				hba->_ports[i]->handleIntrpt();
+		}
+		hba->_regs->is = is;
+	}
+	return 0;
+}
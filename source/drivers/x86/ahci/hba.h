@@ -0,0 +1,83 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+
+#include <esc/proto/pci.h>
+#include <sys/common.h>
+
+#include "ahci.h"
+
+class Port;
+
+/**
+ * An AHCI host bus adapter, i.e. the controller with up to 32 ports.
+ */
+class HBA {
+public:
+	/**
+	 * Maps the registers of the given PCI device, resets the controller and initializes all
+	 * ports with attached disks.
+	 *
+	 * @param pci the PCI service
+	 * @param dev the PCI device
+	 * @throws if the controller can't be used
+	 */
+	explicit HBA(esc::PCI &pci,const esc::PCI::Device &dev);
+	~HBA();
+
+	/**
+	 * @return the capabilities
+	 */
+	uint32_t cap() const {
+		return _cap;
+	}
+	/**
+	 * @param no the port number
+	 * @return the port with given number or NULL if there is no usable disk
+	 */
+	Port *port(size_t no) {
+		return _ports[no];
+	}
+
+	/**
+	 * Enables interrupts and starts the thread that handles them.
+	 */
+	void start();
+
+	/**
+	 * Waits until (*reg & mask) == value.
+	 *
+	 * @param reg the register
+	 * @param mask the bits to check
+	 * @param value the expected value
+	 * @param ms the timeout in milliseconds
+	 * @return true if the condition has been met in time
+	 */
+	static bool waitUntil(volatile uint32_t *reg,uint32_t mask,uint32_t value,uint ms);
+
+private:
+	void reset();
+	static int irqThread(void *arg);
+
+	volatile HBARegs *_regs;
+	uint32_t _cap;
+	int _irqsem;
+	Port *_ports[AHCI_MAX_PORTS];
+};
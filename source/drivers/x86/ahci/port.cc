@@ -0,0 +1,425 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <esc/util.h>
+#include <sys/common.h>
+#include <sys/mman.h>
+#include <sys/thread.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hba.h"
+#include "port.h"
+
+/* the timeout for synchronous commands in milliseconds */
+static const uint SYNC_TIMEOUT		= 5000;
+/* the end of the memory that HBAs without 64-bit addressing can access */
+static const uint64_t ADDR32_END	= 1ULL << 32;
+
+static inline void setPRD(PRD *prd,uint64_t addr,size_t len) {
+	prd->dba = addr;
+	prd->dbau = addr >> 32;
+	prd->reserved = 0;
+	prd->dbc = len - 1;
+}
+
+Port::Port(HBA &hba,uint no,volatile PortRegs *regs)
+	: _hba(hba), _no(no), _regs(regs), _cmdList(), _fis(), _tables(), _tablesPhys(), _bounce(),
+	  _bouncePhys(), _secSize(512), _sectors(), _lba48(), _ncq(), _slots(), _free(), _issued(),
+	  _recovering(), _deferred(), _freeSem(), _mutex(), _reqs(), _ident() {
+}
+
+Port::~Port() {
+	stop();
+	_regs->cmd &= ~PxCMD_FRE;
+	if(_bounce)
+		munmap(_bounce);
+	if(_tables)
+		munmap(_tables);
+	if(_cmdList)
+		munmap(_cmdList);
+	if(_slots)
+		usemdestr(&_freeSem);
+}
+
+bool Port::init() {
+	// the port has to be idle before we can change the addresses
+	stop();
+	_regs->cmd &= ~PxCMD_FRE;
+	if(!HBA::waitUntil(&_regs->cmd,PxCMD_FR,0,500)) {
+		print("Port %u: FIS receive engine does not stop",_no);
+		return false;
+	}
+
+	size_t hwslots = ((_hba.cap() & CAP_NCS_MASK) >> CAP_NCS_SHIFT) + 1;
+
+	// the command list (1 KiB) and the received FIS area (256 bytes) share one page
+	uintptr_t phys = 0;
+	_cmdList = reinterpret_cast<CommandHeader*>(mmapphys(&phys,PAGE_SIZE,PAGE_SIZE,MAP_PHYS_ALLOC));
+	if(_cmdList == NULL) {
+		print("Port %u: unable to allocate command list",_no);
+		return false;
+	}
+	memset(_cmdList,0,PAGE_SIZE);
+	_fis = reinterpret_cast<ReceivedFIS*>(_cmdList + AHCI_MAX_SLOTS);
+	uint64_t fisPhys = phys + AHCI_MAX_SLOTS * sizeof(CommandHeader);
+	_regs->clb = phys;
+	_regs->clbu = static_cast<uint64_t>(phys) >> 32;
+	_regs->fb = fisPhys;
+	_regs->fbu = fisPhys >> 32;
+
+	_tablesPhys = 0;
+	_tables = reinterpret_cast<CommandTable*>(mmapphys(&_tablesPhys,
+		hwslots * sizeof(CommandTable),PAGE_SIZE,MAP_PHYS_ALLOC));
+	_bouncePhys = 0;
+	_bounce = reinterpret_cast<uint8_t*>(mmapphys(&_bouncePhys,
+		hwslots * BOUNCE_SIZE,PAGE_SIZE,MAP_PHYS_ALLOC));
+	if(_tables == NULL || _bounce == NULL) {
+		print("Port %u: unable to allocate command tables",_no);
+		return false;
+	}
+	if(!canAccess(phys,PAGE_SIZE) || !canAccess(_tablesPhys,hwslots * sizeof(CommandTable)) ||
+			!canAccess(_bouncePhys,hwslots * BOUNCE_SIZE)) {
+		print("Port %u: command tables are not accessible for the HBA",_no);
+		return false;
+	}
+	memset(_tables,0,hwslots * sizeof(CommandTable));
+	for(size_t i = 0; i < hwslots; ++i) {
+		uint64_t addr = _tablesPhys + i * sizeof(CommandTable);
+		_cmdList[i].ctba = addr;
+		_cmdList[i].ctbau = addr >> 32;
+	}
+
+	// spin up the device and wait until the link is established
+	_regs->cmd |= PxCMD_FRE | PxCMD_SUD | PxCMD_POD;
+	if(!HBA::waitUntil(&_regs->ssts,SSTS_DET_MASK,SSTS_DET_PRESENT,100))
+		return false;
+	_regs->serr = 0xFFFFFFFF;
+	_regs->is = 0xFFFFFFFF;
+	if(!HBA::waitUntil(&_regs->tfd,PxTFD_BSY | PxTFD_DRQ,0,1000)) {
+		print("Port %u: device stays busy",_no);
+		return false;
+	}
+	if(_regs->sig != SIG_ATA) {
+		print("Port %u: ignoring device with signature %#x",_no,_regs->sig);
+		return false;
+	}
+	start();
+
+	if(!execSync(0,ATA_CMD_IDENTIFY,0,0,sizeof(_ident))) {
+		print("Port %u: IDENTIFY DEVICE failed",_no);
+		return false;
+	}
+	memcpy(_ident,bounce(0),sizeof(_ident));
+
+	_lba48 = _ident[83] & (1 << 10);
+	if(_lba48) {
+		_sectors = static_cast<uint64_t>(_ident[100]) | (static_cast<uint64_t>(_ident[101]) << 16) |
+			(static_cast<uint64_t>(_ident[102]) << 32) | (static_cast<uint64_t>(_ident[103]) << 48);
+	}
+	else
+		_sectors = _ident[60] | (static_cast<uint32_t>(_ident[61]) << 16);
+	// logical sectors larger than 512 bytes?
+	if((_ident[106] & 0xC000) == 0x4000 && (_ident[106] & (1 << 12)))
+		_secSize = (_ident[117] | (static_cast<uint32_t>(_ident[118]) << 16)) * 2;
+	if(_secSize < 512 || _secSize > BOUNCE_SIZE || (_secSize & (_secSize - 1))) {
+		print("Port %u: unsupported sector size %zu",_no,_secSize);
+		return false;
+	}
+
+	if(!execSync(0,command(OP_READ),0,1,_secSize)) {
+		print("Port %u: unable to read partition table",_no);
+		return false;
+	}
+	blkdev::Partition::fill(_parts,bounce(0));
+
+	// from now on, use NCQ if both the HBA and the device support it
+	_ncq = (_hba.cap() & CAP_SNCQ) && (_ident[76] & (1 << 8)) && _lba48;
+	_slots = hwslots;
+	if(_ncq)
+		_slots = esc::Util::min(_slots,static_cast<size_t>((_ident[75] & 0x1F) + 1));
+	_free = _slots == 32 ? 0xFFFFFFFF : (1U << _slots) - 1;
+	if(usemcrt(&_freeSem,_slots) < 0) {
+		_slots = 0;
+		print("Port %u: unable to create semaphore",_no);
+		return false;
+	}
+
+	_regs->is = 0xFFFFFFFF;
+	_regs->ie = PxIS_ERRORS | PxIS_DHRS | PxIS_SDBS;
+
+	print("Port %u: %Lu sectors a %zu bytes, LBA48=%d, NCQ=%d, %zu slots",
+		_no,_sectors,_secSize,_lba48,_ncq,_slots);
+	return true;
+}
+
+void Port::stop() {
+	_regs->cmd &= ~PxCMD_ST;
+	if(!HBA::waitUntil(&_regs->cmd,PxCMD_CR,0,500))
+		print("Port %u: command list engine does not stop",_no);
+}
+
+void Port::start() {
+	HBA::waitUntil(&_regs->cmd,PxCMD_CR,0,500);
+	_regs->cmd |= PxCMD_FRE | PxCMD_ST;
+}
+
+void Port::recover(uint32_t failed) {
+	stop();
+	_regs->serr = 0xFFFFFFFF;
+	_regs->is = 0xFFFFFFFF;
+
+	// if the device is still busy, we need a COMRESET to get it back
+	if(_regs->tfd & (PxTFD_BSY | PxTFD_DRQ)) {
+		print("Port %u: resetting link",_no);
+		_regs->sctl = (_regs->sctl & ~0xF) | 0x1;
+		usleep(1000);
+		_regs->sctl &= ~0xF;
+		HBA::waitUntil(&_regs->ssts,SSTS_DET_MASK,SSTS_DET_PRESENT,100);
+		HBA::waitUntil(&_regs->tfd,PxTFD_BSY | PxTFD_DRQ,0,1000);
+		_regs->serr = 0xFFFFFFFF;
+		_regs->is = 0xFFFFFFFF;
+	}
+	start();
+
+	// after an NCQ error, the device does not accept new queued commands until we've read the log
+	if(_ncq && failed) {
+		uint slot = __builtin_ctz(failed);
+		if(!execSync(slot,ATA_CMD_READ_LOG_EXT,ATA_LOG_NCQ_ERROR,1,512))
+			print("Port %u: unable to read NCQ error log",_no);
+	}
+}
+
+bool Port::canAccess(uint64_t addr,size_t len) const {
+	return (_hba.cap() & CAP_S64A) || (addr < ADDR32_END && len <= ADDR32_END - addr);
+}
+
+bool Port::canAccess(const uintptr_t *pages,size_t count) const {
+	for(size_t i = 0; i < count; ++i) {
+		if(!canAccess(pages[i],PAGE_SIZE))
+			return false;
+	}
+	return true;
+}
+
+uint Port::acquire() {
+	usemdown(&_freeSem);
+	std::lock_guard<std::mutex> guard(_mutex);
+	assert(_free != 0);
+	uint slot = __builtin_ctz(_free);
+	_free &= ~(1U << slot);
+	return slot;
+}
+
+void Port::release(uint slot) {
+	{
+		std::lock_guard<std::mutex> guard(_mutex);
+		_free |= 1U << slot;
+	}
+	usemup(&_freeSem);
+}
+
+uint Port::command(uint op) const {
+	if(_ncq)
+		return op == OP_READ ? ATA_CMD_READ_FPDMA_QUEUED : ATA_CMD_WRITE_FPDMA_QUEUED;
+	if(_lba48)
+		return op == OP_READ ? ATA_CMD_READ_DMA_EXT : ATA_CMD_WRITE_DMA_EXT;
+	return op == OP_READ ? ATA_CMD_READ_DMA : ATA_CMD_WRITE_DMA;
+}
+
+bool Port::setupCommand(uint slot,uint cmd,uint64_t lba,size_t secCount,size_t bytes,bool write,
+		const uintptr_t *pages,size_t offset) {
+	CommandTable *tbl = _tables + slot;
+
+	// build the PRDT; physically contiguous pages are merged into one entry
+	size_t n = 0;
+	if(pages == NULL) {
+		setPRD(tbl->prdt,_bouncePhys + slot * BOUNCE_SIZE,bytes);
+		n = 1;
+	}
+	else {
+		uint64_t start = 0;
+		size_t len = 0;
+		while(bytes > 0) {
+			size_t pgoff = offset & (PAGE_SIZE - 1);
+			uint64_t addr = pages[offset / PAGE_SIZE] + pgoff;
+			size_t amount = esc::Util::min(PAGE_SIZE - pgoff,bytes);
+			if(!canAccess(addr,amount))
+				return false;
+			if(n > 0 && addr == start + len && len + amount <= AHCI_MAX_PRD_BYTES)
+				len += amount;
+			else {
+				if(n > 0)
+					setPRD(tbl->prdt + n - 1,start,len);
+				if(n == AHCI_MAX_PRDS)
+					return false;
+				start = addr;
+				len = amount;
+				n++;
+			}
+			offset += amount;
+			bytes -= amount;
+		}
+		setPRD(tbl->prdt + n - 1,start,len);
+	}
+
+	FISRegH2D *fis = reinterpret_cast<FISRegH2D*>(tbl->cfis);
+	memset(fis,0,sizeof(*fis));
+	fis->type = FIS_TYPE_REG_H2D;
+	fis->flags = 0x80;
+	fis->command = cmd;
+	if(cmd != ATA_CMD_IDENTIFY) {
+		fis->device = ATA_DEV_LBA;
+		fis->lba0 = lba;
+		fis->lba1 = lba >> 8;
+		fis->lba2 = lba >> 16;
+		if(cmd == ATA_CMD_READ_DMA || cmd == ATA_CMD_WRITE_DMA)
+			fis->device |= (lba >> 24) & 0x0F;
+		else {
+			fis->lba3 = lba >> 24;
+			fis->lba4 = lba >> 32;
+			fis->lba5 = lba >> 40;
+		}
+		// for queued commands, the count goes into the features and the tag into the count
+		if(cmd == ATA_CMD_READ_FPDMA_QUEUED || cmd == ATA_CMD_WRITE_FPDMA_QUEUED) {
+			fis->featureLow = secCount;
+			fis->featureHigh = secCount >> 8;
+			fis->countLow = slot << 3;
+		}
+		else {
+			fis->countLow = secCount;
+			fis->countHigh = secCount >> 8;
+		}
+	}
+
+	CommandHeader *hdr = _cmdList + slot;
+	hdr->flags = (sizeof(FISRegH2D) / sizeof(uint32_t)) | (write ? CMDH_WRITE : 0) |
+		(n << CMDH_PRDTL_SHIFT);
+	hdr->prdbc = 0;
+	return true;
+}
+
+bool Port::execSync(uint slot,uint cmd,uint64_t lba,size_t secCount,size_t bytes) {
+	if(!setupCommand(slot,cmd,lba,secCount,bytes,false,NULL,0))
+		return false;
+
+	_regs->is = 0xFFFFFFFF;
+	asm volatile ("" : : : "memory");
+	_regs->ci = 1U << slot;
+
+	for(uint i = 0; i < SYNC_TIMEOUT; ++i) {
+		if((~_regs->ci & (1U << slot)) || (_regs->is & PxIS_ERRORS))
+			break;
+		usleep(1000);
+	}
+
+	bool res = !(_regs->ci & (1U << slot)) && !(_regs->is & PxIS_ERRORS) &&
+		!(_regs->tfd & PxTFD_ERR);
+	_regs->is = 0xFFFFFFFF;
+	return res;
+}
+
+bool Port::submit(uint slot,uint64_t lba,size_t secCount,const uintptr_t *pages,size_t offset,
+		const Request &req) {
+	if(secCount == 0 || secCount > maxSectors())
+		return false;
+	if(!setupCommand(slot,command(req.op),lba,secCount,secCount * _secSize,req.op == OP_WRITE,
+			pages,offset))
+		return false;
+
+	std::lock_guard<std::mutex> guard(_mutex);
+	_reqs[slot] = req;
+	if(_recovering)
+		_deferred |= 1U << slot;
+	else
+		issue(1U << slot);
+	AHCI_PR2("Port %u: issued slot %u: op=%u lba=%Lu count=%zu",_no,slot,req.op,lba,secCount);
+	return true;
+}
+
+void Port::issue(uint32_t slots) {
+	_issued |= slots;
+	asm volatile ("" : : : "memory");
+	if(_ncq)
+		_regs->sact = slots;
+	_regs->ci = slots;
+}
+
+void Port::handleIntrpt() {
+	Request done[AHCI_MAX_SLOTS];
+	uint32_t finished,failed = 0;
+	{
+		std::lock_guard<std::mutex> guard(_mutex);
+		uint32_t is = _regs->is;
+		_regs->is = is;
+
+		// a slot is done when neither SActive nor the command issue bit is set anymore
+		finished = _issued & ~(_regs->sact | _regs->ci);
+		if(is & PxIS_ERRORS) {
+			failed = _issued & ~finished;
+			print("Port %u: error (IS=%#x, TFD=%#x, SERR=%#x); failing slots %#x",
+				_no,is,_regs->tfd,_regs->serr,failed);
+			_recovering = true;
+		}
+		_issued &= ~(finished | failed);
+
+		for(uint32_t bits = finished | failed; bits; bits &= bits - 1) {
+			uint slot = __builtin_ctz(bits);
+			done[slot] = std::move(_reqs[slot]);
+		}
+	}
+
+	// the recovery can take seconds. thus, do it without the lock and let submit() collect the new
+	// commands meanwhile. the failed slots are still ours, because they are released below
+	if(_recovering) {
+		recover(failed);
+
+		std::lock_guard<std::mutex> guard(_mutex);
+		_recovering = false;
+		if(_deferred)
+			issue(_deferred);
+		_deferred = 0;
+	}
+
+	// answer the clients without holding the lock
+	for(uint32_t bits = finished | failed; bits; bits &= bits - 1) {
+		uint slot = __builtin_ctz(bits);
+		finish(slot,done[slot],(finished & (1U << slot)) != 0);
+	}
+}
+
+static void printIdentString(FILE *f,const char *name,const uint16_t *words,size_t count) {
+	fprintf(f,"%-15s",name);
+	for(size_t i = 0; i < count; ++i)
+		fprintf(f,"%c%c",words[i] >> 8,words[i] & 0xFF);
+	fprintf(f,"\n");
+}
+
+void Port::printInfo(FILE *f) const {
+	fprintf(f,"%-15s%s\n","Type:","SATA (AHCI)");
+	printIdentString(f,"ModelNo:",_ident + 27,20);
+	printIdentString(f,"SerialNo:",_ident + 10,10);
+	printIdentString(f,"FirmwareRev:",_ident + 23,4);
+	fprintf(f,"%-15s%Lu\n","Sectors:",_sectors);
+	fprintf(f,"%-15s%zu\n","SectorSize:",_secSize);
+	fprintf(f,"%-15s%d\n","NCQ:",_ncq);
+	fprintf(f,"%-15s%zu\n","Slots:",_slots);
+}
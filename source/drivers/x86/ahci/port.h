@@ -0,0 +1,165 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+
+#include <blkdev/disk.h>
+#include <sys/common.h>
+#include <sys/sync.h>
+#include <mutex>
+#include <stdio.h>
+
+#include "ahci.h"
+
+class HBA;
+
+/**
+ * A port of an AHCI controller with an attached SATA disk. Commands are issued asynchronously and
+ * several of them can be outstanding at once; with NCQ, the disk may also reorder them. They are
+ * completed by the interrupt thread of the HBA, which sends the reply to the client.
+ */
+class Port : public blkdev::Disk {
+public:
+	/**
+	 * Creates a port. Use init() to initialize it afterwards.
+	 *
+	 * @param hba the controller
+	 * @param no the port number
+	 * @param regs the registers of this port
+	 */
+	explicit Port(HBA &hba,uint no,volatile PortRegs *regs);
+	virtual ~Port();
+
+	/**
+	 * Starts the port and identifies the attached disk.
+	 *
+	 * @return true if a usable disk is attached
+	 */
+	bool init();
+
+	/**
+	 * @return the port number
+	 */
+	uint no() const {
+		return _no;
+	}
+	virtual size_t secSize() const override {
+		return _secSize;
+	}
+	virtual uint64_t sectors() const override {
+		return _sectors;
+	}
+	/**
+	 * @return whether native command queuing is used
+	 */
+	bool ncq() const {
+		return _ncq;
+	}
+	/**
+	 * @return the number of commands that can be outstanding at once
+	 */
+	size_t slots() const {
+		return _slots;
+	}
+	/**
+	 * @return the result of the IDENTIFY DEVICE command
+	 */
+	const uint16_t *identify() const {
+		return _ident;
+	}
+
+	/**
+	 * @return the number of PRDs, because each page needs at most one
+	 */
+	virtual size_t maxPages() const override {
+		return AHCI_MAX_PRDS;
+	}
+	/**
+	 * @return the maximum sector count of the used read and write commands
+	 */
+	virtual size_t maxSectors() const override {
+		return (_ncq || _lba48) ? 0xFFFF : 0xFF;
+	}
+
+	virtual uint acquire() override;
+	virtual void release(uint slot) override;
+	virtual void *bounce(uint slot) override {
+		return _bounce + slot * BOUNCE_SIZE;
+	}
+
+	/**
+	 * Checks whether the HBA can access the given pages via DMA. Without 64-bit addressing
+	 * (CAP_S64A), it can only access the first 4 GiB.
+	 *
+	 * @param pages the physical addresses of the pages
+	 * @param count the number of pages
+	 * @return true if so
+	 */
+	virtual bool canAccess(const uintptr_t *pages,size_t count) const override;
+
+	/**
+	 * Issues a read or write command in given slot (see blkdev::Disk::submit()). It fails if the
+	 * HBA can't access the pages (see canAccess()).
+	 */
+	virtual bool submit(uint slot,uint64_t lba,size_t secCount,const uintptr_t *pages,
+		size_t offset,const Request &req) override;
+
+	virtual void printInfo(FILE *f) const override;
+
+	/**
+	 * Handles an interrupt of this port, i.e. answers all completed requests.
+	 */
+	void handleIntrpt();
+
+private:
+	bool canAccess(uint64_t addr,size_t len) const;
+	void stop();
+	void start();
+	void recover(uint32_t failed);
+	void issue(uint32_t slots);
+	bool setupCommand(uint slot,uint cmd,uint64_t lba,size_t secCount,size_t bytes,bool write,
+		const uintptr_t *pages,size_t offset);
+	bool execSync(uint slot,uint cmd,uint64_t lba,size_t secCount,size_t bytes);
+	uint command(uint op) const;
+
+	HBA &_hba;
+	uint _no;
+	volatile PortRegs *_regs;
+	CommandHeader *_cmdList;
+	ReceivedFIS *_fis;
+	CommandTable *_tables;
+	uintptr_t _tablesPhys;
+	uint8_t *_bounce;
+	uintptr_t _bouncePhys;
+	size_t _secSize;
+	uint64_t _sectors;
+	bool _lba48;
+	bool _ncq;
+	size_t _slots;
+	/* the slots that are free and that have been issued to the HBA */
+	uint32_t _free;
+	uint32_t _issued;
+	/* while the port is recovered, new commands are collected in _deferred */
+	bool _recovering;
+	uint32_t _deferred;
+	tUserSem _freeSem;
+	std::mutex _mutex;
+	Request _reqs[AHCI_MAX_SLOTS];
+	uint16_t _ident[256];
+};
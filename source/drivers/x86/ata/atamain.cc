@@ -18,6 +18,7 @@
  */
 
 #include <sys/arch/x86/ports.h>
+#include <blkdev/partition.h>
 #include <esc/ipc/clientdevice.h>
 #include <esc/ipc/ipcstream.h>
 #include <esc/util.h>
@@ -41,7 +42,6 @@
 #include "ata.h"
 #include "controller.h"
 #include "device.h"
-#include "partition.h"
 
 using namespace esc;
 
@@ -50,13 +50,13 @@ class ATAPartitionDevice;
 static const size_t MAX_RW_SIZE		= 4096;
 static const int RETRY_COUNT		= 3;
 
-static ulong handleRead(sATADevice *device,sPartition *part,uint16_t *buf,uint offset,uint count);
-static ulong handleWrite(sATADevice *device,sPartition *part,uint16_t *buf,uint offset,uint count);
+static ulong handleRead(sATADevice *device,blkdev::Partition *part,uint16_t *buf,uint offset,uint count);
+static ulong handleWrite(sATADevice *device,blkdev::Partition *part,uint16_t *buf,uint offset,uint count);
 static void initDrives(void);
-static void createVFSEntry(sATADevice *device,sPartition *part,const char *name);
+static void createVFSEntry(sATADevice *device,blkdev::Partition *part,const char *name);
 
 static size_t drvCount = 0;
-static ATAPartitionDevice *devs[DEVICE_COUNT * PARTITION_COUNT];
+static ATAPartitionDevice *devs[DEVICE_COUNT * blkdev::Partition::COUNT];
 /* don't use dynamic memory here since this may cause trouble with swapping (which we do) */
 /* because if the heap hasn't enough memory and we request more when we should swap the kernel
  * may not have more memory and can't do anything about it */
@@ -82,15 +82,19 @@ public:
 		Client *c = (*this)[is.fd()];
 		DevDelegate::Request r;
 		is >> r;
-		assert(c->shm() == NULL && !is.error());
+		assert(!is.error());
 
 		/* ensure that we don't cause pagefaults when accessing this memory. therefore,
 		 * we populate it immediately and lock it into memory. additionally, we specify
 		 * MAP_NOSWAP to let it fail if there is not enough memory instead of starting
 		 * to swap (which would cause a deadlock, because we're doing that). */
 		int res = -EINVAL;
-		if(r.arg == DEL_ARG_SHFILE)
+		if(r.arg == DEL_ARG_SHFILE) {
+			assert(c->shm() == NULL);
 			res = joinshm(c,r.nfd,MAP_POPULATE | MAP_NOSWAP | MAP_LOCKED);
+		}
+		else if(r.arg == DEL_ARG_SHRING)
+			res = joinring(c,r.nfd);
 		is << DevDelegate::Response(res) << Reply();
 	}
 
@@ -124,9 +128,40 @@ public:
 		is << FileSize::Response::success(_part->size * _ataDev->secSize) << Reply();
 	}
 
+protected:
+	/**
+	 * Handles MSG_FILE_READ and MSG_FILE_WRITE requests that arrive over a ring channel. They are
+	 * serialized as over the channel, but the data has to be in the shared memory, because the
+	 * slots are too small for it.
+	 */
+	virtual void handleRing(Client *c,msgid_t mid,void *data,size_t len) override {
+		IPCBuf ib(reinterpret_cast<ulong*>(data),len);
+		/* both requests have the same format */
+		FileRead::Request r;
+		ib >> r;
+
+		ulong resp[8];
+		IPCBuf ob(resp,sizeof(resp));
+		uint op = mid & 0xFFFF;
+		if(ib.error() || (op != MSG_FILE_READ && op != MSG_FILE_WRITE) || !c->shm() ||
+				r.shmemoff < 0 || (r.shmemoff & 1) || r.count > c->sharedmem()->size ||
+				static_cast<size_t>(r.shmemoff) > c->sharedmem()->size - r.count)
+			ob << FileRead::Response::error(-EINVAL);
+		else {
+			uint16_t *buf = (uint16_t*)c->shm() + (r.shmemoff >> 1);
+			size_t res;
+			if(op == MSG_FILE_READ)
+				res = handleRead(_ataDev,_part,buf,r.offset,r.count);
+			else
+				res = handleWrite(_ataDev,_part,buf,r.offset,r.count);
+			ob << FileRead::Response::success(res);
+		}
+		c->ring()->send(mid,resp,ob.pos());
+	}
+
 private:
 	sATADevice *_ataDev;
-	sPartition *_part;
+	blkdev::Partition *_part;
 };
 
 static int drive_thread(void *arg) {
@@ -190,7 +225,7 @@ int main(int argc,char **argv) {
 	return EXIT_SUCCESS;
 }
 
-static ulong handleRead(sATADevice *ataDev,sPartition *part,uint16_t *buf,uint offset,uint count) {
+static ulong handleRead(sATADevice *ataDev,blkdev::Partition *part,uint16_t *buf,uint offset,uint count) {
 	/* we have to check whether it is at least one sector. otherwise ATA can't
 	 * handle the request */
 	if(offset + count <= part->size * ataDev->secSize && offset + count > offset) {
@@ -217,7 +252,7 @@ static ulong handleRead(sATADevice *ataDev,sPartition *part,uint16_t *buf,uint o
 	return 0;
 }
 
-static ulong handleWrite(sATADevice *ataDev,sPartition *part,uint16_t *buf,uint offset,uint count) {
+static ulong handleWrite(sATADevice *ataDev,blkdev::Partition *part,uint16_t *buf,uint offset,uint count) {
 	if(offset + count <= part->size * ataDev->secSize && offset + count > offset) {
 		if(buf != buffer || count <= MAX_RW_SIZE) {
 			int i;
@@ -257,7 +292,7 @@ static void initDrives(void) {
 		createVFSEntry(ataDev,NULL,name);
 
 		/* register device for every partition */
-		for(size_t p = 0; p < PARTITION_COUNT; p++) {
+		for(size_t p = 0; p < blkdev::Partition::COUNT; p++) {
 			if(ataDev->partTable[p].present) {
 				if(!ataDev->info.general.isATAPI)
 					snprintf(name,sizeof(name),"hd%c%zu",'a' + ataDev->id,p + 1);
@@ -284,7 +319,7 @@ static void initDrives(void) {
 	}
 }
 
-static void createVFSEntry(sATADevice *ataDev,sPartition *part,const char *name) {
+static void createVFSEntry(sATADevice *ataDev,blkdev::Partition *part,const char *name) {
 	FILE *f;
 	char path[SSTRLEN("/sys/dev/hda1") + 1];
 	snprintf(path,sizeof(path),"/sys/dev/%s",name);
@@ -326,8 +361,8 @@ static void createVFSEntry(sATADevice *ataDev,sPartition *part,const char *name)
 		fprintf(f,"%-15s%d\n","DMA:",ataDev->info.capabilities.DMA);
 	}
 	else {
-		fprintf(f,"%-15s%zu\n","Start:",part->start);
-		fprintf(f,"%-15s%zu\n","Sectors:",part->size);
+		fprintf(f,"%-15s%Lu\n","Start:",part->start);
+		fprintf(f,"%-15s%Lu\n","Sectors:",part->size);
 	}
 
 	fclose(f);
@@ -79,7 +79,7 @@ void device_init(sATADevice *device) {
 
 		/* copy partitions to mem */
 		ATA_PR2("Parsing partition-table");
-		part_fillPartitions(device->partTable,buffer);
+		blkdev::Partition::fill(device->partTable,buffer);
 	}
 	else {
 		size_t cap;
@@ -103,7 +103,7 @@ void device_init(sATADevice *device) {
 			}
 		}
 		device->partTable[0].size = cap;
-		ATA_LOG("Device %d is an ATAPI-device with %zu sectors",device->id,device->partTable[0].size);
+		ATA_LOG("Device %d is an ATAPI-device with %zu sectors",device->id,cap);
 	}
 
 	if(device->ctrl->useDma && device->info.capabilities.DMA) {
@@ -19,11 +19,10 @@
 
 #pragma once
 
+#include <blkdev/partition.h>
 #include <sys/common.h>
 #include <sys/irq.h>
 
-#include "partition.h"
-
 enum {
 	OP_READ									= 0,
 	OP_WRITE								= 1,
@@ -304,7 +303,7 @@ struct sATADevice {
 	/* various informations we got via IDENTIFY-command */
 	sATAIdentify info;
 	/* the partition-table */
-	sPartition partTable[PARTITION_COUNT];
+	blkdev::Partition partTable[blkdev::Partition::COUNT];
 };
 
 /* physical region descriptor */
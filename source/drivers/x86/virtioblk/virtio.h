@@ -0,0 +1,143 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+
+#include <sys/common.h>
+
+#define VIRTIO_DEBUG		0
+
+#if VIRTIO_DEBUG > 0
+#	define VIRTIO_PR1(fmt,...)	print(fmt,## __VA_ARGS__)
+#else
+#	define VIRTIO_PR1(...)
+#endif
+
+#if VIRTIO_DEBUG > 1
+#	define VIRTIO_PR2(fmt,...)	print(fmt,## __VA_ARGS__)
+#else
+#	define VIRTIO_PR2(...)
+#endif
+
+/* the PCI ids of (transitional) virtio block devices */
+static const ushort VIRTIO_PCI_VENDOR		= 0x1AF4;
+static const ushort VIRTIO_PCI_DEV_BLK		= 0x1001;
+
+/* the registers of the legacy interface in the I/O BAR */
+enum {
+	VIRTIO_REG_DEV_FEATURES		= 0x00,		/* 32-bit; features offered by the device */
+	VIRTIO_REG_GUEST_FEATURES	= 0x04,		/* 32-bit; features accepted by the driver */
+	VIRTIO_REG_QUEUE_PFN		= 0x08,		/* 32-bit; page frame of the selected queue */
+	VIRTIO_REG_QUEUE_SIZE		= 0x0C,		/* 16-bit; size of the selected queue */
+	VIRTIO_REG_QUEUE_SEL		= 0x0E,		/* 16-bit; queue selector */
+	VIRTIO_REG_QUEUE_NOTIFY		= 0x10,		/* 16-bit; notifies the device about a queue */
+	VIRTIO_REG_STATUS			= 0x12,		/* 8-bit; device status */
+	VIRTIO_REG_ISR				= 0x13,		/* 8-bit; interrupt status; reading clears it */
+	VIRTIO_REG_CONFIG			= 0x14,		/* device specific configuration (without MSI-X) */
+};
+
+enum {
+	VIRTIO_ST_ACKNOWLEDGE		= 1 << 0,
+	VIRTIO_ST_DRIVER			= 1 << 1,
+	VIRTIO_ST_DRIVER_OK			= 1 << 2,
+	VIRTIO_ST_FAILED			= 1 << 7,
+};
+
+enum {
+	VIRTIO_ISR_QUEUE			= 1 << 0,
+	VIRTIO_ISR_CONFIG			= 1 << 1,
+};
+
+/* the queues are aligned to pages in the legacy interface */
+static const size_t VIRTIO_QUEUE_ALIGN		= 4096;
+
+enum {
+	VIRTIO_BLK_F_SIZE_MAX		= 1 << 1,	/* maximum size of a segment in size_max */
+	VIRTIO_BLK_F_SEG_MAX		= 1 << 2,	/* maximum number of segments in seg_max */
+	VIRTIO_BLK_F_RO				= 1 << 5,	/* the disk is read-only */
+	VIRTIO_BLK_F_BLK_SIZE		= 1 << 6,	/* block size of the disk in blk_size */
+	VIRTIO_RING_F_INDIRECT_DESC	= 1 << 28,	/* descriptors may refer to descriptor tables */
+};
+
+/* the layout of the device specific configuration of virtio-blk */
+enum {
+	VIRTIO_BLK_CFG_CAPACITY		= VIRTIO_REG_CONFIG + 0x00,	/* 64-bit; in 512-byte sectors */
+	VIRTIO_BLK_CFG_SIZE_MAX		= VIRTIO_REG_CONFIG + 0x08,	/* 32-bit */
+	VIRTIO_BLK_CFG_SEG_MAX		= VIRTIO_REG_CONFIG + 0x0C,	/* 32-bit */
+	VIRTIO_BLK_CFG_BLK_SIZE		= VIRTIO_REG_CONFIG + 0x14,	/* 32-bit */
+};
+
+enum {
+	VIRTIO_BLK_T_IN				= 0,
+	VIRTIO_BLK_T_OUT			= 1,
+};
+
+enum {
+	VIRTIO_BLK_S_OK				= 0,
+	VIRTIO_BLK_S_IOERR			= 1,
+	VIRTIO_BLK_S_UNSUPP			= 2,
+};
+
+/* virtio-blk always addresses the disk in units of 512 bytes */
+static const size_t VIRTIO_BLK_SECTOR_SIZE	= 512;
+
+/* the header that precedes the data of each request */
+struct VirtioBlkHeader {
+	uint32_t type;
+	uint32_t ioprio;
+	uint64_t sector;
+} A_PACKED;
+
+enum {
+	VRING_DESC_F_NEXT			= 1 << 0,
+	VRING_DESC_F_WRITE			= 1 << 1,	/* the device writes to the buffer */
+	VRING_DESC_F_INDIRECT		= 1 << 2,	/* the buffer is a table of descriptors */
+};
+
+enum {
+	VRING_AVAIL_F_NO_INTERRUPT	= 1 << 0,
+};
+
+enum {
+	VRING_USED_F_NO_NOTIFY		= 1 << 0,
+};
+
+struct VringDesc {
+	uint64_t addr;
+	uint32_t len;
+	uint16_t flags;
+	uint16_t next;
+} A_PACKED;
+
+/* the header of the available ring; followed by <size> ring entries of 16 bit */
+struct VringAvail {
+	uint16_t flags;
+	uint16_t idx;
+} A_PACKED;
+
+struct VringUsedElem {
+	uint32_t id;
+	uint32_t len;
+} A_PACKED;
+
+/* the header of the used ring; followed by <size> VringUsedElem's */
+struct VringUsed {
+	uint16_t flags;
+	uint16_t idx;
+} A_PACKED;
@@ -0,0 +1,70 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <blkdev/partdevice.h>
+#include <esc/proto/pci.h>
+#include <sys/common.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "virtio.h"
+#include "virtioblkdev.h"
+
+using namespace esc;
+
+int main(int argc,char **argv) {
+	if(argc < 2) {
+		printe("Usage: %s <wait> [poll]",argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	bool poll = argc > 2 && strcmp(argv[2],"poll") == 0;
+
+	/* detect and init all virtio block devices */
+	std::vector<blkdev::Disk*> disks;
+	{
+		PCI pci("/dev/pci");
+		size_t count = pci.getCount();
+		for(size_t i = 0; i < count; ++i) {
+			PCI::Device dev = pci.getByIndex(i);
+			if(dev.vendorId != VIRTIO_PCI_VENDOR || dev.deviceId != VIRTIO_PCI_DEV_BLK)
+				continue;
+
+			print("Using PCI-device %d.%d.%d: vendor=%hx, device=%hx",
+				dev.bus,dev.dev,dev.func,dev.vendorId,dev.deviceId);
+			try {
+				VirtioBlk *blk = new VirtioBlk(pci,dev,poll);
+				blk->start();
+				disks.push_back(blk);
+			}
+			catch(const std::exception &e) {
+				printe("Unable to use virtio-blk device: %s",e.what());
+			}
+		}
+	}
+
+	blkdev::serve(disks,"vd",argv[1]);
+
+	/* clean up */
+	for(auto it = disks.begin(); it != disks.end(); ++it)
+		delete *it;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,376 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <esc/util.h>
+#include <esc/vthrow.h>
+#include <sys/arch/x86/ports.h>
+#include <sys/common.h>
+#include <sys/irq.h>
+#include <sys/mman.h>
+#include <sys/thread.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "virtioblkdev.h"
+#include "virtqueue.h"
+
+/* the timeout for synchronous requests in milliseconds */
+static const uint SYNC_TIMEOUT		= 5000;
+/* the largest segment we create, if the device does not tell us its limit */
+static const size_t DEF_SIZE_MAX	= 4 * 1024 * 1024;
+/* the number of requests that should fit into the queue without indirect descriptors */
+static const size_t DIRECT_SLOTS	= 16;
+/* the number of polls without completions after which the poll thread starts to sleep */
+static const uint POLL_SPINS		= 16;
+/* the first and the longest sleep between two polls in microseconds */
+static const time_t POLL_MIN_SLEEP	= 10;
+static const time_t POLL_MAX_SLEEP	= 1000;
+
+static inline void setDesc(VringDesc *desc,uint64_t addr,size_t len,uint16_t flags) {
+	desc->addr = addr;
+	desc->len = len;
+	desc->flags = flags;
+	desc->next = 0;
+}
+
+VirtioBlk::VirtioBlk(esc::PCI &pci,const esc::PCI::Device &dev,bool poll)
+		: _iobase(), _iosize(), _features(), _poll(poll), _irqsem(-1), _queue(), _secSize(512),
+		  _sectors(), _segs(MAX_SEGS), _sizeMax(DEF_SIZE_MAX), _descsPerSlot(), _slots(),
+		  _slotSize(), _slotMem(), _slotPhys(), _bounce(), _bouncePhys(), _free(), _inflight(),
+		  _freeSem(), _pollSem(), _mutex(), _reqs() {
+	/* the legacy interface is in the I/O BAR */
+	for(size_t i = 0; i < ARRAY_SIZE(dev.bars); ++i) {
+		if(dev.bars[i].addr && dev.bars[i].type == esc::PCI::Bar::BAR_IO) {
+			_iobase = dev.bars[i].addr;
+			_iosize = dev.bars[i].size;
+			break;
+		}
+	}
+	if(_iobase == 0)
+		VTHROW("Device has no I/O BAR");
+	int res;
+	if((res = reqports(_iobase,_iosize)) < 0)
+		VTHROWE("Unable to request ports " << _iobase << ".." << (_iobase + _iosize - 1),res);
+
+	/* ensure that the device may use I/O ports and DMA */
+	uint32_t statusCmd = pci.read(dev.bus,dev.dev,dev.func,0x04);
+	pci.write(dev.bus,dev.dev,dev.func,0x04,(statusCmd & ~0x400) | 0x5);
+
+	/* reset the device and tell it that we know how to drive it */
+	outbyte(_iobase + VIRTIO_REG_STATUS,0);
+	outbyte(_iobase + VIRTIO_REG_STATUS,VIRTIO_ST_ACKNOWLEDGE);
+	outbyte(_iobase + VIRTIO_REG_STATUS,VIRTIO_ST_ACKNOWLEDGE | VIRTIO_ST_DRIVER);
+
+	uint32_t features = indword(_iobase + VIRTIO_REG_DEV_FEATURES);
+	_features = features & (VIRTIO_BLK_F_SIZE_MAX | VIRTIO_BLK_F_SEG_MAX | VIRTIO_BLK_F_RO |
+		VIRTIO_BLK_F_BLK_SIZE | VIRTIO_RING_F_INDIRECT_DESC);
+	outdword(_iobase + VIRTIO_REG_GUEST_FEATURES,_features);
+
+	_sectors = indword(_iobase + VIRTIO_BLK_CFG_CAPACITY) |
+		(static_cast<uint64_t>(indword(_iobase + VIRTIO_BLK_CFG_CAPACITY + 4)) << 32);
+	if(_features & VIRTIO_BLK_F_BLK_SIZE)
+		_secSize = indword(_iobase + VIRTIO_BLK_CFG_BLK_SIZE);
+	if(_features & VIRTIO_BLK_F_SEG_MAX)
+		_segs = esc::Util::max<size_t>(1,esc::Util::min<size_t>(_segs,
+			indword(_iobase + VIRTIO_BLK_CFG_SEG_MAX)));
+	if(_features & VIRTIO_BLK_F_SIZE_MAX)
+		_sizeMax = esc::Util::max<size_t>(PAGE_SIZE,indword(_iobase + VIRTIO_BLK_CFG_SIZE_MAX));
+	if(_secSize < VIRTIO_BLK_SECTOR_SIZE || _secSize > BOUNCE_SIZE || (_secSize & (_secSize - 1))) {
+		outbyte(_iobase + VIRTIO_REG_STATUS,VIRTIO_ST_FAILED);
+		VTHROW("Unsupported block size " << _secSize);
+	}
+	/* capacity is always in 512 byte units */
+	_sectors /= _secSize / VIRTIO_BLK_SECTOR_SIZE;
+
+	try {
+		_queue = new VirtQueue(_iobase,0);
+	}
+	catch(...) {
+		outbyte(_iobase + VIRTIO_REG_STATUS,VIRTIO_ST_FAILED);
+		throw;
+	}
+
+	/* with indirect descriptors, each request needs only one entry in the queue. otherwise,
+	 * each slot gets a fixed range of descriptors for its chain: header, segments and status.
+	 * thus, we limit the segments so that DIRECT_SLOTS requests fit into the queue; with
+	 * MAX_SEGS segments, a queue with 256 entries would only hold 3 requests. */
+	if(indirect()) {
+		_descsPerSlot = 1;
+		_slots = esc::Util::min(_queue->size(),MAX_SLOTS);
+	}
+	else {
+		if(_queue->size() < 3) {
+			outbyte(_iobase + VIRTIO_REG_STATUS,VIRTIO_ST_FAILED);
+			VTHROW("Queue is too small (" << _queue->size() << " entries)");
+		}
+		size_t perSlot = esc::Util::max<size_t>(3,_queue->size() / DIRECT_SLOTS);
+		_segs = esc::Util::min(_segs,perSlot - 2);
+		_descsPerSlot = _segs + 2;
+		_slots = esc::Util::min(_queue->size() / _descsPerSlot,MAX_SLOTS);
+	}
+
+	_slotSize = sizeof(SlotMem) + (indirect() ? (_segs + 2) * sizeof(VringDesc) : 0);
+	_slotPhys = 0;
+	_slotMem = reinterpret_cast<uint8_t*>(mmapphys(&_slotPhys,_slots * _slotSize,PAGE_SIZE,
+		MAP_PHYS_ALLOC));
+	_bouncePhys = 0;
+	_bounce = reinterpret_cast<uint8_t*>(mmapphys(&_bouncePhys,_slots * BOUNCE_SIZE,PAGE_SIZE,
+		MAP_PHYS_ALLOC));
+	if(_slotMem == NULL || _bounce == NULL) {
+		outbyte(_iobase + VIRTIO_REG_STATUS,VIRTIO_ST_FAILED);
+		VTHROWE("Unable to allocate request memory",-ENOMEM);
+	}
+	memset(_slotMem,0,_slots * _slotSize);
+
+	/* register for the interrupt before the device may raise it */
+	if(!_poll) {
+		_irqsem = semcrtirq(dev.irq,"virtio-blk",NULL,NULL);
+		if(_irqsem < 0) {
+			outbyte(_iobase + VIRTIO_REG_STATUS,VIRTIO_ST_FAILED);
+			VTHROWE("Unable to create irq-semaphore",_irqsem);
+		}
+	}
+	else
+		_queue->interrupts(false);
+
+	outbyte(_iobase + VIRTIO_REG_STATUS,
+		VIRTIO_ST_ACKNOWLEDGE | VIRTIO_ST_DRIVER | VIRTIO_ST_DRIVER_OK);
+
+	if(!execSync(0,VIRTIO_BLK_T_IN,0,_secSize))
+		VTHROW("Unable to read partition table");
+	blkdev::Partition::fill(_parts,bounce(0));
+
+	_free = _slots == 64 ? ~0ULL : (1ULL << _slots) - 1;
+	if(usemcrt(&_freeSem,_slots) < 0 || usemcrt(&_pollSem,0) < 0)
+		VTHROW("Unable to create semaphores");
+
+	print("virtio-blk: %Lu sectors a %zu bytes, RO=%d, %zu slots, %zu segments, indirect=%d, %s",
+		_sectors,_secSize,readonly(),_slots,_segs,indirect(),_poll ? "polling" : "interrupts");
+}
+
+VirtioBlk::~VirtioBlk() {
+	outbyte(_iobase + VIRTIO_REG_STATUS,0);
+	delete _queue;
+	if(_bounce)
+		munmap(_bounce);
+	if(_slotMem)
+		munmap(_slotMem);
+	if(_irqsem >= 0)
+		semdestr(_irqsem);
+	relports(_iobase,_iosize);
+}
+
+void VirtioBlk::start() {
+	if(startthread(_poll ? pollThread : irqThread,this) < 0)
+		error("Unable to start completion thread");
+}
+
+uint VirtioBlk::acquire() {
+	usemdown(&_freeSem);
+	std::lock_guard<std::mutex> guard(_mutex);
+	assert(_free != 0);
+	uint slot = __builtin_ctzll(_free);
+	_free &= ~(1ULL << slot);
+	return slot;
+}
+
+void VirtioBlk::release(uint slot) {
+	{
+		std::lock_guard<std::mutex> guard(_mutex);
+		_free |= 1ULL << slot;
+	}
+	usemup(&_freeSem);
+}
+
+int VirtioBlk::setupRequest(uint slot,uint type,uint64_t lba,size_t bytes,const uintptr_t *pages,
+		size_t offset) {
+	SlotMem *mem = slotMem(slot);
+	uint64_t memPhys = _slotPhys + slot * _slotSize;
+	mem->hdr.type = type;
+	mem->hdr.ioprio = 0;
+	mem->hdr.sector = lba * (_secSize / VIRTIO_BLK_SECTOR_SIZE);
+	mem->status = 0xFF;
+
+	uint16_t first = indirect() ? 0 : slot * _descsPerSlot;
+	VringDesc *descs = indirect() ? mem->table : _queue->desc(first);
+	uint16_t dataFlags = type == VIRTIO_BLK_T_IN ? VRING_DESC_F_WRITE : 0;
+
+	size_t n = 0;
+	setDesc(descs + n++,memPhys + offsetof(SlotMem,hdr),sizeof(mem->hdr),0);
+
+	/* the data segments; physically contiguous pages are merged into one segment */
+	if(pages == NULL)
+		setDesc(descs + n++,_bouncePhys + slot * BOUNCE_SIZE,bytes,dataFlags);
+	else {
+		while(bytes > 0) {
+			size_t pgoff = offset & (PAGE_SIZE - 1);
+			uint64_t addr = pages[offset / PAGE_SIZE] + pgoff;
+			size_t amount = esc::Util::min(PAGE_SIZE - pgoff,bytes);
+			VringDesc *last = descs + n - 1;
+			if(n > 1 && addr == last->addr + last->len && last->len + amount <= _sizeMax)
+				last->len += amount;
+			else {
+				if(n - 1 == _segs)
+					return -1;
+				setDesc(descs + n++,addr,amount,dataFlags);
+			}
+			offset += amount;
+			bytes -= amount;
+		}
+	}
+
+	setDesc(descs + n++,memPhys + offsetof(SlotMem,status),sizeof(mem->status),VRING_DESC_F_WRITE);
+	for(size_t i = 0; i < n - 1; ++i) {
+		descs[i].flags |= VRING_DESC_F_NEXT;
+		descs[i].next = first + i + 1;
+	}
+
+	if(indirect()) {
+		setDesc(_queue->desc(slot),memPhys + offsetof(SlotMem,table),n * sizeof(VringDesc),
+			VRING_DESC_F_INDIRECT);
+		return slot;
+	}
+	return first;
+}
+
+bool VirtioBlk::execSync(uint slot,uint type,uint64_t lba,size_t bytes) {
+	int head = setupRequest(slot,type,lba,bytes,NULL,0);
+	if(head < 0)
+		return false;
+
+	_queue->publish(head);
+	_queue->notify();
+
+	uint32_t id,len;
+	for(uint i = 0; i < SYNC_TIMEOUT; ++i) {
+		if(_queue->nextUsed(&id,&len))
+			return slotMem(slot)->status == VIRTIO_BLK_S_OK;
+		usleep(1000);
+	}
+	return false;
+}
+
+bool VirtioBlk::submit(uint slot,uint64_t lba,size_t secCount,const uintptr_t *pages,size_t offset,
+		const Request &req) {
+	if(secCount == 0 || (req.op == OP_WRITE && readonly()))
+		return false;
+	int head = setupRequest(slot,req.op == OP_READ ? VIRTIO_BLK_T_IN : VIRTIO_BLK_T_OUT,
+		lba,secCount * _secSize,pages,offset);
+	if(head < 0)
+		return false;
+
+	{
+		std::lock_guard<std::mutex> guard(_mutex);
+		_reqs[slot] = req;
+		_inflight++;
+		_queue->publish(head);
+		_queue->notify();
+	}
+	VIRTIO_PR2("Submitted slot %u: op=%u lba=%Lu count=%zu",slot,req.op,lba,secCount);
+	if(_poll)
+		usemup(&_pollSem);
+	return true;
+}
+
+size_t VirtioBlk::handleCompletions() {
+	Request done[MAX_SLOTS];
+	uint slots[MAX_SLOTS];
+	bool success[MAX_SLOTS];
+	size_t count = 0;
+	{
+		std::lock_guard<std::mutex> guard(_mutex);
+		uint32_t id,len;
+		while(_queue->nextUsed(&id,&len)) {
+			uint slot = id / _descsPerSlot;
+			assert(slot < _slots && count < MAX_SLOTS);
+			slots[count] = slot;
+			success[count] = slotMem(slot)->status == VIRTIO_BLK_S_OK;
+			done[count] = std::move(_reqs[slot]);
+			count++;
+			_inflight--;
+		}
+	}
+
+	/* answer the clients without holding the lock */
+	for(size_t i = 0; i < count; ++i) {
+		if(!success[i])
+			printe("Request in slot %u failed with status %u",slots[i],slotMem(slots[i])->status);
+		finish(slots[i],done[i],success[i]);
+	}
+	return count;
+}
+
+void VirtioBlk::printInfo(FILE *f) const {
+	fprintf(f,"%-15s%s\n","Type:","virtio-blk");
+	fprintf(f,"%-15s%Lu\n","Sectors:",_sectors);
+	fprintf(f,"%-15s%zu\n","SectorSize:",_secSize);
+	fprintf(f,"%-15s%d\n","ReadOnly:",readonly());
+	fprintf(f,"%-15s%zu\n","Slots:",_slots);
+	fprintf(f,"%-15s%zu\n","Segments:",_segs);
+	fprintf(f,"%-15s%d\n","Indirect:",indirect());
+	fprintf(f,"%-15s%d\n","Polling:",_poll);
+}
+
+int VirtioBlk::irqThread(void *arg) {
+	VirtioBlk *blk = reinterpret_cast<VirtioBlk*>(arg);
+	while(1) {
+		semdown(blk->_irqsem);
+
+		/* reading the ISR acknowledges the interrupt */
+		if(inbyte(blk->_iobase + VIRTIO_REG_ISR) & VIRTIO_ISR_QUEUE)
+			blk->handleCompletions();
+	}
+	return 0;
+}
+
+int VirtioBlk::pollThread(void *arg) {
+	VirtioBlk *blk = reinterpret_cast<VirtioBlk*>(arg);
+	while(1) {
+		/* sleep until a request has been submitted */
+		usemdown(&blk->_pollSem);
+
+		/* poll the used ring as long as there are requests in flight. if nothing completes, we
+		 * yield the CPU a few times and sleep with increasing duration afterwards, so that a slow
+		 * request doesn't keep a CPU busy */
+		uint idle = 0;
+		time_t delay = POLL_MIN_SLEEP;
+		while(1) {
+			if(blk->handleCompletions() > 0) {
+				idle = 0;
+				delay = POLL_MIN_SLEEP;
+			}
+			{
+				std::lock_guard<std::mutex> guard(blk->_mutex);
+				if(blk->_inflight == 0)
+					break;
+			}
+			if(idle < POLL_SPINS) {
+				idle++;
+				yield();
+			}
+			else {
+				usleep(delay);
+				delay = esc::Util::min(delay * 2,POLL_MAX_SLEEP);
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,169 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+
+#include <blkdev/disk.h>
+#include <esc/proto/pci.h>
+#include <sys/common.h>
+#include <sys/sync.h>
+#include <mutex>
+#include <stdio.h>
+
+#include "virtio.h"
+
+class VirtQueue;
+
+/**
+ * A virtio block device. Requests are put into the virtqueue without waiting for their completion,
+ * so that many of them can be in flight at once. Completed requests are collected either by the
+ * interrupt thread or, in polling mode, by a thread that polls the used ring while requests are
+ * pending and backs off if nothing completes. That thread sends the reply to the client.
+ */
+class VirtioBlk : public blkdev::Disk {
+	/* per-request memory the device accesses: header, status and indirect descriptor table */
+	struct SlotMem {
+		VirtioBlkHeader hdr;
+		uint8_t status;
+		uint8_t reserved[15];
+		VringDesc table[0];
+	} A_PACKED;
+
+public:
+	/* the maximum number of requests in flight */
+	static const size_t MAX_SLOTS		= 64;
+	/* the maximum number of data segments per request */
+	static const size_t MAX_SEGS		= 64;
+
+	/**
+	 * Initializes the given virtio-blk PCI device and reads its partition table.
+	 *
+	 * @param pci the PCI service
+	 * @param dev the PCI device
+	 * @param poll whether to poll for completions instead of using interrupts
+	 * @throws if the device can't be used
+	 */
+	explicit VirtioBlk(esc::PCI &pci,const esc::PCI::Device &dev,bool poll);
+	virtual ~VirtioBlk();
+
+	virtual size_t secSize() const override {
+		return _secSize;
+	}
+	virtual uint64_t sectors() const override {
+		return _sectors;
+	}
+	/**
+	 * @return whether the disk is read-only
+	 */
+	bool readonly() const {
+		return _features & VIRTIO_BLK_F_RO;
+	}
+	/**
+	 * @return the number of requests that can be in flight at once
+	 */
+	size_t slots() const {
+		return _slots;
+	}
+	/**
+	 * @return the number of data segments per request (fewer without indirect descriptors)
+	 */
+	size_t segments() const {
+		return _segs;
+	}
+	/**
+	 * @return whether indirect descriptors are used
+	 */
+	bool indirect() const {
+		return _features & VIRTIO_RING_F_INDIRECT_DESC;
+	}
+	/**
+	 * @return whether completions are polled
+	 */
+	bool polling() const {
+		return _poll;
+	}
+	/**
+	 * Starts the thread that handles completions.
+	 */
+	void start();
+
+	/**
+	 * @return the number of segments, because each page needs at most one
+	 */
+	virtual size_t maxPages() const override {
+		return _segs;
+	}
+	/**
+	 * @return the number of sectors that fit into the segments, if all pages are contiguous
+	 */
+	virtual size_t maxSectors() const override {
+		return _segs * _sizeMax / _secSize;
+	}
+
+	virtual uint acquire() override;
+	virtual void release(uint slot) override;
+	virtual void *bounce(uint slot) override {
+		return _bounce + slot * BOUNCE_SIZE;
+	}
+
+	/**
+	 * Puts a read or write request into the virtqueue (see blkdev::Disk::submit()). It fails if
+	 * the buffer consists of more than segments() physically contiguous pieces.
+	 */
+	virtual bool submit(uint slot,uint64_t lba,size_t secCount,const uintptr_t *pages,
+		size_t offset,const Request &req) override;
+
+	virtual void printInfo(FILE *f) const override;
+
+private:
+	SlotMem *slotMem(uint slot) {
+		return reinterpret_cast<SlotMem*>(_slotMem + slot * _slotSize);
+	}
+	int setupRequest(uint slot,uint type,uint64_t lba,size_t bytes,const uintptr_t *pages,
+		size_t offset);
+	bool execSync(uint slot,uint type,uint64_t lba,size_t bytes);
+	size_t handleCompletions();
+	static int irqThread(void *arg);
+	static int pollThread(void *arg);
+
+	uint16_t _iobase;
+	size_t _iosize;
+	uint32_t _features;
+	bool _poll;
+	int _irqsem;
+	VirtQueue *_queue;
+	size_t _secSize;
+	uint64_t _sectors;
+	size_t _segs;
+	size_t _sizeMax;
+	size_t _descsPerSlot;
+	size_t _slots;
+	size_t _slotSize;
+	uint8_t *_slotMem;
+	uintptr_t _slotPhys;
+	uint8_t *_bounce;
+	uintptr_t _bouncePhys;
+	/* the free slots and the number of requests in flight */
+	uint64_t _free;
+	size_t _inflight;
+	tUserSem _freeSem;
+	tUserSem _pollSem;
+	std::mutex _mutex;
+	Request _reqs[MAX_SLOTS];
+};
@@ -0,0 +1,103 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <esc/util.h>
+#include <esc/vthrow.h>
+#include <sys/arch/x86/ports.h>
+#include <sys/common.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <string.h>
+
+#include "virtqueue.h"
+
+VirtQueue::VirtQueue(uint16_t iobase,uint16_t index)
+		: _iobase(iobase), _index(index), _size(), _mem(), _descs(), _avail(), _availRing(),
+		  _used(), _usedRing(), _lastUsed() {
+	outword(_iobase + VIRTIO_REG_QUEUE_SEL,_index);
+	_size = inword(_iobase + VIRTIO_REG_QUEUE_SIZE);
+	if(_size == 0)
+		VTHROW("Queue " << _index << " does not exist");
+
+	/* descriptors and available ring (including the used_event field) on the first pages,
+	 * the used ring (including avail_event) on the following ones */
+	size_t ring1 = esc::Util::round_up(
+		_size * sizeof(VringDesc) + sizeof(VringAvail) + (_size + 1) * sizeof(uint16_t),
+		VIRTIO_QUEUE_ALIGN);
+	size_t ring2 = esc::Util::round_up(
+		sizeof(VringUsed) + _size * sizeof(VringUsedElem) + sizeof(uint16_t),
+		VIRTIO_QUEUE_ALIGN);
+
+	uintptr_t phys = 0;
+	_mem = mmapphys(&phys,ring1 + ring2,VIRTIO_QUEUE_ALIGN,MAP_PHYS_ALLOC);
+	if(_mem == NULL)
+		VTHROWE("Unable to allocate queue " << _index << " with " << _size << " entries",-ENOMEM);
+	memset(_mem,0,ring1 + ring2);
+
+	uintptr_t base = reinterpret_cast<uintptr_t>(_mem);
+	_descs = reinterpret_cast<VringDesc*>(base);
+	_avail = reinterpret_cast<volatile VringAvail*>(base + _size * sizeof(VringDesc));
+	_availRing = reinterpret_cast<volatile uint16_t*>(_avail + 1);
+	_used = reinterpret_cast<volatile VringUsed*>(base + ring1);
+	_usedRing = reinterpret_cast<volatile VringUsedElem*>(_used + 1);
+
+	outdword(_iobase + VIRTIO_REG_QUEUE_PFN,phys / VIRTIO_QUEUE_ALIGN);
+	VIRTIO_PR1("Queue %u: %zu entries @ virt=%p phys=%p",_index,_size,_mem,phys);
+}
+
+VirtQueue::~VirtQueue() {
+	outword(_iobase + VIRTIO_REG_QUEUE_SEL,_index);
+	outdword(_iobase + VIRTIO_REG_QUEUE_PFN,0);
+	munmap(_mem);
+}
+
+void VirtQueue::publish(uint16_t head) {
+	uint16_t idx = _avail->idx;
+	_availRing[idx & (_size - 1)] = head;
+	/* the descriptors and the ring entry have to be visible before the index */
+	__sync_synchronize();
+	_avail->idx = idx + 1;
+}
+
+void VirtQueue::notify() {
+	/* the index update has to be visible before we check whether the device wants a notify */
+	__sync_synchronize();
+	if(~_used->flags & VRING_USED_F_NO_NOTIFY)
+		outword(_iobase + VIRTIO_REG_QUEUE_NOTIFY,_index);
+}
+
+bool VirtQueue::nextUsed(uint32_t *id,uint32_t *len) {
+	if(_lastUsed == _used->idx)
+		return false;
+
+	/* read the element not before the index */
+	__sync_synchronize();
+	volatile VringUsedElem *elem = _usedRing + (_lastUsed & (_size - 1));
+	*id = elem->id;
+	*len = elem->len;
+	_lastUsed++;
+	return true;
+}
+
+void VirtQueue::interrupts(bool enabled) {
+	if(enabled)
+		_avail->flags &= ~VRING_AVAIL_F_NO_INTERRUPT;
+	else
+		_avail->flags |= VRING_AVAIL_F_NO_INTERRUPT;
+}
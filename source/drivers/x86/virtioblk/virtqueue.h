@@ -0,0 +1,94 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+
+#include <sys/common.h>
+
+#include "virtio.h"
+
+/**
+ * A virtqueue in the layout of the legacy virtio interface: the descriptor table, followed by the
+ * available ring and, on the next page, the used ring.
+ */
+class VirtQueue {
+public:
+	/**
+	 * Allocates the memory for queue <index> and announces it to the device.
+	 *
+	 * @param iobase the base of the I/O BAR
+	 * @param index the queue index
+	 * @throws if the queue does not exist or there is not enough memory
+	 */
+	explicit VirtQueue(uint16_t iobase,uint16_t index);
+	~VirtQueue();
+
+	/**
+	 * @return the number of descriptors
+	 */
+	size_t size() const {
+		return _size;
+	}
+	/**
+	 * @param i the index
+	 * @return the descriptor with given index
+	 */
+	VringDesc *desc(size_t i) {
+		return _descs + i;
+	}
+
+	/**
+	 * Makes the descriptor chain starting at <head> available to the device. Use notify() to
+	 * let the device know.
+	 *
+	 * @param head the first descriptor of the chain
+	 */
+	void publish(uint16_t head);
+	/**
+	 * Notifies the device about new available descriptors, unless it told us not to.
+	 */
+	void notify();
+	/**
+	 * Fetches the next element of the used ring, if there is any.
+	 *
+	 * @param id will be set to the head of the used descriptor chain
+	 * @param len will be set to the number of bytes the device has written
+	 * @return true if there was an element
+	 */
+	bool nextUsed(uint32_t *id,uint32_t *len);
+	/**
+	 * Enables or disables the interrupts for used buffers. Note that this is just a hint for the
+	 * device.
+	 *
+	 * @param enabled whether interrupts are desired
+	 */
+	void interrupts(bool enabled);
+
+private:
+	uint16_t _iobase;
+	uint16_t _index;
+	size_t _size;
+	void *_mem;
+	VringDesc *_descs;
+	volatile VringAvail *_avail;
+	volatile uint16_t *_availRing;
+	volatile VringUsed *_used;
+	volatile VringUsedElem *_usedRing;
+	uint16_t _lastUsed;
+};
@@ -0,0 +1,203 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+
+#include <blkdev/partition.h>
+#include <esc/ipc/clientdevice.h>
+#include <sys/common.h>
+#include <sys/messages.h>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+
+namespace blkdev {
+
+/**
+ * The interface of a disk for the partition devices. The disk executes the transfers
+ * asynchronously in slots: the device acquires a slot, submits the transfer and the disk answers
+ * the client and releases the slot as soon as the transfer is finished.
+ */
+class Disk {
+public:
+	/* the size of the per-slot buffer for requests without shared memory */
+	static const size_t BOUNCE_SIZE		= 4096;
+
+	/* the transfer operations */
+	enum {
+		OP_READ,
+		OP_WRITE,
+	};
+
+	/**
+	 * The state that the parts of a request share, if a single transfer can't hold it. The client
+	 * is answered as soon as the last part is finished.
+	 */
+	class Split {
+	public:
+		explicit Split(size_t parts) : _mutex(), _pending(parts), _success(true) {
+		}
+
+		/**
+		 * Marks <count> parts as failed that have not been submitted and thus never finish.
+		 * Requires that at least one more part is pending.
+		 *
+		 * @param count the number of parts
+		 */
+		void cancel(size_t count) {
+			std::lock_guard<std::mutex> guard(_mutex);
+			_success = false;
+			_pending -= count;
+		}
+
+		/**
+		 * Finishes one part.
+		 *
+		 * @param success whether the part was successful. If it was the last one, it is set to
+		 *  whether all parts were successful
+		 * @return true if it was the last part
+		 */
+		bool finish(bool *success) {
+			std::lock_guard<std::mutex> guard(_mutex);
+			_success = _success && *success;
+			*success = _success;
+			return --_pending == 0;
+		}
+
+	private:
+		std::mutex _mutex;
+		size_t _pending;
+		bool _success;
+	};
+
+	/**
+	 * The information that is necessary to answer a request on completion.
+	 */
+	struct Request {
+		int fd;
+		msgid_t mid;
+		uint op;
+		/* the number of bytes to report to the client */
+		size_t count;
+		/* whether the data is in the bounce buffer of the slot */
+		bool bounce;
+		/* keeps the shared memory of the client mapped until the transfer is finished */
+		std::shared_ptr<esc::SharedMemory> shm;
+		/* if the request consists of multiple transfers, their shared state */
+		std::shared_ptr<Split> split;
+	};
+
+	explicit Disk() : _parts() {
+	}
+	virtual ~Disk() {
+	}
+
+	/**
+	 * @return the sector size in bytes
+	 */
+	virtual size_t secSize() const = 0;
+	/**
+	 * @return the number of sectors
+	 */
+	virtual uint64_t sectors() const = 0;
+	/**
+	 * @return the partition table (Partition::COUNT entries)
+	 */
+	const Partition *partitions() const {
+		return _parts;
+	}
+
+	/**
+	 * @return the maximum number of pages the buffer of a single transfer may span
+	 */
+	virtual size_t maxPages() const = 0;
+	/**
+	 * @return the maximum number of sectors of a single transfer
+	 */
+	virtual size_t maxSectors() const = 0;
+
+	/**
+	 * Allocates a slot. Blocks until one is available.
+	 *
+	 * @return the slot
+	 */
+	virtual uint acquire() = 0;
+	/**
+	 * Frees the given slot again, if it has not been submitted.
+	 *
+	 * @param slot the slot
+	 */
+	virtual void release(uint slot) = 0;
+	/**
+	 * @param slot the slot
+	 * @return the bounce buffer of given slot (BOUNCE_SIZE bytes)
+	 */
+	virtual void *bounce(uint slot) = 0;
+
+	/**
+	 * Checks whether the disk can access the given pages via DMA. By default, it can access all.
+	 *
+	 * @param pages the physical addresses of the pages
+	 * @param count the number of pages
+	 * @return true if so
+	 */
+	virtual bool canAccess(const uintptr_t *,size_t) const {
+		return true;
+	}
+
+	/**
+	 * Starts a read or write transfer in given slot. The buffer is either described by <pages>,
+	 * which contains the physical address of each page, and <offset>, which is the byte offset
+	 * into these pages, or is the bounce buffer of the slot, if <pages> is NULL. The transfer
+	 * must not exceed maxPages() and maxSectors(). On success, the slot is released as soon as
+	 * the transfer has been completed and the client is answered.
+	 *
+	 * @param slot the slot
+	 * @param lba the first sector
+	 * @param secCount the number of sectors
+	 * @param pages the physical addresses of the pages of the buffer (or NULL)
+	 * @param offset the byte offset into <pages>
+	 * @param req the request information to answer the client
+	 * @return true if the transfer has been started
+	 */
+	virtual bool submit(uint slot,uint64_t lba,size_t secCount,const uintptr_t *pages,
+		size_t offset,const Request &req) = 0;
+
+	/**
+	 * Prints information about the disk into <f>, one "<name>: <value>" pair per line.
+	 *
+	 * @param f the file
+	 */
+	virtual void printInfo(FILE *f) const = 0;
+
+	/**
+	 * Answers the client of the finished request <req> in <slot> and releases the slot. If the
+	 * request has been split, only the last part answers the client.
+	 *
+	 * @param slot the slot
+	 * @param req the request
+	 * @param success whether the transfer was successful
+	 */
+	void finish(uint slot,const Request &req,bool success);
+
+protected:
+	Partition _parts[Partition::COUNT];
+};
+
+}
@@ -0,0 +1,87 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+
+#include <blkdev/disk.h>
+#include <blkdev/partition.h>
+#include <esc/ipc/clientdevice.h>
+#include <esc/ipc/ipcstream.h>
+#include <sys/common.h>
+#include <vector>
+
+namespace blkdev {
+
+/**
+ * A client of a partition device.
+ */
+class BlockClient : public esc::Client {
+public:
+	explicit BlockClient(int fd) : esc::Client(fd), pages() {
+	}
+
+	/* the physical address of each page of the shared memory */
+	std::vector<uintptr_t> pages;
+};
+
+/**
+ * The device for a partition of a disk. It checks the requests of the clients and passes them on
+ * to the disk, which answers them on completion. Thus, the device can accept further requests in
+ * the meantime.
+ */
+class PartitionDevice : public esc::ClientDevice<BlockClient> {
+public:
+	/**
+	 * Creates the device <name> for partition <part> of <disk>.
+	 *
+	 * @param disk the disk
+	 * @param part the partition
+	 * @param name the device name
+	 * @param mode the permissions of the device
+	 * @throws if the device can't be created
+	 */
+	explicit PartitionDevice(Disk *disk,const Partition *part,const char *name,mode_t mode);
+
+	void delegate(esc::IPCStream &is);
+	void read(esc::IPCStream &is);
+	void write(esc::IPCStream &is);
+	void size(esc::IPCStream &is);
+
+private:
+	void transfer(esc::IPCStream &is,BlockClient *c,uint op,size_t offset,size_t count,
+		ssize_t shmemoff,uint slot);
+	size_t partSize(size_t offset,size_t count,bool pages) const;
+
+	Disk *_disk;
+	const Partition *_part;
+};
+
+/**
+ * Registers a device for every partition of the given disks, named <prefix><letter><number>, and
+ * describes the disks and partitions in /sys/dev. Afterwards, it creates <wait> to tell fs that all
+ * devices are registered and handles the requests of all devices. The disks have to be started
+ * before, so that they can complete the transfers.
+ *
+ * @param disks the disks
+ * @param prefix the prefix of the device names (e.g. "sd")
+ * @param wait the file to create as soon as all devices are registered
+ */
+void serve(const std::vector<Disk*> &disks,const char *prefix,const char *wait);
+
+}
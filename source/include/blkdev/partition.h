@@ -21,29 +21,28 @@
 
 #include <sys/common.h>
 
-/* the number of partitions per disk */
-static const size_t PARTITION_COUNT		= 4;
-
-/* represents a partition (in memory) */
-typedef struct {
-	uchar present;
-	/* start sector */
-	size_t start;
-	/* sector count */
-	size_t size;
-} sPartition;
+namespace blkdev {
 
 /**
- * Fills the partition-table with the given MBR
- *
- * @param table the table to fill
- * @param mbr the content of the first sector
+ * A partition of a disk, as described by the MBR.
  */
-void part_fillPartitions(sPartition *table,void *mbr);
+struct Partition {
+	/* the number of partitions per disk */
+	static const size_t COUNT	= 4;
 
-/**
- * Prints the given partition table
- *
- * @param table the tables to print
- */
-void part_print(sPartition *table);
+	/**
+	 * Fills the given partition table with the partitions in <mbr>.
+	 *
+	 * @param table the table to fill (COUNT entries)
+	 * @param mbr the content of the first sector
+	 */
+	static void fill(Partition *table,const void *mbr);
+
+	bool present;
+	/* start sector */
+	uint64_t start;
+	/* sector count */
+	uint64_t size;
+};
+
+}
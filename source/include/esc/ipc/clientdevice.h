@@ -21,6 +21,7 @@
 
 #include <esc/ipc/device.h>
 #include <esc/ipc/ipcstream.h>
+#include <esc/ipc/ring.h>
 #include <esc/proto/file.h>
 #include <esc/proto/device.h>
 #include <esc/vthrow.h>
@@ -64,7 +65,7 @@ class Client {
 	friend class ClientDevice;
 
 public:
-	explicit Client(int f) : _fd(f), _shm() {
+	explicit Client(int f) : _fd(f), _shm(), _ringmem(), _ring() {
 	}
 	virtual ~Client() {
 	}
@@ -81,10 +82,18 @@ public:
 	void sharedmem(const std::shared_ptr<SharedMemory> &s) {
 		_shm = s;
 	}
+	/**
+	 * @return the ring channel, if the client has established one (see RingChannel)
+	 */
+	RingChannel *ring() {
+		return _ring.get();
+	}
 
 private:
 	int _fd;
 	std::shared_ptr<SharedMemory> _shm;
+	std::unique_ptr<SharedMemory> _ringmem;
+	std::unique_ptr<RingChannel> _ring;
 };
 
 /**
@@ -108,8 +117,10 @@ public:
 	explicit ClientDevice(const char *path,mode_t mode,uint type,uint ops)
 		: Device(path,mode,type,ops | DEV_OPEN), _clients(), _mutex() {
 		set(MSG_FILE_OPEN,std::make_memfun(this,&ClientDevice::open));
-		if(ops & DEV_DELEGATE)
+		if(ops & DEV_DELEGATE) {
 			set(MSG_DEV_DELEGATE,std::make_memfun(this,&ClientDevice::delegate));
+			set(MSG_DEV_RING,std::make_memfun(this,&ClientDevice::ringwork),false);
+		}
 		set(MSG_FILE_CLOSE,std::make_memfun(this,&ClientDevice::close),false);
 	}
 	/**
@@ -129,6 +140,7 @@ public:
 	 * @return the client with given file-descriptor
 	 */
 	C *operator[](int fd) {
+		std::lock_guard<std::mutex> guard(_mutex);
 		typename map_type::iterator it = _clients.find(fd);
 		return it != _clients.end() ? it->second : NULL;
 	}
@@ -143,6 +155,7 @@ public:
 	 * @throws if the client does not exist
 	 */
 	C *get(int fd) {
+		std::lock_guard<std::mutex> guard(_mutex);
 		typename map_type::iterator it = _clients.find(fd);
 		if(it == _clients.end())
 			VTHROWE("No client with id " << fd,-ENOTFOUND);
@@ -228,7 +241,52 @@ public:
 		return res;
 	}
 
+	/**
+	 * Joins client <c> to the ring channel in the given shared memory.
+	 *
+	 * @param c the client
+	 * @param fd the file
+	 * @return 0 on success
+	 */
+	int joinring(C *c,int fd) {
+		struct stat info;
+		int res = fstat(fd,&info);
+		if(res < 0)
+			return res;
+		if(c->_ring)
+			return -EEXIST;
+
+		void *addr = mmap(NULL,info.st_size,0,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+		if(!addr)
+			return -errno;
+		c->_ringmem.reset(new SharedMemory(
+			fd,reinterpret_cast<char*>(addr),info.st_size,info.st_ino,info.st_dev));
+		try {
+			c->_ring.reset(new RingChannel(c->fd(),addr,info.st_size));
+		}
+		catch(const default_error &e) {
+			c->_ringmem.reset();
+			return e.error();
+		}
+		return 0;
+	}
+
 protected:
+	/**
+	 * Handles the message <mid> that has been received over the ring channel of client <c>. The
+	 * response has to be sent via c->ring()->send(). The default implementation responds with
+	 * -ENOTSUP.
+	 *
+	 * @param c the client
+	 * @param mid the message-id
+	 * @param data the message
+	 * @param len the length of the message
+	 */
+	virtual void handleRing(C *c,msgid_t mid,A_UNUSED void *data,A_UNUSED size_t len) {
+		errcode_t res = -ENOTSUP;
+		c->ring()->send(mid,&res,sizeof(res));
+	}
+
 	void open(IPCStream &is) {
 		add(is.fd(),new C(is.fd()));
 
@@ -245,9 +303,35 @@ protected:
 			assert(c->shm() == NULL && !is.error());
 			res = joinshm(c,r.nfd,0);
 		}
+		else if(r.arg == DEL_ARG_SHRING)
+			res = joinring(c,r.nfd);
 		is << DevDelegate::Response(res) << Reply();
 	}
 
+	void ringwork(IPCStream &is) {
+		C *c = get(is.fd());
+		RingChannel *ring = c->ring();
+		if(!ring)
+			return;
+
+		/* handle all requests until the ring stays empty. afterwards, the client will wake us
+		 * up again via MSG_DEV_RING */
+		ulong buf[IPC_DEF_SIZE / sizeof(ulong)];
+		do {
+			msgid_t mid;
+			ssize_t len;
+			while((len = ring->receive(&mid,buf,sizeof(buf),false)) != -EWOULDBLOCK) {
+				if(len < 0) {
+					errcode_t res = len;
+					ring->send(mid,&res,sizeof(res));
+				}
+				else
+					handleRing(c,mid,buf,len);
+			}
+		}
+		while(!ring->sleep());
+	}
+
 	void close(IPCStream &is) {
 		remove(is.fd());
 		Device::close(is);
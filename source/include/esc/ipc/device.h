@@ -110,8 +110,8 @@ public:
 	void unset(msgid_t op);
 
 	/**
-	 * Executes the device-loop, i.e. uses getwork() to get a messages and handles it with the
-	 * appropriate handler.
+	 * Executes the device-loop, i.e. uses getworkv() to get the pending messages of a client and
+	 * handles them with the appropriate handler.
 	 */
 	void loop();
 
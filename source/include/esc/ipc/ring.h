@@ -0,0 +1,281 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#pragma once
+
+#include <sys/atomic.h>
+#include <sys/common.h>
+#include <sys/io.h>
+#include <sys/messages.h>
+#include <errno.h>
+#include <string.h>
+
+namespace esc {
+
+/**
+ * A single-producer/single-consumer queue of fixed-size slots in shared memory. The producer only
+ * writes the tail and the consumer only writes the head, so that no locks are required. Besides
+ * that, the consumer announces via <sleeping> that it is about to block, so that the producer
+ * knows when it has to wake it up.
+ */
+class RingQueue {
+public:
+	struct Header {
+		volatile ulong head;
+		volatile ulong tail;
+		volatile long sleeping;
+	};
+
+	struct Slot {
+		msgid_t mid;
+		size_t length;
+		/* the data follows */
+	};
+
+	explicit RingQueue() : _hdr(), _slots(), _count(), _slotsize() {
+	}
+	explicit RingQueue(Header *hdr,char *slots,size_t count,size_t slotsize)
+		: _hdr(hdr), _slots(slots), _count(count), _slotsize(slotsize) {
+	}
+
+	/**
+	 * @return the maximum payload of one slot
+	 */
+	size_t maxsize() const {
+		return _slotsize - sizeof(Slot);
+	}
+	/**
+	 * @return true if there is nothing to consume
+	 */
+	bool empty() const {
+		return _hdr->head == _hdr->tail;
+	}
+
+	/**
+	 * Appends the given message. May only be called by the producer.
+	 *
+	 * @param mid the message-id
+	 * @param data the data
+	 * @param len the length of the data
+	 * @return true if the consumer sleeps and has to be woken up
+	 */
+	bool push(msgid_t mid,const void *data,size_t len) {
+		Slot *s = slot(_hdr->tail);
+		s->mid = mid;
+		s->length = len;
+		memcpy(s + 1,data,len);
+		/* make the slot visible before the new tail */
+		__sync_synchronize();
+		_hdr->tail = _hdr->tail + 1;
+		/* the store of the tail has to be visible before we look at the sleeping flag and
+		 * the consumer sets the flag before it looks at the tail again (see sleep()) */
+		__sync_synchronize();
+		return _hdr->sleeping && atomic_cmpnswap(&_hdr->sleeping,1,0);
+	}
+
+	/**
+	 * Removes the first message and copies it into <buf>. May only be called by the consumer.
+	 *
+	 * @param mid will be set to the message-id
+	 * @param buf the buffer to copy the data to
+	 * @param size the size of the buffer
+	 * @return the length of the message, -EWOULDBLOCK if the queue is empty or -EINVAL if the
+	 *  message does not fit into the buffer (the message is dropped in this case)
+	 */
+	ssize_t pop(msgid_t *mid,void *buf,size_t size) {
+		if(empty())
+			return -EWOULDBLOCK;
+		/* don't read the slot before we've seen the tail */
+		__sync_synchronize();
+
+		/* the other side can change the slot at any time. thus, read it only once and use only
+		 * the local copies afterwards */
+		volatile Slot *s = slot(_hdr->head);
+		msgid_t smid = s->mid;
+		size_t slen = s->length;
+		*mid = smid;
+
+		ssize_t res = slen;
+		if(slen > size || slen > maxsize())
+			res = -EINVAL;
+		else
+			memcpy(buf,const_cast<Slot*>(s) + 1,slen);
+
+		/* we're done with the slot before the producer can reuse it */
+		__sync_synchronize();
+		_hdr->head = _hdr->head + 1;
+		return res;
+	}
+
+	/**
+	 * Announces that the consumer is about to block. If the queue has been filled in the meantime,
+	 * the announcement is withdrawn again.
+	 *
+	 * @return true if the consumer should block, i.e., the producer will wake it up
+	 */
+	bool sleep() {
+		_hdr->sleeping = 1;
+		__sync_synchronize();
+		if(!empty()) {
+			/* if the producer took the flag already, it will send a wakeup, which is fine */
+			atomic_cmpnswap(&_hdr->sleeping,1,0);
+			return false;
+		}
+		return true;
+	}
+
+private:
+	Slot *slot(ulong idx) {
+		return reinterpret_cast<Slot*>(_slots + (idx % _count) * _slotsize);
+	}
+
+	Header *_hdr;
+	char *_slots;
+	size_t _count;
+	size_t _slotsize;
+};
+
+/**
+ * A ring channel is an opt-in mode for channels in which client and driver exchange messages via
+ * two RingQueues in shared memory: one for the requests and one for the responses. That is, no
+ * message is copied by the kernel. The kernel is only involved for wakeups: if one side sleeps,
+ * the other side sends a MSG_DEV_RING message over the channel, which requires O_MSGS.
+ *
+ * The client creates the channel by constructing a RingChannel for its channel file descriptor,
+ * which delegates the shared memory with DEL_ARG_SHRING to the driver. The driver attaches to it
+ * with the second constructor (ClientDevice does that automatically). Since the client has at most
+ * as many requests in flight as there are slots, the driver can always put its responses into the
+ * response queue.
+ */
+class RingChannel {
+	static const ulong MAGIC	= 0x52494E47;
+
+	struct Layout {
+		ulong magic;
+		size_t count;
+		size_t slotsize;
+		RingQueue::Header req;
+		RingQueue::Header resp;
+		/* the request slots follow, then the response slots */
+	};
+
+public:
+	/**
+	 * @param count the number of slots per queue
+	 * @param slotsize the size of a slot including its header
+	 * @return the number of bytes that are required in shared memory
+	 */
+	static size_t bytes(size_t count,size_t slotsize) {
+		return sizeof(Layout) + count * slotsize * 2;
+	}
+
+	/**
+	 * Creates a new ring channel for the channel <fd> as the client and shares it with the driver.
+	 *
+	 * @param fd the file descriptor for the channel
+	 * @param count the number of slots per queue
+	 * @param slotsize the maximum size of the messages
+	 * @throws if the operation failed
+	 */
+	explicit RingChannel(int fd,size_t count,size_t slotsize);
+
+	/**
+	 * Attaches to the ring channel in the given shared memory as the driver.
+	 *
+	 * @param fd the file descriptor for the client
+	 * @param mem the shared memory, received via DEL_ARG_SHRING
+	 * @param size the size of the shared memory
+	 * @throws if the memory does not contain a valid ring channel
+	 */
+	explicit RingChannel(int fd,void *mem,size_t size);
+
+	/**
+	 * Destroys the shared memory, if we've created it
+	 */
+	~RingChannel();
+
+	/**
+	 * No copying/cloning
+	 */
+	RingChannel(const RingChannel &) = delete;
+	RingChannel &operator=(const RingChannel &) = delete;
+
+	/**
+	 * @return the file descriptor for the channel
+	 */
+	int fd() const {
+		return _fd;
+	}
+	/**
+	 * @return the maximum message size
+	 */
+	size_t maxsize() const {
+		return _out.maxsize();
+	}
+
+	/**
+	 * Puts the given message into the outgoing queue and wakes up the other side, if necessary.
+	 * The client can have at most as many requests in flight as there are slots.
+	 *
+	 * @param mid the message-id
+	 * @param data the data
+	 * @param len the length of the data
+	 * @return 0 on success, -EAGAIN if too many requests are in flight (the client has to receive
+	 *  responses first) or -EINVAL if the message is too large
+	 */
+	int send(msgid_t mid,const void *data,size_t len);
+
+	/**
+	 * Fetches the next message from the incoming queue. If there is none and <block> is true, it
+	 * waits until the other side wakes us up. The driver should not block, but use sleep() and
+	 * return to its device-loop instead.
+	 *
+	 * @param mid will be set to the message-id
+	 * @param buf the buffer to copy the message to
+	 * @param size the size of the buffer
+	 * @param block whether to block
+	 * @return the length of the message or a negative error-code
+	 */
+	ssize_t receive(msgid_t *mid,void *buf,size_t size,bool block = true);
+
+	/**
+	 * Announces that we are going to sleep, so that the other side wakes us up via MSG_DEV_RING.
+	 *
+	 * @return false if there are new messages in the incoming queue, i.e., we should not sleep
+	 */
+	bool sleep() {
+		return _in.sleep();
+	}
+
+private:
+	void attach(void *mem,bool client);
+
+	int _fd;
+	bool _client;
+	size_t _count;
+	size_t _inflight;
+	size_t _size;
+	void *_mem;
+	bool _owner;
+	RingQueue _out;
+	RingQueue _in;
+};
+
+}
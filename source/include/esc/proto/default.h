@@ -82,6 +82,9 @@ struct ValueResponse : public ErrorResponse {
 			r.err = -EINVAL;
 		return is;
 	}
+	friend IPCBuf &operator<<(IPCBuf &is,const ValueResponse &r) {
+		return is << r.err << r.res;
+	}
 	friend IPCStream &operator<<(IPCStream &is,const ValueResponse &r) {
 		return is << r.err << r.res;
 	}
@@ -19,8 +19,11 @@
 
 #pragma once
 
+#include <esc/util.h>
 #include <sys/common.h>
+#include <sys/sync.h>
 #include <stdio.h>
+#include <time.h>
 
 namespace fs {
 
@@ -29,17 +32,138 @@ struct CBlock {
 	CBlock *prev;
 	CBlock *next;
 	CBlock *hnext;
+	/* the list of dirty blocks, ordered by the time they became dirty */
+	CBlock *dprev;
+	CBlock *dnext;
+	time_t dirtyTime;
 	size_t blockNo;
 	ushort dirty;
 	ushort refs;
+	/* whether the block is in the list of frequently used blocks */
+	bool frequent;
 	/* NULL indicates an unused entry */
 	void *buffer;
 };
 
+/* a list of cached blocks, from the most recently to the least recently used one */
+struct CBlockList {
+	explicit CBlockList() : newest(), oldest(), count() {
+	}
+
+	void prepend(CBlock *b) {
+		b->prev = NULL;
+		b->next = newest;
+		if(newest)
+			newest->prev = b;
+		else
+			oldest = b;
+		newest = b;
+		count++;
+	}
+	void remove(CBlock *b) {
+		if(b->prev)
+			b->prev->next = b->next;
+		else
+			newest = b->next;
+		if(b->next)
+			b->next->prev = b->prev;
+		else
+			oldest = b->prev;
+		count--;
+	}
+
+	CBlock *newest;
+	CBlock *oldest;
+	size_t count;
+};
+
+/**
+ * The state of the sequential readahead for one open file. The readahead is done in windows that
+ * grow with every sequential access. The first block of the current window serves as a marker:
+ * as soon as the reader reaches it, the next window is read ahead in the background. Thus, the
+ * next window is (hopefully) in the cache when the reader arrives there, and a window is
+ * requested only once instead of with every read.
+ */
+struct ReadAhead {
+	static const size_t MIN_WINDOW	= 4;
+	static const size_t MAX_WINDOW	= 32;
+
+	explicit ReadAhead() : next(), start(), size(), marker() {
+	}
+
+	/**
+	 * Records an access of <count> blocks, starting at <first>, and determines whether a new
+	 * window should be read ahead. A random access resets the window.
+	 *
+	 * @param first the first (file-relative) block
+	 * @param count the number of blocks
+	 * @param rastart will be set to the first (file-relative) block to read ahead
+	 * @return the number of blocks to read ahead (0 = nothing to do)
+	 */
+	size_t access(block_t first,size_t count,block_t *rastart) {
+		/* reads that are not block-aligned continue in the last block of the previous read */
+		bool seq = first == next || (next > 0 && first == next - 1);
+		next = first + count;
+		if(!seq) {
+			size = 0;
+			return 0;
+		}
+
+		if(size == 0) {
+			start = next;
+			size = MIN_WINDOW;
+		}
+		/* nothing to do until the reader reaches the marker */
+		else if(next <= marker)
+			return 0;
+		else {
+			start = esc::Util::max<block_t>(start + size,next);
+			size = esc::Util::min(size * 2,MAX_WINDOW);
+		}
+		marker = start;
+		*rastart = start;
+		return size;
+	}
+
+	/* the block behind the last access */
+	block_t next;
+	/* the current window */
+	block_t start;
+	size_t size;
+	/* the block that triggers the readahead of the next window */
+	block_t marker;
+};
+
+/**
+ * The block cache uses the 2Q replacement policy to be resistant against scans: blocks that are
+ * used for the first time are put into a small FIFO queue (A1in). If they are evicted from there,
+ * only their number is remembered in a ghost queue (A1out). Only if a block is requested again
+ * while it is in the ghost queue, it is considered as frequently used and put into the main LRU
+ * list (Am). Thus, reading a large file once does not throw out metadata blocks like bitmaps,
+ * group descriptors and indirect blocks, which are used by almost every request.
+ */
 class BlockCache {
-	static const size_t HASH_SIZE	= 256;
+	static const size_t HASH_SIZE		= 256;
+	/* the percentage of the cache that is used for A1in */
+	static const size_t IN_RATIO		= 25;
+	/* the number of remembered blocks in A1out, in percent of the cache size. ghosts are cheap,
+	 * so we remember more than the usual 50% to catch blocks that are reused less often */
+	static const size_t GHOST_RATIO		= 200;
+	/* the number of old blocks we look at to find a clean one to evict */
+	static const size_t EVICT_SCAN		= 8;
+	/* the flusher writes back all dirty blocks if more than this percentage is dirty */
+	static const size_t DIRTY_RATIO		= 10;
+	/* and otherwise all blocks that are dirty for at least that many seconds */
+	static const time_t DIRTY_EXPIRE	= 5;
+	/* the interval in which the flusher wakes up (in microseconds) */
+	static const uint FLUSH_INTERVAL	= 500 * 1000;
+	/* the number of pending jobs for the prefetcher; further jobs are dropped */
+	static const size_t PREFETCH_JOBS	= 8;
 
 public:
+	/* the maximum number of blocks that are read or written with one call */
+	static const size_t MAX_BATCH		= ReadAhead::MAX_WINDOW;
+
 	enum {
 		READ	= 0x1,
 		WRITE	= 0x2,
@@ -48,7 +172,7 @@ public:
 	/**
 	 * Inits the block-cache
 	 *
-	 * @param fd the file descriptor for the disk device
+	 * @param fd the file descriptor for the disk device (-1 = don't share the buffer)
 	 * @param blocks the number of blocks in the cache
 	 * @param bsize the block size
 	 */
@@ -80,18 +204,30 @@ public:
 	virtual bool writeBlocks(const void *buffer,size_t start,size_t blockCount) = 0;
 
 	/**
-	 * Writes all dirty blocks to disk
+	 * Writes all dirty blocks to disk, in ascending order and with contiguous blocks coalesced
 	 */
 	void flush();
 
+	/**
+	 * Starts a thread that writes back dirty blocks in the background, as soon as too many blocks
+	 * are dirty or they are dirty for too long.
+	 *
+	 * @return 0 on success
+	 */
+	int startFlusher();
+
+	/**
+	 * Stops the flusher thread again and waits until it is finished. This has to be done before the
+	 * device is closed.
+	 */
+	void stopFlusher();
+
 	/**
 	 * Marks the given block as dirty
 	 *
 	 * @param b the block
 	 */
-	void markDirty(CBlock *b) {
-		b->dirty = true;
-	}
+	void markDirty(CBlock *b);
 
 	/**
 	 * Creates a new block-cache-entry for given block-number. Does not read the contents from disk!
@@ -126,6 +262,38 @@ public:
 		doRelease(b,true);
 	}
 
+	/**
+	 * Brings the given blocks into the cache, if they are not already there. Missing blocks that
+	 * are consecutive on disk are read with a single readBlocks() call.
+	 *
+	 * @param blocks the block numbers (0 denotes a hole and is skipped)
+	 * @param count the number of blocks
+	 */
+	void prefetch(const block_t *blocks,size_t count);
+
+	/**
+	 * Like prefetch(), but lets the prefetcher thread bring the blocks into the cache, so that the
+	 * caller does not need to wait. If the prefetcher is not running, the blocks are prefetched
+	 * synchronously. If it has too much to do already, the request is ignored.
+	 *
+	 * @param blocks the block numbers (0 denotes a hole and is skipped)
+	 * @param count the number of blocks
+	 */
+	void prefetchAsync(const block_t *blocks,size_t count);
+
+	/**
+	 * Starts the thread that performs the prefetchAsync() requests.
+	 *
+	 * @return 0 on success
+	 */
+	int startPrefetcher();
+
+	/**
+	 * Stops the prefetcher thread again and waits until it is finished. Pending requests are
+	 * dropped. This has to be done before the device is closed.
+	 */
+	void stopPrefetcher();
+
 	/**
 	 * Prints statistics about the given blockcache to the given file
 	 *
@@ -147,10 +315,19 @@ private:
 	 * Aquires the tpool_lock, depending on <mode>, for the given block
 	 */
 	void acquire(CBlock *b,uint mode);
+	/**
+	 * Acquires the exclusive tpool_lock for the given block, which has just been fetched, and
+	 * releases ALLOC_LOCK afterwards
+	 */
+	void acquireNew(CBlock *b);
 	/**
 	 * Releases the tpool_lock for given block
 	 */
 	void doRelease(CBlock *b,bool unlockAlloc);
+	/**
+	 * Drops the reference to the given block, whose content could not be read, from the cache
+	 */
+	void discard(CBlock *b);
 	/**
 	 * Requests the given block and reads it from disk if desired
 	 */
@@ -159,17 +336,97 @@ private:
 	 * Fetches a block-cache-entry
 	 */
 	CBlock *getBlock(block_t blockNo);
+	/**
+	 * Searches for the given block in the cache, without changing the LRU order
+	 */
+	CBlock *lookup(block_t blockNo);
+	/**
+	 * Removes the given block from the hashmap
+	 */
+	void unhash(CBlock *b);
+	/**
+	 * Chooses an unused block from <list>, preferring clean ones
+	 */
+	CBlock *chooseVictim(CBlockList *list);
+	/**
+	 * Chooses the block to evict, writes it back, if necessary, and removes it from its list and
+	 * the hashmap. Note that this might release ALLOC_LOCK temporarily.
+	 */
+	CBlock *evict();
+	/**
+	 * Remembers <blockNo> in the ghost queue
+	 */
+	void addGhost(block_t blockNo);
+	/**
+	 * Removes <blockNo> from the ghost queue
+	 *
+	 * @return true if it was present
+	 */
+	bool removeGhost(block_t blockNo);
+	/**
+	 * Writes <b> together with the dirty and unused blocks around it with one writeBlocks() call
+	 */
+	bool writeCluster(CBlock *b);
+	/**
+	 * Removes the given block from the dirty list
+	 */
+	void markClean(CBlock *b);
+	/**
+	 * Writes back the dirty blocks, that should be written according to DIRTY_RATIO and
+	 * DIRTY_EXPIRE
+	 */
+	void writeback();
+	static int flusher(void *arg);
+	static int prefetcher(void *arg);
+
+	/* an entry in the ghost queue */
+	struct Ghost {
+		block_t blockNo;
+		Ghost *hnext;
+	};
+
+	/* a request for the prefetcher */
+	struct PrefetchJob {
+		block_t blocks[MAX_BATCH];
+		size_t count;
+	};
 
 	size_t _blockCacheSize;
 	size_t _blockSize;
 	CBlock **_hashmap;
-	CBlock *_oldestBlock;
-	CBlock *_newestBlock;
+	/* A1in and Am */
+	CBlockList _inList;
+	CBlockList _mainList;
+	size_t _inMax;
 	CBlock *_freeBlocks;
+	/* A1out as a ring buffer, with a hashmap for the lookup */
+	Ghost *_ghosts;
+	Ghost **_ghostmap;
+	size_t _ghostCount;
+	size_t _ghostPos;
+	CBlock *_dirtyFirst;
+	CBlock *_dirtyLast;
+	size_t _dirtyCount;
 	CBlock *_blockCache;
 	void *_blockmem;
-	ulong _hits;
+	/* the buffer for multi-block reads, which is shared with the disk driver as well */
+	void *_batchmem;
+	ulong _inHits;
+	ulong _mainHits;
+	ulong _ghostHits;
 	ulong _misses;
+	ulong _prefetched;
+	ulong _writes;
+	ulong _written;
+	volatile bool _flusherRun;
+	int _flusherTid;
+	/* the pending prefetcher jobs as a ring buffer */
+	PrefetchJob *_jobs;
+	size_t _jobFirst;
+	size_t _jobCount;
+	tUserSem _jobSem;
+	volatile bool _prefetcherRun;
+	int _prefetcherTid;
 };
 
 }
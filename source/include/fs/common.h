@@ -21,8 +21,33 @@
 
 #include <sys/common.h>
 
-#define tpool_lock(...)		0
-#define tpool_unlock(...)	0
+/* flags for tpool_lock() */
+enum {
+	/* take the lock exclusively instead of shared */
+	LOCK_EXCLUSIVE	= 1 << 0,
+	/* keep the lock around when it is released, because it is used frequently */
+	LOCK_KEEP		= 1 << 1,
+};
+
+/**
+ * Acquires the readers-writer-lock identified by <ident>, which is typically the address of the
+ * object to protect or a constant. The lock is created on the first use. A thread that holds a
+ * lock exclusively may acquire it again.
+ *
+ * @param ident the lock identifier
+ * @param flags the flags (LOCK_*)
+ * @return 0 on success
+ */
+int tpool_lock(ulong ident,uint flags);
+
+/**
+ * Releases the lock identified by <ident> again. It is destroyed if it is not used anymore and
+ * has not been acquired with LOCK_KEEP.
+ *
+ * @param ident the lock identifier
+ * @return 0 on success
+ */
+int tpool_unlock(ulong ident);
 
 namespace fs {
 
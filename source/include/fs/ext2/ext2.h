@@ -99,8 +99,19 @@
 #define EXT2_BOOT_LOADER_INO				5
 #define EXT2_UNDEL_DIR_INO					6
 
+/* file types in directory entries (if EXT2_FEATURE_INCOMPAT_FILETYPE is set) */
+#define EXT2_FT_UNKNOWN						0
+#define EXT2_FT_REG_FILE					1
+#define EXT2_FT_DIR							2
+#define EXT2_FT_CHRDEV						3
+#define EXT2_FT_BLKDEV						4
+#define EXT2_FT_FIFO						5
+#define EXT2_FT_SOCK						6
+#define EXT2_FT_SYMLINK						7
+
 /* mode flags */
 /* file format */
+#define EXT2_S_IFMT							0xF000
 #define EXT2_S_IFSOCK						0xC000
 #define EXT2_S_IFLNK						0xA000
 #define EXT2_S_IFREG						0x8000
@@ -146,6 +157,18 @@
 #define EXT3_JOURNAL_DATA_FL				0x00040000	/* journal file data */
 #define EXT2_RESERVED_FL					0x80000000	/* reserved for ext2 library */
 
+/* superblock flags */
+#define EXT2_FLAGS_SIGNED_HASH				0x0001
+#define EXT2_FLAGS_UNSIGNED_HASH			0x0002
+
+/* hash versions for indexed directories */
+#define EXT2_HASH_LEGACY					0
+#define EXT2_HASH_HALF_MD4					1
+#define EXT2_HASH_TEA						2
+#define EXT2_HASH_LEGACY_UNSIGNED			3
+#define EXT2_HASH_HALF_MD4_UNSIGNED			4
+#define EXT2_HASH_TEA_UNSIGNED				5
+
 namespace fs {
 
 struct Ext2SuperBlock {
@@ -242,8 +265,18 @@ struct Ext2SuperBlock {
 	uint32_t defMountOptions;
 	/* A 32bit value indicating the block group ID of the first meta block group. */
 	uint32_t firstMetaBg;
+	/* ext3/ext4 fields we don't use */
+	uint32_t mkfsTime;
+	uint32_t journalBlocks[17];
+	uint32_t blockCountHi;
+	uint32_t suResBlockCountHi;
+	uint32_t freeBlockCountHi;
+	uint16_t minExtraInodeSize;
+	uint16_t wantExtraInodeSize;
+	/* EXT2_FLAGS_* */
+	uint32_t flags;
 	/* UNUSED */
-	uint8_t unused[760];
+	uint8_t unused[668];
 } A_PACKED;
 
 struct Ext2BlockGrp {
@@ -268,11 +301,45 @@ struct Ext2BlockGrp {
 struct Ext2DirEntry {
 	ino_t inode;
 	uint16_t recLen;
-	uint16_t nameLen;
+	/* names are at most 255 bytes long. revision 0 used 16 bits for the length, but the upper
+	 * byte is always 0 there, which matches EXT2_FT_UNKNOWN */
+	uint8_t nameLen;
+	/* the file type (EXT2_FT_*), if EXT2_FEATURE_INCOMPAT_FILETYPE is set */
+	uint8_t fileType;
 	/* name follows (up to 255 bytes) */
 	char name[];
 } A_PACKED;
 
+/* the index of a hash-indexed directory. the first block contains the entries "." and "..", where
+ * ".." spans the whole block. this is followed by the root info and the index entries. the other
+ * index blocks start with an empty directory entry spanning the whole block, followed by index
+ * entries. this way, the directory stays readable for implementations without index support. */
+struct Ext2DxRootInfo {
+	uint32_t reservedZero;
+	/* EXT2_HASH_* */
+	uint8_t hashVersion;
+	/* the size of this struct */
+	uint8_t infoLength;
+	/* the number of index levels below the root (0 or 1) */
+	uint8_t indirectLevels;
+	uint8_t unusedFlags;
+} A_PACKED;
+
+/* an index entry. all keys in <block> are >= hash */
+struct Ext2DxEntry {
+	uint32_t hash;
+	/* the directory-relative block number */
+	uint32_t block;
+} A_PACKED;
+
+/* replaces the hash of the first index entry in each index block */
+struct Ext2DxCountLimit {
+	/* the max. number of entries in this block */
+	uint16_t limit;
+	/* the number of entries in this block, including this one */
+	uint16_t count;
+} A_PACKED;
+
 struct Ext2Inode {
 	uint16_t mode;
 	uint16_t uid;
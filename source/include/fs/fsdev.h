@@ -21,9 +21,15 @@
 
 #include <esc/ipc/clientdevice.h>
 #include <esc/proto/fs.h>
+#include <fs/blockcache.h>
 #include <fs/common.h>
+#include <sys/atomic.h>
 #include <sys/common.h>
+#include <sys/driver.h>
+#include <sys/io.h>
 #include <sys/stat.h>
+#include <sys/thread.h>
+#include <signal.h>
 #include <stdio.h>
 
 namespace fs {
@@ -32,21 +38,41 @@ template<class F>
 class FileSystem;
 
 struct OpenFile : public esc::Client {
-	explicit OpenFile(int fd) : Client(fd), ino() {
+	explicit OpenFile(int fd) : Client(fd), ino(), readahead() {
 	}
-	explicit OpenFile(int fd,const fs::User &u,ino_t _ino) : Client(fd), user(u), ino(_ino) {
+	explicit OpenFile(int fd,const fs::User &u,ino_t _ino)
+		: Client(fd), user(u), ino(_ino), readahead() {
 	}
 
 	fs::User user;
 	ino_t ino;
+	fs::ReadAhead readahead;
 };
 
+/**
+ * The device for filesystems. It can serve the clients with multiple threads: every channel is
+ * bound to one of them, round-robin, so that the requests of one client are handled in order,
+ * while different clients are served in parallel. Thus, the filesystem has to be thread-safe in
+ * this case.
+ */
 template<class F>
 class FSDevice : public esc::ClientDevice<F> {
+	/* the interval in which the threads are woken up on shutdown, until all have noticed it */
+	static const uint WAKEUP_INTERVAL	= 10 * 1000;
+
 public:
-	explicit FSDevice(FileSystem<F> *fs,const char *fsDev)
+	/**
+	 * Creates the device
+	 *
+	 * @param fs the filesystem
+	 * @param fsDev the device path
+	 * @param threads the number of threads to serve the clients with (including the one that
+	 *  calls loop())
+	 */
+	explicit FSDevice(FileSystem<F> *fs,const char *fsDev,size_t threads = 1)
 		: esc::ClientDevice<F>(fsDev,0700,DEV_TYPE_FS,DEV_OPEN | DEV_READ | DEV_WRITE | DEV_CLOSE | DEV_DELEGATE),
-		  _fs(fs), _clients(0) {
+		  _fs(fs), _clients(0), _threads(esc::Util::max<size_t>(threads,1)),
+		  _tids(new tid_t[_threads]), _next(0), _running(0) {
 		this->set(MSG_FILE_OPEN,std::make_memfun(this,&FSDevice::devopen));
 		this->set(MSG_FILE_CLOSE,std::make_memfun(this,&FSDevice::devclose),false);
 		this->set(MSG_FS_OPEN,std::make_memfun(this,&FSDevice::open));
@@ -69,37 +95,56 @@ public:
 
 	virtual ~FSDevice() {
 		_fs->sync();
+		delete[] _tids;
 	}
 
+	/**
+	 * Serves the clients until the device is stopped. If multiple threads have been requested,
+	 * the additional ones are started here and this method waits until they are finished.
+	 */
 	void loop() {
-		ulong buf[IPC_DEF_SIZE / sizeof(ulong)];
-		while(1) {
-			msgid_t mid;
-			int fd = getwork(this->id(),&mid,buf,sizeof(buf),this->isStopped() ? GW_NOBLOCK : 0);
-			if(EXPECT_FALSE(fd < 0)) {
-				if(fd != -EINTR) {
-					/* no requests anymore and we should shutdown? */
-					if(this->isStopped())
-						break;
-					printe("getwork failed");
-				}
-				continue;
+		_tids[0] = gettid();
+		_running = 1;
+		for(size_t i = 1; i < _threads; ++i) {
+			_tids[i] = startthread(worker,this);
+			if(_tids[i] < 0) {
+				printe("Unable to start worker thread");
+				_threads = i;
+				break;
 			}
+			atomic_add(&_running,+1);
+		}
 
-			esc::IPCStream is(fd,buf,sizeof(buf),mid);
-			this->handleMsg(mid,is);
+		serve();
+
+		/* the others might still be waiting for requests; wake them up until they have noticed
+		 * that we're finished. the signal handlers are one-shot, so that we might miss them */
+		while(_running > 1) {
+			raise(SIGUSR1);
+			usleep(WAKEUP_INTERVAL);
 		}
+		for(size_t i = 1; i < _threads; ++i)
+			IGNSIGS(join(_tids[i]));
 	}
 
 	void devopen(esc::IPCStream &is) {
-		_clients++;
+		atomic_add(&_clients,+1);
+		/* distribute the clients among the threads */
+		if(_threads > 1) {
+			tid_t tid = _tids[(ulong)atomic_add(&_next,+1) % _threads];
+			::bindto(is.fd(),tid);
+		}
 		is << esc::FileOpen::Response::success(0) << esc::Reply();
 	}
 
 	void devclose(esc::IPCStream &is) {
 		::close(is.fd());
-		if(--_clients == 0)
+		if(atomic_add(&_clients,-1) == 1) {
 			this->stop();
+			/* the other threads are probably blocked in getwork */
+			if(_threads > 1)
+				raise(SIGUSR1);
+		}
 	}
 
 	void open(esc::IPCStream &is) {
@@ -281,6 +326,41 @@ public:
 	}
 
 private:
+	static void wakeup(int) {
+		/* nothing to do; we just want to interrupt getwork */
+	}
+
+	static int worker(void *arg) {
+		FSDevice *dev = static_cast<FSDevice*>(arg);
+		dev->serve();
+		atomic_add(&dev->_running,-1);
+		return 0;
+	}
+
+	void serve() {
+		ulong buf[IPC_DEF_SIZE / sizeof(ulong)];
+		while(1) {
+			/* the handler is removed as soon as it has been called */
+			if(_threads > 1 && signal(SIGUSR1,wakeup) == SIG_ERR)
+				printe("Unable to set signal-handler for SIGUSR1");
+
+			msgid_t mid;
+			int fd = getwork(this->id(),&mid,buf,sizeof(buf),this->isStopped() ? GW_NOBLOCK : 0);
+			if(EXPECT_FALSE(fd < 0)) {
+				if(fd != -EINTR) {
+					/* no requests anymore and we should shutdown? */
+					if(this->isStopped())
+						break;
+					printe("getwork failed");
+				}
+				continue;
+			}
+
+			esc::IPCStream is(fd,buf,sizeof(buf),mid);
+			this->handleMsg(mid,is);
+		}
+	}
+
 	void handleInfoRead(esc::IPCStream &is,const esc::FileRead::Request &r) {
 		FILE *str = fopendyn();
 		char *data = NULL;
@@ -307,7 +387,12 @@ private:
 	}
 
 	FileSystem<F> *_fs;
-	size_t _clients;
+	long volatile _clients;
+	size_t _threads;
+	tid_t *_tids;
+	/* all threads wait for messages on the device, so that every one might handle devopen */
+	long volatile _next;
+	long volatile _running;
 };
 
 }
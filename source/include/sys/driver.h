@@ -20,6 +20,7 @@
 #pragma once
 
 #include <sys/common.h>
+#include <sys/io.h>
 #include <sys/syscalls.h>
 
 enum {
@@ -110,6 +111,23 @@ A_CHECKRET static inline int getwork(int fd,msgid_t *mid,void *msg,size_t size,u
 	return syscall4(SYSCALL_GETWORK,(fd << 2) | flags,(ulong)mid,(ulong)msg,size);
 }
 
+/**
+ * For drivers: Like getwork(), but fetches up to *<count> messages from the client at once. That
+ * is, as soon as a client wants to be served, all messages of this client that are pending and
+ * fit into the buffers in <vec> are fetched. For each fetched message, vec[i].id is set to the
+ * msg-id and vec[i].size to the size of the message.
+ *
+ * @param fd the device fd
+ * @param vec the buffers for the messages
+ * @param count the number of buffers (at most MAX_MSGV_COUNT); will be set to the number of
+ *  fetched messages
+ * @param flags the flags
+ * @return the file-descriptor for the communication with the client
+ */
+A_CHECKRET static inline int getworkv(int fd,struct msgvec *vec,size_t *count,uint flags) {
+	return syscall3(SYSCALL_GETWORKV,(fd << 2) | flags,(ulong)vec,(ulong)count);
+}
+
 /**
  * Binds the device or channel, referenced by <fd>, to the thread with given id.
  * For devices it means that all channels are bound to thread <tid>, i.e. thread <tid> will receive
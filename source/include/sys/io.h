@@ -75,6 +75,7 @@ enum {
 /* reserved delegate arguments */
 enum {
 	DEL_ARG_SHFILE			= -1,
+	DEL_ARG_SHRING			= -2,	/* establishes a ring channel (see esc::RingChannel) */
 };
 
 /* retry a syscall until it succeeded, skipping tries that failed because of a signal */
@@ -215,6 +216,16 @@ static inline int ftruncate(int fd,off_t length) {
  */
 int truncate(const char *path,off_t length);
 
+/* describes one message for sendv() and getworkv() */
+struct msgvec {
+	msgid_t id;		/* the message-id */
+	void *data;		/* the message data (may be NULL) */
+	size_t size;	/* the size of the message or the buffer */
+};
+
+/* the maximum number of messages that can be transferred with one sendv() or getworkv() */
+static const size_t MAX_MSGV_COUNT	= 16;
+
 /**
  * Sends a message to the device identified by <fd>.
  *
@@ -228,6 +239,21 @@ static inline ssize_t send(int fd,msgid_t id,const void *msg,size_t size) {
 	return syscall4(SYSCALL_SEND,fd,id,(ulong)msg,size);
 }
 
+/**
+ * Sends the <count> messages described by <vec> to the device identified by <fd> at once. This
+ * behaves as if send() was called for each message, but requires only one system call and wakes
+ * up the driver only once. Afterwards, vec[i].id holds the message-id that has been used for the
+ * i-th message.
+ *
+ * @param fd the file-descriptor
+ * @param vec the messages
+ * @param count the number of messages (at most MAX_MSGV_COUNT)
+ * @return the number of sent messages on success or < 0 if an error occurred
+ */
+static inline ssize_t sendv(int fd,struct msgvec *vec,size_t count) {
+	return syscall3(SYSCALL_SENDV,fd,(ulong)vec,count);
+}
+
 /**
  * Receives the message from the device identified by <fd> with id *<id> or the next "for anybody"
  * message if <id> is NULL or *<id> is 0. Blocks if that message is not available.
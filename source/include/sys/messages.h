@@ -31,6 +31,7 @@ enum {
 	MSG_DEV_CANCEL					= 55,
 	MSG_DEV_DELEGATE				= 56,
 	MSG_DEV_OBTAIN					= 57,
+	MSG_DEV_RING					= 58,	/* wakeup for a ring channel (see esc::RingChannel) */
 
 	/* requests to fs */
 	MSG_FS_OPEN						= 100,
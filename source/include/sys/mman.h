@@ -156,6 +156,21 @@ static inline int mlockall(void) {
 	return syscall0(SYSCALL_MLOCKALL);
 }
 
+/**
+ * Determines the physical addresses of the <count> pages starting at <addr>. The region has to be
+ * locked (see mlock), so that the addresses stay valid until it is unmapped. This allows drivers
+ * to let devices transfer data directly from/to shared memory. Only root and the members of the
+ * driver group may use it.
+ *
+ * @param addr the page-aligned virtual address
+ * @param count the number of pages
+ * @param phys the array to write the physical addresses to
+ * @return 0 on success or -EPERM if the process is not allowed to do that
+ */
+static inline int mphys(const void *addr,size_t count,uintptr_t *phys) {
+	return syscall3(SYSCALL_MPHYS,(ulong)addr,count,(ulong)phys);
+}
+
 #if defined(__cplusplus)
 }
 #endif
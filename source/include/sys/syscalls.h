@@ -114,6 +114,9 @@ enum {
 	SYSCALL_UTIME,
 	SYSCALL_TRUNCATE,
 	SYSCALL_SYMLINK,
+	SYSCALL_SENDV,
+	SYSCALL_GETWORKV,
+	SYSCALL_MPHYS,
 #	ifdef __x86__
 	SYSCALL_REQIOPORTS,
 	SYSCALL_RELIOPORTS,
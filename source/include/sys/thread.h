@@ -48,14 +48,12 @@ static inline tid_t gettid(void) {
 int startthread(fThreadEntry entryPoint,void *arg) A_CHECKRET;
 
 /**
- * The syscall exit
+ * The syscall exit. Before, the free memory that is cached for the current thread is given back
+ * to the heap.
  *
  * @param errorCode the error-code for the parent
  */
-A_NORETURN static inline void _exit(int exitCode) {
-	syscall1(SYSCALL_EXIT,exitCode);
-	A_UNREACHED;
-}
+A_NORETURN void _exit(int exitCode);
 
 /**
  * @return the cpu-cycles of the current thread
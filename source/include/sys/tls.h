@@ -30,7 +30,7 @@
 #	include <sys/arch/mmix/tls.h>
 #endif
 
-#define MAX_TLS_ENTRIES		4
+#define MAX_TLS_ENTRIES		8
 
 #if defined(__cplusplus)
 extern "C" {
@@ -38,6 +38,13 @@ extern "C" {
 
 extern long __tls_num;
 
+/**
+ * @return true if the TLS of the current thread has already been created
+ */
+static inline bool tlsready(void) {
+	return *(ulong**)stack_top(2) != NULL;
+}
+
 /**
  * Returns the value at index <idx> from thread local storage. It assumes that <idx> exists.
  *
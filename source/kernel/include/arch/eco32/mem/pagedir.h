@@ -112,6 +112,16 @@ inline frameno_t PageDirBase::getFrameNo(uintptr_t virt) const {
 	return pdir->pts.getFrameNo(virt);
 }
 
+inline bool PageDirBase::isLargePage(uintptr_t virt) const {
+	const PageDir *pdir = static_cast<const PageDir*>(this);
+	return pdir->pts.isLarge(virt);
+}
+
+inline bool PageDirBase::testAndClearAccessed(uintptr_t virt) {
+	PageDir *pdir = static_cast<PageDir*>(this);
+	return pdir->pts.testAndClearAccessed(virt);
+}
+
 inline void PageDirBase::copyToFrame(frameno_t frame,const void *src) {
 	memcpy((void*)(frame * PAGE_SIZE | DIR_MAP_AREA),src,PAGE_SIZE);
 }
@@ -133,9 +143,18 @@ inline int PageDirBase::map(uintptr_t virt,size_t count,PageTables::Allocator &a
 	return 0;
 }
 
-inline void PageDirBase::unmap(uintptr_t virt,size_t count,PageTables::Allocator &alloc) {
+inline int PageDirBase::unmap(uintptr_t virt,size_t count,PageTables::Allocator &alloc) {
 	PageDir *pdir = static_cast<PageDir*>(this);
-	pdir->pts.unmap(virt,count,alloc);
+	int res = pdir->pts.unmap(virt,count,alloc);
+	return res < 0 ? res : 0;
+}
+
+inline void PageDirBase::beginBatch() {
+	/* nothing to do */
+}
+
+inline void PageDirBase::endBatch() {
+	/* nothing to do */
 }
 
 inline size_t PageDirBase::getPageCount() const {
@@ -42,4 +42,4 @@
 
 #define PHYS_MEM_END			0xFFFFFFFF
 
-#define BITMAP_PAGE_COUNT		((2 * 1024 * 1024) / PAGE_SIZE)
+#define CONT_PAGE_COUNT		((2 * 1024 * 1024) / PAGE_SIZE)
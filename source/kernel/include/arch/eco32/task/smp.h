@@ -49,6 +49,10 @@ inline void SMPBase::ensureTLBFlushed() {
 	/* nothing to do */
 }
 
+inline void SMPBase::flushRequested(A_UNUSED cpuid_t id) {
+	/* nothing to do */
+}
+
 inline void SMPBase::sendIPI(A_UNUSED cpuid_t id,A_UNUSED uint8_t vector) {
 	/* ignored */
 }
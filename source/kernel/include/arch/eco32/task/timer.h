@@ -43,10 +43,22 @@ public:
 	static void ackIntrpt();
 };
 
+inline uint64_t TimerBase::getTimestamp() {
+	/* the timer-device interrupts us periodically, so that we can only count the interrupts */
+	return (uint64_t)perCPU[0].timerIntrpts * (1000000 / Timer::FREQUENCY_DIV);
+}
+
 inline void TimerBase::getTimeval(struct timeval *tv) {
-	time_t time = Timer::getRuntime();
-	tv->tv_sec = time / 1000;
-	tv->tv_usec = time % 1000;
+	uint64_t usecs = getTimestamp();
+	tv->tv_sec = usecs / 1000000;
+	tv->tv_usec = usecs % 1000000;
+}
+
+inline bool TimerBase::archIsOneShot() {
+	return false;
+}
+
+inline void TimerBase::archProgram(A_UNUSED uint64_t deadline) {
 }
 
 inline void TimerBase::archInit() {
@@ -123,6 +123,16 @@ inline frameno_t PageDirBase::getFrameNo(uintptr_t virt) const {
 	return PTE_FRAMENO(pte);
 }
 
+inline bool PageDirBase::isLargePage(A_UNUSED uintptr_t virt) const {
+	/* there are no large pages */
+	return false;
+}
+
+inline bool PageDirBase::testAndClearAccessed(A_UNUSED uintptr_t virt) {
+	/* there is no accessed-bit */
+	return false;
+}
+
 inline uintptr_t PageDirBase::getAccess(frameno_t frame) {
 	return frame * PAGE_SIZE | DIR_MAP_AREA;
 }
@@ -138,3 +148,11 @@ inline void PageDirBase::copyToFrame(frameno_t frame,const void *src) {
 inline void PageDirBase::copyFromFrame(frameno_t frame,void *dst) {
 	memcpy(dst,(void*)(frame * PAGE_SIZE | DIR_MAP_AREA),PAGE_SIZE);
 }
+
+inline void PageDirBase::beginBatch() {
+	/* nothing to do */
+}
+
+inline void PageDirBase::endBatch() {
+	/* nothing to do */
+}
@@ -44,4 +44,4 @@
 
 #define PHYS_MEM_END			0xFFFFFFFFFFFFFFFF
 
-#define BITMAP_PAGE_COUNT		((6 * 1024 * 1024) / PAGE_SIZE)
+#define CONT_PAGE_COUNT		((6 * 1024 * 1024) / PAGE_SIZE)
@@ -70,6 +70,7 @@ public:
 		FEAT_SSE41		= 1ULL << (32 + 19),
 		FEAT_SSE42		= 1ULL << (32 + 20),
 		FEAT_POPCNT		= 1ULL << (32 + 23),
+		FEAT_TSCDEADLINE	= 1ULL << (32 + 24),
 		FEAT_AES		= 1ULL << (32 + 25),
 		FEAT_AVX		= 1ULL << (32 + 28),
 
@@ -111,6 +112,8 @@ public:
 		CR4_OSFXSR		= 1 << 9,
 		/* for SIMD floating-point exception (#XM) */
 		CR4_OSXMMEXCPT	= 1 << 10,
+		/* process-context identifiers (only in IA-32e mode) */
+		CR4_PCIDE		= 1 << 17,
 	};
 
 	enum {
@@ -132,6 +135,7 @@ public:
 		MSR_IA32_MTRR_PHYSBASE0		= 0x200,
 		MSR_IA32_MTRR_PHYSMASK0		= 0x201,
 		MSR_IA32_MTRR_DEF_TYPE		= 0x2FF,
+		MSR_IA32_TSC_DEADLINE		= 0x6E0,
         MSR_EFER					= 0xc0000080,
         MSR_IA32_STAR              	= 0xc0000081,
         MSR_IA32_LSTAR             	= 0xc0000082,
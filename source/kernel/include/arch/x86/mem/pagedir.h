@@ -20,6 +20,7 @@
 #pragma once
 
 #include <common.h>
+#include <atomic.h>
 #include <mem/layout.h>
 #include <mem/pagetables.h>
 #include <spinlock.h>
@@ -31,6 +32,20 @@
 class PageDir : public PageDirBase {
 	friend class PageDirBase;
 
+	/* the number of PCIDs each CPU uses for the page-dirs (PCID 0 is only used during boot) */
+	static const size_t PCID_COUNT		= 16;
+
+	/* a PCID of a CPU; valid as long as the generation of the page-dir has not changed */
+	struct PCIDSlot {
+		ulong id;
+		ulong gen;
+	};
+
+	struct PCIDCache {
+		PCIDSlot slots[PCID_COUNT];
+		size_t next;
+	};
+
 	class PTAllocator : public PageTables::Allocator {
 	public:
 		explicit PTAllocator(uintptr_t physStart,size_t count)
@@ -57,7 +72,9 @@ class PageDir : public PageDirBase {
 	};
 
 public:
-	explicit PageDir() : PageDirBase(), freeKStack(), lock(), pts() {
+	explicit PageDir()
+		: PageDirBase(), freeKStack(), lock(), pts(), id(Atomic::fetch_and_add(&nextId,+1)),
+		  tlbGen(), flushLock(), batches(), flushPending(), flushStart(), flushLast() {
 	}
 
 	PageTables *getPageTables() {
@@ -73,6 +90,26 @@ public:
 	 */
 	static void enableNXE();
 
+	/**
+	 * Allocates the PCID-state for all CPUs and enables PCIDs on the BSP, if supported.
+	 */
+	static void initPCID();
+
+	/**
+	 * Enables PCIDs on the current CPU, if supported. Has to be called by every AP.
+	 */
+	static void enablePCID();
+
+	/**
+	 * Determines the value for CR3 to switch to this page-dir on CPU <cpu>. If PCIDs are used and
+	 * the page-dir has not been changed since it ran on <cpu> the last time, its TLB-entries are
+	 * kept. Has to be called after SMP::schedule().
+	 *
+	 * @param cpu the current CPU
+	 * @return the value for CR3
+	 */
+	ulong getCR3(cpuid_t cpu);
+
 	/**
 	* Creates a kernel-stack at an unused address.
 	*
@@ -98,12 +135,27 @@ private:
 	static uintptr_t mapToTemp(frameno_t frame);
 	static void unmapFromTemp();
 
+	void flush(uintptr_t virt,size_t count);
+
 	uintptr_t freeKStack;
 	SpinLock lock;
 	PageTables pts;
+	/* the unique id of this page-dir, used to identify it in the PCID-caches */
+	ulong id;
+	/* increased on every change; CPUs with older TLB-entries flush them on the next switch */
+	volatile ulong tlbGen;
+	/* the collected TLB-shootdowns during a batch */
+	SpinLock flushLock;
+	uint batches;
+	bool flushPending;
+	uintptr_t flushStart;
+	uintptr_t flushLast;
 
 	static uintptr_t freeAreaAddr;
 	static uint8_t sharedPtbls[][PAGE_SIZE];
+	static ulong volatile nextId;
+	static bool pcidEnabled;
+	static PCIDCache *pcids;
 };
 
 inline void PageTables::flushAddr(uintptr_t addr,bool wasPresent) {
@@ -145,6 +197,16 @@ inline frameno_t PageDirBase::getFrameNo(uintptr_t virt) const {
 	return pdir->pts.getFrameNo(virt);
 }
 
+inline bool PageDirBase::isLargePage(uintptr_t virt) const {
+	const PageDir *pdir = static_cast<const PageDir*>(this);
+	return pdir->pts.isLarge(virt);
+}
+
+inline bool PageDirBase::testAndClearAccessed(uintptr_t virt) {
+	PageDir *pdir = static_cast<PageDir*>(this);
+	return pdir->pts.testAndClearAccessed(virt);
+}
+
 inline void PageDirBase::zeroToUser(void *dst,size_t count) {
 	PageDir::setWriteProtection(false);
 	memclear(dst,count);
@@ -55,7 +55,7 @@ public:
 private:
 	static void startup() asm("thread_startup");
 	static bool save(ThreadRegs *saveArea) asm("thread_save");
-	static bool resume(uintptr_t pageDir,const ThreadRegs *saveArea,SpinLock *lock) asm("thread_resume");
+	static bool resume(uintptr_t pageDir,const ThreadRegs *saveArea,uint *switching) asm("thread_resume");
 
 	uintptr_t kernelStack;
 	/* FPU-state; initially NULL */
@@ -28,6 +28,17 @@ class Timer : public TimerBase {
 	Timer() = delete;
 
 	static const uint64_t TOLERANCE			= 1000000;
+	/* the maximum time we program the LAPIC timer for at once */
+	static const uint64_t MAX_ONESHOT_USECS	= 10000000;
+
+	enum Device {
+		/* the PIT, programmed periodically */
+		DEV_PIT,
+		/* the LAPIC timer, programmed with one-shot counts */
+		DEV_LAPIC,
+		/* the LAPIC timer, programmed with TSC deadlines */
+		DEV_TSCDEADLINE,
+	};
 
 public:
 	/**
@@ -56,15 +67,23 @@ private:
 	static uint64_t bootTSC;
 	static time_t bootTime;
 	static uint64_t cpuMhz;
+	static Device device;
 };
 
+inline uint64_t TimerBase::getTimestamp() {
+	return cyclesToTime(CPU::rdtsc() - Timer::bootTSC);
+}
+
 inline void TimerBase::getTimeval(struct timeval *tv) {
-	uint64_t tsc = CPU::rdtsc();
-	uint64_t usecs = cyclesToTime(tsc - Timer::bootTSC);
+	uint64_t usecs = getTimestamp();
 	tv->tv_sec = Timer::bootTime + usecs / 1000000;
 	tv->tv_usec = usecs % 1000000;
 }
 
+inline bool TimerBase::archIsOneShot() {
+	return Timer::device != Timer::DEV_PIT;
+}
+
 inline uint64_t TimerBase::cyclesToTime(uint64_t cycles) {
 	return cycles / Timer::cpuMhz;
 }
@@ -41,4 +41,4 @@
 
 #define PHYS_MEM_END			0xFFFFFFFFFFFFF
 
-#define BITMAP_PAGE_COUNT		((2 * 1024 * 1024) / PAGE_SIZE)
+#define CONT_PAGE_COUNT		((2 * 1024 * 1024) / PAGE_SIZE)
@@ -35,7 +35,14 @@ class Cache {
 		void *freeList;
 	};
 
+	struct Magazine;
+
 public:
+	/**
+	 * Creates the per-CPU magazines. Before that, all objects are taken from the shared freelists.
+	 */
+	static void initMagazines();
+
 	/**
 	 * Allocates <size> bytes from the cache
 	 *
@@ -113,10 +120,16 @@ private:
 	static size_t totalObjSize(size_t sz);
 	static void printBar(OStream &os,size_t mem,size_t maxMem,size_t total,size_t free);
 	static void *get(Entry *c,size_t i);
+	static void put(Entry *c,ulong *area);
+	static bool grow(Entry *c);
+	static Magazine *getMagazine(size_t i);
+	static bool refill(Entry *c,Magazine *m);
+	static void drain(Entry *c,Magazine *m);
 
 #if DEBUGGING
 	static bool aafEnabled;
 #endif
 	static SpinLock lock;
 	static Entry caches[];
+	static Magazine *magazines;
 };
@@ -19,32 +19,41 @@
 
 #pragma once
 
-#include <esc/col/slist.h>
 #include <task/proc.h>
 #include <common.h>
+#include <spinlock.h>
 
+/**
+ * The copy-on-write bookkeeping stores a reference count for every frame, indexed by the frame
+ * number. A count of zero means that the frame is not shared. The counts are protected by a set of
+ * locks that are selected by the frame number as well, so that faults on different frames don't
+ * contend with each other.
+ */
 class CopyOnWrite {
 	CopyOnWrite() = delete;
 
-	struct Entry : public esc::SListItem {
-		explicit Entry(frameno_t frameNo) : esc::SListItem(), frameNumber(frameNo), refCount(0) {
-		}
-		frameno_t frameNumber;
-		size_t refCount;
-	};
-
-	static const size_t HEAP_SIZE	= 64;
+	static const size_t LOCK_COUNT	= 64;
+	static const uint16_t MAX_REFS	= 0xFFFF;
 
 public:
+	/**
+	 * Initializes the reference counts for the frames 0 .. <frameCount> - 1. This has to be done
+	 * during the initialization of the physical memory-management.
+	 *
+	 * @param frameCount the number of frames
+	 */
+	static void init(size_t frameCount);
+
 	/**
 	 * Handles a pagefault for given address. Assumes that the pagefault was caused by a write access
 	 * to a copy-on-write page!
 	 *
 	 * @param address the address
 	 * @param frameNumber the frame for that address
-	 * @return the number of frames that should be added to the current process
+	 * @return the number of page-tables that have been created to split a large page or -ENOMEM if
+	 *  there was not enough memory. In the latter case, nothing has been changed.
 	 */
-	static size_t pagefault(uintptr_t address,frameno_t frameNumber);
+	static int pagefault(uintptr_t address,frameno_t frameNumber);
 
 	/**
 	 * Adds the given frame to the cow-list.
@@ -64,11 +73,11 @@ public:
 	static size_t remove(frameno_t frameNo,bool *foundOther);
 
 	/**
-	 * Note that this is intended for debugging or similar only! (not very efficient)
-	 *
 	 * @return the number of different frames that are in the cow-list
 	 */
-	static size_t getFrmCount();
+	static size_t getFrmCount() {
+		return sharedFrames;
+	}
 
 	/**
 	 * Prints the cow-list
@@ -78,8 +87,13 @@ public:
 	static void print(OStream &os);
 
 private:
-	static Entry *getByFrame(frameno_t frameNo,bool dec);
+	static SpinLock *getLock(frameno_t frameNo) {
+		return locks + (frameNo % LOCK_COUNT);
+	}
+	static uint16_t decRefs(frameno_t frameNo);
 
-	static esc::SList<Entry> frames[];
-	static SpinLock lock;
+	static uint16_t *refs;
+	static size_t frameCount;
+	static size_t sharedFrames;
+	static SpinLock locks[];
 };
@@ -29,6 +29,7 @@ class OStream;
 
 class KHeap {
 	friend class Cache;
+	friend class ObjCache;
 
 	KHeap() = delete;
 
@@ -0,0 +1,103 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+
+#include <common.h>
+#include <spinlock.h>
+
+class OStream;
+
+/**
+ * A cache for objects of one type. In contrast to Cache, it uses the exact object size (plus
+ * alignment) and allocates the objects from page-backed slabs. Guards are only put around the
+ * objects in debugging builds. The objects are never given back to the kernel-heap.
+ */
+class ObjCache {
+public:
+	typedef void (*ctor_func)(void *obj);
+
+	/**
+	 * Creates a new object cache. Intended to be used for static objects.
+	 *
+	 * @param name the name (for debugging)
+	 * @param objSize the size of the objects
+	 * @param align the alignment of the objects (a power of 2, at most PAGE_SIZE)
+	 * @param ctor if not NULL, this function is called for every allocated object
+	 */
+	explicit ObjCache(const char *name,size_t objSize,size_t align = sizeof(ulong),
+	                  ctor_func ctor = NULL);
+
+	/**
+	 * Allocates an object
+	 *
+	 * @return the object or NULL
+	 */
+	void *alloc();
+
+	/**
+	 * Frees the given object
+	 *
+	 * @param obj the object (may be NULL)
+	 */
+	void free(void *obj);
+
+	/**
+	 * @return the size of the objects
+	 */
+	size_t getObjSize() const {
+		return objSize;
+	}
+
+	/**
+	 * @return the occupied memory
+	 */
+	size_t getOccMem() const {
+		return totalObjs * slotSize;
+	}
+
+	/**
+	 * Prints this object cache
+	 *
+	 * @param os the output-stream
+	 */
+	void print(OStream &os) const;
+
+	/**
+	 * Prints all object caches
+	 *
+	 * @param os the output-stream
+	 */
+	static void printAll(OStream &os);
+
+private:
+	bool grow();
+
+	const char *name;
+	size_t objSize;
+	size_t objOffset;
+	size_t slotSize;
+	ctor_func ctor;
+	size_t totalObjs;
+	size_t freeObjs;
+	void *freeList;
+	SpinLock lock;
+	ObjCache *next;
+	static ObjCache *first;
+};
@@ -181,6 +181,23 @@ public:
 	 */
 	frameno_t getFrameNo(uintptr_t virt) const;
 
+	/**
+	 * Determines whether the given page is mapped via a large page
+	 *
+	 * @param virt the virtual address
+	 * @return true if so
+	 */
+	bool isLargePage(uintptr_t virt) const;
+
+	/**
+	 * Tests whether the given page has been accessed since the last call and clears the
+	 * accessed-bit. Without hardware support, it always returns false.
+	 *
+	 * @param virt the virtual address
+	 * @return true if the page has been accessed
+	 */
+	bool testAndClearAccessed(uintptr_t virt);
+
 	/**
 	 * Clones <count> pages at <virtSrc> to <virtDst> from <this> into <dst>. That means
 	 * the flags and frames are copied. Additionally, if <share> is false all present pages will
@@ -213,8 +230,21 @@ public:
 	 * @param virt the virtual start-address
 	 * @param count the number of pages to unmap
 	 * @param alloc the allocator to use for freeing pages/page-tables
+	 * @return 0 on success or -ENOMEM if a large page could not be split (nothing is removed then)
+	 */
+	int unmap(uintptr_t virt,size_t count,PageTables::Allocator &alloc);
+
+	/**
+	 * Starts a batch of changes to this page-directory. Until endBatch() is called, the
+	 * TLB-shootdowns of clone(), map() and unmap() are collected and performed at once. Note that
+	 * the current CPU still invalidates its TLB-entries immediately.
+	 */
+	void beginBatch();
+
+	/**
+	 * Ends a batch of changes and performs the collected TLB-shootdowns.
 	 */
-	void unmap(uintptr_t virt,size_t count,PageTables::Allocator &alloc);
+	void endBatch();
 
 	/**
 	 * Counts the number of pages that are currently present in this page-directory
@@ -22,11 +22,19 @@
 #include <mem/physmem.h>
 #include <mem/layout.h>
 #include <assert.h>
+#include <atomic.h>
 #include <common.h>
 #include <cppsupport.h>
 
 class PageTables {
 public:
+	/**
+	 * The number of pages and bytes that a large page covers. A large page replaces a complete
+	 * last-level page-table. If the architecture has no large pages, LARGE_PAGE_SIZE is 0.
+	 */
+	static const size_t LARGE_PAGE_COUNT	= PT_ENTRY_COUNT;
+	static const size_t LARGE_PAGE_SIZE		= PTE_LARGE ? PAGE_SIZE * PT_ENTRY_COUNT : 0;
+
 	/**
 	 * Base class for all allocators. Allocators are responsible for allocating and freeing pages
 	 * and page-tables.
@@ -39,7 +47,8 @@ public:
 		}
 
 		/**
-		 * @return the number of allocated and free'd page-tables
+		 * @return the number of allocated minus the number of free'd page-tables. This includes the
+		 *  page-tables that have been created to split large pages.
 		 */
 		int pageTables() const {
 			return _pts;
@@ -50,12 +59,33 @@ public:
 		 */
 		virtual frameno_t allocPage() = 0;
 
+		/**
+		 * Allocates LARGE_PAGE_COUNT contiguous frames for a large page, starting at a frame that
+		 * is aligned to LARGE_PAGE_COUNT. By default, this is not supported.
+		 *
+		 * @return the first frame, 0 to keep the current frames or INVALID_FRAME if not possible
+		 */
+		virtual frameno_t allocLargePage() {
+			return PhysMem::INVALID_FRAME;
+		}
+
+		/**
+		 * Frees the LARGE_PAGE_COUNT frames of a large page, starting at <first>. By default, they
+		 * are free'd page by page.
+		 */
+		virtual void freeLargePage(frameno_t first) {
+			for(size_t i = 0; i < LARGE_PAGE_COUNT; ++i)
+				freePage(first + i);
+		}
+
 		/**
 		 * Allocates a frame for a page-table
 		 */
 		virtual frameno_t allocPT() {
-			_pts++;
-			return PhysMem::allocate(PhysMem::KERN);
+			frameno_t frame = PhysMem::allocate(PhysMem::KERN);
+			if(frame != PhysMem::INVALID_FRAME)
+				_pts++;
+			return frame;
 		}
 
 		/**
@@ -67,7 +97,7 @@ public:
 		 * Frees the given frame that belonged to a page-table
 		 */
 		virtual void freePT(frameno_t frame) {
-			_pts++;
+			_pts--;
 			PhysMem::free(frame,PhysMem::KERN);
 		}
 
@@ -84,6 +114,9 @@ public:
 		virtual frameno_t allocPage() override {
 			return 0;
 		}
+		virtual frameno_t allocLargePage() override {
+			return 0;
+		}
 		virtual void freePage(frameno_t) override {
 		}
 	};
@@ -99,6 +132,13 @@ public:
 		virtual frameno_t allocPage() override {
 			return _frame++;
 		}
+		virtual frameno_t allocLargePage() override {
+			if(_frame % LARGE_PAGE_COUNT != 0)
+				return PhysMem::INVALID_FRAME;
+			frameno_t first = _frame;
+			_frame += LARGE_PAGE_COUNT;
+			return first;
+		}
 		virtual void freePage(frameno_t) override;
 
 	private:
@@ -107,16 +147,22 @@ public:
 
 	/**
 	 * The user allocator takes frames from the current thread (which have to be put there
-	 * beforehand). It frees them as PhysMem::USR.
+	 * beforehand). It frees them as PhysMem::USR. Large pages come from PhysMem::allocateLarge().
 	 */
 	class UAllocator : public Allocator {
 	public:
 		explicit UAllocator();
 
 		virtual frameno_t allocPage() override;
+		virtual frameno_t allocLargePage() override {
+			return PhysMem::allocateLarge();
+		}
 		virtual void freePage(frameno_t frame) override {
 			PhysMem::free(frame,PhysMem::USR);
 		}
+		virtual void freeLargePage(frameno_t first) override {
+			PhysMem::freeLarge(first);
+		}
 
 	private:
 		Thread *_thread;
@@ -208,6 +254,18 @@ public:
 		return pte ? *pte & PTE_PRESENT : false;
 	}
 
+	/**
+	 * Determines whether the given page is mapped via a large page
+	 *
+	 * @param virt the virtual address
+	 * @return true if so
+	 */
+	bool isLarge(uintptr_t virt) const {
+		uintptr_t base;
+		pte_t *pte = getPTE(virt,&base);
+		return pte ? *pte & PTE_LARGE : false;
+	}
+
 	/**
 	 * Returns the frame-number of the given virtual address. Assumes that its present.
 	 *
@@ -221,6 +279,27 @@ public:
 		return PTE_FRAMENO(*pte) + (virt - base) / PAGE_SIZE;
 	}
 
+	/**
+	 * Tests whether the given page has been accessed since the last call and clears the
+	 * accessed-bit. Without hardware support, it always returns false. All pages of a large page
+	 * share the bit; it is cleared with the last page.
+	 *
+	 * @param virt the virtual address
+	 * @return true if the page has been accessed
+	 */
+	bool testAndClearAccessed(uintptr_t virt) {
+		uintptr_t base = virt;
+		pte_t *pte = getPTE(virt,&base);
+		if(!PTE_ACCESSED || !pte || !(*pte & PTE_ACCESSED))
+			return false;
+		if((*pte & PTE_LARGE) && (virt & ~(PAGE_SIZE - 1)) - base != LARGE_PAGE_SIZE - PAGE_SIZE)
+			return true;
+		/* the CPU might set the dirty-bit meanwhile. we don't flush the TLB here; at worst, the
+		 * page is considered unused a bit too early */
+		Atomic::fetch_and_and(pte,~PTE_ACCESSED);
+		return true;
+	}
+
 	/**
 	 * Clones <count> pages at <virtSrc> to <virtDst> from <this> into <dst>. That means
 	 * the flags and frames are copied. Additionally, if <share> is false all present pages will
@@ -237,23 +316,30 @@ public:
 	int clone(PageTables *dst,uintptr_t virtSrc,uintptr_t virtDst,size_t count,bool share);
 
 	/**
-	 * Maps <count> pages starting at <virt> in this page-directory.
+	 * Maps <count> pages starting at <virt> in this page-directory. In user-space, every part that
+	 * covers a complete and aligned large page is mapped as a large page, if the allocator can
+	 * provide suitable frames (or if a large page is already there and should be kept). This
+	 * replaces page-tables that have no present page. Large pages that are only partially affected
+	 * are split into page-tables first.
 	 *
 	 * @param virt the virt start-address
 	 * @param count the number of pages to map
 	 * @param alloc the allocator to use for allocating pages/page-tables
 	 * @param flags some flags for the pages (PG_*)
-	 * @return 1 or 0 on success. 1 means that a TLB shootdown is necessary
+	 * @return 1 or 0 on success. 1 means that a TLB shootdown is necessary. -ENOMEM if there was
+	 *  not enough memory for frames or page-tables
 	 */
 	int map(uintptr_t virt,size_t count,Allocator &alloc,uint flags);
 
 	/**
-	 * Removes <count> pages starting at <virt> from the page-tables in this page-directory.
+	 * Removes <count> pages starting at <virt> from the page-tables in this page-directory. Large
+	 * pages that are only partially removed are split into page-tables first.
 	 *
 	 * @param virt the virtual start-address
 	 * @param count the number of pages to unmap
 	 * @param alloc the allocator to use for freeing pages/page-tables
-	 * @return 1 if a TLB shootdown is necessary
+	 * @return 1 if a TLB shootdown is necessary. -ENOMEM if a large page could not be split, in
+	 *  which case nothing has been removed
 	 */
 	int unmap(uintptr_t virt,size_t count,Allocator &alloc);
 
@@ -276,9 +362,16 @@ public:
 
 private:
 	static int crtPageTable(pte_t *pte,uint flags,Allocator &alloc);
+	static int splitLarge(pte_t *pte,Allocator &alloc);
+	int splitPartial(uintptr_t virt,size_t count,Allocator &alloc);
+	static bool isLargeCandidate(uintptr_t virt,size_t count) {
+		return LARGE_PAGE_SIZE && virt < KERNEL_AREA && (virt & (LARGE_PAGE_SIZE - 1)) == 0 &&
+			count >= LARGE_PAGE_COUNT;
+	}
 	static void printPTE(OStream &os,uintptr_t from,uintptr_t to,pte_t page,int level);
 
 	int mapPage(uintptr_t virt,frameno_t frame,pte_t flags,Allocator &alloc);
+	int mapLarge(uintptr_t virt,pte_t flags,Allocator &alloc);
 	frameno_t unmapPage(uintptr_t virt);
 	pte_t *getPTE(uintptr_t virt,uintptr_t *base) const;
 	bool gc(uintptr_t virt,pte_t pte,int level,uint bits,Allocator &alloc);
@@ -44,6 +44,10 @@ typedef ulong tBitmap;
 class PhysMem {
 	PhysMem() = delete;
 
+	/* the number of frames per frame cache and the number of frames to move at once */
+	static const size_t FCACHE_SIZE					= 32;
+	static const size_t FCACHE_BATCH				= FCACHE_SIZE / 2;
+
 	struct SwapInJob {
 		uintptr_t addr;
 		Thread *thread;
@@ -56,13 +60,28 @@ class PhysMem {
 		frameno_t *frames;
 	};
 
-	static const size_t BITS_PER_BMWORD				= sizeof(tBitmap) * 8;
+	/* the metadata of a frame in the contiguous area */
+	struct ContFrame {
+		uint16_t prev;
+		uint16_t next;
+		/* the order of the free block starting here or ORDER_NONE */
+		uint8_t order;
+	};
+
+	/* a per-CPU cache of kernel frames (e.g., for page-tables), handed out without defLock */
+	struct FrameCache {
+		size_t count;
+		frameno_t frames[FCACHE_SIZE];
+	};
+
+	/* the largest block the buddy allocator manages is 2^CONT_MAX_ORDER frames */
+	static const size_t CONT_MAX_ORDER				= 10;
+	static const uint8_t ORDER_NONE					= 0xFF;
+	static const uint16_t CONT_NIL					= 0xFFFF;
 	static const ulong KERNEL_MEM_PERCENT			= 20;
 	static const ulong KERNEL_MEM_MIN				= 750;
-	static const ulong MAX_SWAP_AT_ONCE				= 10;
+	static const ulong MAX_SWAP_AT_ONCE				= 32;
 	static const ulong SWAPIN_JOB_COUNT				= 64;
-	/* the amount of memory at which we should start to set the region-timestamp */
-	static const size_t REG_TS_BEGIN				= 4 * 1024 * PAGE_SIZE;
 
 	static const int OPEN_RETRIES					= 1000;
 
@@ -89,6 +108,11 @@ public:
 	 */
 	static void init();
 
+	/**
+	 * Initializes the per-CPU frame caches. Has to be done after SMP::init().
+	 */
+	static void initCaches();
+
 	/**
 	 * @return the total amount of memory
 	 */
@@ -119,7 +143,7 @@ public:
 	 * @return the number of bytes used for the mm-stack
 	 */
 	static size_t getStackSize() {
-		return (lower.pages + upper.pages) * PAGE_SIZE;
+		return (lower.pages + upper.pages + lowerLarge.pages + upperLarge.pages) * PAGE_SIZE;
 	}
 
 	/**
@@ -137,14 +161,9 @@ public:
 	static size_t getFreeFrames(uint types);
 
 	/**
-	 * Determines whether the region-timestamp should be set (depending on the still available memory)
-	 *
-	 * @return true if so
-	 */
-	static bool shouldSetRegTimestamp();
-
-	/**
-	 * Allocates <count> contiguous frames from the MM-bitmap
+	 * Allocates <count> contiguous frames from the buddy allocator of the contiguous area. The
+	 * allocation is rounded up to the next power of two internally, but the unused rest is given
+	 * back immediately, so that exactly <count> frames are in use afterwards.
 	 *
 	 * @param count the number of frames
 	 * @param align the alignment of the memory (in pages)
@@ -153,7 +172,8 @@ public:
 	static ssize_t allocateContiguous(size_t count,size_t align);
 
 	/**
-	 * Free's <count> contiguous frames, starting at <first> in the MM-bitmap
+	 * Free's <count> contiguous frames, starting at <first> in the contiguous area. The frames
+	 * are coalesced with their free buddies.
 	 *
 	 * @param first the first frame-number
 	 * @param count the number of frames
@@ -185,6 +205,17 @@ public:
 	 */
 	static frameno_t allocate(FrameType type);
 
+	/**
+	 * Allocates up to <count> frames at once, i.e., with a single lock round-trip. Like
+	 * allocate(), it assumes that the frames have been announced with reserve().
+	 *
+	 * @param type the type of memory (FRM_*)
+	 * @param count the number of frames
+	 * @param frames the array to store the frame-numbers into
+	 * @return the number of allocated frames
+	 */
+	static size_t allocate(FrameType type,size_t count,frameno_t *frames);
+
 	/**
 	 * Frees the given frame
 	 *
@@ -193,6 +224,33 @@ public:
 	 */
 	static void free(frameno_t frame,FrameType type);
 
+	/**
+	 * Frees the given <count> frames at once, i.e., with a single lock round-trip.
+	 *
+	 * @param frames the frame-numbers
+	 * @param count the number of frames
+	 * @param type the type of memory (FRM_*)
+	 */
+	static void free(const frameno_t *frames,size_t count,FrameType type);
+
+	/**
+	 * Allocates PageTables::LARGE_PAGE_COUNT contiguous user frames that start at a frame which is
+	 * aligned to PageTables::LARGE_PAGE_COUNT. In contrast to allocate(), the frames don't need to
+	 * be reserved, but they are only handed out if they are not needed to satisfy the reservations.
+	 * It never swaps.
+	 *
+	 * @return the first frame or INVALID_FRAME if there is no such block available
+	 */
+	static frameno_t allocateLarge();
+
+	/**
+	 * Frees the block of PageTables::LARGE_PAGE_COUNT frames that has been allocated via
+	 * allocateLarge().
+	 *
+	 * @param first the first frame of the block
+	 */
+	static void freeLarge(frameno_t first);
+
 	/**
 	 * Swaps the page with given address for the current process in
 	 *
@@ -234,24 +292,38 @@ private:
 	static void initArch(uintptr_t *stackBegin,size_t *stackSize,tBitmap **bitmap);
 
 private:
-	static uintptr_t bitmapStartFrame();
+	static uintptr_t contStartFrame();
 	static uintptr_t lowerStart();
 	static uintptr_t lowerEnd();
 	static frameno_t allocFrame(bool forceLower);
+	static size_t getFreeLower();
+	static void breakLarge(StackFrames *pool);
+	static void pushLarge(frameno_t first);
+	static frameno_t doAllocate(FrameType type);
+	static void doFree(frameno_t frame,FrameType type);
+	static FrameCache *getFrameCache();
 	static void freeFrame(frameno_t frame);
 	static size_t getFreeDef();
 	static void markRangeUsed(uintptr_t from,uintptr_t to,bool used);
 	static void doMarkRangeUsed(uintptr_t from,uintptr_t to,bool used);
 	static void markUsed(frameno_t frame,bool used);
+	static ssize_t allocBlock(size_t order);
+	static void freeBlock(size_t idx,size_t order);
+	static void freeRange(size_t from,size_t to);
+	static void addFree(size_t idx,size_t order);
+	static void remFree(size_t idx,size_t order);
+	static size_t getOrder(size_t count);
 	static void appendJob(SwapInJob *job);
 	static SwapInJob *getJob();
 	static void freeJob(SwapInJob *job);
 
 	static size_t totalMem;
 
-	/* the bitmap for the frames of the lowest few MB; 0 = free, 1 = used */
-	static tBitmap *bitmap;
-	static uintptr_t bitmapStart;
+	/* the buddy allocator for the frames of the lowest few MB */
+	static ContFrame *contFrames;
+	static uint16_t contFree[];
+	static uintptr_t contStart;
+	static size_t contAlign;
 	static size_t freeCont;
 	static SpinLock contLock;
 
@@ -259,10 +331,16 @@ private:
 	 * TODO Currently we don't free the frames for the stack */
 	static StackFrames lower;
 	static StackFrames upper;
+	/* the first frames of free, aligned blocks for large pages */
+	static StackFrames lowerLarge;
+	static StackFrames upperLarge;
 	static SpinLock defLock;
 
 	static bool initialized;
 
+	/* the per-CPU caches of kernel frames */
+	static FrameCache *frameCaches;
+
 	/* for swapping */
 	static size_t swappedOut;
 	static size_t swappedIn;
@@ -279,11 +357,3 @@ private:
 	static SwapInJob *siJobEnd;
 	static size_t jobWaiters;
 };
-
-inline bool PhysMem::shouldSetRegTimestamp() {
-	if(!swapEnabled)
-		return false;
-
-	LockGuard<SpinLock> g(&defLock);
-	return getFreeDef() * PAGE_SIZE < REG_TS_BEGIN;
-}
@@ -144,13 +144,13 @@ public:
 		return pfSize;
 	}
 	/**
-	 * @return the timestamp of last usage (for swapping)
+	 * @return the page index at which the clock-sweep of the swapper continues in this region
 	 */
-	uint64_t getTimestamp() const {
-		return timestamp;
+	size_t getClockPos() const {
+		return clockPos;
 	}
-	void setTimestamp(uint64_t ts) {
-		timestamp = ts;
+	void setClockPos(size_t pos) {
+		clockPos = pos;
 	}
 
 	/**
@@ -254,7 +254,7 @@ private:
 	off_t offset;
 	size_t loadCount;
 	size_t byteCount;
-	uint64_t timestamp;
+	size_t clockPos;
 	size_t pfSize;			/* size of pageFlags */
 	ulong *pageFlags;		/* flags for each page; upper bits: swap-block, if swapped */
 	esc::ISList<VirtMem*> vms;
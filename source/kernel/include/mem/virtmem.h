@@ -99,14 +99,6 @@ public:
 	 */
 	static bool swapIn(OpenFile *file,Thread *t,uintptr_t addr);
 
-	/**
-	 * Sets the timestamp for all regions that are used by the given thread
-	 *
-	 * @param t the thread
-	 * @param timestamp the timestamp to set
-	 */
-	static void setTimestamp(Thread *t,uint64_t timestamp);
-
 	explicit VirtMem(Proc *p)
 		: proc(p), pagedir(), ownFrames(), sharedFrames(), swapped(), freeStackAddr(),
 		  dataAddr(), freemap(FREE_AREA_BEGIN,FREE_AREA_END - FREE_AREA_BEGIN), regtree(this),
@@ -215,6 +207,17 @@ public:
 	 */
 	int lockall();
 
+	/**
+	 * Determines the physical addresses of the <count> pages starting at <addr>. This is only
+	 * supported for locked regions, because only their frames are guaranteed to stay the same.
+	 *
+	 * @param addr the page-aligned virtual address
+	 * @param phys the array to write the physical addresses to
+	 * @param count the number of pages
+	 * @return 0 on success
+	 */
+	int getPhysAddrs(uintptr_t addr,uintptr_t *phys,size_t count);
+
 	/**
 	 * This is a helper-function for determining the real memory-usage of all processes. It counts
 	 * the number of present frames in all regions of the given process and divides them for each
@@ -386,9 +389,9 @@ private:
 		swapCount = 0;
 	}
 
-	static Region *getLRURegion();
-	static ssize_t getPgIdxForSwap(const Region *reg);
-	static void setSwappedOut(Region *reg,size_t index);
+	static Region *getSwapVictims(size_t *indices,size_t max,size_t *count);
+	static size_t sweepRegion(Region *reg,size_t *indices,size_t max);
+	static bool setSwappedOut(Region *reg,size_t index,frameno_t frameNo);
 	static void setSwappedIn(Region *reg,size_t index,frameno_t frameNo);
 
 	int lockRegion(VMRegion *vm,int flags);
@@ -398,8 +401,10 @@ private:
 	void doUnmap(VMRegion *vm);
 	size_t doGrow(VMRegion *vm,ssize_t amount);
 	int demandLoad(VMRegion *vm,uintptr_t addr);
+	int demandLoadLarge(VMRegion *vm,uintptr_t addr);
 	int loadFromFile(VMRegion *vm,uintptr_t addr,size_t loadCount);
 	uintptr_t findFreeStack(size_t byteCount,ulong rflags);
+	uintptr_t findFreeArea(size_t byteCount);
 	bool isOccupied(uintptr_t start,uintptr_t end) const;
 	uintptr_t getFirstUsableAddr() const;
 	const char *getRegName(const VMRegion *vm) const;
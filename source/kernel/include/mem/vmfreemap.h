@@ -59,6 +59,16 @@ public:
 	 */
 	uintptr_t allocate(size_t size);
 
+	/**
+	 * Allocates an area in the given map, that is <size> bytes large and starts at an address that
+	 * is a multiple of <align>.
+	 *
+	 * @param size the size of the area
+	 * @param align the alignment (a multiple of the page-size)
+	 * @return the address of 0 if failed
+	 */
+	uintptr_t allocate(size_t size,size_t align);
+
 	/**
 	 * Allocates an area in the given map at the specified address, that is <size> bytes large.
 	 *
@@ -35,6 +35,10 @@ struct VMRegion : public esc::DListTreapNode<uintptr_t> {
     	: esc::DListTreapNode<uintptr_t>(_virt), fileuse(), reg(_reg) {
     }
 
+    /* VMRegions are allocated very often, so that we use a dedicated object cache for them */
+    static void *operator new(size_t size) throw();
+    static void operator delete(void *ptr) throw();
+
     virtual bool matches(uintptr_t key) override;
 
     /**
@@ -103,6 +107,25 @@ public:
 		regMutex.up();
 	}
 
+	/**
+	 * The tree at which the clock-sweep of the swapper continues. Assumes that the list of trees
+	 * has been requested via reqTree().
+	 *
+	 * @return the tree or NULL
+	 */
+	static VMTree *getClockHand() {
+		return clockHand;
+	}
+	/**
+	 * Sets the tree at which the clock-sweep continues. Assumes that the list of trees has been
+	 * requested via reqTree().
+	 *
+	 * @param tree the tree
+	 */
+	static void setClockHand(VMTree *tree) {
+		clockHand = tree;
+	}
+
 	/**
 	 * @return the virtmem object it belongs to
 	 */
@@ -189,4 +212,5 @@ private:
 	static Mutex regMutex;
 	static VMTree *regList;
 	static VMTree *regListEnd;
+	static VMTree *clockHand;
 };
@@ -125,6 +125,7 @@ private:
 	static int createdev(Thread *t,IntrptStackFrame *stack);
 	static int createchan(Thread *t,IntrptStackFrame *stack);
 	static int getwork(Thread *t,IntrptStackFrame *stack);
+	static int getworkv(Thread *t,IntrptStackFrame *stack);
 	static int bindto(Thread *t,IntrptStackFrame *stack);
 
 	// io
@@ -140,6 +141,7 @@ private:
 	static int send(Thread *t,IntrptStackFrame *stack);
 	static int receive(Thread *t,IntrptStackFrame *stack);
 	static int sendrecv(Thread *t,IntrptStackFrame *stack);
+	static int sendv(Thread *t,IntrptStackFrame *stack);
 	static int cancel(Thread *t,IntrptStackFrame *stack);
 	static int delegate(Thread *t,IntrptStackFrame *stack);
 	static int obtain(Thread *t,IntrptStackFrame *stack);
@@ -172,6 +174,7 @@ private:
 	static int mattr(Thread *t,IntrptStackFrame *stack);
 	static int mlock(Thread *t,IntrptStackFrame *stack);
 	static int mlockall(Thread *t,IntrptStackFrame *stack);
+	static int mphys(Thread *t,IntrptStackFrame *stack);
 
 	// proc
 	static int getpid(Thread *t,IntrptStackFrame *stack);
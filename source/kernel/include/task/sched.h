@@ -74,11 +74,10 @@ public:
 	static void wakeup(uint event,evobj_t object,bool all = true);
 
 	/**
-	 * @return the current ready-mask. 1 bit per priority.
+	 * @param cpu the CPU
+	 * @return the current ready-mask of the given CPU. 1 bit per priority.
 	 */
-	static ulong getReadyMask() {
-		return readyMask;
-	}
+	static ulong getReadyMask(cpuid_t cpu);
 
 	/**
 	 * Blocks the given thread
@@ -115,6 +114,12 @@ public:
 	static const char *getEventName(uint event);
 
 private:
+	struct RunQueue;
+	struct WaitQueue;
+
+	/* the number of wait-queues for threads that wait for a specific object (a power of 2) */
+	static const size_t WAIT_QUEUE_COUNT	= 256;
+
 	/**
 	 * Adds the given thread as an idle-thread to the scheduler
 	 *
@@ -142,16 +147,18 @@ private:
 	/**
 	 * Appends the given thread on the ready-queue and sets the state to Thread::READY
 	 *
+	 * @param q the ready-queue of the thread (locked)
 	 * @param t the thread
 	 */
-	static void setReady(Thread *t);
+	static void setReady(RunQueue *q,Thread *t);
 
 	/**
 	 * Sets the thread in the blocked-state
 	 *
+	 * @param q the ready-queue of the thread (locked)
 	 * @param t the thread
 	 */
-	static void setBlocked(Thread *t);
+	static void setBlocked(RunQueue *q,Thread *t);
 
 	/**
 	 * Removes the given thread from the scheduler (depending on the state)
@@ -160,28 +167,61 @@ private:
 	 */
 	static void removeThread(Thread *t);
 
-	static void enqueue(Thread *t);
-	static void dequeue(Thread *t);
+	/**
+	 * Locks the ready-queue that is responsible for the given thread
+	 *
+	 * @param t the thread
+	 * @return the locked queue
+	 */
+	static RunQueue *lockQueue(Thread *t);
+
+	/**
+	 * Locks the ready-queue of the given thread and the wait-queue of the event it waits for.
+	 *
+	 * @param t the thread
+	 * @param wq will be set to the locked wait-queue (NULL if it doesn't wait)
+	 * @return the locked ready-queue
+	 */
+	static RunQueue *lockWithEvent(Thread *t,WaitQueue **wq);
+
+	/**
+	 * @param event the event
+	 * @param object the object (0 = any)
+	 * @return the wait-queue for the given event and object
+	 */
+	static WaitQueue *getWaitQueue(uint event,evobj_t object);
+
+	/**
+	 * Wakes up the threads in the given wait-queue that wait for exactly <event> and <object>
+	 *
+	 * @param wq the wait-queue
+	 * @param event the event
+	 * @param object the object
+	 * @param all whether all should be waked up or only the first one
+	 * @return true if a thread has been waked up
+	 */
+	static bool wakeupIn(WaitQueue *wq,uint event,evobj_t object,bool all);
+
+	/**
+	 * Tries to steal a ready thread from the most loaded queue of another CPU
+	 *
+	 * @param q the queue of the current CPU (locked)
+	 * @param cpu the current CPU
+	 * @return the stolen thread or NULL
+	 */
+	static Thread *steal(RunQueue *q,cpuid_t cpu);
+
+	static void enqueue(RunQueue *q,Thread *t);
+	static void dequeue(RunQueue *q,Thread *t);
+	static Thread *dequeueFirst(RunQueue *q,Thread *old);
 	static void removeFromEventlist(Thread *t);
 	static bool setReadyState(Thread *t);
 	static void print(OStream &os,esc::DList<Thread> *q);
+	static void print(OStream &os,const WaitQueue *wq,uint event);
 
-	static SpinLock lock;
-	static ulong readyMask;
-	static esc::DList<Thread> rdyQueues[];
-	static esc::DList<Thread> evlists[EV_COUNT];
-	static size_t rdyCount;
+	static WaitQueue waitQueues[];
+	static WaitQueue anyQueues[];
+	static RunQueue *runQueues;
+	static SpinLock idleLock;
 	static Thread **idleThreads;
 };
-
-inline void Sched::block(Thread *t) {
-	assert(t != NULL);
-	LockGuard<SpinLock> g(&lock);
-	setBlocked(t);
-}
-
-inline void Sched::unblock(Thread *t) {
-	assert(t != NULL);
-	LockGuard<SpinLock> g(&lock);
-	setReady(t);
-}
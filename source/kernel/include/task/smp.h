@@ -22,6 +22,7 @@
 #include <esc/col/slist.h>
 #include <task/thread.h>
 #include <common.h>
+#include <spinlock.h>
 
 /* the IPIs we can send */
 #define IPI_WORK			51
@@ -47,7 +48,8 @@ public:
 	struct CPU : public esc::SListItem {
 		explicit CPU(uint8_t id,bool bootstrap,uint8_t ready)
 			: esc::SListItem(), id(id), bootstrap(bootstrap), ready(ready), curCycles(), lastCycles(),
-			  lastTotal(), lastUpdate(), callback(), thread() {
+			  lastTotal(), lastUpdate(), callback(), thread(), flushLock(), flushPending(), flushStart(),
+			  flushLast() {
 		}
 
 		uint8_t id;
@@ -59,8 +61,16 @@ public:
 		uint64_t lastUpdate;
 		callback_func callback;
 		Thread *thread;
+		/* the TLB-range that this CPU has been asked to invalidate (both inclusive) */
+		SpinLock flushLock;
+		bool flushPending;
+		uintptr_t flushStart;
+		uintptr_t flushLast;
 	};
 
+	/* if more pages should be invalidated, the whole TLB is flushed instead */
+	static const size_t MAX_FLUSH_PAGES		= 32;
+
 	typedef esc::SList<CPU>::iterator iterator;
 
 	/**
@@ -132,11 +142,28 @@ public:
 	static void wakeupCPU();
 
 	/**
-	 * If there is any CPU that uses the given pagedir, it is flushed
+	 * Wakes up CPU <id>, if it is idling, so that it can run a thread from its ready-queue
+	 *
+	 * @param id the CPU-id
+	 */
+	static void wakeupCPU(cpuid_t id);
+
+	/**
+	 * Asks all other CPUs that use the given pagedir to invalidate their TLB-entries for the given
+	 * range. Requests that are still pending for a CPU are merged with the new one.
 	 *
 	 * @param pdir the pagedir
+	 * @param virt the virtual start-address
+	 * @param count the number of pages
+	 */
+	static void flushTLB(PageDir *pdir,uintptr_t virt,size_t count);
+
+	/**
+	 * Invalidates the TLB-entries that other CPUs have requested for CPU <id> via flushTLB().
+	 *
+	 * @param id the id of the current CPU
 	 */
-	static void flushTLB(PageDir *pdir);
+	static void flushRequested(cpuid_t id);
 
 	/**
 	 * Calls the callback for CPU <id>
@@ -74,6 +74,7 @@ class ThreadBase : public esc::DListItem {
 	friend class Signals;
 	friend class Event;
 	friend class Terminator;
+	friend class TimerBase;
 
 	struct Stats {
 		/* number of microseconds of runtime this thread has got so far */
@@ -95,6 +96,9 @@ class ThreadBase : public esc::DListItem {
 		int exitCode;
 	};
 
+	/* the number of frames to allocate or free at once in reserveFrames() and discardFrames() */
+	static const size_t FRAME_BATCH		= 32;
+
 protected:
 	explicit ThreadBase(Proc *p,uint8_t flags);
 
@@ -285,6 +289,13 @@ public:
 	void setCPU(cpuid_t cpu) {
 		this->cpu = cpu;
 	}
+	/**
+	 * @return true if the thread is being switched away from, i.e. its registers are not saved yet.
+	 *  Such a thread must not be run on another CPU.
+	 */
+	bool isSwitching() const {
+		return *(volatile const uint*)&switching != 0;
+	}
 
 	/**
 	 * @return the stack region with given number
@@ -314,7 +325,7 @@ public:
 	 * @return true if so
 	 */
 	bool haveHigherPrio() {
-		ulong mask = Sched::getReadyMask();
+		ulong mask = Sched::getReadyMask(cpu);
 		return mask & ~((1UL << (priority + 1)) - 1);
 	}
 
@@ -572,6 +583,10 @@ protected:
 	/* the next state it will receive on context-switch */
 	uint8_t newState;
 	cpuid_t cpu;
+	/* the CPU whose ready-queue is responsible for this thread (managed by Sched) */
+	cpuid_t schedCPU;
+	/* non-zero while the CPU that ran it last has not saved its registers (managed by doSwitch) */
+	uint switching;
 	/* the stack-region(s) for this thread */
 	VMRegion *stackRegions[STACK_REG_COUNT];
 	/* thread-directory in VFS */
@@ -580,6 +595,8 @@ protected:
 	ThreadRegs saveArea;
 	ListItem threadListItem;
 	ListItem signalListItem;
+	/* the entry in the timer-heap (managed by Timer) */
+	TimerBase::Listener timerListener;
 	/* a list of currently requested frames, i.e. frames that are not free anymore, but were
 	 * reserved for this thread and have not yet been used */
 	esc::ISList<frameno_t> reqFrames;
@@ -661,12 +678,6 @@ inline frameno_t ThreadBase::getFrame() {
 	return frm;
 }
 
-inline void ThreadBase::discardFrames() {
-	frameno_t frm;
-	while((frm = reqFrames.removeFirst()) != 0)
-		PhysMem::free(frm,PhysMem::USR);
-}
-
 /**
  * The start-function for the idle-thread
  */
@@ -24,35 +24,56 @@
 #include <time.h>
 
 class OStream;
+class Thread;
 
 class TimerBase {
 	TimerBase() = delete;
 
-	/* an entry in the listener-list */
+public:
+	static const size_t NOT_QUEUED			= (size_t)-1;
+
+	/* an entry in the timer-heap; every thread has one, because it can't be in the heap twice */
 	struct Listener {
-		tid_t tid;
-		/* difference to the previous listener */
-		time_t time;
+		explicit Listener(Thread *t) : thread(t), time(), block(), cpu(), index(NOT_QUEUED) {
+		}
+
+		Thread *thread;
+		/* the timestamp in microseconds at which the listener expires */
+		uint64_t time;
 		/* if true, the thread is blocked during that time. otherwise it can run and will not be waked
 		 * up, but gets a signal (SIGALRM) */
 		bool block;
-		Listener *next;
+		/* the CPU whose heap contains the listener */
+		cpuid_t cpu;
+		/* the position in the heap or NOT_QUEUED */
+		size_t index;
 	};
 
+private:
 	struct PerCPU {
-		/* total elapsed milliseconds */
-		time_t elapsedMsecs;
-		time_t lastResched;
+		SpinLock lock;
+		/* min-heap of the listeners, ordered by Listener::time */
+		Listener **heap;
+		size_t count;
+		size_t size;
+		/* the timestamp of the last time-slice start */
+		uint64_t lastResched;
+		/* the timestamp the timer-device is currently programmed for */
+		uint64_t deadline;
+		/* whether the CPU runs its idle-thread, i.e., does not need a time-slice */
+		bool idle;
 		size_t timerIntrpts;
 	};
 
-	static const size_t LISTENER_COUNT		= 1024;
+	static const size_t INITIAL_HEAP_SIZE	= 16;
 
 public:
-	/* timer period = 5ms */
+	/* timer period for periodic timer-devices = 5ms */
 	static const unsigned FREQUENCY_DIV		= 200;
-	/* time-slice for a thread (60ms) */
-	static const unsigned TIMESLICE			= ((1000 / FREQUENCY_DIV) * 4);
+	/* time-slice for a thread (20ms), in microseconds */
+	static const uint64_t TIMESLICE			= 20000;
+	/* the value for "no deadline", i.e., the timer-device is disarmed */
+	static const uint64_t NO_DEADLINE		= (uint64_t)-1;
 
 	/**
 	 * Initializes the timer
@@ -67,10 +88,15 @@ public:
 	}
 
 	/**
-	 * @return the kernel-internal timestamp; starts from zero, in milliseconds, increased by timer-irq
+	 * @return the kernel-internal timestamp; starts from zero, in microseconds
+	 */
+	static uint64_t getTimestamp();
+
+	/**
+	 * @return the kernel-internal timestamp; starts from zero, in milliseconds
 	 */
 	static time_t getRuntime() {
-		return perCPU[0].elapsedMsecs;
+		return getTimestamp() / 1000;
 	}
 
 	/**
@@ -100,15 +126,16 @@ public:
 	static uint64_t timeToCycles(uint us);
 
 	/**
-	 * Puts the given thread to sleep for the given number of milliseconds
+	 * Puts the given thread to sleep for the given number of microseconds. If the thread is already
+	 * in the timer-heap, the previous entry is replaced.
 	 *
 	 * @param tid the thread-id
-	 * @param msecs the number of milliseconds to wait
+	 * @param usecs the number of microseconds to wait
 	 * @param block whether to block the thread or not (if so, it will be waked up, otherwise it gets
 	 *  SIGALRM)
 	 * @return 0 on success
 	 */
-	static int sleepFor(tid_t tid,time_t msecs,bool block);
+	static int sleepFor(tid_t tid,uint64_t usecs,bool block);
 
 	/**
 	 * Removes the given thread from the timer
@@ -117,6 +144,15 @@ public:
 	 */
 	static void removeThread(tid_t tid);
 
+	/**
+	 * Starts a new time-slice on the given CPU and programs the timer-device accordingly. Has to be
+	 * called on <cpu> whenever a thread has been chosen to run on it.
+	 *
+	 * @param cpu the current CPU
+	 * @param idle whether the chosen thread is the idle-thread
+	 */
+	static void startSlice(cpuid_t cpu,bool idle);
+
 	/**
 	 * Handles a timer-interrupt
 	 *
@@ -137,13 +173,31 @@ private:
 	 */
 	static void archInit();
 
-	static SpinLock lock;
+	/**
+	 * @return true if the timer-device is programmed with one-shot deadlines. otherwise, it
+	 *  interrupts CPU 0 periodically with FREQUENCY_DIV Hz.
+	 */
+	static bool archIsOneShot();
+
+	/**
+	 * Programs the timer-device of the current CPU to fire at the given timestamp.
+	 *
+	 * @param deadline the timestamp in microseconds or NO_DEADLINE to disarm it
+	 */
+	static void archProgram(uint64_t deadline);
+
+	static void reprogram(PerCPU *pc);
+	static void enqueue(PerCPU *pc,Listener *l);
+	static void dequeue(PerCPU *pc,Listener *l);
+	static void siftUp(PerCPU *pc,size_t i);
+	static void siftDown(PerCPU *pc,size_t i);
+	static void place(PerCPU *pc,Listener *l,size_t i) {
+		pc->heap[i] = l;
+		l->index = i;
+	}
+
 	static PerCPU *perCPU;
-	static time_t lastRuntimeUpdate;
-	static Listener listenObjs[LISTENER_COUNT];
-	static Listener *freeList;
-	/* processes that should be waked up to a specified time */
-	static Listener *listener;
+	static uint64_t volatile lastRuntimeUpdate;
 };
 
 #if defined(__x86__)
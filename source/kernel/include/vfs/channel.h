@@ -20,22 +20,41 @@
 #pragma once
 
 #include <esc/col/slist.h>
+#include <mem/objcache.h>
 #include <vfs/node.h>
 #include <common.h>
 
 class VFSDevice;
+struct msgvec;
 
 class VFSChannel : public VFSNode {
 	friend class VFSDevice;
 
 	struct Message : public esc::SListItem {
 		static const size_t MAX_SIZE	= 256 * 1024;
+		/* messages up to this size are taken from the message cache */
+		static const size_t CACHED_SIZE	= 128;
 
 		static void *operator new(size_t size, size_t msgSize) {
+			if(msgSize <= CACHED_SIZE)
+				return msgCache.alloc();
 			return Cache::alloc(size + msgSize);
 		}
-		static void operator delete(void *ptr) {
-			Cache::free(ptr);
+		/* the cache depends on the length, which can't be read after the destructor has run */
+		static void operator delete(void *ptr) = delete;
+
+		/**
+		 * Destroys the given message and frees its memory. Use it instead of delete.
+		 *
+		 * @param msg the message
+		 */
+		static void destroy(Message *msg) {
+			bool cached = msg->length <= CACHED_SIZE;
+			msg->~Message();
+			if(cached)
+				msgCache.free(msg);
+			else
+				Cache::free(msg);
 		}
 
 		explicit Message(size_t _length) : esc::SListItem(), id(), length(_length) {
@@ -110,6 +129,26 @@ public:
 	 */
 	ssize_t receive(ushort flags,msgid_t *id,void *data,size_t size);
 
+	/**
+	 * Sends the <count> messages described by <vec> to the channel at once
+	 *
+	 * @param flags the flags of the file
+	 * @param vec the messages (the ids will be set to the used message-ids)
+	 * @param count the number of messages
+	 * @return the number of sent messages on success
+	 */
+	ssize_t sendv(ushort flags,struct msgvec *vec,size_t count);
+
+	/**
+	 * Receives up to <count> messages from the channel at once
+	 *
+	 * @param flags the flags of the file
+	 * @param vec the buffers (the ids and sizes will be set to the received ones)
+	 * @param count the number of buffers
+	 * @return the number of received messages on success
+	 */
+	ssize_t receivev(ushort flags,struct msgvec *vec,size_t count);
+
 	/**
 	 * Cancels the message <mid> that is currently in flight. If the device supports it, it waits
 	 * until it has received the response. This tells us whether the message has been canceled or if
@@ -160,6 +199,7 @@ private:
 	pid_t getDeviceProc() const;
 	uint getReceiveFlags() const;
 	int isSupported(int op) const;
+	static void destroyAll(esc::SList<Message> &list);
 
 	int fd;
 	tid_t handler;
@@ -171,4 +211,5 @@ private:
 	esc::SList<Message> sendList;
 	/* a list for reading messages from the device */
 	esc::SList<Message> recvList;
+	static ObjCache msgCache;
 };
@@ -100,6 +100,18 @@ public:
 	 */
 	ssize_t receive(VFSChannel *chan,ushort flags,msgid_t *id,USER void *data,size_t size);
 
+	/**
+	 * Sends the <count> messages described by <vec> to the channel <chan>, which belongs to this
+	 * device, with a single acquisition of the message lock and a single wakeup.
+	 */
+	ssize_t sendv(VFSChannel *chan,ushort flags,struct msgvec *vec,size_t count);
+
+	/**
+	 * Receives up to <count> messages from the channel <chan>, which belongs to this device. It
+	 * waits for the first message and takes all following ones that are already present.
+	 */
+	ssize_t receivev(VFSChannel *chan,ushort flags,struct msgvec *vec,size_t count);
+
 	virtual ssize_t getSize() override;
 	virtual void close(OpenFile *file,int msgid) override;
 	virtual void print(OStream &os) const override;
@@ -113,6 +125,8 @@ private:
 		msgCount -= count;
 	}
 
+	msgid_t genRequestId(msgid_t id);
+	int waitMsg(VFSChannel *chan,ushort flags,msgid_t mid,VFSChannel::Message **msg);
 	void wakeupClients();
 	int getClientFd(tid_t tid);
 
@@ -366,6 +366,25 @@ public:
 	 */
 	ssize_t receiveMsg(msgid_t *id,void *data,size_t size,uint flags);
 
+	/**
+	 * Sends the <count> messages described by <vec> to the corresponding device at once
+	 *
+	 * @param vec the messages (the ids will be set to the used msg-ids)
+	 * @param count the number of messages
+	 * @return the number of sent messages (or < 0 if an error occurred)
+	 */
+	ssize_t sendMsgv(struct msgvec *vec,size_t count);
+
+	/**
+	 * Receives up to <count> messages from the corresponding device at once
+	 *
+	 * @param vec the buffers (the ids and sizes will be set to the fetched ones)
+	 * @param count the number of buffers
+	 * @param flags additional flags (overwrite flags in the file)
+	 * @return the number of received messages (or < 0 if an error occurred)
+	 */
+	ssize_t receiveMsgv(struct msgvec *vec,size_t count,uint flags);
+
 	/**
 	 * Truncates the file to <length> bytes by either extending it with 0-bytes or cutting it to
 	 * that length.
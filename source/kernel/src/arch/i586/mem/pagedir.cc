@@ -59,6 +59,17 @@ void PageDirBase::init() {
 void PageDir::enableNXE() {
 }
 
+void PageDir::initPCID() {
+	/* PCIDs are only available in IA-32e mode */
+}
+
+void PageDir::enablePCID() {
+}
+
+ulong PageDir::getCR3(A_UNUSED cpuid_t cpu) {
+	return pts.getRoot();
+}
+
 int PageDirBase::cloneKernelspace(PageDir *dst,tid_t tid) {
 	Thread *t = Thread::getById(tid);
 	PageDir *cur = Proc::getCurPageDir();
@@ -277,7 +277,7 @@ void PageDirBase::unmapFromCur(uintptr_t virt,size_t count,PageTables::Allocator
 	Proc::getCurPageDir()->unmap(virt,count,alloc);
 }
 
-void PageDirBase::unmap(uintptr_t virt,size_t count,PageTables::Allocator &alloc) {
+int PageDirBase::unmap(uintptr_t virt,size_t count,PageTables::Allocator &alloc) {
 	PageDir *pdir = static_cast<PageDir*>(this);
 	ulong pageNo = pageNumber(virt);
 	uint64_t pte,*pt = NULL;
@@ -305,7 +305,8 @@ void PageDirBase::unmap(uintptr_t virt,size_t count,PageTables::Allocator &alloc
 	/* check if the last changed pagetable is empty (pt is NULL if no pages have been unmapped) */
 	if(pt)
 		pdir->remEmptyPts(virt - PAGE_SIZE,alloc);
-	pdir->ptables -= alloc.pageTables();
+	pdir->ptables += alloc.pageTables();
+	return 0;
 }
 
 uint64_t *PageDir::getPT(uintptr_t virt,bool create,PageTables::Allocator &alloc) const {
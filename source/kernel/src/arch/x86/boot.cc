@@ -73,7 +73,10 @@ static const BootTask tasks[] = {
 	{"Initializing ACPI...",ACPI::init},
 	{"Initializing SMP...",SMP::init},
 	{"Initializing GDT for BSP...",GDT::initBSP},
+	{"Initializing cache magazines...",Cache::initMagazines},
+	{"Initializing frame caches...",PhysMem::initCaches},
 	{"Initializing CPU...",CPU::detect},
+	{"Initializing PCIDs...",PageDir::initPCID},
 	{"Initializing MTRRs...",MTRR::init},
 	{"Initializing FPU...",FPU::init},
 	{"Initializing RTC...",RTC::init},
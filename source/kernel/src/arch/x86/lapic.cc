@@ -19,7 +19,6 @@
 
 #include <arch/x86/lapic.h>
 #include <mem/pagedir.h>
-#include <task/timer.h>
 #include <assert.h>
 #include <common.h>
 #include <config.h>
@@ -44,9 +43,13 @@ void LAPIC::init() {
 	}
 }
 
-void LAPIC::enableTimer() {
-	setTimer((CPU::getBusSpeed() / TIMER_DIVIDER) / Timer::FREQUENCY_DIV);
-	setLVT(REG_LVT_TIMER,Interrupts::IRQ_LAPIC,ICR_DELMODE_FIXED,UNMASKED,MODE_PERIODIC);
+void LAPIC::enableTimer(bool tscDeadline) {
+	/* the timer is armed later by Timer, either by writing the initial count or the deadline MSR */
+	setLVT(REG_LVT_TIMER,Interrupts::IRQ_LAPIC,ICR_DELMODE_FIXED,UNMASKED,
+		tscDeadline ? MODE_TSCDEADLINE : MODE_ONESHOT);
+	/* the LVT-write has to be visible before the first write to the deadline MSR */
+	if(tscDeadline)
+		asm volatile ("mfence" : : : "memory");
 }
 
 void LAPIC::writeIPI(uint32_t high,uint32_t low) {
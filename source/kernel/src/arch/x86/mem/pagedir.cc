@@ -26,6 +26,9 @@
 
 extern void *proc0TLPD;
 uintptr_t PageDir::freeAreaAddr = KFREE_AREA;
+ulong volatile PageDir::nextId = 1;
+bool PageDir::pcidEnabled = false;
+PageDir::PCIDCache *PageDir::pcids = NULL;
 
 /* Note that we only need a lock for the temp-page here, because everything else is not shared
  * among different modules. First, the only critical state here are the page-tables. They are
@@ -136,7 +139,7 @@ int PageDirBase::clone(PageDir *dst,uintptr_t virtSrc,uintptr_t virtDst,size_t c
 	PageDir *pdir = static_cast<PageDir*>(this);
 	int res = pdir->pts.clone(&dst->pts,virtSrc,virtDst,count,share);
 	if(res >= 0)
-		SMP::flushTLB(pdir);
+		pdir->flush(virtSrc,count);
 	return res;
 }
 
@@ -146,13 +149,62 @@ int PageDirBase::map(uintptr_t virt,size_t count,PageTables::Allocator &alloc,ui
 	if(res < 0)
 		return res;
 	if(res == 1)
-		SMP::flushTLB(pdir);
+		pdir->flush(virt,count);
 	return 0;
 }
 
-void PageDirBase::unmap(uintptr_t virt,size_t count,PageTables::Allocator &alloc) {
+int PageDirBase::unmap(uintptr_t virt,size_t count,PageTables::Allocator &alloc) {
 	PageDir *pdir = static_cast<PageDir*>(this);
 	int res = pdir->pts.unmap(virt,count,alloc);
+	if(res < 0)
+		return res;
 	if(res == 1)
-		SMP::flushTLB(pdir);
+		pdir->flush(virt,count);
+	return 0;
+}
+
+void PageDirBase::beginBatch() {
+	PageDir *pdir = static_cast<PageDir*>(this);
+	LockGuard<SpinLock> g(&pdir->flushLock);
+	pdir->batches++;
+}
+
+void PageDirBase::endBatch() {
+	PageDir *pdir = static_cast<PageDir*>(this);
+	uintptr_t start,last;
+	{
+		LockGuard<SpinLock> g(&pdir->flushLock);
+		assert(pdir->batches > 0);
+		pdir->batches--;
+		if(!pdir->flushPending)
+			return;
+		/* perform all collected shootdowns, even if there are other batches running */
+		start = pdir->flushStart;
+		last = pdir->flushLast;
+		pdir->flushPending = false;
+	}
+	SMP::flushTLB(pdir,start,(last - start) / PAGE_SIZE + 1);
+}
+
+void PageDir::flush(uintptr_t virt,size_t count) {
+	if(count == 0)
+		return;
+
+	/* CPUs that don't run us at the moment, but might still have TLB-entries tagged with one of
+	 * their PCIDs, will notice the new generation when switching to us again */
+	Atomic::fetch_and_add(&tlbGen,+1);
+
+	{
+		LockGuard<SpinLock> g(&flushLock);
+		if(batches > 0) {
+			uintptr_t last = virt + (count - 1) * PAGE_SIZE;
+			if(!flushPending || virt < flushStart)
+				flushStart = virt;
+			if(!flushPending || last > flushLast)
+				flushLast = last;
+			flushPending = true;
+			return;
+		}
+	}
+	SMP::flushTLB(this,virt,count);
 }
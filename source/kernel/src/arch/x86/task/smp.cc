@@ -154,6 +154,26 @@ void SMPBase::ensureTLBFlushed() {
 	}
 }
 
+void SMPBase::flushRequested(cpuid_t id) {
+	CPU *cpu = cpus[id];
+	cpu->flushLock.down();
+	uintptr_t start = cpu->flushStart;
+	uintptr_t last = cpu->flushLast;
+	bool pending = cpu->flushPending;
+	cpu->flushPending = false;
+	cpu->flushLock.up();
+
+	if(!pending)
+		return;
+	size_t pages = (last - start) / PAGE_SIZE + 1;
+	if(pages > MAX_FLUSH_PAGES)
+		PageDir::flushTLB();
+	else {
+		for(size_t i = 0; i < pages; ++i)
+			PageTables::flushAddr(start + i * PAGE_SIZE,true);
+	}
+}
+
 void SMP::apIsRunning() {
 	smpLock.down();
 	cpuid_t phys = LAPIC::getId();
@@ -24,8 +24,6 @@
 #include <task/thread.h>
 #include <common.h>
 
-static SpinLock switchLock;
-
 int ThreadBase::initArch(Thread *t) {
 	t->kernelStack = t->getProc()->getPageDir()->createKernelStack();
 	t->fpuState = NULL;
@@ -129,24 +127,23 @@ void ThreadBase::finishThreadStart(A_UNUSED Thread *t,Thread *nt,const void *arg
 }
 
 void Thread::initialSwitch() {
-	switchLock.down();
 	cpuid_t cpu = GDT::getCPUId();
 	Thread *cur = Sched::perform(NULL,cpu);
 	cur->stats.schedCount++;
-	if(PhysMem::shouldSetRegTimestamp())
-		VirtMem::setTimestamp(cur,Timer::getRuntime());
 	GDT::prepareRun(cpu,true,cur);
 	cur->setCPU(cpu);
+	Timer::startSlice(cpu,cur->getFlags() & T_IDLE);
 	FPU::lockFPU();
 	cur->stats.cycleStart = CPU::rdtsc();
-	Thread::resume(cur->getProc()->getPageDir()->getPhysAddr(),&cur->saveArea,&switchLock);
+	Thread::resume(cur->getProc()->getPageDir()->getCR3(cpu),&cur->saveArea,&cur->switching);
 }
 
 void ThreadBase::doSwitch() {
 	Thread *old = Thread::getRunning();
-	/* lock this, because Sched::perform() may make us ready and we can't be chosen by another CPU
-	 * until we've really switched the thread (kernelstack, ...) */
-	switchLock.down();
+	/* Sched::perform() may make us ready, but we can't be chosen by another CPU until we've really
+	 * switched the thread (kernelstack, ...). thus, mark us as switching until Thread::resume() has
+	 * left our stack */
+	old->switching = 1;
 
 	/* update runtime-stats */
 	uint64_t cycles = CPU::rdtsc();
@@ -159,10 +156,11 @@ void ThreadBase::doSwitch() {
 	Thread *n = Sched::perform(old,cpu);
 	n->stats.schedCount++;
 
+	/* the new thread gets a complete time-slice; idle CPUs don't need the timer at all */
+	Timer::startSlice(cpu,n->getFlags() & T_IDLE);
+
 	/* switch thread */
 	if(EXPECT_TRUE(n->getTid() != old->getTid())) {
-		if(EXPECT_FALSE(PhysMem::shouldSetRegTimestamp()))
-			VirtMem::setTimestamp(n,cycles);
 		GDT::prepareRun(cpu,n->getProc() != old->getProc(),n);
 		if(cpu != n->getCPU()) {
 			FPU::initSaveState(n);
@@ -178,13 +176,13 @@ void ThreadBase::doSwitch() {
 		FPU::lockFPU();
 
 		n->stats.cycleStart = CPU::rdtsc();
-		uintptr_t pdir = n->getProc() == old->getProc() ? 0 : n->getProc()->getPageDir()->getPhysAddr();
+		uintptr_t pdir = n->getProc() == old->getProc() ? 0 : n->getProc()->getPageDir()->getCR3(cpu);
 		if(!Thread::save(&old->saveArea))
-			Thread::resume(pdir,&n->saveArea,&switchLock);
+			Thread::resume(pdir,&n->saveArea,&old->switching);
 	}
 	else {
 		SMP::schedule(cpu,n,cycles);
 		n->stats.cycleStart = CPU::rdtsc();
-		switchLock.up();
+		old->switching = 0;
 	}
 }
@@ -17,6 +17,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <esc/util.h>
 #include <arch/x86/ioapic.h>
 #include <arch/x86/lapic.h>
 #include <arch/x86/pic.h>
@@ -33,6 +34,7 @@
 uint64_t Timer::bootTSC = 0;
 time_t Timer::bootTime = 0;
 uint64_t Timer::cpuMhz;
+Timer::Device Timer::device = Timer::DEV_PIT;
 
 void TimerBase::archInit() {
 	Timer::bootTSC = CPU::rdtsc();
@@ -41,7 +43,9 @@ void TimerBase::archInit() {
 
 void Timer::start(bool isBSP) {
 	if(!Config::get(Config::FORCE_PIT) && LAPIC::isAvailable()) {
-		Log::get().writef("CPU %d uses LAPIC as timer device\n",SMP::getCurId());
+		bool tscDeadline = CPU::hasFeature(CPU::BASIC,CPU::FEAT_TSCDEADLINE);
+		Log::get().writef("CPU %d uses LAPIC as timer device (%s)\n",SMP::getCurId(),
+			tscDeadline ? "TSC-deadline" : "one-shot");
 		if(isBSP) {
 			/* mask it as well */
 			if(IOAPIC::enabled())
@@ -49,7 +53,10 @@ void Timer::start(bool isBSP) {
 			else
 				PIC::mask(Interrupts::IRQ_PIT - Interrupts::IRQ_MASTER_BASE);
 		}
-		LAPIC::enableTimer();
+		device = tscDeadline ? DEV_TSCDEADLINE : DEV_LAPIC;
+		LAPIC::enableTimer(tscDeadline);
+		/* the timer is only armed on demand; start with a time-slice for the current thread */
+		startSlice(SMP::getCurId(),false);
 	}
 	else if(isBSP) {
 		Log::get().writef("CPU %d uses PIT as timer device\n",SMP::getCurId());
@@ -61,6 +68,28 @@ void Timer::start(bool isBSP) {
 	}
 }
 
+void TimerBase::archProgram(uint64_t deadline) {
+	if(Timer::device == Timer::DEV_TSCDEADLINE) {
+		/* writing zero disarms the timer; a deadline in the past fires immediately */
+		uint64_t tsc = 0;
+		if(deadline != NO_DEADLINE)
+			tsc = Timer::bootTSC + Timer::cpuMhz * deadline;
+		CPU::setMSR(CPU::MSR_IA32_TSC_DEADLINE,tsc);
+	}
+	else {
+		/* writing zero stops the timer */
+		uint32_t count = 0;
+		if(deadline != NO_DEADLINE) {
+			uint64_t now = getTimestamp();
+			/* if the counter is not sufficient, we simply get an interrupt too early */
+			uint64_t usecs = esc::Util::min(deadline > now ? deadline - now : 1,MAX_ONESHOT_USECS);
+			uint64_t ticks = (usecs * (CPU::getBusSpeed() / LAPIC::TIMER_DIVIDER)) / 1000000;
+			count = esc::Util::min<uint64_t>(esc::Util::max<uint64_t>(ticks,1),0xFFFFFFFF);
+		}
+		LAPIC::setTimer(count);
+	}
+}
+
 void Timer::wait(uint us) {
 	uint64_t start = CPU::rdtsc();
 	uint64_t end = start + timeToCycles(us);
@@ -17,8 +17,10 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <mem/cache.h>
 #include <mem/pagedir.h>
 #include <task/proc.h>
+#include <task/smp.h>
 #include <assert.h>
 #include <common.h>
 
@@ -28,6 +30,9 @@ static const ulong SHPT_COUNT			= 1 + (DIR_MAP_AREA_SIZE / PD_SIZE) +
 				 							((SHARED_AREA_SIZE + PD_SIZE - 1) / PD_SIZE) +
 				 							((SHARED_AREA_SIZE + PT_SIZE - 1) / PT_SIZE);
 
+/* if set in the value for CR3, the TLB-entries tagged with the new PCID are kept */
+static const ulong CR3_NOFLUSH			= 1UL << 63;
+
 extern void *proc0TLPD;
 /* we can't allocate any frames at the beginning. so put the shared-pagetables in bss */
 uint8_t PageDir::sharedPtbls[SHPT_COUNT][PAGE_SIZE] A_ALIGNED(PAGE_SIZE);
@@ -80,6 +85,53 @@ void PageDir::enableNXE() {
 	}
 }
 
+void PageDir::initPCID() {
+	if(!CPU::hasFeature(CPU::BASIC,CPU::FEAT_PCID))
+		return;
+
+	pcids = (PCIDCache*)Cache::calloc(SMP::getCPUCount(),sizeof(PCIDCache));
+	if(!pcids)
+		return;
+	pcidEnabled = true;
+	enablePCID();
+}
+
+void PageDir::enablePCID() {
+	/* this requires that we currently use PCID 0, which is the case for proc0TLPD */
+	if(pcidEnabled)
+		CPU::setCR4(CPU::getCR4() | CPU::CR4_PCIDE);
+}
+
+ulong PageDir::getCR3(cpuid_t cpu) {
+	if(!pcidEnabled)
+		return pts.getRoot();
+
+	/* SMP::schedule() has announced that we're running this page-dir on <cpu>. use a locked
+	 * instruction to read the generation afterwards. this way, we either see the new generation or
+	 * the CPU that changed the page-dir sees us and sends us a shootdown */
+	ulong gen = Atomic::fetch_and_add(&tlbGen,0);
+
+	PCIDCache *cache = pcids + cpu;
+	size_t i;
+	for(i = 0; i < PCID_COUNT; ++i) {
+		if(cache->slots[i].id == id) {
+			if(cache->slots[i].gen == gen)
+				return pts.getRoot() | (i + 1) | CR3_NOFLUSH;
+			break;
+		}
+	}
+
+	/* if we had no PCID yet, replace the oldest one */
+	if(i == PCID_COUNT) {
+		i = cache->next;
+		cache->next = (cache->next + 1) % PCID_COUNT;
+	}
+	/* in both cases, the entries tagged with that PCID are outdated. thus, let CR3 flush them */
+	cache->slots[i].id = id;
+	cache->slots[i].gen = gen;
+	return pts.getRoot() | (i + 1);
+}
+
 int PageDirBase::cloneKernelspace(PageDir *dst,tid_t tid) {
 	Thread *t = Thread::getById(tid);
 	PageDir *cur = Proc::getCurPageDir();
@@ -39,6 +39,7 @@
 #include <mem/copyonwrite.h>
 #include <mem/cache.h>
 #include <mem/kheap.h>
+#include <mem/objcache.h>
 #include <mem/pagedir.h>
 #include <mem/physmem.h>
 #include <mem/physmemareas.h>
@@ -78,6 +79,7 @@ static View views[] = {
 	{"cow",			CopyOnWrite::print},
 	{"cache",		Cache::print},
 	{"kheap",		KHeap::print},
+	{"objcache",	ObjCache::printAll},
 	{"pdirall",		view_pdirall},
 	{"pdiruser",	view_pdiruser},
 	{"pdirkernel",	view_pdirkernel},
@@ -20,6 +20,7 @@
 #include <mem/cache.h>
 #include <mem/kheap.h>
 #include <mem/pagedir.h>
+#include <task/smp.h>
 #include <assert.h>
 #include <common.h>
 #include <log.h>
@@ -36,6 +37,24 @@
 #define MIN_OBJ_COUNT		8
 #define SIZE_THRESHOLD		128
 #define HEAP_THRESHOLD		512
+/* the number of objects per magazine and the number of objects to move at once */
+#define MAG_SIZE			16
+#define MAG_BATCH			(MAG_SIZE / 2)
+/* larger objects are not worth keeping around per CPU */
+#define MAG_MAX_OBJSIZE		2048
+
+/**
+ * Every CPU has a magazine per size class, i.e. a small stack of free objects. Allocations and
+ * frees are served from it without taking a lock. Only if a magazine is empty or full, objects are
+ * moved in batches from or to the shared freelist. Since the kernel is not preemptible and runs
+ * with interrupts disabled, nobody else can use the magazines of the current CPU meanwhile.
+ */
+struct Cache::Magazine {
+	size_t count;
+	size_t hits;
+	size_t misses;
+	void *objs[MAG_SIZE];
+};
 
 SpinLock Cache::lock;
 Cache::Entry Cache::caches[] = {
@@ -51,10 +70,19 @@ Cache::Entry Cache::caches[] = {
 	{8192,0,0,NULL},
 	{16384,0,0,NULL},
 };
+Cache::Magazine *Cache::magazines = NULL;
 #if DEBUGGING
 bool Cache::aafEnabled = false;
 #endif
 
+void Cache::initMagazines() {
+	/* zero'd memory means empty magazines */
+	Magazine *mags = (Magazine*)calloc(SMP::getCPUCount() * ARRAY_SIZE(caches),sizeof(Magazine));
+	if(!mags)
+		Util::panic("Unable to allocate cache magazines");
+	magazines = mags;
+}
+
 size_t Cache::totalObjSize(size_t sz) {
 	/* ensure that all objects are 16 bytes aligned, thus, use 16 bytes before and behind. */
 	return sz + sizeof(uint64_t) * 4;
@@ -140,12 +168,7 @@ A_NOASAN void Cache::free(void *p) {
 	/* check guard */
 	assert(area[(objSize / sizeof(ulong)) + (16 / sizeof(ulong))] == GUARD_MAGIC);
 
-	/* put on freelist */
-	Entry *c = caches + area[0];
-	LockGuard<SpinLock> g(&lock);
-	area[0] = (ulong)c->freeList;
-	c->freeList = area;
-	c->freeObjs++;
+	put(caches + area[0],area);
 }
 
 size_t Cache::getOccMem() {
@@ -157,8 +180,15 @@ size_t Cache::getOccMem() {
 
 size_t Cache::getUsedMem() {
 	size_t count = 0;
-	for(size_t i = 0; i < ARRAY_SIZE(caches); i++)
-		count += (caches[i].totalObjs - caches[i].freeObjs) * totalObjSize(caches[i].objSize);
+	for(size_t i = 0; i < ARRAY_SIZE(caches); i++) {
+		size_t used = caches[i].totalObjs - caches[i].freeObjs;
+		/* the objects in the magazines are free as well */
+		if(magazines) {
+			for(size_t c = 0; c < SMP::getCPUCount(); ++c)
+				used -= magazines[c * ARRAY_SIZE(caches) + i].count;
+		}
+		count += used * totalObjSize(caches[i].objSize);
+	}
 	return count;
 }
 
@@ -177,6 +207,23 @@ void Cache::print(OStream &os) {
 				caches[i].totalObjs,caches[i].freeObjs,BYTES_2_PAGES(mem));
 		printBar(os,mem,maxMem,caches[i].totalObjs,caches[i].freeObjs);
 	}
+
+	if(magazines) {
+		os.writef("Magazines:\n");
+		for(size_t i = 0; i < ARRAY_SIZE(caches); i++) {
+			if(caches[i].objSize > MAG_MAX_OBJSIZE)
+				break;
+			size_t count = 0,hits = 0,misses = 0;
+			for(size_t c = 0; c < SMP::getCPUCount(); ++c) {
+				Magazine *m = magazines + c * ARRAY_SIZE(caches) + i;
+				count += m->count;
+				hits += m->hits;
+				misses += m->misses;
+			}
+			os.writef("Cache %zu [size=%zu, cached=%zu, hits=%zu, misses=%zu]\n",
+				i,caches[i].objSize,count,hits,misses);
+		}
+	}
 }
 
 void Cache::printBar(OStream &os,size_t mem,size_t maxMem,size_t total,size_t free) {
@@ -191,40 +238,107 @@ void Cache::printBar(OStream &os,size_t mem,size_t maxMem,size_t total,size_t fr
 	os.writef("\n");
 }
 
-A_NOASAN void *Cache::get(Entry *c,size_t i) {
+Cache::Magazine *Cache::getMagazine(size_t i) {
+	if(EXPECT_FALSE(!magazines || caches[i].objSize > MAG_MAX_OBJSIZE))
+		return NULL;
+	return magazines + SMP::getCurId() * ARRAY_SIZE(caches) + i;
+}
+
+bool Cache::grow(Entry *c) {
+	size_t pageCount = BYTES_2_PAGES(MIN_OBJ_COUNT * c->objSize);
+	size_t bytes = pageCount * PAGE_SIZE;
+	size_t total = totalObjSize(c->objSize);
+	size_t objs = bytes / total;
+	size_t rem = bytes - objs * total;
+	ulong *space = (ulong*)KHeap::allocSpace(pageCount);
+	if(space == NULL)
+		return false;
+
+	/* if the remaining space is big enough (it won't bring advantages to add dozens e.g. 8
+	 * byte large areas to the heap), add it to the fallback-heap */
+	if(rem >= HEAP_THRESHOLD)
+		KHeap::addMemory((uintptr_t)space + bytes - rem,rem);
+
+	c->totalObjs += objs;
+	c->freeObjs += objs;
+	for(size_t j = 0; j < objs; j++) {
+		space[0] = (ulong)c->freeList;
+		c->freeList = space;
+		space += totalObjSize(c->objSize) / sizeof(ulong);
+	}
+	return true;
+}
+
+A_NOASAN bool Cache::refill(Entry *c,Magazine *m) {
 	LockGuard<SpinLock> g(&lock);
-	if(EXPECT_FALSE(!c->freeList)) {
-		size_t pageCount = BYTES_2_PAGES(MIN_OBJ_COUNT * c->objSize);
-		size_t bytes = pageCount * PAGE_SIZE;
-		size_t total = totalObjSize(c->objSize);
-		size_t objs = bytes / total;
-		size_t rem = bytes - objs * total;
-		ulong *space = (ulong*)KHeap::allocSpace(pageCount);
-		if(space == NULL)
-			return NULL;
+	while(m->count < MAG_BATCH) {
+		if(EXPECT_FALSE(!c->freeList && !grow(c)))
+			break;
+		ulong *area = (ulong*)c->freeList;
+		c->freeList = (void*)area[0];
+		c->freeObjs--;
+		m->objs[m->count++] = area;
+	}
+	return m->count > 0;
+}
 
-		/* if the remaining space is big enough (it won't bring advantages to add dozens e.g. 8
-		 * byte large areas to the heap), add it to the fallback-heap */
-		if(rem >= HEAP_THRESHOLD)
-			KHeap::addMemory((uintptr_t)space + bytes - rem,rem);
-
-		c->totalObjs += objs;
-		c->freeObjs += objs;
-		for(size_t j = 0; j < objs; j++) {
-			space[0] = (ulong)c->freeList;
-			c->freeList = space;
-			space += totalObjSize(c->objSize) / sizeof(ulong);
+A_NOASAN void Cache::drain(Entry *c,Magazine *m) {
+	LockGuard<SpinLock> g(&lock);
+	while(m->count > MAG_BATCH) {
+		ulong *area = (ulong*)m->objs[--m->count];
+		area[0] = (ulong)c->freeList;
+		c->freeList = area;
+		c->freeObjs++;
+	}
+}
+
+A_NOASAN void Cache::put(Entry *c,ulong *area) {
+	Magazine *m = getMagazine(c - caches);
+	if(EXPECT_TRUE(m)) {
+		if(EXPECT_FALSE(m->count == MAG_SIZE)) {
+			m->misses++;
+			drain(c,m);
 		}
+		else
+			m->hits++;
+		m->objs[m->count++] = area;
+		return;
 	}
 
-	/* get first from freelist */
-	ulong *area = (ulong*)c->freeList;
-	c->freeList = (void*)area[0];
+	/* put on freelist */
+	LockGuard<SpinLock> g(&lock);
+	area[0] = (ulong)c->freeList;
+	c->freeList = area;
+	c->freeObjs++;
+}
+
+A_NOASAN void *Cache::get(Entry *c,size_t i) {
+	ulong *area;
+	Magazine *m = getMagazine(i);
+	if(EXPECT_TRUE(m)) {
+		if(EXPECT_FALSE(m->count == 0)) {
+			m->misses++;
+			if(!refill(c,m))
+				return NULL;
+		}
+		else
+			m->hits++;
+		area = (ulong*)m->objs[--m->count];
+	}
+	else {
+		LockGuard<SpinLock> g(&lock);
+		if(EXPECT_FALSE(!c->freeList && !grow(c)))
+			return NULL;
+
+		/* get first from freelist */
+		area = (ulong*)c->freeList;
+		c->freeList = (void*)area[0];
+		c->freeObjs--;
+	}
 
 	/* store size and put guards in front and behind the area */
 	area[0] = i;
 	area[1] = GUARD_MAGIC;
 	area[(c->objSize / sizeof(ulong)) + (16 / sizeof(ulong))] = GUARD_MAGIC;
-	c->freeObjs--;
 	return (void*)((uintptr_t)area + 16);
 }
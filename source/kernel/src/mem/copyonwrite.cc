@@ -18,99 +18,86 @@
  */
 
 #include <esc/util.h>
-#include <mem/cache.h>
 #include <mem/copyonwrite.h>
 #include <mem/pagedir.h>
 #include <task/proc.h>
 #include <assert.h>
+#include <atomic.h>
 #include <common.h>
 #include <spinlock.h>
 #include <string.h>
 #include <util.h>
 #include <video.h>
 
-esc::SList<CopyOnWrite::Entry> CopyOnWrite::frames[HEAP_SIZE];
-SpinLock CopyOnWrite::lock;
+uint16_t *CopyOnWrite::refs = NULL;
+size_t CopyOnWrite::frameCount = 0;
+size_t CopyOnWrite::sharedFrames = 0;
+SpinLock CopyOnWrite::locks[LOCK_COUNT];
 
-size_t CopyOnWrite::pagefault(uintptr_t address,frameno_t frameNumber) {
-	LockGuard<SpinLock> g(&lock);
-	/* find the cow-entry */
-	Entry *cow = getByFrame(frameNumber,true);
-	vassert(cow != NULL,"No COW entry for frame %#x and address %p",frameNumber,address);
+void CopyOnWrite::init(size_t count) {
+	size_t pages = BYTES_2_PAGES(count * sizeof(uint16_t));
+	refs = (uint16_t*)PageDir::makeAccessible(0,pages);
+	memclear(refs,pages * PAGE_SIZE);
+	frameCount = count;
+}
+
+int CopyOnWrite::pagefault(uintptr_t address,frameno_t frameNumber) {
+	/* keep the lock until we're done; otherwise the last user might change the frame before we've
+	 * copied it */
+	LockGuard<SpinLock> g(getLock(frameNumber));
+	vassert(refs[frameNumber] > 0,"Frame %#x is not shared",frameNumber);
 
 	/* if there is another process who wants to get the frame, we make a copy for us */
 	/* otherwise we keep the frame for ourself */
-	if(cow->refCount == 0) {
-		PageTables::NoAllocator noalloc;
-		PageDir::mapToCur(address,1,noalloc,PG_PRESENT | PG_WRITABLE);
+	int res;
+	if(refs[frameNumber] == 1) {
+		PageTables::NoAllocator alloc;
+		res = PageDir::mapToCur(address,1,alloc,PG_PRESENT | PG_WRITABLE);
+		if(res < 0)
+			return res;
+		res = alloc.pageTables();
 	}
 	else {
-		PageTables::UAllocator ualloc;
-		/* can't fail, we've already allocated the frame */
-		PageDir::mapToCur(address,1,ualloc,PG_PRESENT | PG_WRITABLE);
-	}
-
-	/* copy? */
-	if(cow->refCount > 0)
+		PageTables::UAllocator alloc;
+		/* fails if a large page needs to be split and there is no frame for the page-table */
+		res = PageDir::mapToCur(address,1,alloc,PG_PRESENT | PG_WRITABLE);
+		if(res < 0)
+			return res;
 		PageDir::copyFromFrame(frameNumber,(void*)(esc::Util::round_page_dn(address)));
-	else
-		delete cow;
-	return 1;
+		res = alloc.pageTables();
+	}
+	/* only drop our reference if we don't use the frame anymore */
+	decRefs(frameNumber);
+	return res;
 }
 
 bool CopyOnWrite::add(frameno_t frameNo) {
-	LockGuard<SpinLock> g(&lock);
-	Entry *cow = getByFrame(frameNo,false);
-	if(!cow) {
-		cow = new Entry(frameNo);
-		if(cow == NULL)
-			return false;
-		frames[frameNo % HEAP_SIZE].append(cow);
-	}
-	cow->refCount++;
+	vassert(frameNo < frameCount,"Frame %#x out of range",frameNo);
+	LockGuard<SpinLock> g(getLock(frameNo));
+	if(EXPECT_FALSE(refs[frameNo] == MAX_REFS))
+		return false;
+	if(refs[frameNo]++ == 0)
+		Atomic::fetch_and_add(&sharedFrames,+1);
 	return true;
 }
 
 size_t CopyOnWrite::remove(frameno_t frameNo,bool *foundOther) {
-	LockGuard<SpinLock> g(&lock);
-	/* find the cow-entry */
-	Entry *cow = getByFrame(frameNo,true);
-	vassert(cow != NULL,"For frameNo %#x",frameNo);
-
-	*foundOther = cow->refCount > 0;
-	if(cow->refCount == 0)
-		delete cow;
+	LockGuard<SpinLock> g(getLock(frameNo));
+	*foundOther = decRefs(frameNo) > 0;
 	return 1;
 }
 
-size_t CopyOnWrite::getFrmCount() {
-	LockGuard<SpinLock> g(&lock);
-	size_t count = 0;
-	for(size_t i = 0; i < HEAP_SIZE; i++)
-		count += frames[i].length();
-	return count;
-}
-
 void CopyOnWrite::print(OStream &os) {
 	os.writef("COW-Frames: (%zu frames)\n",getFrmCount());
-	for(size_t i = 0; i < HEAP_SIZE; i++) {
-		os.writef("\t%zu:\n",i);
-		for(auto it = frames[i].cbegin(); it != frames[i].cend(); ++it)
-			os.writef("\t\t%#x (%zu refs)\n",it->frameNumber,it->refCount);
+	for(size_t i = 0; i < frameCount; i++) {
+		if(refs[i])
+			os.writef("\t%#zx (%u refs)\n",i,refs[i]);
 	}
 }
 
-CopyOnWrite::Entry *CopyOnWrite::getByFrame(frameno_t frameNo,bool dec) {
-	esc::SList<Entry> *list = frames + (frameNo % HEAP_SIZE);
-	Entry *p = NULL;
-	for(auto it = list->begin(); it != list->end(); p = &*it, ++it) {
-		if(it->frameNumber == frameNo) {
-			if(dec) {
-				if(--it->refCount == 0)
-					list->removeAt(p,&*it);
-			}
-			return &*it;
-		}
-	}
-	return NULL;
+uint16_t CopyOnWrite::decRefs(frameno_t frameNo) {
+	vassert(frameNo < frameCount && refs[frameNo] > 0,"No COW entry for frame %#x",frameNo);
+	if(--refs[frameNo] == 0)
+		Atomic::fetch_and_add(&sharedFrames,-1);
+	return refs[frameNo];
 }
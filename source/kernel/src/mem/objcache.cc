@@ -0,0 +1,122 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <esc/util.h>
+#include <mem/kheap.h>
+#include <mem/objcache.h>
+#include <mem/pagedir.h>
+#include <assert.h>
+#include <common.h>
+#include <ostream.h>
+#include <spinlock.h>
+#include <string.h>
+
+#define GUARD_MAGIC			0xCAFEBABE
+#define MIN_OBJ_COUNT		16
+#define HEAP_THRESHOLD		512
+
+/* this is constant-initialized, so that it is valid before all constructors have been called */
+ObjCache *ObjCache::first = NULL;
+
+ObjCache::ObjCache(const char *name,size_t objSize,size_t align,ctor_func ctor)
+	: name(name), objSize(objSize), objOffset(), slotSize(), ctor(ctor), totalObjs(), freeObjs(),
+	  freeList(), lock(), next(first) {
+	assert(align > 0 && (align & (align - 1)) == 0 && align <= PAGE_SIZE);
+	/* free objects store the pointer to the next one */
+	size_t size = esc::Util::max(objSize,sizeof(void*));
+#if DEBUGGING
+	/* put a guard in front of and behind the object */
+	objOffset = esc::Util::round_up(sizeof(ulong),align);
+	size += objOffset + sizeof(ulong);
+#endif
+	slotSize = esc::Util::round_up(size,esc::Util::max(align,sizeof(void*)));
+	first = this;
+}
+
+void *ObjCache::alloc() {
+	ulong *slot;
+	{
+		LockGuard<SpinLock> g(&lock);
+		if(EXPECT_FALSE(!freeList && !grow()))
+			return NULL;
+
+		slot = (ulong*)freeList;
+		freeList = *(void**)((uintptr_t)slot + objOffset);
+		freeObjs--;
+	}
+
+	void *obj = (void*)((uintptr_t)slot + objOffset);
+#if DEBUGGING
+	slot[0] = GUARD_MAGIC;
+	*(ulong*)((uintptr_t)obj + objSize) = GUARD_MAGIC;
+#endif
+	if(ctor)
+		ctor(obj);
+	return obj;
+}
+
+void ObjCache::free(void *obj) {
+	if(EXPECT_FALSE(obj == NULL))
+		return;
+
+	ulong *slot = (ulong*)((uintptr_t)obj - objOffset);
+#if DEBUGGING
+	assert(slot[0] == GUARD_MAGIC);
+	assert(*(ulong*)((uintptr_t)obj + objSize) == GUARD_MAGIC);
+#endif
+
+	LockGuard<SpinLock> g(&lock);
+	*(void**)obj = freeList;
+	freeList = slot;
+	freeObjs++;
+}
+
+bool ObjCache::grow() {
+	size_t pageCount = BYTES_2_PAGES(MIN_OBJ_COUNT * slotSize);
+	size_t bytes = pageCount * PAGE_SIZE;
+	size_t objs = bytes / slotSize;
+	size_t rem = bytes - objs * slotSize;
+	uintptr_t space = KHeap::allocSpace(pageCount);
+	if(space == 0)
+		return false;
+
+	/* if the remaining space is big enough, add it to the kernel-heap */
+	if(rem >= HEAP_THRESHOLD)
+		KHeap::addMemory(space + bytes - rem,rem);
+
+	/* put the objects in ascending order on the freelist */
+	for(size_t i = objs; i > 0; i--) {
+		uintptr_t slot = space + (i - 1) * slotSize;
+		*(void**)(slot + objOffset) = freeList;
+		freeList = (void*)slot;
+	}
+	totalObjs += objs;
+	freeObjs += objs;
+	return true;
+}
+
+void ObjCache::print(OStream &os) const {
+	os.writef("%-16s [size=%zu, slot=%zu, total=%zu, free=%zu, pages=%zu]\n",
+		name,objSize,slotSize,totalObjs,freeObjs,BYTES_2_PAGES(getOccMem()));
+}
+
+void ObjCache::printAll(OStream &os) {
+	for(const ObjCache *c = first; c != NULL; c = c->next)
+		c->print(os);
+}
@@ -53,8 +53,10 @@ int PageTables::clone(PageTables *dst,uintptr_t virtSrc,uintptr_t virtDst,size_t
 	PageTables *cur = Proc::getCurPageDir()->getPageTables();
 	uintptr_t base,orgVirtSrc = virtSrc,orgVirtDst = virtDst;
 	size_t orgCount = count;
+	int pts = 0;
 	assert(this != dst && (this == cur || dst == cur));
 	while(count > 0) {
+		base = virtSrc;
 		pte_t *spt = getPTE(virtSrc,&base);
 		pte_t pte = *spt;
 
@@ -62,6 +64,47 @@ int PageTables::clone(PageTables *dst,uintptr_t virtSrc,uintptr_t virtDst,size_t
 		if((pte & PTE_WRITABLE) && (!share && (pte & PTE_PRESENT)))
 			pte &= ~PTE_WRITABLE;
 
+		/* large pages never cross region boundaries, so that we always clone them completely. we
+		 * don't split them here, because the page-tables would belong to the source */
+		if(pte & PTE_LARGE) {
+			assert(base == virtSrc && count >= LARGE_PAGE_COUNT);
+			pte_t flags = pte & ~(PTE_FRAMENO_MASK | PTE_LARGE);
+			frameno_t frame = PTE_FRAMENO(pte);
+			int res = -ENOTSUP;
+			if(isLargeCandidate(virtDst,count)) {
+				RangeAllocator lalloc(frame);
+				res = dst->mapLarge(virtDst,flags,lalloc);
+				pts += lalloc.pageTables();
+			}
+			/* if that's not possible, map the frames page by page into the destination */
+			if(res == -ENOTSUP) {
+				size_t i;
+				for(i = 0; i < LARGE_PAGE_COUNT; ++i) {
+					if(dst->mapPage(virtDst + i * PAGE_SIZE,frame + i,flags,noalloc) < 0)
+						break;
+				}
+				res = 0;
+				if(i < LARGE_PAGE_COUNT) {
+					dst->unmap(virtDst,i,noalloc);
+					res = -ENOMEM;
+				}
+			}
+			if(res < 0)
+				goto error;
+
+			/* the source stays a large page; just make it readable, if necessary */
+			if(!share && (pte & PTE_PRESENT)) {
+				*spt &= ~PTE_WRITABLE;
+				if(this == cur)
+					flushAddr(virtSrc,true);
+			}
+
+			virtSrc += LARGE_PAGE_SIZE;
+			virtDst += LARGE_PAGE_SIZE;
+			count -= LARGE_PAGE_COUNT;
+			continue;
+		}
+
 		int res = dst->mapPage(virtDst,PTE_FRAMENO(pte),pte & ~PTE_FRAMENO_MASK,noalloc);
 		if(res < 0)
 			goto error;
@@ -79,18 +122,24 @@ int PageTables::clone(PageTables *dst,uintptr_t virtSrc,uintptr_t virtDst,size_t
 		virtDst += PAGE_SIZE;
 		count--;
 	}
-	return noalloc.pageTables();
+	return noalloc.pageTables() + pts;
 
 error:
 	/* unmap from dest-pagedir; the frames are always owned by src */
 	dst->unmap(orgVirtDst,orgCount - count,noalloc);
 	/* make the cow-pages writable again */
 	while(orgCount > count) {
+		size_t pages = 1;
 		pte_t *pte = getPTE(orgVirtSrc,&base);
-		if(!share && (*pte & PTE_PRESENT))
+		if(*pte & PTE_LARGE) {
+			if(!share && (*pte & PTE_PRESENT))
+				*pte |= PTE_WRITABLE;
+			pages = LARGE_PAGE_COUNT;
+		}
+		else if(!share && (*pte & PTE_PRESENT))
 			mapPage(orgVirtSrc,PTE_FRAMENO(*pte),PTE_PRESENT | PTE_WRITABLE | PTE_EXISTS,noalloc);
-		orgVirtSrc += PAGE_SIZE;
-		orgCount--;
+		orgVirtSrc += pages * PAGE_SIZE;
+		orgCount -= pages;
 	}
 	return -ENOMEM;
 }
@@ -109,6 +158,42 @@ int PageTables::crtPageTable(pte_t *pte,uint flags,Allocator &alloc) {
 	return 0;
 }
 
+int PageTables::splitLarge(pte_t *pte,Allocator &alloc) {
+	frameno_t frame = alloc.allocPT();
+	if(frame == PhysMem::INVALID_FRAME)
+		return -ENOMEM;
+
+	/* map the same frames with the same flags via a page-table. thus, the TLB-entry of the large
+	 * page stays valid until the caller changes and flushes the pages it is interested in */
+	pte_t *pt = reinterpret_cast<pte_t*>(DIR_MAP_AREA + (frame << PAGE_BITS));
+	pte_t flags = *pte & ~(PTE_FRAMENO_MASK | PTE_LARGE);
+	frameno_t first = PTE_FRAMENO(*pte);
+	for(size_t i = 0; i < PT_ENTRY_COUNT; ++i)
+		pt[i] = ((first + i) << PAGE_BITS) | flags;
+
+	*pte = frame << PAGE_BITS | PTE_PRESENT | PTE_WRITABLE | PTE_EXISTS | (*pte & PTE_NOTSUPER);
+	return 0;
+}
+
+int PageTables::splitPartial(uintptr_t virt,size_t count,Allocator &alloc) {
+	/* only the large pages at the beginning and the end of the range can be partially affected */
+	uintptr_t base = virt;
+	pte_t *pte = getPTE(virt,&base);
+	if(pte && (*pte & PTE_LARGE) && (base != virt || count < LARGE_PAGE_COUNT)) {
+		if(splitLarge(pte,alloc) < 0)
+			return -ENOMEM;
+	}
+
+	uintptr_t last = virt + (count - 1) * PAGE_SIZE;
+	base = last;
+	pte = getPTE(last,&base);
+	if(pte && (*pte & PTE_LARGE) && base + LARGE_PAGE_SIZE - PAGE_SIZE != last) {
+		if(splitLarge(pte,alloc) < 0)
+			return -ENOMEM;
+	}
+	return 0;
+}
+
 int PageTables::mapPage(uintptr_t virt,frameno_t frame,pte_t flags,Allocator &alloc) {
 	pte_t *pt = reinterpret_cast<pte_t*>(DIR_MAP_AREA + root);
 	uint bits = PT_BITS - PT_BPL;
@@ -118,6 +203,11 @@ int PageTables::mapPage(uintptr_t virt,frameno_t frame,pte_t flags,Allocator &al
 			if(crtPageTable(pt + idx,flags,alloc) < 0)
 				return -ENOMEM;
 		}
+		/* a single page of a large page is changed */
+		else if(pt[idx] & PTE_LARGE) {
+			if(splitLarge(pt + idx,alloc) < 0)
+				return -ENOMEM;
+		}
 		pt = reinterpret_cast<pte_t*>(DIR_MAP_AREA + (pt[idx] & PTE_FRAMENO_MASK));
 		bits -= PT_BPL;
 	}
@@ -131,6 +221,48 @@ int PageTables::mapPage(uintptr_t virt,frameno_t frame,pte_t flags,Allocator &al
 	return wasPresent;
 }
 
+int PageTables::mapLarge(uintptr_t virt,pte_t flags,Allocator &alloc) {
+	/* walk down to the entry in the last page-directory */
+	pte_t *pt = reinterpret_cast<pte_t*>(DIR_MAP_AREA + root);
+	uint bits = PT_BITS - PT_BPL;
+	for(int i = 0; i < PT_LEVELS - 2; ++i) {
+		uintptr_t idx = (virt >> bits) & (PT_ENTRY_COUNT - 1);
+		if(pt[idx] == 0) {
+			if(crtPageTable(pt + idx,flags,alloc) < 0)
+				return -ENOMEM;
+		}
+		pt = reinterpret_cast<pte_t*>(DIR_MAP_AREA + (pt[idx] & PTE_FRAMENO_MASK));
+		bits -= PT_BPL;
+	}
+
+	/* if there is a page-table already, we can only replace it if no page in it is present (e.g.,
+	 * because the pages are demand-loaded) */
+	pte_t *pte = pt + ((virt >> bits) & (PT_ENTRY_COUNT - 1));
+	frameno_t ptFrame = 0;
+	if(*pte != 0 && (~*pte & PTE_LARGE)) {
+		pte_t *lpt = reinterpret_cast<pte_t*>(DIR_MAP_AREA + (*pte & PTE_FRAMENO_MASK));
+		for(size_t i = 0; i < PT_ENTRY_COUNT; ++i) {
+			if(lpt[i] & PTE_PRESENT)
+				return -ENOTSUP;
+		}
+		ptFrame = PTE_FRAMENO(*pte);
+	}
+
+	frameno_t frame = alloc.allocLargePage();
+	if(frame == PhysMem::INVALID_FRAME || (frame == 0 && (~*pte & PTE_LARGE)))
+		return -ENOTSUP;
+
+	bool wasPresent = *pte & PTE_PRESENT;
+	if(frame)
+		*pte = (frame << PAGE_BITS) | flags | PTE_LARGE;
+	else
+		*pte = (*pte & PTE_FRAMENO_MASK) | flags | PTE_LARGE;
+	/* the page-table might still be cached by the CPUs; thus, a shootdown is needed in this case */
+	if(ptFrame)
+		alloc.freePT(ptFrame);
+	return wasPresent;
+}
+
 pte_t *PageTables::getPTE(uintptr_t virt,uintptr_t *base) const {
 	pte_t *pt = reinterpret_cast<pte_t*>(DIR_MAP_AREA + root);
 	uint bits = PT_BITS - PT_BPL;
@@ -165,7 +297,7 @@ frameno_t PageTables::unmapPage(uintptr_t virt) {
 bool PageTables::gc(uintptr_t virt,pte_t pte,int level,uint bits,Allocator &alloc) {
 	if(~pte & PTE_EXISTS)
 		return true;
-	if(level == 0)
+	if(level == 0 || (pte & PTE_LARGE))
 		return false;
 
 	pte_t *pt = reinterpret_cast<pte_t*>(DIR_MAP_AREA + (pte & PTE_FRAMENO_MASK));
@@ -212,8 +344,27 @@ int PageTables::map(uintptr_t virt,size_t count,Allocator &alloc,uint flags) {
 	if(hasNXE && (~flags & PG_EXECUTABLE))
 		pteFlags |= PTE_NO_EXEC;
 
+	/* split the affected large pages before we change anything, so that we can simply fail */
+	if(count > 0 && virt < KERNEL_AREA && splitPartial(virt,count,alloc) < 0)
+		return -ENOMEM;
+
 	bool needShootdown = false;
 	while(count > 0) {
+		/* map a complete large page at once, if possible */
+		if((flags & PG_PRESENT) && isLargeCandidate(virt,count)) {
+			int res = mapLarge(virt,pteFlags,alloc);
+			if(res == -ENOMEM)
+				goto error;
+			if(res >= 0) {
+				needShootdown |= res == 1;
+				if(this == cur)
+					flushAddr(virt,res == 1);
+				virt += LARGE_PAGE_SIZE;
+				count -= LARGE_PAGE_COUNT;
+				continue;
+			}
+		}
+
 		frameno_t frame = 0;
 		if(flags & PG_PRESENT) {
 			frame = alloc.allocPage();
@@ -246,7 +397,12 @@ int PageTables::unmap(uintptr_t virt,size_t count,Allocator &alloc) {
 	size_t pti = PT_ENTRY_COUNT;
 	size_t lastPti = PT_ENTRY_COUNT;
 	bool needShootdown = false;
-	while(count-- > 0) {
+
+	/* as in map(), either all pages are removed or none */
+	if(count > 0 && virt < KERNEL_AREA && splitPartial(virt,count,alloc) < 0)
+		return -ENOMEM;
+
+	while(count > 0) {
 		/* remove and free page-table, if necessary */
 		pti = index(virt,1);
 		if(pti != lastPti) {
@@ -255,6 +411,22 @@ int PageTables::unmap(uintptr_t virt,size_t count,Allocator &alloc) {
 			lastPti = pti;
 		}
 
+		/* the remaining large pages are removed completely */
+		uintptr_t base = virt;
+		pte_t *pte = getPTE(virt,&base);
+		if(pte && (*pte & PTE_LARGE)) {
+			assert(base == virt && count >= LARGE_PAGE_COUNT);
+			frameno_t first = PTE_FRAMENO(*pte);
+			*pte = 0;
+			alloc.freeLargePage(first);
+			if(this == cur)
+				flushAddr(virt,true);
+			needShootdown = true;
+			virt += LARGE_PAGE_SIZE;
+			count -= LARGE_PAGE_COUNT;
+			continue;
+		}
+
 		/* remove page and free if necessary */
 		frameno_t frame = unmapPage(virt);
 		if(frame) {
@@ -267,6 +439,7 @@ int PageTables::unmap(uintptr_t virt,size_t count,Allocator &alloc) {
 
 		/* to next page */
 		virt += PAGE_SIZE;
+		count--;
 	}
 	/* check if the last changed pagetable is empty */
 	if(pti != PT_ENTRY_COUNT && (virt < KERNEL_AREA || virt >= KSTACK_AREA))
@@ -282,6 +455,8 @@ size_t PageTables::countEntries(pte_t pte,int level) const {
 		if(pt[i] & PTE_PRESENT) {
 			if(level == 1)
 				count++;
+			else if(pt[i] & PTE_LARGE)
+				count += LARGE_PAGE_COUNT;
 			else if(level > 1)
 				count += countEntries(pt[i],level - 1);
 		}
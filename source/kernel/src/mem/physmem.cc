@@ -19,6 +19,8 @@
 
 #include <esc/ipc/ipcbuf.h>
 #include <esc/util.h>
+#include <mem/cache.h>
+#include <mem/copyonwrite.h>
 #include <mem/pagedir.h>
 #include <mem/physmem.h>
 #include <mem/physmemareas.h>
@@ -26,6 +28,7 @@
 #include <mem/virtmem.h>
 #include <sys/messages.h>
 #include <task/proc.h>
+#include <task/smp.h>
 #include <task/thread.h>
 #include <vfs/openfile.h>
 #include <vfs/vfs.h>
@@ -51,9 +54,12 @@
 
 size_t PhysMem::totalMem = 0;
 
-/* the bitmap for the frames of the lowest few MB; 0 = free, 1 = used */
-tBitmap *PhysMem::bitmap;
-uintptr_t PhysMem::bitmapStart;
+/* the buddy allocator for the frames of the lowest few MB. contFree holds the first free block of
+ * each order; the blocks are linked via contFrames, indexed relative to contStart. */
+PhysMem::ContFrame *PhysMem::contFrames;
+uint16_t PhysMem::contFree[CONT_MAX_ORDER + 1];
+uintptr_t PhysMem::contStart;
+size_t PhysMem::contAlign;
 size_t PhysMem::freeCont = 0;
 SpinLock PhysMem::contLock;
 
@@ -61,10 +67,21 @@ SpinLock PhysMem::contLock;
  * TODO Currently we don't free the frames for the stack */
 PhysMem::StackFrames PhysMem::lower;
 PhysMem::StackFrames PhysMem::upper;
+/* the free blocks for large pages are kept separately, so that they aren't scattered by the frame
+ * stacks. they are broken up if the stacks run empty; frames that are free'd individually never
+ * come back, though */
+PhysMem::StackFrames PhysMem::lowerLarge;
+PhysMem::StackFrames PhysMem::upperLarge;
 SpinLock PhysMem::defLock;
 
 bool PhysMem::initialized = false;
 
+/* Every CPU has a small cache of kernel frames. The frames in it count as allocated kernel frames,
+ * so that the accounting doesn't change when moving them in or out. Since the kernel is not
+ * preemptible and runs with interrupts disabled, nobody else can use the cache of the current CPU
+ * meanwhile. */
+PhysMem::FrameCache *PhysMem::frameCaches = NULL;
+
 /* for swapping */
 size_t PhysMem::swappedOut = 0;
 size_t PhysMem::swappedIn = 0;
@@ -84,11 +101,11 @@ size_t PhysMem::jobWaiters = 0;
 
 extern void *_ebss;
 
-uintptr_t PhysMem::bitmapStartFrame() {
-	return PhysMem::bitmapStart / PAGE_SIZE;
+uintptr_t PhysMem::contStartFrame() {
+	return PhysMem::contStart / PAGE_SIZE;
 }
 uintptr_t PhysMem::lowerStart() {
-	return (bitmapStartFrame() + BITMAP_PAGE_COUNT) * PAGE_SIZE;
+	return (contStartFrame() + CONT_PAGE_COUNT) * PAGE_SIZE;
 }
 uintptr_t PhysMem::lowerEnd() {
 	return DIR_MAP_AREA_SIZE;
@@ -122,38 +139,66 @@ void PhysMem::init() {
 	for(auto mod = Boot::modsBegin(); mod != Boot::modsEnd(); ++mod)
 		PhysMemAreas::rem(mod->phys,mod->phys + mod->size);
 
-	/* first, search memory that will be managed with the bitmap */
-	const PhysMemAreas::MemArea *first = NULL;
-	for(const PhysMemAreas::MemArea *area = PhysMemAreas::get(); area != NULL; area = area->next) {
-		if(area->size >= BITMAP_PAGE_COUNT * PAGE_SIZE && (!first || area->addr < first->addr))
-			first = area;
+	/* first, search memory that will be managed with the buddy allocator. place it in the lowest
+	 * area that is large enough, as aligned as possible, so that large blocks are physically
+	 * aligned as well */
+	/* note that 0 is a valid start, so that we need a separate flag */
+	bool found = false;
+	contStart = 0;
+	contAlign = 1UL << CONT_MAX_ORDER;
+	for(; !found && contAlign > 0; contAlign >>= 1) {
+		for(const PhysMemAreas::MemArea *area = PhysMemAreas::get(); area != NULL; area = area->next) {
+			uintptr_t start = esc::Util::round_up(area->addr,contAlign * PAGE_SIZE);
+			if(start + CONT_PAGE_COUNT * PAGE_SIZE <= area->addr + area->size &&
+					(!found || start < contStart)) {
+				contStart = start;
+				found = true;
+			}
+		}
 	}
-
-	if(!first)
+	if(!found)
 		Util::panic("Unable to find an area for the contiguous memory");
-
-	/* map bitmap */
-	size_t bmFrmCnt = BYTES_2_PAGES(BITMAP_PAGE_COUNT / 8);
-	bitmap = (tBitmap*)PageDir::makeAccessible(0,bmFrmCnt);
-	/* mark all free */
-	memclear(bitmap,BITMAP_PAGE_COUNT / 8);
-	bitmapStart = first->addr;
-	freeCont = BITMAP_PAGE_COUNT;
+	/* the loop shifted once more */
+	contAlign <<= 1;
 	/* remove it from phys mem areas */
-	PhysMemAreas::rem(first->addr,first->addr + BITMAP_PAGE_COUNT * PAGE_SIZE);
+	PhysMemAreas::rem(contStart,contStart + CONT_PAGE_COUNT * PAGE_SIZE);
+
+	/* map the metadata and put the whole area into the free lists */
+	static_assert(CONT_PAGE_COUNT < CONT_NIL,"Contiguous area too large");
+	size_t metaFrmCnt = BYTES_2_PAGES(CONT_PAGE_COUNT * sizeof(ContFrame));
+	contFrames = (ContFrame*)PageDir::makeAccessible(0,metaFrmCnt);
+	for(size_t i = 0; i < CONT_PAGE_COUNT; ++i)
+		contFrames[i].order = ORDER_NONE;
+	for(size_t i = 0; i <= CONT_MAX_ORDER; ++i)
+		contFree[i] = CONT_NIL;
+	freeRange(0,CONT_PAGE_COUNT);
 
 	/* determine which of the memory areas becomes lower and which upper memory */
-	size_t lowerPages = 0,upperPages = 0;
+	size_t lowerPages = 0,upperPages = 0,lowerBlocks = 0,upperBlocks = 0;
 	for(const PhysMemAreas::MemArea *area = PhysMemAreas::get(); area != NULL; area = area->next) {
 		uintptr_t aend = area->addr + area->size;
 		if(area->addr >= lowerStart() || aend < lowerStart())
 			lowerPages += (esc::Util::min(lowerEnd(),aend) - area->addr) / PAGE_SIZE;
 		if(aend > lowerEnd())
 			upperPages += (aend - esc::Util::max(lowerEnd(),area->addr)) / PAGE_SIZE;
+
+		/* count the aligned blocks for large pages; the ones crossing lowerEnd() are not used */
+		if(PageTables::LARGE_PAGE_SIZE) {
+			uintptr_t block = esc::Util::round_up(area->addr,PageTables::LARGE_PAGE_SIZE);
+			for(; block < aend && aend - block >= PageTables::LARGE_PAGE_SIZE;
+					block += PageTables::LARGE_PAGE_SIZE) {
+				if(block + PageTables::LARGE_PAGE_SIZE <= lowerEnd())
+					lowerBlocks++;
+				else if(block >= lowerEnd())
+					upperBlocks++;
+			}
+		}
 	}
 
 	lower.pages = BYTES_2_PAGES(lowerPages * sizeof(frameno_t));
 	upper.pages = BYTES_2_PAGES(upperPages * sizeof(frameno_t));
+	lowerLarge.pages = BYTES_2_PAGES(lowerBlocks * sizeof(frameno_t));
+	upperLarge.pages = BYTES_2_PAGES(upperBlocks * sizeof(frameno_t));
 
 	/* map it so that we can access it; this will automatically remove some frames from the
 	 * available memory. */
@@ -163,12 +208,42 @@ void PhysMem::init() {
 		upper.begin = (frameno_t*)PageDir::makeAccessible(0,upper.pages);
 		upper.frames = upper.begin;
 	}
+	if(lowerLarge.pages > 0) {
+		lowerLarge.begin = (frameno_t*)PageDir::makeAccessible(0,lowerLarge.pages);
+		lowerLarge.frames = lowerLarge.begin;
+	}
+	if(upperLarge.pages > 0) {
+		upperLarge.begin = (frameno_t*)PageDir::makeAccessible(0,upperLarge.pages);
+		upperLarge.frames = upperLarge.begin;
+	}
 
-	/* now mark the remaining memory as free on stack */
+	/* the copy-on-write reference counts are indexed by frame-number; thus, cover all frames up to
+	 * the end of the highest area */
+	frameno_t frameCount = contStartFrame() + CONT_PAGE_COUNT;
 	for(const PhysMemAreas::MemArea *area = PhysMemAreas::get(); area != NULL; area = area->next)
-		markRangeUsed(area->addr,area->addr + area->size,false);
+		frameCount = esc::Util::max(frameCount,(frameno_t)((area->addr + area->size) / PAGE_SIZE));
+	CopyOnWrite::init(frameCount);
+
+	/* now mark the remaining memory as free on stack. the aligned blocks that are still completely
+	 * available (makeAccessible took some frames) go into the pools for large pages */
+	for(const PhysMemAreas::MemArea *area = PhysMemAreas::get(); area != NULL; area = area->next) {
+		uintptr_t start = area->addr;
+		uintptr_t aend = area->addr + area->size;
+		if(PageTables::LARGE_PAGE_SIZE) {
+			uintptr_t block = esc::Util::round_up(start,PageTables::LARGE_PAGE_SIZE);
+			for(; block < aend && aend - block >= PageTables::LARGE_PAGE_SIZE;
+					block += PageTables::LARGE_PAGE_SIZE) {
+				if(block + PageTables::LARGE_PAGE_SIZE <= lowerEnd() || block >= lowerEnd()) {
+					markRangeUsed(start,block,false);
+					pushLarge(block / PAGE_SIZE);
+					start = block + PageTables::LARGE_PAGE_SIZE;
+				}
+			}
+		}
+		markRangeUsed(start,aend,false);
+	}
 
-	/* stack and bitmap is ready */
+	/* stack and buddy allocator are ready */
 	initialized = true;
 
 	/* determine kernel-memory-size */
@@ -194,53 +269,67 @@ void PhysMem::init() {
 	}
 }
 
+void PhysMem::initCaches() {
+	/* zero'd memory means empty caches */
+	FrameCache *fcs = (FrameCache*)Cache::calloc(SMP::getCPUCount(),sizeof(FrameCache));
+	if(!fcs)
+		Util::panic("Unable to allocate frame caches");
+	frameCaches = fcs;
+}
+
 size_t PhysMem::getFreeFrames(uint types) {
 	/* no lock; just intended for debugging and information */
 	size_t count = 0;
 	if(types & CONT)
 		count += freeCont;
-	if(types & DEF)
+	if(types & DEF) {
 		count += getFreeDef();
+		/* the frames in the caches are free as well */
+		if(frameCaches) {
+			for(size_t i = 0; i < SMP::getCPUCount(); ++i)
+				count += frameCaches[i].count;
+		}
+	}
 	return count;
 }
 
 ssize_t PhysMem::allocateContiguous(size_t count,size_t align) {
-	LockGuard<SpinLock> g(&contLock);
-	size_t c = 0;
-	/* align in physical memory */
-	size_t i = esc::Util::round_up(bitmapStartFrame(),align);
-	i -= bitmapStartFrame();
-	for(; i < BITMAP_PAGE_COUNT; ) {
-		/* walk forward until we find an occupied frame */
-		size_t j = i;
-		for(c = 0; c < count; j++,c++) {
-			tBitmap dword = bitmap[j / BITS_PER_BMWORD];
-			tBitmap bit = (BITS_PER_BMWORD - 1) - (j % BITS_PER_BMWORD);
-			if(dword & (1UL << bit))
-				break;
-		}
-		/* found enough? */
-		if(c == count)
-			break;
-		/* ok, to next aligned frame */
-		i = esc::Util::round_up(bitmapStartFrame() + j + 1,align);
-		i -= bitmapStartFrame();
-	}
+	if(count == 0)
+		return -EINVAL;
+	if(align == 0)
+		align = 1;
+
+	/* a block of order X is aligned to min(2^X,contAlign) in physical memory. thus, if that is
+	 * sufficient, simply use a block that is at least as large as the alignment. otherwise, take
+	 * a block that is large enough to contain an aligned range of <count> frames */
+	size_t order;
+	if(align <= contAlign)
+		order = esc::Util::max(getOrder(count),getOrder(align));
+	else
+		order = getOrder(count + align - 1);
+	if(order > CONT_MAX_ORDER)
+		return -ENOMEM;
 
-	if(c != count)
+	LockGuard<SpinLock> g(&contLock);
+	ssize_t block = allocBlock(order);
+	if(block < 0)
 		return -ENOMEM;
 
-	/* the bitmap starts managing the memory at itself */
-	i += bitmapStartFrame();
-	doMarkRangeUsed(i * PAGE_SIZE,(i + count) * PAGE_SIZE,true);
-	printAllocFree("[AC] %x:%zu ",i,count);
-	return i;
+	/* give the unused head and tail back */
+	size_t first = esc::Util::round_up(contStartFrame() + block,align) - contStartFrame();
+	freeRange(block,first);
+	freeRange(first + count,block + (1UL << order));
+
+	first += contStartFrame();
+	printAllocFree("[AC] %x:%zu ",first,count);
+	return first;
 }
 
 void PhysMem::freeContiguous(frameno_t first,size_t count) {
 	LockGuard<SpinLock> g(&contLock);
 	printAllocFree("[FC] %x:%zu ",first,count);
-	doMarkRangeUsed(first * PAGE_SIZE,(first + count) * PAGE_SIZE,false);
+	assert(first >= contStartFrame() && first + count <= contStartFrame() + CONT_PAGE_COUNT);
+	freeRange(first - contStartFrame(),first - contStartFrame() + count);
 }
 
 bool PhysMem::reserve(size_t frameCount,bool swap) {
@@ -279,14 +368,71 @@ bool PhysMem::reserve(size_t frameCount,bool swap) {
 
 frameno_t PhysMem::allocFrame(bool forceLower) {
 	/* prefer lower pages */
-	if(!forceLower && (size_t)(lower.frames - lower.begin) <= kframes) {
-		if(upper.frames == upper.begin)
-			return PhysMem::INVALID_FRAME;
+	if(!forceLower && getFreeLower() <= kframes) {
+		if(upper.frames == upper.begin) {
+			if(upperLarge.frames == upperLarge.begin)
+				return PhysMem::INVALID_FRAME;
+			breakLarge(&upperLarge);
+		}
 		return *(--upper.frames);
 	}
+	/* break up a large block if there are no single frames left */
+	if(lower.frames == lower.begin && lowerLarge.frames != lowerLarge.begin)
+		breakLarge(&lowerLarge);
 	return *(--lower.frames);
 }
 
+size_t PhysMem::getFreeLower() {
+	return (lower.frames - lower.begin) +
+		(lowerLarge.frames - lowerLarge.begin) * PageTables::LARGE_PAGE_COUNT;
+}
+
+void PhysMem::breakLarge(StackFrames *pool) {
+	frameno_t first = *(--pool->frames);
+	/* push them in reverse order to hand them out in ascending order */
+	for(size_t i = PageTables::LARGE_PAGE_COUNT; i-- > 0; )
+		freeFrame(first + i);
+}
+
+void PhysMem::pushLarge(frameno_t first) {
+	assert((first % PageTables::LARGE_PAGE_COUNT) == 0);
+	StackFrames *pool = &upperLarge;
+	if((first + PageTables::LARGE_PAGE_COUNT) * PAGE_SIZE <= lowerEnd())
+		pool = &lowerLarge;
+	if(pool->frames >= pool->begin + pool->pages * PAGE_SIZE / sizeof(frameno_t))
+		Util::panic("MM-Stack (large) too small for physical memory!");
+	*(pool->frames++) = first;
+}
+
+frameno_t PhysMem::allocateLarge() {
+	if(!PageTables::LARGE_PAGE_SIZE || !initialized)
+		return PhysMem::INVALID_FRAME;
+
+	LockGuard<SpinLock> g(&defLock);
+	/* don't take the frames that are needed for the kernel or that have been reserved */
+	size_t free = getFreeDef();
+	if(free < PageTables::LARGE_PAGE_COUNT + kframes + cframes + uframes)
+		return PhysMem::INVALID_FRAME;
+
+	/* prefer upper memory, because the lower memory is needed for kernel frames */
+	frameno_t first;
+	if(upperLarge.frames != upperLarge.begin)
+		first = *(--upperLarge.frames);
+	else if(lowerLarge.frames != lowerLarge.begin &&
+			getFreeLower() >= kframes + PageTables::LARGE_PAGE_COUNT)
+		first = *(--lowerLarge.frames);
+	else
+		return PhysMem::INVALID_FRAME;
+	printAllocFree("[AL] %x %zu ",first,PageTables::LARGE_PAGE_COUNT);
+	return first;
+}
+
+void PhysMem::freeLarge(frameno_t first) {
+	LockGuard<SpinLock> g(&defLock);
+	printAllocFree("[FL] %x %zu ",first,PageTables::LARGE_PAGE_COUNT);
+	pushLarge(first);
+}
+
 void PhysMem::freeFrame(frameno_t frame) {
 	if(frame * PAGE_SIZE < lowerEnd()) {
 		if(lower.frames >= lower.begin + lower.pages * PAGE_SIZE)
@@ -300,8 +446,45 @@ void PhysMem::freeFrame(frameno_t frame) {
 	}
 }
 
+PhysMem::FrameCache *PhysMem::getFrameCache() {
+	if(EXPECT_FALSE(!frameCaches))
+		return NULL;
+	return frameCaches + SMP::getCurId();
+}
+
 frameno_t PhysMem::allocate(FrameType type) {
+	/* kernel frames are served from the frame cache of the current CPU, if possible */
+	FrameCache *fc;
+	if(type == KERN && EXPECT_TRUE((fc = getFrameCache()) != NULL)) {
+		if(EXPECT_FALSE(fc->count == 0)) {
+			fc->count = allocate(KERN,FCACHE_BATCH,fc->frames);
+			if(fc->count == 0)
+				return PhysMem::INVALID_FRAME;
+		}
+		frameno_t frame = fc->frames[--fc->count];
+		printAllocFree("[A] %x 1 ",frame);
+		return frame;
+	}
+
 	LockGuard<SpinLock> g(&defLock);
+	frameno_t frame = doAllocate(type);
+	printAllocFree("[A] %x 1 ",frame);
+	return frame;
+}
+
+size_t PhysMem::allocate(FrameType type,size_t count,frameno_t *frames) {
+	LockGuard<SpinLock> g(&defLock);
+	size_t i;
+	for(i = 0; i < count; ++i) {
+		frames[i] = doAllocate(type);
+		if(frames[i] == PhysMem::INVALID_FRAME)
+			break;
+		printAllocFree("[A] %x 1 ",frames[i]);
+	}
+	return i;
+}
+
+frameno_t PhysMem::doAllocate(FrameType type) {
 	/* remove the memory from the available one when we're not yet initialized */
 	frameno_t frame = PhysMem::INVALID_FRAME;
 	if(!initialized)
@@ -323,7 +506,7 @@ frameno_t PhysMem::allocate(FrameType type) {
 			case KERN:
 				/* if there are no kframes anymore, take away a few uframes */
 				if(kframes == 0) {
-					size_t free = lower.frames - lower.begin;
+					size_t free = getFreeLower();
 					kframes = (free - cframes) / (100 / KERNEL_MEM_PERCENT);
 				}
 				if(kframes > 0) {
@@ -341,13 +524,36 @@ frameno_t PhysMem::allocate(FrameType type) {
 				break;
 		}
 	}
-	printAllocFree("[A] %x 1 ",frame);
 	return frame;
 }
 
 void PhysMem::free(frameno_t frame,FrameType type) {
+	FrameCache *fc;
+	if(type == KERN && EXPECT_TRUE((fc = getFrameCache()) != NULL)) {
+		printAllocFree("[F] %x 1 ",frame);
+		/* if the cache is full, give a batch back */
+		if(EXPECT_FALSE(fc->count == FCACHE_SIZE)) {
+			free(fc->frames + FCACHE_BATCH,FCACHE_SIZE - FCACHE_BATCH,KERN);
+			fc->count = FCACHE_BATCH;
+		}
+		fc->frames[fc->count++] = frame;
+		return;
+	}
+
 	LockGuard<SpinLock> g(&defLock);
 	printAllocFree("[F] %x 1 ",frame);
+	doFree(frame,type);
+}
+
+void PhysMem::free(const frameno_t *frames,size_t count,FrameType type) {
+	LockGuard<SpinLock> g(&defLock);
+	for(size_t i = 0; i < count; ++i) {
+		printAllocFree("[F] %x 1 ",frames[i]);
+		doFree(frames[i],type);
+	}
+}
+
+void PhysMem::doFree(frameno_t frame,FrameType type) {
 	if(type == CRIT)
 		cframes++;
 	else if(type == KERN)
@@ -411,7 +617,7 @@ void PhysMem::swapper() {
 			goto error;
 		}
 
-		Timer::sleepFor(swapperThread->getTid(),10,true);
+		Timer::sleepFor(swapperThread->getTid(),10000,true);
 		Thread::switchAway();
 	}
 
@@ -492,6 +698,14 @@ void PhysMem::print(OStream &os) {
 	const char *dev = Config::getStr(Config::SWAP_DEVICE);
 	os.writef("Default: %zu\n",getFreeDef());
 	os.writef("Contiguous: %zu\n",freeCont);
+	os.writef("Large blocks: %zu\n",(lowerLarge.frames - lowerLarge.begin) +
+		(upperLarge.frames - upperLarge.begin));
+	if(frameCaches) {
+		size_t cached = 0;
+		for(size_t i = 0; i < SMP::getCPUCount(); ++i)
+			cached += frameCaches[i].count;
+		os.writef("Cached: %zu\n",cached);
+	}
 	os.writef("Swap-Device: %s\n",dev ? dev : "-none-");
 	os.writef("Swap enabled: %d\n",swapEnabled);
 	os.writef("CFrames: %zu\n",cframes);
@@ -513,7 +727,9 @@ void PhysMem::printStack(OStream &os) {
 		StackFrames *obj;
 	} stacks[] = {
 		{"Lower",&lower},
-		{"Upper",&upper}
+		{"Upper",&upper},
+		{"Lower large",&lowerLarge},
+		{"Upper large",&upperLarge}
 	};
 
 	for(size_t i = 0; i < ARRAY_SIZE(stacks); ++i) {
@@ -531,16 +747,25 @@ void PhysMem::printStack(OStream &os) {
 }
 
 void PhysMem::printCont(OStream &os) {
-	os.writef("Bitmap: (frame numbers)\n");
-	size_t pos = bitmapStart;
-	for(size_t i = 0; i < BITMAP_PAGE_COUNT / BITS_PER_BMWORD; i++) {
-		os.writef("0x%08Px..: %0*lb\n",pos / PAGE_SIZE,sizeof(tBitmap) * 8,bitmap[i]);
-		pos += PAGE_SIZE * BITS_PER_BMWORD;
+	LockGuard<SpinLock> g(&contLock);
+	os.writef("Area: 0x%08Px .. 0x%08Px (aligned to %zu frames)\n",
+		contStartFrame(),contStartFrame() + CONT_PAGE_COUNT - 1,contAlign);
+	for(size_t o = 0; o <= CONT_MAX_ORDER; ++o) {
+		os.writef("Order %2zu: (frame numbers)\n",o);
+		size_t j = 0;
+		for(uint16_t idx = contFree[o]; idx != CONT_NIL; idx = contFrames[idx].next, ++j) {
+			os.writef("0x%08Px, ",contStartFrame() + idx);
+			if(j % 6 == 5)
+				os.writef("\n");
+		}
+		os.writef("\n");
 	}
 }
 
 size_t PhysMem::getFreeDef() {
-	return (lower.frames - lower.begin) + (upper.frames - upper.begin);
+	size_t blocks = (lowerLarge.frames - lowerLarge.begin) + (upperLarge.frames - upperLarge.begin);
+	return (lower.frames - lower.begin) + (upper.frames - upper.begin) +
+		blocks * PageTables::LARGE_PAGE_COUNT;
 }
 
 void PhysMem::markRangeUsed(uintptr_t from,uintptr_t to,bool used) {
@@ -555,33 +780,94 @@ void PhysMem::doMarkRangeUsed(uintptr_t from,uintptr_t to,bool used) {
 }
 
 void PhysMem::markUsed(frameno_t frame,bool used) {
-	/* ignore the stuff before; we don't manage it */
-	if(frame < bitmapStartFrame())
+	/* we don't mark frames as used since this function is just used for initializing the
+	 * memory-management and for freeing frames */
+	if(used)
 		return;
-	/* we use a bitmap for the lowest few MB */
-	if(frame < bitmapStartFrame() + BITMAP_PAGE_COUNT) {
-		tBitmap bit,*bitmapEntry;
-		/* the bitmap starts managing the memory at itself */
-		frame -= bitmapStartFrame();
-		bitmapEntry = (tBitmap*)(bitmap + (frame / BITS_PER_BMWORD));
-		bit = (BITS_PER_BMWORD - 1) - (frame % BITS_PER_BMWORD);
-		if(used) {
-			*bitmapEntry = *bitmapEntry | (1UL << bit);
-			assert(freeCont > 0);
-			freeCont--;
-		}
-		else {
-			*bitmapEntry = *bitmapEntry & ~(1UL << bit);
-			freeCont++;
-		}
+
+	/* the lowest few MB are managed by the buddy allocator */
+	if(frame >= contStartFrame() && frame < contStartFrame() + CONT_PAGE_COUNT) {
+		LockGuard<SpinLock> g(&contLock);
+		frame -= contStartFrame();
+		freeRange(frame,frame + 1);
 	}
-	/* use a stack for the remaining memory */
-	else {
-		/* we don't mark frames as used since this function is just used for initializing the
-		 * memory-management */
-		if(!used)
-			freeFrame(frame);
+	/* use a stack for the remaining memory (the memory before the area is managed by it as well) */
+	else
+		freeFrame(frame);
+}
+
+size_t PhysMem::getOrder(size_t count) {
+	size_t order = 0;
+	while((1UL << order) < count)
+		order++;
+	return order;
+}
+
+ssize_t PhysMem::allocBlock(size_t order) {
+	/* find the smallest free block that is large enough */
+	size_t o = order;
+	while(o <= CONT_MAX_ORDER && contFree[o] == CONT_NIL)
+		o++;
+	if(o > CONT_MAX_ORDER)
+		return -ENOMEM;
+
+	size_t idx = contFree[o];
+	remFree(idx,o);
+	/* split it until it has the desired size; the upper halves become free */
+	while(o > order) {
+		o--;
+		addFree(idx + (1UL << o),o);
 	}
+	freeCont -= 1UL << order;
+	return idx;
+}
+
+void PhysMem::freeBlock(size_t idx,size_t order) {
+	assert(contFrames[idx].order == ORDER_NONE);
+	freeCont += 1UL << order;
+	/* merge it with its buddy as long as that is free as well */
+	while(order < CONT_MAX_ORDER) {
+		size_t buddy = idx ^ (1UL << order);
+		if(buddy >= CONT_PAGE_COUNT || contFrames[buddy].order != order)
+			break;
+		remFree(buddy,order);
+		idx = esc::Util::min(idx,buddy);
+		order++;
+	}
+	addFree(idx,order);
+}
+
+void PhysMem::freeRange(size_t from,size_t to) {
+	/* free the range in the largest naturally aligned blocks possible */
+	while(from < to) {
+		size_t order = 0;
+		while(order < CONT_MAX_ORDER && (from & ((2UL << order) - 1)) == 0 &&
+				from + (2UL << order) <= to)
+			order++;
+		freeBlock(from,order);
+		from += 1UL << order;
+	}
+}
+
+void PhysMem::addFree(size_t idx,size_t order) {
+	ContFrame *f = contFrames + idx;
+	f->order = order;
+	f->prev = CONT_NIL;
+	f->next = contFree[order];
+	if(f->next != CONT_NIL)
+		contFrames[f->next].prev = idx;
+	contFree[order] = idx;
+}
+
+void PhysMem::remFree(size_t idx,size_t order) {
+	ContFrame *f = contFrames + idx;
+	if(f->prev != CONT_NIL)
+		contFrames[f->prev].next = f->next;
+	else
+		contFree[order] = f->next;
+	if(f->next != CONT_NIL)
+		contFrames[f->next].prev = f->prev;
+	f->order = ORDER_NONE;
 }
 
 void PhysMem::appendJob(SwapInJob *job) {
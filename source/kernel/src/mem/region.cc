@@ -54,13 +54,13 @@
 Region::Region(OpenFile *f,size_t bCount,size_t lCount,size_t off,ulong pgFlags,
                ulong _flags,bool &success)
 		: flags(_flags), file(f), offset(off), loadCount(lCount), byteCount(bCount),
-		  timestamp(0), pfSize(), pageFlags(), vms(), lock() {
+		  clockPos(0), pfSize(), pageFlags(), vms(), lock() {
 	init(pgFlags,success);
 }
 
 Region::Region(const Region &reg,VirtMem *vm,bool &success)
 		: flags(reg.flags), file(reg.file), offset(reg.offset), loadCount(reg.loadCount),
-		  byteCount(reg.byteCount), timestamp(0), pfSize(), pageFlags(), vms(), lock() {
+		  byteCount(reg.byteCount), clockPos(0), pfSize(), pageFlags(), vms(), lock() {
 	assert(!(flags & RF_SHAREABLE));
 	init(-1,success);
 	if(!success)
@@ -191,7 +191,7 @@ void Region::print(OStream &os,uintptr_t virt) const {
 		file->print(os);
 		os.writef("\n");
 	}
-	os.writef("\tTimestamp: %Lu\n",timestamp);
+	os.writef("\tClock position: %zu\n",clockPos);
 	os.writef("\tProcesses: ");
 	for(auto it = vms.cbegin(); it != vms.cend(); ++it)
 		os.writef("%d ",(*it)->getProc()->getPid());
@@ -48,6 +48,10 @@
  */
 
 #define DEBUG_SWAP			0
+/* the number of frames to free at once when unmapping a region */
+#define FREE_BATCH			32
+/* the max. number of pages to swap out at once */
+#define SWAP_BATCH			16
 
 static uint8_t buffer[PAGE_SIZE];
 
@@ -72,7 +76,13 @@ uintptr_t VirtMem::mapphys(uintptr_t *phys,size_t bCount,size_t align,int flags)
 	uint mapflags = MAP_NOMAP;
 	if(!(flags & MAP_PHYS_MAP)) {
 		if(align) {
-			ssize_t first = PhysMem::allocateContiguous(pages,align / PAGE_SIZE);
+			ssize_t first = -ENOMEM;
+			/* try to get memory that can be mapped with large pages first */
+			size_t large = PageTables::LARGE_PAGE_COUNT;
+			if(PageTables::LARGE_PAGE_SIZE && pages >= large && align < PageTables::LARGE_PAGE_SIZE)
+				first = PhysMem::allocateContiguous(pages,large);
+			if(first < 0)
+				first = PhysMem::allocateContiguous(pages,align / PAGE_SIZE);
 			if(first < 0)
 				return first;
 			firstFrame = first;
@@ -203,7 +213,7 @@ int VirtMem::map(uintptr_t *addr,size_t length,size_t loadCount,int prot,int fla
 		if(rflags & MAP_STACK)
 			virt = findFreeStack(length,rflags);
 		else
-			virt = freemap.allocate(esc::Util::round_page_up(length));
+			virt = findFreeArea(length);
 		if(virt == 0)
 			goto errProc;
 	}
@@ -272,7 +282,6 @@ errProc:
 int VirtMem::protect(uintptr_t addr,ulong flags) {
 	size_t pgcount;
 	int res = -EPERM;
-	PageTables::NoAllocator alloc;
 	acquire();
 	VMRegion *vmreg = regtree.getByAddr(addr);
 	if(vmreg == NULL) {
@@ -296,21 +305,36 @@ int VirtMem::protect(uintptr_t addr,ulong flags) {
 
 	/* change mapping */
 	for(auto mp = vmreg->reg->vmbegin(); mp != vmreg->reg->vmend(); ++mp) {
+		PageTables::NoAllocator alloc;
 		/* the region may be mapped to a different virtual address */
 		VMRegion *mpreg = (*mp)->regtree.getByReg(vmreg->reg);
 		assert(mpreg != NULL);
-		for(size_t i = 0; i < pgcount; i++) {
+		/* do only one TLB-shootdown for the whole region */
+		(*mp)->getPageDir()->beginBatch();
+		res = 0;
+		for(size_t i = 0; res == 0 && i < pgcount; ) {
 			/* determine flags; we can't always mark it present.. */
-			uint mapFlags = 0;
-			if(!(vmreg->reg->getPageFlags(i) & (PF_DEMANDLOAD | PF_SWAPPED)))
-				mapFlags |= PG_PRESENT;
+			bool present = !(vmreg->reg->getPageFlags(i) & (PF_DEMANDLOAD | PF_SWAPPED));
+			uint mapFlags = present ? PG_PRESENT : 0;
 			if(flags & RF_EXECUTABLE)
 				mapFlags |= PG_EXECUTABLE;
 			if(flags & RF_WRITABLE)
 				mapFlags |= PG_WRITABLE;
-			/* can't fail because of NoAllocator and because the page-table is always present */
-			sassert((*mp)->getPageDir()->map(mpreg->virt() + i * PAGE_SIZE,1,alloc,mapFlags) == 0);
+			/* change all following pages with the same flags at once to keep large pages */
+			size_t count = 1;
+			for(; i + count < pgcount; ++count) {
+				uint pflags = vmreg->reg->getPageFlags(i + count);
+				if(present != !(pflags & (PF_DEMANDLOAD | PF_SWAPPED)))
+					break;
+			}
+			/* fails if a large page needs to be split and there is no frame for the page-table */
+			res = (*mp)->getPageDir()->map(mpreg->virt() + i * PAGE_SIZE,count,alloc,mapFlags);
+			i += count;
 		}
+		(*mp)->getPageDir()->endBatch();
+		(*mp)->addOwn(alloc.pageTables());
+		if(res < 0)
+			goto error;
 	}
 	res = 0;
 
@@ -344,6 +368,36 @@ int VirtMem::lockall() {
 	return res;
 }
 
+int VirtMem::getPhysAddrs(uintptr_t addr,uintptr_t *phys,size_t count) {
+	int res = 0;
+	acquire();
+	VMRegion *vm = regtree.getByAddr(addr);
+	if(vm == NULL) {
+		release();
+		return -ENXIO;
+	}
+
+	vm->reg->acquire();
+	size_t first = (addr - vm->virt()) / PAGE_SIZE;
+	if(!(vm->reg->getFlags() & RF_LOCKED))
+		res = -EINVAL;
+	else if(first + count < first || first + count > BYTES_2_PAGES(vm->reg->getByteCount()))
+		res = -EINVAL;
+	else {
+		for(size_t i = 0; i < count; ++i) {
+			/* a copy-on-write page would be replaced on the next write */
+			if(vm->reg->getPageFlags(first + i) & PF_COPYONWRITE) {
+				res = -EBUSY;
+				break;
+			}
+			phys[i] = getPageDir()->getFrameNo(addr + i * PAGE_SIZE) * PAGE_SIZE;
+		}
+	}
+	vm->reg->release();
+	release();
+	return res;
+}
+
 int VirtMem::lockRegion(VMRegion *vm,int flags) {
 	Thread *t = Thread::getRunning();
 	int res = 0;
@@ -391,56 +445,64 @@ int VirtMem::populatePages(VMRegion *vm,size_t count) {
 
 void VirtMem::swapOut(OpenFile *file,size_t count) {
 	while(count > 0) {
-		Region *reg = getLRURegion();
+		size_t indices[SWAP_BATCH];
+		frameno_t frames[SWAP_BATCH];
+		ulong blocks[SWAP_BATCH];
+		size_t num;
+		Region *reg = getSwapVictims(indices,esc::Util::min(count,static_cast<size_t>(SWAP_BATCH)),&num);
 		if(reg == NULL)
 			Util::panic("No pages to swap out");
 
-		/* the list of processes may have changed in the meantime; we can't swap out in this case */
-		while(count > 0) {
-			/* get page to swap out */
-			ssize_t index = getPgIdxForSwap(reg);
-			if(index < 0)
-				break;
-
-			/* get VM-region of first process */
-			VirtMem *vm = *reg->vmbegin();
-			VMRegion *vmreg = vm->regtree.getByReg(reg);
+		/* get VM-region of first process */
+		VirtMem *vm = *reg->vmbegin();
+		VMRegion *vmreg = vm->regtree.getByReg(reg);
 
+		size_t done = 0;
+		for(size_t i = 0; i < num; ++i) {
 			/* find swap-block */
-			ulong block = SwapMap::alloc();
-			assert(block != SwapMap::INVALID);
+			blocks[done] = SwapMap::alloc();
+			assert(blocks[done] != SwapMap::INVALID);
 
 			/* get the frame first, because the page has to be present */
-			frameno_t frameNo = vm->getPageDir()->getFrameNo(vmreg->virt() + index * PAGE_SIZE);
+			frames[done] = vm->getPageDir()->getFrameNo(vmreg->virt() + indices[i] * PAGE_SIZE);
 
 #if DEBUG_SWAP
-			Log::get().writef("OUT: %d of region %x (frame %#x, block %d)\n",index,vmreg->reg,frameNo,block);
+			Log::get().writef("OUT: %d of region %x (frame %#x, block %d)\n",
+				indices[i],vmreg->reg,frames[done],blocks[done]);
 			for(auto mp = reg->vmbegin(); mp != reg->vmend(); ++mp) {
 				VMRegion *mpreg = (*mp)->regtree.getByReg(reg);
 				Log::get().writef("\tProcess %d:%s -> page %p\n",(*mp)->getProc()->getPid(),
-						(*mp)->getProc()->getProgram(),mpreg->virt() + index * PAGE_SIZE);
+						(*mp)->getProc()->getProgram(),mpreg->virt() + indices[i] * PAGE_SIZE);
 			}
 			Log::get().writef("\n");
 #endif
 
-			/* unmap the page in all processes and ensure that all CPUs have flushed their TLB */
-			/* this way we know that nobody can still access the page; if someone tries, he will
-			 * cause a page-fault and will wait until we release the region-mutex */
-			setSwappedOut(reg,index);
-			reg->setSwapBlock(index,block);
-			SMP::ensureTLBFlushed();
+			/* unmap the page in all processes. if a large page can't be split, keep it */
+			if(!setSwappedOut(reg,indices[i],frames[done])) {
+				SwapMap::free(blocks[done]);
+				continue;
+			}
+			reg->setSwapBlock(indices[i],blocks[done]);
+			done++;
+		}
+
+		/* ensure that all CPUs have flushed their TLB; once for the whole batch. this way we know
+		 * that nobody can still access the pages; if someone tries, he will cause a page-fault and
+		 * will wait until we release the region-mutex */
+		SMP::ensureTLBFlushed();
 
+		for(size_t i = 0; i < done; ++i) {
 			/* copy to a temporary buffer because we can't use the temp-area when switching threads */
-			PageDir::copyFromFrame(frameNo,buffer);
-			PhysMem::free(frameNo,PhysMem::USR);
+			PageDir::copyFromFrame(frames[i],buffer);
 
 			/* write out on disk */
-			sassert(file->seek(block * PAGE_SIZE,SEEK_SET) >= 0);
+			sassert(file->seek(blocks[i] * PAGE_SIZE,SEEK_SET) >= 0);
 			sassert(file->write(buffer,PAGE_SIZE) == PAGE_SIZE);
-
-			count--;
 		}
+		PhysMem::free(frames,done,PhysMem::USR);
+
 		reg->release();
+		count -= num;
 	}
 }
 
@@ -484,24 +546,6 @@ bool VirtMem::swapIn(OpenFile *file,Thread *t,uintptr_t addr) {
 	return true;
 }
 
-void VirtMem::setTimestamp(Thread *t,uint64_t timestamp) {
-	/* ignore setting the timestamp if the process is currently locked; its not that critical and
-	 * we can't wait for the mutex here because this is called from Thread::switchAway() and the wait
-	 * for the mutex would call that as well */
-	VirtMem *vm = t->getProc()->getVM();
-	if(vm->tryAquire()) {
-		for(size_t i = 0; i < STACK_REG_COUNT; i++) {
-			if(t->getStackRegion(i))
-				t->getStackRegion(i)->reg->setTimestamp(timestamp);
-		}
-		for(auto reg = vm->regtree.begin(); reg != vm->regtree.end(); ++reg) {
-			if(!(reg->reg->getFlags() & RF_STACK))
-				reg->reg->setTimestamp(timestamp);
-		}
-		vm->release();
-	}
-}
-
 size_t VirtMem::getMemUsage(size_t *pages) const {
 	size_t rpages = 0;
 	*pages = 0;
@@ -574,19 +618,26 @@ int VirtMem::doPagefault(uintptr_t addr,VMRegion *vm,bool write) {
 	ulong flags = vm->reg->getPageFlags(page);
 	addr &= ~(PAGE_SIZE - 1);
 	if(flags & PF_DEMANDLOAD) {
-		res = demandLoad(vm,addr);
-		if(res == 0)
-			vm->reg->setPageFlags(page,flags & ~PF_DEMANDLOAD);
+		/* load the complete large page around it at once, if possible */
+		res = demandLoadLarge(vm,addr);
+		if(res == -ENOTSUP) {
+			res = demandLoad(vm,addr);
+			if(res == 0)
+				vm->reg->setPageFlags(page,flags & ~PF_DEMANDLOAD);
+		}
 	}
 	else if(flags & PF_SWAPPED)
 		res = PhysMem::swapIn(addr);
 	else if(flags & PF_COPYONWRITE) {
 		frameno_t frameNumber = getPageDir()->getFrameNo(addr);
-		size_t frmCount = CopyOnWrite::pagefault(addr,frameNumber);
-		addOwn(frmCount);
-		addShared(-frmCount);
-		vm->reg->setPageFlags(page,flags & ~PF_COPYONWRITE);
-		res = 0;
+		res = CopyOnWrite::pagefault(addr,frameNumber);
+		if(res >= 0) {
+			/* the frame is ours now; the page-table of a split large page as well */
+			addOwn(1 + res);
+			addShared(-1);
+			vm->reg->setPageFlags(page,flags & ~PF_COPYONWRITE);
+			res = 0;
+		}
 	}
 	else {
 		vassert(flags == 0,"Flags: %x",flags);
@@ -602,11 +653,14 @@ int VirtMem::doPagefault(uintptr_t addr,VMRegion *vm,bool write) {
 
 void VirtMem::unmapAll(bool remStack) {
 	acquire();
+	/* collect the TLB-shootdowns of all regions */
+	getPageDir()->beginBatch();
 	for(auto vm = regtree.begin(); vm != regtree.end(); ) {
 		auto old = vm++;
 		if((!(old->reg->getFlags() & RF_STACK) || remStack))
 			doUnmap(&*old);
 	}
+	getPageDir()->endBatch();
 	release();
 }
 
@@ -668,9 +722,30 @@ void VirtMem::doUnmap(VMRegion *vm) {
 		/* first, write the content of the memory back to the file, if necessary */
 		sync(vm);
 		/* remove us from cow and unmap the pages (and free frames, if necessary) */
+		frameno_t frames[FREE_BATCH];
+		size_t fcount = 0;
 		for(size_t i = 0; i < pcount; i++) {
 			bool freeFrame = !(vm->reg->getFlags() & RF_NOFREE);
 			frameno_t frameNo = 0;
+
+			/* give complete large pages back at once, unless parts of them are shared via cow */
+			const size_t large = PageTables::LARGE_PAGE_COUNT;
+			if(freeFrame && PageTables::LARGE_PAGE_SIZE && pcount - i >= large &&
+					(virt & (PageTables::LARGE_PAGE_SIZE - 1)) == 0 && getPageDir()->isLargePage(virt)) {
+				size_t j = 0;
+				while(j < large && !(vm->reg->getPageFlags(i + j) & PF_COPYONWRITE))
+					j++;
+				if(j == large) {
+					PhysMem::freeLarge(getPageDir()->getFrameNo(virt));
+					if(vm->reg->getFlags() & RF_SHAREABLE)
+						addShared(-large);
+					else
+						addOwn(-large);
+					i += large - 1;
+					virt += PageTables::LARGE_PAGE_SIZE;
+					continue;
+				}
+			}
 			if(vm->reg->getPageFlags(i) & PF_COPYONWRITE) {
 				bool foundOther;
 				frameNo = getPageDir()->getFrameNo(virt);
@@ -685,7 +760,12 @@ void VirtMem::doUnmap(VMRegion *vm) {
 				if(freeFrame) {
 					if(frameNo == 0)
 						frameNo = getPageDir()->getFrameNo(virt);
-					PhysMem::free(frameNo,PhysMem::USR);
+					/* free them in batches to reduce the lock round-trips */
+					frames[fcount++] = frameNo;
+					if(fcount == FREE_BATCH) {
+						PhysMem::free(frames,fcount,PhysMem::USR);
+						fcount = 0;
+					}
 				}
 
 				if(vm->reg->getFlags() & (RF_NOFREE | RF_SHAREABLE))
@@ -696,10 +776,12 @@ void VirtMem::doUnmap(VMRegion *vm) {
 
 			virt += PAGE_SIZE;
 		}
+		if(fcount > 0)
+			PhysMem::free(frames,fcount,PhysMem::USR);
 
 		/* now unmap it (do it here to prevent multiple calls for it (locking, ...) */
 		getPageDir()->unmap(vm->virt(),pcount,alloc);
-		addOwn(-alloc.pageTables());
+		addOwn(alloc.pageTables());
 
 		/* store next free stack-address, if its a stack */
 		if(vm->virt() + vm->reg->getByteCount() > freeStackAddr && (vm->reg->getFlags() & RF_STACK))
@@ -727,7 +809,7 @@ void VirtMem::doUnmap(VMRegion *vm) {
 		/* so we have to substract the present content-frames from the shared ones,
 		 * and the ptables from ours */
 		addShared(-vm->reg->pageCount(&sw,&cow));
-		addOwn(-alloc.pageTables());
+		addOwn(alloc.pageTables());
 		addSwap(-sw);
 		/* remove from shared tree */
 		if(vm->reg->getFlags() & RF_SHAREABLE)
@@ -785,7 +867,7 @@ int VirtMem::join(uintptr_t srcAddr,VirtMem *dst,VMRegion **nvm,uintptr_t *dstAd
 
 	addr = dstAddr ? *dstAddr : 0;
 	if(addr == 0 || (~flags & MAP_FIXED))
-		addr = dst->freemap.allocate(esc::Util::round_page_up(vm->reg->getByteCount()));
+		addr = dst->findFreeArea(vm->reg->getByteCount());
 	else if(dst->regtree.getByAddr(addr) != NULL)
 		goto errRel;
 	if(addr == 0)
@@ -1079,14 +1161,30 @@ size_t VirtMem::doGrow(VMRegion *vm,ssize_t amount) {
 				}
 			}
 		}
+		/* when shrinking, remove the pages first, because that fails if a large page can't be split */
+		uintptr_t virt;
+		if(amount < 0) {
+			if(vm->reg->getByteCount() < (size_t)-amount * PAGE_SIZE) {
+				vm->reg->release();
+				return 0;
+			}
+			if(vm->reg->getFlags() & RF_GROWS_DOWN)
+				virt = oldVirt;
+			else
+				virt = oldVirt + esc::Util::round_page_up(oldSize) + amount * PAGE_SIZE;
+			if(getPageDir()->unmap(virt,-amount,alloc) < 0) {
+				vm->reg->release();
+				return 0;
+			}
+		}
+
 		size_t own = 0;
 		if((res = vm->reg->grow(amount,&own)) < 0) {
 			vm->reg->release();
 			return 0;
 		}
 
-		/* map / unmap pages */
-		uintptr_t virt;
+		/* map pages or update the state for the removed ones */
 		if(amount > 0) {
 			uint mapFlags = PG_PRESENT;
 			if(vm->reg->getFlags() & RF_WRITABLE)
@@ -1112,17 +1210,12 @@ size_t VirtMem::doGrow(VMRegion *vm,ssize_t amount) {
 				freemap.allocate(amount * PAGE_SIZE);
 		}
 		else {
-			if(vm->reg->getFlags() & RF_GROWS_DOWN) {
-				virt = vm->virt();
+			if(vm->reg->getFlags() & RF_GROWS_DOWN)
 				vm->virt(vm->virt() - amount * PAGE_SIZE);
-			}
-			else
-				virt = vm->virt() + esc::Util::round_page_up(vm->reg->getByteCount());
 			/* give it back to the free area */
 			if(vm->virt() >= FREE_AREA_BEGIN)
 				freemap.free(virt,-amount * PAGE_SIZE);
-			getPageDir()->unmap(virt,-amount,alloc);
-			addOwn(-(alloc.pageTables() - own));
+			addOwn(alloc.pageTables() - own);
 			addSwap(-res);
 		}
 	}
@@ -1254,6 +1347,100 @@ int VirtMem::demandLoad(VMRegion *vm,uintptr_t addr) {
 	return res;
 }
 
+int VirtMem::demandLoadLarge(VMRegion *vm,uintptr_t addr) {
+	if(!PageTables::LARGE_PAGE_SIZE)
+		return -ENOTSUP;
+
+	/* the large page has to be completely within the region and none of its pages may have been
+	 * touched yet */
+	uintptr_t start = addr & ~(PageTables::LARGE_PAGE_SIZE - 1);
+	uintptr_t end = vm->virt() + esc::Util::round_page_up(vm->reg->getByteCount());
+	if(start < vm->virt() || end - start < PageTables::LARGE_PAGE_SIZE)
+		return -ENOTSUP;
+	size_t first = (start - vm->virt()) / PAGE_SIZE;
+	for(size_t i = 0; i < PageTables::LARGE_PAGE_COUNT; ++i) {
+		if(vm->reg->getPageFlags(first + i) != PF_DEMANDLOAD)
+			return -ENOTSUP;
+	}
+
+	frameno_t frame = PhysMem::allocateLarge();
+	if(frame == PhysMem::INVALID_FRAME)
+		return -ENOTSUP;
+
+	/* load the part that is backed by the file page by page via a temp-buffer (see loadFromFile)
+	 * and zero the rest */
+	ssize_t err = 0;
+	void *tempBuf = NULL;
+	uintptr_t offset = start - vm->virt();
+	size_t loadCount = 0;
+	if(offset < vm->reg->getLoadCount()) {
+		loadCount = esc::Util::min(PageTables::LARGE_PAGE_SIZE,
+			(size_t)(vm->reg->getLoadCount() - offset));
+		tempBuf = Cache::alloc(PAGE_SIZE);
+		if(tempBuf == NULL) {
+			err = -ENOMEM;
+			goto error;
+		}
+		if((err = vm->reg->getFile()->seek(vm->reg->getOffset() + offset,SEEK_SET)) < 0)
+			goto error;
+	}
+	for(size_t i = 0; i < PageTables::LARGE_PAGE_COUNT; ++i) {
+		size_t amount = 0;
+		if(loadCount > i * PAGE_SIZE)
+			amount = esc::Util::min((size_t)PAGE_SIZE,loadCount - i * PAGE_SIZE);
+		if(amount) {
+			err = vm->reg->getFile()->read(tempBuf,amount);
+			if(err != (ssize_t)amount) {
+				if(err >= 0)
+					err = -ENOMEM;
+				goto error;
+			}
+			memclear((char*)tempBuf + amount,PAGE_SIZE - amount);
+			PageDir::copyToFrame(frame + i,tempBuf);
+		}
+		else {
+			uintptr_t frameAddr = PageDir::getAccess(frame + i);
+			memclear((void*)frameAddr,PAGE_SIZE);
+			PageDir::removeAccess(frame + i);
+		}
+	}
+	if(tempBuf)
+		Cache::free(tempBuf);
+
+	/* map it into all processes. if the region is not aligned in one of them, it gets the frames
+	 * page by page */
+	{
+		uint mapFlags = PG_PRESENT;
+		if(vm->reg->getFlags() & RF_WRITABLE)
+			mapFlags |= PG_WRITABLE;
+		if(vm->reg->getFlags() & RF_EXECUTABLE)
+			mapFlags |= PG_EXECUTABLE;
+		for(auto mp = vm->reg->vmbegin(); mp != vm->reg->vmend(); ++mp) {
+			PageTables::RangeAllocator alloc(frame);
+			VMRegion *mpreg = (*mp)->regtree.getByReg(vm->reg);
+			/* can't fail, because the page-tables exist and can only be replaced */
+			sassert((*mp)->getPageDir()->map(mpreg->virt() + offset,PageTables::LARGE_PAGE_COUNT,
+				alloc,mapFlags) == 0);
+			(*mp)->addOwn(alloc.pageTables());
+			if(vm->reg->getFlags() & RF_SHAREABLE)
+				(*mp)->addShared(PageTables::LARGE_PAGE_COUNT);
+			else
+				(*mp)->addOwn(PageTables::LARGE_PAGE_COUNT);
+		}
+	}
+	for(size_t i = 0; i < PageTables::LARGE_PAGE_COUNT; ++i)
+		vm->reg->setPageFlags(first + i,0);
+	return 0;
+
+error:
+	if(tempBuf)
+		Cache::free(tempBuf);
+	PhysMem::freeLarge(frame);
+	Log::get().writef("Demandload large page @ %p for proc %s: %s (%d)\n",start,
+		proc->getProgram(),strerror(err),err);
+	return err;
+}
+
 int VirtMem::loadFromFile(VMRegion *vm,uintptr_t addr,size_t loadCount) {
 	uint mapFlags;
 	frameno_t frame;
@@ -1314,84 +1501,111 @@ error:
 	return err;
 }
 
-Region *VirtMem::getLRURegion() {
-	Region *lru = NULL;
-	uint64_t ts = (uint64_t)-1;
-	VMTree *tree = VMTree::reqTree();
-	for(; tree != NULL; tree = tree->getNext()) {
+Region *VirtMem::getSwapVictims(size_t *indices,size_t max,size_t *count) {
+	/* we use a two-handed clock: the hand walks over the processes and in each region over the
+	 * pages. pages that have been accessed since the last visit get a second chance; the others are
+	 * swapped out. thus, two rounds are usually enough to find a victim. the third one is for the
+	 * case that the pages are accessed again while we're sweeping */
+	VMTree *first = VMTree::reqTree();
+	VMTree *start = VMTree::getClockHand() ? VMTree::getClockHand() : first;
+	VMTree *tree = start;
+	for(int round = 0; tree != NULL && round < 3; ) {
 		/* same as below; we have to try to acquire the mutex, otherwise we risk a deadlock */
 		if(tree->getVM()->tryAquire()) {
-			for(auto vm = tree->cbegin(); vm != tree->cend(); ++vm) {
-				size_t count = 0;
-				if(vm->reg->getTimestamp() >= ts)
-					continue;
-
+			for(auto vm = tree->begin(); vm != tree->end(); ++vm) {
 				/* we can't block here because otherwise we risk a deadlock. suppose that fs has to
-				 * swap out to get more memory. if we want to demand-load something before this operation
-				 * is finished and lock the region for that, the swapper will find this region at this
-				 * place locked. so we have to skip it in this case to be able to continue. */
-				if(vm->reg->tryAquire()) {
-					/* skip locked regions */
-					if(~vm->reg->getFlags() & RF_LOCKED) {
-						size_t pages = BYTES_2_PAGES(vm->reg->getByteCount());
-						for(size_t j = 0; j < pages; j++) {
-							if(!(vm->reg->getPageFlags(j) & (PF_SWAPPED | PF_COPYONWRITE | PF_DEMANDLOAD))) {
-								count++;
-								break;
-							}
-						}
-					}
-					if(count > 0) {
-						if(lru)
-							lru->release();
-						ts = vm->reg->getTimestamp();
-						lru = vm->reg;
+				 * swap out to get more memory. if we want to demand-load something before this
+				 * operation is finished and lock the region for that, the swapper will find this
+				 * region at this place locked. so we have to skip it in this case to be able to
+				 * continue. */
+				if(!vm->reg->tryAquire())
+					continue;
+				/* skip locked regions */
+				if(~vm->reg->getFlags() & RF_LOCKED) {
+					*count = sweepRegion(vm->reg,indices,max);
+					if(*count > 0) {
+						/* continue with the next process next time */
+						tree->getVM()->release();
+						VMTree::setClockHand(tree->getNext());
+						VMTree::relTree();
+						return vm->reg;
 					}
-					else
-						vm->reg->release();
 				}
+				vm->reg->release();
 			}
 			tree->getVM()->release();
 		}
+
+		tree = tree->getNext() ? tree->getNext() : first;
+		if(tree == start)
+			round++;
 	}
 	VMTree::relTree();
-	return lru;
+	return NULL;
 }
 
-ssize_t VirtMem::getPgIdxForSwap(const Region *reg) {
+size_t VirtMem::sweepRegion(Region *reg,size_t *indices,size_t max) {
 	size_t pages = BYTES_2_PAGES(reg->getByteCount());
 	size_t count = 0;
-	for(size_t i = 0; i < pages; i++) {
-		if(!(reg->getPageFlags(i) & (PF_SWAPPED | PF_COPYONWRITE | PF_DEMANDLOAD)))
-			count++;
-	}
-	if(count > 0) {
-		size_t index = Util::rand() % count;
-		for(size_t i = 0; i < pages; i++) {
-			if(!(reg->getPageFlags(i) & (PF_SWAPPED | PF_COPYONWRITE | PF_DEMANDLOAD))) {
-				if(index-- == 0)
-					return i;
-			}
+	size_t i = reg->getClockPos();
+	for(; i < pages && count < max; ++i) {
+		if(reg->getPageFlags(i) & (PF_SWAPPED | PF_COPYONWRITE | PF_DEMANDLOAD))
+			continue;
+
+		/* the page might be used by multiple processes; give it a second chance if any of them
+		 * has accessed it since our last visit */
+		bool accessed = false;
+		for(auto mp = reg->vmbegin(); mp != reg->vmend(); ++mp) {
+			VMRegion *mpreg = (*mp)->regtree.getByReg(reg);
+			if((*mp)->getPageDir()->testAndClearAccessed(mpreg->virt() + i * PAGE_SIZE))
+				accessed = true;
 		}
+		if(!accessed)
+			indices[count++] = i;
 	}
-	return -1;
+	/* start at the beginning next time, if we're through */
+	reg->setClockPos(i < pages ? i : 0);
+	return count;
 }
 
-void VirtMem::setSwappedOut(Region *reg,size_t index) {
+bool VirtMem::setSwappedOut(Region *reg,size_t index,frameno_t frameNo) {
 	uintptr_t offset = index * PAGE_SIZE;
-	PageTables::NoAllocator alloc;
-	reg->setPageFlags(index,reg->getPageFlags(index) | PF_SWAPPED);
-	for(auto mp = reg->vmbegin(); mp != reg->vmend(); ++mp) {
+	auto mp = reg->vmbegin();
+	for(; mp != reg->vmend(); ++mp) {
+		PageTables::NoAllocator alloc;
 		/* the region may be mapped to a different virtual address */
 		VMRegion *mpreg = (*mp)->regtree.getByReg(reg);
-		/* can't fail */
-		sassert((*mp)->getPageDir()->map(mpreg->virt() + offset,1,alloc,0) == 0);
+		/* fails if a large page needs to be split and there is no frame for the page-table */
+		if((*mp)->getPageDir()->map(mpreg->virt() + offset,1,alloc,0) < 0)
+			break;
+		(*mp)->addOwn(alloc.pageTables());
+	}
+
+	/* if that failed, make it present again in the processes we've already handled */
+	if(mp != reg->vmend()) {
+		uint flags = PG_PRESENT;
+		if(reg->getFlags() & RF_WRITABLE)
+			flags |= PG_WRITABLE;
+		if(reg->getFlags() & RF_EXECUTABLE)
+			flags |= PG_EXECUTABLE;
+		for(auto up = reg->vmbegin(); up != mp; ++up) {
+			PageTables::RangeAllocator alloc(frameNo);
+			VMRegion *mpreg = (*up)->regtree.getByReg(reg);
+			/* can't fail, because the large page has already been split */
+			sassert((*up)->getPageDir()->map(mpreg->virt() + offset,1,alloc,flags) == 0);
+		}
+		return false;
+	}
+
+	reg->setPageFlags(index,reg->getPageFlags(index) | PF_SWAPPED);
+	for(mp = reg->vmbegin(); mp != reg->vmend(); ++mp) {
 		if(reg->getFlags() & RF_SHAREABLE)
 			(*mp)->addShared(-1);
 		else
 			(*mp)->addOwn(-1);
 		(*mp)->addSwap(1);
 	}
+	return true;
 }
 
 void VirtMem::setSwappedIn(Region *reg,size_t index,frameno_t frameNo) {
@@ -1417,6 +1631,17 @@ void VirtMem::setSwappedIn(Region *reg,size_t index,frameno_t frameNo) {
 	}
 }
 
+uintptr_t VirtMem::findFreeArea(size_t byteCount) {
+	size_t size = esc::Util::round_page_up(byteCount);
+	/* put large areas at a large-page boundary, so that they can use large pages */
+	if(PageTables::LARGE_PAGE_SIZE && size >= PageTables::LARGE_PAGE_SIZE) {
+		uintptr_t addr = freemap.allocate(size,PageTables::LARGE_PAGE_SIZE);
+		if(addr != 0)
+			return addr;
+	}
+	return freemap.allocate(size);
+}
+
 uintptr_t VirtMem::findFreeStack(size_t byteCount,A_UNUSED ulong rflags) {
 	/* leave a gap between the stacks as a guard */
 	if(byteCount > (MAX_STACK_PAGES - 1) * PAGE_SIZE)
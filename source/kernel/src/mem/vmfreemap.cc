@@ -17,6 +17,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <esc/util.h>
 #include <mem/cache.h>
 #include <mem/vmfreemap.h>
 #include <assert.h>
@@ -72,6 +73,16 @@ uintptr_t VMFreeMap::allocate(size_t size) {
 	return res;
 }
 
+uintptr_t VMFreeMap::allocate(size_t size,size_t align) {
+	assert((size & 0xFFF) == 0 && (align & 0xFFF) == 0);
+	for(Area *a = list; a != NULL; a = a->next) {
+		uintptr_t addr = esc::Util::round_up(a->addr,align);
+		if(a->size >= size && addr - a->addr <= a->size - size)
+			return allocateAt(addr,size) ? addr : 0;
+	}
+	return 0;
+}
+
 bool VMFreeMap::allocateAt(uintptr_t addr,size_t size) {
 	Area *a,*p = NULL;
 	for(a = list; a != NULL && addr > a->addr + a->size; p = a, a = a->next)
@@ -19,6 +19,7 @@
 
 #include <esc/util.h>
 #include <mem/cache.h>
+#include <mem/objcache.h>
 #include <mem/region.h>
 #include <mem/vmtree.h>
 #include <task/proc.h>
@@ -38,6 +39,17 @@
 Mutex VMTree::regMutex;
 VMTree *VMTree::regList;
 VMTree *VMTree::regListEnd;
+VMTree *VMTree::clockHand;
+static ObjCache vmregCache("VMRegion",sizeof(VMRegion));
+
+void *VMRegion::operator new(A_UNUSED size_t size) throw() {
+	assert(size == sizeof(VMRegion));
+	return vmregCache.alloc();
+}
+
+void VMRegion::operator delete(void *ptr) throw() {
+	vmregCache.free(ptr);
+}
 
 bool VMRegion::matches(uintptr_t k) {
     return k >= virt() && k < virt() + esc::Util::round_page_up(reg->getByteCount());
@@ -63,6 +75,9 @@ void VMTree::remTree(VMTree *tree) {
 				regList = t->next;
 			if(t == regListEnd)
 				regListEnd = p;
+			/* move the clock-hand forward, if necessary */
+			if(t == clockHand)
+				clockHand = t->next;
 			break;
 		}
 	}
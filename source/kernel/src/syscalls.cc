@@ -123,6 +123,9 @@ const Syscalls::handler_func Syscalls::syscalls[] = {
 	utime,
 	truncate,
 	symlink,
+	sendv,
+	getworkv,
+	mphys,
 #if defined(__x86__)
 	reqports,
 	relports,
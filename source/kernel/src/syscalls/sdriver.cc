@@ -144,3 +144,47 @@ int Syscalls::getwork(Thread *t,IntrptStackFrame *stack) {
 	UserAccess::writeVar(id,mid);
 	SYSC_SUCCESS(stack,clifd);
 }
+
+int Syscalls::getworkv(Thread *t,IntrptStackFrame *stack) {
+	int fd = SYSC_ARG1(stack) >> 2;
+	struct msgvec *uvec = (struct msgvec*)SYSC_ARG2(stack);
+	size_t *ucount = (size_t*)SYSC_ARG3(stack);
+	uint flags = SYSC_ARG1(stack) & 0x3;
+	Proc *p = t->getProc();
+	struct msgvec vec[MAX_MSGV_COUNT];
+	size_t count;
+
+	/* validate pointers */
+	if(EXPECT_FALSE(!PageDir::isInUserSpace((uintptr_t)ucount,sizeof(size_t))))
+		SYSC_ERROR(stack,-EFAULT);
+	if(EXPECT_FALSE(UserAccess::readVar(&count,ucount) < 0))
+		SYSC_ERROR(stack,-EFAULT);
+	if(EXPECT_FALSE(count == 0 || count > MAX_MSGV_COUNT))
+		SYSC_ERROR(stack,-EINVAL);
+	if(EXPECT_FALSE(!PageDir::isInUserSpace((uintptr_t)uvec,count * sizeof(struct msgvec))))
+		SYSC_ERROR(stack,-EFAULT);
+	if(EXPECT_FALSE(UserAccess::read(vec,uvec,count * sizeof(struct msgvec)) < 0))
+		SYSC_ERROR(stack,-EFAULT);
+	for(size_t i = 0; i < count; ++i) {
+		if(EXPECT_FALSE(!PageDir::isInUserSpace((uintptr_t)vec[i].data,vec[i].size)))
+			SYSC_ERROR(stack,-EFAULT);
+	}
+
+	/* get client */
+	int clifd;
+	{
+		ScopedFile file(p,fd);
+		clifd = EXPECT_TRUE(file) ? OpenFile::getWork(&*file,flags) : -EBADF;
+		if(EXPECT_FALSE(clifd < 0))
+			SYSC_ERROR(stack,clifd);
+	}
+
+	/* receive all pending messages of that client that fit into the buffers */
+	ScopedFile cli(p,clifd);
+	ssize_t res = EXPECT_TRUE(cli) ? cli->receiveMsgv(vec,count,VFS_SIGNALS) : -EBADF;
+	if(EXPECT_FALSE(res < 0))
+		SYSC_ERROR(stack,res);
+	UserAccess::write(uvec,vec,res * sizeof(struct msgvec));
+	UserAccess::writeVar(ucount,(size_t)res);
+	SYSC_SUCCESS(stack,clifd);
+}
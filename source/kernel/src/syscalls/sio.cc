@@ -308,6 +308,44 @@ int Syscalls::sendrecv(Thread *t,IntrptStackFrame *stack) {
 	SYSC_RESULT(stack,res);
 }
 
+int Syscalls::sendv(Thread *t,IntrptStackFrame *stack) {
+	int fd = (int)SYSC_ARG1(stack);
+	struct msgvec *uvec = (struct msgvec*)SYSC_ARG2(stack);
+	size_t count = SYSC_ARG3(stack);
+	Proc *p = t->getProc();
+	struct msgvec vec[MAX_MSGV_COUNT];
+
+	if(EXPECT_FALSE(count == 0 || count > MAX_MSGV_COUNT))
+		SYSC_ERROR(stack,-EINVAL);
+	if(EXPECT_FALSE(!PageDir::isInUserSpace((uintptr_t)uvec,count * sizeof(struct msgvec))))
+		SYSC_ERROR(stack,-EFAULT);
+	if(EXPECT_FALSE(UserAccess::read(vec,uvec,count * sizeof(struct msgvec)) < 0))
+		SYSC_ERROR(stack,-EFAULT);
+
+	ScopedFile file(p,fd);
+	if(EXPECT_FALSE(!file))
+		SYSC_ERROR(stack,-EBADF);
+
+	size_t total = 0;
+	for(size_t i = 0; i < count; ++i) {
+		if(EXPECT_FALSE(!PageDir::isInUserSpace((uintptr_t)vec[i].data,vec[i].size)))
+			SYSC_ERROR(stack,-EFAULT);
+		/* can only be sent by drivers */
+		if(EXPECT_FALSE(!file->isDevice() && isDeviceMsg(vec[i].id & 0xFFFF)))
+			SYSC_ERROR(stack,-EPERM);
+		total += vec[i].size;
+	}
+
+	ssize_t res = file->sendMsgv(vec,count);
+	if(EXPECT_FALSE(res < 0))
+		SYSC_ERROR(stack,res);
+
+	/* tell the caller the used message-ids */
+	UserAccess::write(uvec,vec,count * sizeof(struct msgvec));
+	p->getStats().output += total;
+	SYSC_RESULT(stack,res);
+}
+
 int Syscalls::cancel(Thread *t,IntrptStackFrame *stack) {
 	int fd = (int)SYSC_ARG1(stack);
 	msgid_t id = (msgid_t)SYSC_ARG2(stack);
@@ -21,7 +21,10 @@
 #include <mem/pagedir.h>
 #include <mem/virtmem.h>
 #include <task/filedesc.h>
+#include <task/groups.h>
 #include <task/proc.h>
+#include <usergroup/usergroup.h>
+#include <esc/util.h>
 #include <boot.h>
 #include <common.h>
 #include <errno.h>
@@ -167,6 +170,34 @@ int Syscalls::mlockall(Thread *t,IntrptStackFrame *stack) {
 	SYSC_RESULT(stack,res);
 }
 
+int Syscalls::mphys(Thread *t,IntrptStackFrame *stack) {
+	uintptr_t virt = (uintptr_t)SYSC_ARG1(stack);
+	size_t count = SYSC_ARG2(stack);
+	uintptr_t *phys = (uintptr_t*)SYSC_ARG3(stack);
+	Proc *p = t->getProc();
+
+	/* physical addresses are only of interest for drivers; don't reveal them to others */
+	if(EXPECT_FALSE(p->getUid() != ROOT_UID && p->getGid() != GROUP_DRIVER &&
+			Groups::contains(p->getPid(),GROUP_DRIVER) != 1))
+		SYSC_ERROR(stack,-EPERM);
+	if(EXPECT_FALSE((virt & (PAGE_SIZE - 1)) || count == 0 || count > (size_t)-1 / sizeof(uintptr_t)))
+		SYSC_ERROR(stack,-EINVAL);
+	if(EXPECT_FALSE(!PageDir::isInUserSpace((uintptr_t)phys,count * sizeof(uintptr_t))))
+		SYSC_ERROR(stack,-EFAULT);
+
+	/* we can't access user memory while holding the locks, thus copy it in chunks */
+	uintptr_t addrs[16];
+	for(size_t i = 0; i < count; i += ARRAY_SIZE(addrs)) {
+		size_t amount = esc::Util::min(count - i,ARRAY_SIZE(addrs));
+		int res = p->getVM()->getPhysAddrs(virt + i * PAGE_SIZE,addrs,amount);
+		if(EXPECT_FALSE(res < 0))
+			SYSC_ERROR(stack,res);
+		if(EXPECT_FALSE(UserAccess::write(phys + i,addrs,amount * sizeof(uintptr_t)) < 0))
+			SYSC_ERROR(stack,-EFAULT);
+	}
+	SYSC_SUCCESS(stack,0);
+}
+
 int Syscalls::mattr(A_UNUSED Thread *t,IntrptStackFrame *stack) {
 	uintptr_t phys = (uintptr_t)SYSC_ARG1(stack);
 	size_t bytes = SYSC_ARG2(stack);
@@ -72,16 +72,14 @@ int Syscalls::alarm(Thread *t,IntrptStackFrame *stack) {
 	/* ensure that we're not already in the list */
 	Timer::removeThread(t->getTid());
 
-	/* TODO support microseconds */
-	int res = Timer::sleepFor(t->getTid(),usecs / 1000,false);
+	int res = Timer::sleepFor(t->getTid(),usecs,false);
 	SYSC_RESULT(stack,res);
 }
 
 int Syscalls::sleep(Thread *t,IntrptStackFrame *stack) {
 	time_t usecs = SYSC_ARG1(stack);
 
-	/* TODO support microseconds */
-	int res = Timer::sleepFor(t->getTid(),usecs / 1000,true);
+	int res = Timer::sleepFor(t->getTid(),usecs,true);
 	if(EXPECT_FALSE(res < 0))
 		SYSC_ERROR(stack,res);
 
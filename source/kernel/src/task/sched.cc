@@ -41,24 +41,53 @@
  * the beginning and end. Therefore we can dequeue the first, prepend, append and remove a thread
  * in O(1). Additionally the number of threads is limited by the kernel-heap (i.e. we don't need
  * a static storage of nodes for the linked list; we use the threads itself)
+ *
+ * Every CPU has its own ready-queues, ready-mask and lock. A thread belongs to the queue of
+ * Thread::schedCPU, which is the CPU it runs on or has run on last. Thus, a thread that becomes
+ * ready is put on the CPU it ran on previously. If a CPU has nothing to do, it steals a thread from
+ * the most loaded CPU. All state-changes of a thread are done while holding the lock of its
+ * queue.
+ *
+ * Threads that wait for an event are put into a wait-queue, which is chosen by hashing the event
+ * and object. Threads that wait for any object of an event have a separate queue per event. Thus,
+ * waking up the threads for a specific object only walks the threads that wait for an object with
+ * the same hash. Each wait-queue has its own lock, which has to be acquired before a queue-lock.
  */
 
-SpinLock Sched::lock;
-ulong Sched::readyMask = 0;
-esc::DList<Thread> Sched::rdyQueues[MAX_PRIO + 1];
-esc::DList<Thread> Sched::evlists[EV_COUNT];
-size_t Sched::rdyCount;
+struct Sched::RunQueue {
+	SpinLock lock;
+	ulong readyMask;
+	size_t count;
+	esc::DList<Thread> queues[MAX_PRIO + 1];
+};
+
+struct Sched::WaitQueue {
+	SpinLock lock;
+	esc::DList<Thread> list;
+};
+
+Sched::WaitQueue Sched::waitQueues[WAIT_QUEUE_COUNT];
+Sched::WaitQueue Sched::anyQueues[EV_COUNT];
+Sched::RunQueue *Sched::runQueues;
+SpinLock Sched::idleLock;
 Thread **Sched::idleThreads;
 
 void Sched::init() {
 	idleThreads = (Thread**)Cache::calloc(SMP::getCPUCount(),sizeof(Thread*));
 	if(!idleThreads)
 		Util::panic("Unable to allocate idle-threads array");
-	rdyCount = 0;
+	/* zero'd memory is a valid empty queue */
+	runQueues = (RunQueue*)Cache::calloc(SMP::getCPUCount(),sizeof(RunQueue));
+	if(!runQueues)
+		Util::panic("Unable to allocate ready-queues");
+}
+
+ulong Sched::getReadyMask(cpuid_t cpu) {
+	return runQueues[cpu].readyMask;
 }
 
 void Sched::addIdleThread(Thread *t) {
-	LockGuard<SpinLock> g(&lock);
+	LockGuard<SpinLock> g(&idleLock);
 	for(size_t i = 0; i < SMP::getCPUCount(); ++i) {
 		if(idleThreads[i] == NULL) {
 			idleThreads[i] = t;
@@ -67,23 +96,131 @@ void Sched::addIdleThread(Thread *t) {
 	}
 }
 
-void Sched::enqueue(Thread *t) {
+Sched::RunQueue *Sched::lockQueue(Thread *t) {
+	while(true) {
+		RunQueue *q = runQueues + *(volatile cpuid_t*)&t->schedCPU;
+		q->lock.down();
+		/* the thread might have been stolen in the meantime */
+		if(EXPECT_TRUE(q == runQueues + t->schedCPU))
+			return q;
+		q->lock.up();
+	}
+}
+
+Sched::WaitQueue *Sched::getWaitQueue(uint event,evobj_t object) {
+	if(object == 0)
+		return anyQueues + event - 1;
+	/* the objects are kernel-objects, so that the lower bits are usually the same */
+	size_t hash = (object >> 4) ^ (object >> 12) ^ (event * 31);
+	return waitQueues + (hash & (WAIT_QUEUE_COUNT - 1));
+}
+
+Sched::RunQueue *Sched::lockWithEvent(Thread *t,WaitQueue **wq) {
+	while(true) {
+		RunQueue *q = lockQueue(t);
+		/* t->event is only changed while holding the queue-lock */
+		if(t->event == 0) {
+			*wq = NULL;
+			return q;
+		}
+
+		/* respect the lock-order */
+		WaitQueue *w = getWaitQueue(t->event,t->evobject);
+		q->lock.up();
+		w->lock.down();
+		q = lockQueue(t);
+		/* the thread might have been waked up and started to wait for something else */
+		if(t->event == 0 || getWaitQueue(t->event,t->evobject) == w) {
+			*wq = w;
+			return q;
+		}
+		q->lock.up();
+		w->lock.up();
+	}
+}
+
+void Sched::enqueue(RunQueue *q,Thread *t) {
 	uint8_t prio = t->getPriority();
-	rdyQueues[prio].append(t);
-	readyMask |= 1UL << prio;
-	rdyCount++;
+	q->queues[prio].append(t);
+	q->readyMask |= 1UL << prio;
+	q->count++;
 }
 
-void Sched::dequeue(Thread *t) {
+void Sched::dequeue(RunQueue *q,Thread *t) {
 	uint8_t prio = t->getPriority();
-	rdyQueues[prio].remove(t);
-	if(rdyQueues[prio].length() == 0)
-		readyMask &= ~(1UL << prio);
-	rdyCount--;
+	q->queues[prio].remove(t);
+	if(q->queues[prio].length() == 0)
+		q->readyMask &= ~(1UL << prio);
+	q->count--;
+}
+
+Thread *Sched::dequeueFirst(RunQueue *q,Thread *old) {
+	for(ssize_t i = MAX_PRIO; i >= 0; i--) {
+		Thread *t = q->queues[i].removeFirst();
+		if(t) {
+			/* if its the old thread again and we have more ready threads, don't take this one again.
+			 * because we assume that Thread::switchAway() has been called for a reason. therefore, it
+			 * should be better to take a thread with a lower priority than taking the same again */
+			if(q->count > 1 && t == old) {
+				q->queues[i].append(t);
+				continue;
+			}
+			if(q->queues[i].length() == 0)
+				q->readyMask &= ~(1UL << i);
+			q->count--;
+			return t;
+		}
+	}
+	return NULL;
+}
+
+Thread *Sched::steal(RunQueue *q,cpuid_t cpu) {
+	/* search for the most loaded queue. it doesn't matter if the count is outdated */
+	RunQueue *victim = NULL;
+	for(size_t i = 0; i < SMP::getCPUCount(); ++i) {
+		RunQueue *other = runQueues + i;
+		if(other != q && other->count > 0 && (!victim || other->count > victim->count))
+			victim = other;
+	}
+
+	/* never wait for the lock of another queue, because its owner might wait for ours. if we can't
+	 * get it now, we'll try again at the next scheduling decision */
+	Thread *t = NULL;
+	if(victim && victim->lock.tryDown()) {
+		for(ssize_t i = MAX_PRIO; t == NULL && i >= 0; i--) {
+			for(auto it = victim->queues[i].begin(); it != victim->queues[i].end(); ++it) {
+				/* a thread the victim is still switching away from has a stale save-area */
+				if(!it->isSwitching()) {
+					t = &*it;
+					break;
+				}
+			}
+		}
+		/* we hold both locks here, so that lockQueue() will either see the old or new queue */
+		if(t) {
+			dequeue(victim,t);
+			t->schedCPU = cpu;
+		}
+		victim->lock.up();
+	}
+	return t;
 }
 
 Thread *Sched::perform(Thread *old,cpuid_t cpu) {
-	LockGuard<SpinLock> g(&lock);
+	RunQueue *q = runQueues + cpu;
+	/* if the old thread waits for an event and has a signal, we have to remove it from the wait-queue.
+	 * only the thread itself can start to wait, so that event and object can't change to different
+	 * ones. but another CPU can wake it up meanwhile, which sets the event to 0 and leaves the object
+	 * as it is. thus, read the event only once. if it is 0 afterwards, removeFromEventlist() below
+	 * won't touch the wait-queue */
+	WaitQueue *wq = NULL;
+	uint event = old ? old->event : 0;
+	if(event != 0 && old->hasSignal()) {
+		wq = getWaitQueue(event,old->evobject);
+		wq->lock.down();
+	}
+	q->lock.down();
+
 	/* give the old thread a new state */
 	if(old) {
 		if(old->getFlags() & T_IDLE)
@@ -93,40 +230,43 @@ Thread *Sched::perform(Thread *old,cpuid_t cpu) {
 
 			/* we have to check for a signal here, because otherwise we might miss it */
 			/* (scenario: cpu0 unblocks t1 for signal, cpu1 runs t1 and blocks itself) */
-			if(old->getNewState() != Thread::ZOMBIE && old->hasSignal()) {
+			/* if the signal has arrived after we've checked it above, the sender will unblock us as
+			 * soon as we've released the lock, so that we can simply block in this case */
+			if(old->getNewState() != Thread::ZOMBIE && old->hasSignal() &&
+					(wq || old->event == 0)) {
 				/* we have to reset the newstate in this case and remove us from event */
 				old->setNewState(Thread::READY);
 				old->waitstart = 0;
 				removeFromEventlist(old);
+				q->lock.up();
+				if(wq)
+					wq->lock.up();
 				return old;
 			}
 
 			old->setState(old->getNewState());
 			if(old->getNewState() == Thread::READY) {
 				assert(old->event == 0);
-				enqueue(old);
+				enqueue(q,old);
 			}
 		}
 	}
+	if(wq)
+		wq->lock.up();
 
-	/* get new thread */
-	Thread *t;
-	for(ssize_t i = MAX_PRIO; i >= 0; i--) {
-		t = rdyQueues[i].removeFirst();
-		if(t) {
-			/* if its the old thread again and we have more ready threads, don't take this one again.
-			 * because we assume that Thread::switchAway() has been called for a reason. therefore, it
-			 * should be better to take a thread with a lower priority than taking the same again */
-			if(rdyCount > 1 && t == old) {
-				rdyQueues[i].append(t);
-				continue;
-			}
-			if(rdyQueues[i].length() == 0)
-				readyMask &= ~(1UL << i);
-			rdyCount--;
-			break;
+	/* get new thread; prefer our own queue, but if there is nothing else than the old thread, take
+	 * one from another CPU. note that the old thread is not stolen from us before we've switched
+	 * away from it, because Thread::doSwitch() marks it as switching until its registers are saved */
+	Thread *t = dequeueFirst(q,old);
+	if(t == NULL || t == old) {
+		Thread *stolen = steal(q,cpu);
+		if(stolen) {
+			if(t)
+				enqueue(q,t);
+			t = stolen;
 		}
 	}
+
 	if(t == NULL) {
 		/* choose an idle-thread */
 		t = idleThreads[cpu];
@@ -137,14 +277,16 @@ Thread *Sched::perform(Thread *old,cpuid_t cpu) {
 		t->setNewState(Thread::READY);
 	}
 
-	/* if there is another thread ready, check if we have another cpu that we can start for it */
-	if(rdyCount > 0)
+	/* if there is another thread ready, check if we have another cpu that can steal it */
+	bool overloaded = q->count > 0;
+	q->lock.up();
+	if(overloaded)
 		SMP::wakeupCPU();
 	return t;
 }
 
 void Sched::adjustPrio(Thread *t,uint64_t total) {
-	LockGuard<SpinLock> g(&lock);
+	RunQueue *q = lockQueue(t);
 	/* if it is still blocked, add the time to the blocked time */
 	if(t->waitstart > 0) {
 		uint64_t now = CPU::rdtsc();
@@ -175,10 +317,10 @@ void Sched::adjustPrio(Thread *t,uint64_t total) {
 	if(t->stats.blocked < BAD_BLOCK_TIME(total)) {
 		if(t->getPriority() > 0) {
 			if(t->getState() == Thread::READY)
-				dequeue(t);
+				dequeue(q,t);
 			t->setPriority(t->getPriority() - 1);
 			if(t->getState() == Thread::READY)
-				enqueue(t);
+				enqueue(q,t);
 		}
 		t->prioGoodCnt = 0;
 	}
@@ -188,10 +330,10 @@ void Sched::adjustPrio(Thread *t,uint64_t total) {
 			/* but don't do that immediately, but only if it happened multiple times */
 			if(++t->prioGoodCnt == PRIO_FORGIVE_CNT) {
 				if(t->getState() == Thread::READY)
-					dequeue(t);
+					dequeue(q,t);
 				t->setPriority(t->getPriority() + 1);
 				if(t->getState() == Thread::READY)
-					enqueue(t);
+					enqueue(q,t);
 				t->prioGoodCnt = 0;
 			}
 		}
@@ -199,44 +341,79 @@ void Sched::adjustPrio(Thread *t,uint64_t total) {
 
 	/* reset blocked time */
 	t->stats.blocked = 0;
+	q->lock.up();
+}
+
+void Sched::block(Thread *t) {
+	assert(t != NULL);
+	RunQueue *q = lockQueue(t);
+	setBlocked(q,t);
+	q->lock.up();
+}
+
+void Sched::unblock(Thread *t) {
+	assert(t != NULL);
+	WaitQueue *wq;
+	RunQueue *q = lockWithEvent(t,&wq);
+	setReady(q,t);
+	q->lock.up();
+	if(wq)
+		wq->lock.up();
 }
 
 void Sched::wait(Thread *t,uint event,evobj_t object) {
-	LockGuard<SpinLock> g(&lock);
 	assert(t->event == 0);
 	assert(Thread::getRunning() == t);
+	WaitQueue *wq = event ? getWaitQueue(event,object) : NULL;
+	if(wq)
+		wq->lock.down();
+	RunQueue *q = lockQueue(t);
 	t->event = event;
 	t->evobject = object;
-	setBlocked(t);
-	if(event)
-		evlists[event - 1].append(t);
+	setBlocked(q,t);
+	if(wq)
+		wq->list.append(t);
+	q->lock.up();
+	if(wq)
+		wq->lock.up();
 }
 
 void Sched::wakeup(uint event,evobj_t object,bool all) {
 	assert(event >= 1 && event <= EV_COUNT);
-	esc::DList<Thread> *list = evlists + event - 1;
-	LockGuard<SpinLock> g(&lock);
-	for(auto it = list->begin(); it != list->end(); ) {
+	/* first the threads that wait for this object, afterwards the ones that wait for any object */
+	if(object != 0 && wakeupIn(getWaitQueue(event,object),event,object,all) && !all)
+		return;
+	wakeupIn(getWaitQueue(event,0),event,0,all);
+}
+
+bool Sched::wakeupIn(WaitQueue *wq,uint event,evobj_t object,bool all) {
+	bool found = false;
+	LockGuard<SpinLock> g(&wq->lock);
+	for(auto it = wq->list.begin(); it != wq->list.end(); ) {
 		auto old = it++;
-		assert(old->event == event);
-		if(old->evobject == 0 || old->evobject == object) {
+		/* other events and objects might have the same hash */
+		if(old->event == event && old->evobject == object) {
+			RunQueue *q = lockQueue(&*old);
 			removeFromEventlist(&*old);
-			setReady(&*old);
+			setReady(q,&*old);
+			q->lock.up();
+			found = true;
 			if(!all)
 				break;
 		}
 	}
+	return found;
 }
 
 void Sched::removeFromEventlist(Thread *t) {
 	if(t->event) {
 		/* important: remove it first from the event-list and set event to 0 */
-		evlists[t->event - 1].remove(t);
+		getWaitQueue(t->event,t->evobject)->list.remove(t);
 		t->event = 0;
 	}
 }
 
-void Sched::setReady(Thread *t) {
+void Sched::setReady(RunQueue *q,Thread *t) {
 	if(t->getFlags() & T_IDLE)
 		return;
 
@@ -251,11 +428,13 @@ void Sched::setReady(Thread *t) {
 	}
 	else if(setReadyState(t)) {
 		assert(t->event == 0);
-		enqueue(t);
+		enqueue(q,t);
+		/* let the CPU it ran on last pick it up, if it's idling */
+		SMP::wakeupCPU(t->schedCPU);
 	}
 }
 
-void Sched::setBlocked(Thread *t) {
+void Sched::setBlocked(RunQueue *q,Thread *t) {
 	switch(t->getState()) {
 		case Thread::ZOMBIE:
 		case Thread::BLOCKED:
@@ -265,7 +444,7 @@ void Sched::setBlocked(Thread *t) {
 			break;
 		case Thread::READY:
 			t->setState(Thread::BLOCKED);
-			dequeue(t);
+			dequeue(q,t);
 			break;
 		default:
 			vassert(false,"Invalid state for setBlocked (%d)",t->getState());
@@ -275,7 +454,8 @@ void Sched::setBlocked(Thread *t) {
 }
 
 void Sched::removeThread(Thread *t) {
-	LockGuard<SpinLock> g(&lock);
+	WaitQueue *wq;
+	RunQueue *q = lockWithEvent(t,&wq);
 	switch(t->getState()) {
 		case Thread::RUNNING:
 			break;
@@ -283,7 +463,7 @@ void Sched::removeThread(Thread *t) {
 			removeFromEventlist(t);
 			break;
 		case Thread::READY:
-			dequeue(t);
+			dequeue(q,t);
 			break;
 		default:
 			/* TODO threads can die during swap, right? */
@@ -291,6 +471,9 @@ void Sched::removeThread(Thread *t) {
 			break;
 	}
 	t->setNewState(Thread::ZOMBIE);
+	q->lock.up();
+	if(wq)
+		wq->lock.up();
 }
 
 bool Sched::setReadyState(Thread *t) {
@@ -311,26 +494,37 @@ bool Sched::setReadyState(Thread *t) {
 
 void Sched::print(OStream &os) {
 	os.writef("Ready queues:\n");
-	for(size_t i = 0; i < ARRAY_SIZE(rdyQueues); i++) {
-		os.writef("\t[%d]:\n",i);
-		print(os,rdyQueues + i);
-		os.writef("\n");
+	for(size_t c = 0; c < SMP::getCPUCount(); c++) {
+		RunQueue *q = runQueues + c;
+		os.writef("\tCPU %zu (%zu ready):\n",c,q->count);
+		for(size_t i = 0; i < ARRAY_SIZE(q->queues); i++) {
+			os.writef("\t[%d]:\n",i);
+			print(os,q->queues + i);
+			os.writef("\n");
+		}
 	}
 }
 
 void Sched::printEventLists(OStream &os) {
 	os.writef("Eventlists:\n");
 	for(size_t e = 0; e < EV_COUNT; e++) {
-		esc::DList<Thread> *list = evlists + e;
 		os.writef("\t%s:\n",getEventName(e + 1));
-		for(auto t = list->cbegin(); t != list->cend(); ++t) {
-			os.writef("\t\tthread=%d (%d:%s), object=%x",
-					t->getTid(),t->getProc()->getPid(),t->getProc()->getProgram(),t->evobject);
-			ino_t nodeNo = ((VFSNode*)t->evobject)->getNo();
-			if(VFSNode::isValid(nodeNo))
-				os.writef("(%s)",((VFSNode*)t->evobject)->getPath());
-			os.writef("\n");
-		}
+		print(os,anyQueues + e,e + 1);
+		for(size_t i = 0; i < WAIT_QUEUE_COUNT; i++)
+			print(os,waitQueues + i,e + 1);
+	}
+}
+
+void Sched::print(OStream &os,const WaitQueue *wq,uint event) {
+	for(auto t = wq->list.cbegin(); t != wq->list.cend(); ++t) {
+		if(t->event != event)
+			continue;
+		os.writef("\t\tthread=%d (%d:%s), object=%x",
+				t->getTid(),t->getProc()->getPid(),t->getProc()->getProgram(),t->evobject);
+		ino_t nodeNo = ((VFSNode*)t->evobject)->getNo();
+		if(VFSNode::isValid(nodeNo))
+			os.writef("(%s)",((VFSNode*)t->evobject)->getPath());
+		os.writef("\n");
 	}
 }
 
@@ -105,16 +105,37 @@ void SMPBase::wakeupCPU() {
 	}
 }
 
-void SMPBase::flushTLB(PageDir *pdir) {
-	if(!cpus || cpuCount == 1)
+void SMPBase::wakeupCPU(cpuid_t id) {
+	if(cpus && cpuCount > 1 && id != getCurId()) {
+		CPU *cpu = cpus[id];
+		if(cpu->ready && (!cpu->thread || (cpu->thread->getFlags() & T_IDLE)))
+			sendIPI(id,IPI_WORK);
+	}
+}
+
+void SMPBase::flushTLB(PageDir *pdir,uintptr_t virt,size_t count) {
+	if(!cpus || cpuCount == 1 || count == 0)
 		return;
 
+	uintptr_t last = virt + (count - 1) * PAGE_SIZE;
 	cpuid_t cur = getCurId();
-	for(auto cpu = cpuList.cbegin(); cpu != cpuList.cend(); ++cpu) {
+	for(auto cpu = cpuList.begin(); cpu != cpuList.end(); ++cpu) {
 		if(cpu->ready && cpu->id != cur) {
 			Thread *t = cpu->thread;
-			if(t && t->getProc()->getPageDir() == pdir)
-				sendIPI(cpu->id,IPI_FLUSH_TLB);
+			if(t && t->getProc()->getPageDir() == pdir) {
+				/* if there is still a request pending, the IPI has not been handled yet */
+				cpu->flushLock.down();
+				bool pending = cpu->flushPending;
+				if(!pending || virt < cpu->flushStart)
+					cpu->flushStart = virt;
+				if(!pending || last > cpu->flushLast)
+					cpu->flushLast = last;
+				cpu->flushPending = true;
+				cpu->flushLock.up();
+
+				if(!pending)
+					sendIPI(cpu->id,IPI_FLUSH_TLB);
+			}
 		}
 	}
 }
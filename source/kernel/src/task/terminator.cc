@@ -38,7 +38,8 @@ void Terminator::start() {
 
 		/* better do that unlocked; we might block on a mutex */
 		lock.up();
-		while(dt->getState() != Thread::ZOMBIE)
+		/* wait until its CPU has left its kernel-stack */
+		while(dt->getState() != Thread::ZOMBIE || dt->isSwitching())
 			Thread::switchAway();
 		Proc::killThread(dt);
 		lock.down();
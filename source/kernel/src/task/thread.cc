@@ -72,8 +72,9 @@ void ThreadBase::relRef(const Thread *t) {
 ThreadBase::ThreadBase(Proc *p,uint8_t flags)
 	: esc::DListItem(), tid(), refs(1), proc(p), sigHandler(), sigmask(), event(), evobject(),
 	  waitstart(), prioGoodCnt(), flags(flags), priority(MAX_PRIO), state(BLOCKED), newState(READY),
-	  cpu(), stackRegions(), threadDir(), threadListItem(static_cast<Thread*>(this)),
-	  signalListItem(static_cast<Thread*>(this)), reqFrames(), stats() {
+	  cpu(), schedCPU(), switching(), stackRegions(), threadDir(), threadListItem(static_cast<Thread*>(this)),
+	  signalListItem(static_cast<Thread*>(this)), timerListener(static_cast<Thread*>(this)),
+	  reqFrames(), stats() {
 	stats.cycleStart = CPU::rdtsc();
 	stats.signal = SIG_COUNT;
 }
@@ -184,17 +185,36 @@ bool ThreadBase::reserveFrames(size_t count,bool swap) {
 			discardFrames();
 			return false;
 		}
-		for(size_t i = count; i > 0; i--) {
-			frameno_t frm = PhysMem::allocate(PhysMem::USR);
-			if(frm == PhysMem::INVALID_FRAME)
+		/* take the frames in batches to reduce the lock round-trips */
+		while(count > 0) {
+			frameno_t frames[FRAME_BATCH];
+			size_t req = esc::Util::min(count,FRAME_BATCH);
+			size_t amount = PhysMem::allocate(PhysMem::USR,req,frames);
+			for(size_t i = 0; i < amount; ++i)
+				reqFrames.append(frames[i]);
+			count -= amount;
+			if(amount < req)
 				break;
-			reqFrames.append(frm);
-			count--;
 		}
 	}
 	return true;
 }
 
+void ThreadBase::discardFrames() {
+	frameno_t frames[FRAME_BATCH];
+	size_t count = 0;
+	frameno_t frm;
+	while((frm = reqFrames.removeFirst()) != 0) {
+		frames[count++] = frm;
+		if(count == FRAME_BATCH) {
+			PhysMem::free(frames,count,PhysMem::USR);
+			count = 0;
+		}
+	}
+	if(count > 0)
+		PhysMem::free(frames,count,PhysMem::USR);
+}
+
 int ThreadBase::create(Thread *src,Thread **dst,Proc *p,uint8_t tflags,bool cloneProc) {
 	int err = -ENOMEM;
 	Thread *t = new Thread(p,tflags);
@@ -213,6 +233,8 @@ int ThreadBase::create(Thread *src,Thread **dst,Proc *p,uint8_t tflags,bool clon
 		/* do that here to prevent that one see's a temporary priority, i.e. during the update-phase */
 		t->priority = p->getPriority();
 	}
+	/* start on the CPU of the creator; if that one is busy, another CPU will steal the thread */
+	t->schedCPU = src->getCPU();
 
 	/* we don't want to destroy the process first because we have a pointer to it */
 	Proc::getRef(p->getPid());
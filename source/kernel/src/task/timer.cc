@@ -17,24 +17,20 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <esc/util.h>
 #include <task/proc.h>
 #include <task/sched.h>
 #include <task/smp.h>
 #include <task/timer.h>
+#include <atomic.h>
 #include <common.h>
 #include <errno.h>
 #include <spinlock.h>
 #include <util.h>
 #include <video.h>
 
-/* total elapsed milliseconds */
 TimerBase::PerCPU *TimerBase::perCPU = NULL;
-time_t TimerBase::lastRuntimeUpdate = 0;
-
-SpinLock TimerBase::lock;
-TimerBase::Listener TimerBase::listenObjs[LISTENER_COUNT];
-TimerBase::Listener *TimerBase::freeList;
-TimerBase::Listener *TimerBase::listener = NULL;
+uint64_t volatile TimerBase::lastRuntimeUpdate = 0;
 
 void TimerBase::init() {
 	archInit();
@@ -42,136 +38,189 @@ void TimerBase::init() {
 	perCPU = (PerCPU*)Cache::calloc(SMP::getCPUCount(),sizeof(PerCPU));
 	if(!perCPU)
 		Util::panic("Unable to create per-cpu-array");
-
-	/* init objects */
-	listenObjs->next = NULL;
-	freeList = listenObjs;
-	for(size_t i = 1; i < LISTENER_COUNT; i++) {
-		listenObjs[i].next = freeList;
-		freeList = listenObjs + i;
-	}
+	for(size_t i = 0; i < SMP::getCPUCount(); ++i)
+		perCPU[i].deadline = NO_DEADLINE;
 }
 
-int TimerBase::sleepFor(tid_t tid,time_t msecs,bool block) {
-	LockGuard<SpinLock> g(&lock);
-	Listener *l = freeList;
-	if(l == NULL)
-		return -ENOMEM;
-
-	/* remove from freelist */
-	freeList = freeList->next;
-	/* find place and calculate time */
-	l->tid = tid;
-	time_t msecDiff = 0;
-	Listener *p = NULL;
-	Listener *nl;
-	for(nl = listener; nl != NULL; p = nl, nl = nl->next) {
-		if(msecDiff + nl->time > msecs)
-			break;
-		msecDiff += nl->time;
+int TimerBase::sleepFor(tid_t tid,uint64_t usecs,bool block) {
+	Thread *t = Thread::getById(tid);
+	Listener *l = &t->timerListener;
+
+	/* a thread can only be in the heap once */
+	removeThread(tid);
+
+	/* periodic timer-devices interrupt CPU 0 only. otherwise, the current CPU gets the listener,
+	 * so that we only need to program our own timer-device */
+	cpuid_t cpu = archIsOneShot() ? SMP::getCurId() : 0;
+	PerCPU *pc = perCPU + cpu;
+	LockGuard<SpinLock> g(&pc->lock);
+	if(pc->count == pc->size) {
+		size_t nsize = esc::Util::max(pc->size * 2,INITIAL_HEAP_SIZE);
+		Listener **nheap = (Listener**)Cache::realloc(pc->heap,nsize * sizeof(Listener*));
+		if(nheap == NULL)
+			return -ENOMEM;
+		pc->heap = nheap;
+		pc->size = nsize;
 	}
 
-	l->time = msecs - msecDiff;
+	l->time = getTimestamp() + usecs;
 	l->block = block;
-	/* insert entry */
-	l->next = nl;
-	if(p)
-		p->next = l;
-	else
-		listener = l;
+	l->cpu = cpu;
+	enqueue(pc,l);
 
-	/* now change time of next one */
-	if(nl)
-		nl->time -= l->time;
+	/* wake us up earlier, if necessary */
+	if(archIsOneShot() && l->time < pc->deadline)
+		reprogram(pc);
 
 	/* put process to sleep */
 	if(block)
-		Thread::getById(tid)->block();
+		t->block();
 	return 0;
 }
 
 void TimerBase::removeThread(tid_t tid) {
-	LockGuard<SpinLock> g(&lock);
-	Listener *p = NULL;
-	for(Listener *l = listener; l != NULL; p = l, l = l->next) {
-		if(l->tid == tid) {
-			/* increase time of next */
-			if(l->next)
-				l->next->time += l->time;
-			/* remove from list */
-			if(p)
-				p->next = l->next;
-			else
-				listener = l->next;
-			/* put on freelist */
-			l->next = freeList;
-			freeList = l;
-			/* it's not possible to be in the list twice */
+	Thread *t = Thread::getById(tid);
+	if(t == NULL)
+		return;
+
+	Listener *l = &t->timerListener;
+	/* if it's not queued, it can't be queued concurrently, because only the thread itself is put
+	 * to sleep. but the timer-interrupt might remove it concurrently */
+	while(l->index != NOT_QUEUED) {
+		cpuid_t cpu = l->cpu;
+		LockGuard<SpinLock> g(&perCPU[cpu].lock);
+		if(l->index != NOT_QUEUED && l->cpu == cpu) {
+			dequeue(perCPU + cpu,l);
 			break;
 		}
 	}
 }
 
+void TimerBase::startSlice(cpuid_t cpu,bool idle) {
+	PerCPU *pc = perCPU + cpu;
+	pc->lastResched = getTimestamp();
+	pc->idle = idle;
+	if(archIsOneShot()) {
+		LockGuard<SpinLock> g(&pc->lock);
+		reprogram(pc);
+	}
+}
+
 bool TimerBase::intrpt() {
-	bool res,foundThread = false;
-	time_t timeInc = 1000 / FREQUENCY_DIV;
+	bool foundThread = false;
 	cpuid_t cpu = Thread::getRunning()->getCPU();
+	PerCPU *pc = perCPU + cpu;
+
+	pc->timerIntrpts++;
+	uint64_t now = getTimestamp();
+
+	/* idle CPUs don't get interrupts anymore, so let the first one that notices it do the update.
+	 * claim it with a compare-and-swap instead of a global lock that every interrupt would hit. */
+	uint64_t last = lastRuntimeUpdate;
+	if((now - last) >= RUNTIME_UPDATE_INTVAL * 1000 &&
+			Atomic::cmpnswap(&lastRuntimeUpdate,last,now)) {
+		Thread::updateRuntimes();
+		SMP::updateRuntimes();
+	}
 
-	perCPU[cpu].timerIntrpts++;
-	perCPU[cpu].elapsedMsecs += timeInc;
-
-	if(cpu == 0) {
-		if((perCPU[cpu].elapsedMsecs - lastRuntimeUpdate) >= RUNTIME_UPDATE_INTVAL) {
-			Thread::updateRuntimes();
-			SMP::updateRuntimes();
-			lastRuntimeUpdate = perCPU[cpu].elapsedMsecs;
-		}
-
+	{
 		/* look if there are threads to wakeup */
-		LockGuard<SpinLock> g(&lock);
-		for(Listener *l = listener; l != NULL; ) {
-			/* stop if we have to continue waiting for this one */
-			/* note that multiple listeners may have l->time = 0 */
-			if(l->time > timeInc) {
-				l->time -= timeInc;
-				break;
-			}
+		LockGuard<SpinLock> g(&pc->lock);
+		/* a one-shot device is disarmed now */
+		pc->deadline = NO_DEADLINE;
+		while(pc->count > 0 && pc->heap[0]->time <= now) {
+			Listener *l = pc->heap[0];
+			dequeue(pc,l);
 
-			timeInc -= l->time;
 			/* wake up thread */
-			Thread *t = Thread::getById(l->tid);
 			if(l->block) {
-				t->unblock();
+				l->thread->unblock();
 				foundThread = true;
 			}
 			else
-				Signals::addSignalFor(t,SIGALRM);
-			/* remove from list */
-			listener = l->next;
-			Listener *tl = l->next;
-			/* put on freelist */
-			l->next = freeList;
-			freeList = l;
-			/* to next */
-			l = tl;
+				Signals::addSignalFor(l->thread,SIGALRM);
+		}
+
+		/* if a process has been waked up or the time-slice is over, reschedule */
+		if(foundThread || (!pc->idle && (now - pc->lastResched) >= TIMESLICE)) {
+			pc->lastResched = now;
+			return true;
 		}
+
+		/* otherwise, continue with the current thread until its slice or the next listener ends */
+		if(archIsOneShot())
+			reprogram(pc);
 	}
+	return false;
+}
+
+void TimerBase::reprogram(PerCPU *pc) {
+	uint64_t deadline = pc->idle ? NO_DEADLINE : pc->lastResched + TIMESLICE;
+	if(pc->count > 0 && pc->heap[0]->time < deadline)
+		deadline = pc->heap[0]->time;
+	/* if the device is already programmed for that point in time, we're done */
+	if(deadline == pc->deadline)
+		return;
+
+	pc->deadline = deadline;
+	archProgram(deadline);
+}
+
+void TimerBase::enqueue(PerCPU *pc,Listener *l) {
+	place(pc,l,pc->count++);
+	siftUp(pc,l->index);
+}
+
+void TimerBase::dequeue(PerCPU *pc,Listener *l) {
+	size_t i = l->index;
+	Listener *last = pc->heap[--pc->count];
+	l->index = NOT_QUEUED;
+	if(last != l) {
+		place(pc,last,i);
+		siftUp(pc,i);
+		siftDown(pc,last->index);
+	}
+}
+
+void TimerBase::siftUp(PerCPU *pc,size_t i) {
+	Listener *l = pc->heap[i];
+	while(i > 0) {
+		size_t parent = (i - 1) / 2;
+		if(pc->heap[parent]->time <= l->time)
+			break;
+		place(pc,pc->heap[parent],i);
+		i = parent;
+	}
+	place(pc,l,i);
+}
 
-	/* if a process has been waked up or the time-slice is over, reschedule */
-	res = false;
-	if(foundThread || (perCPU[cpu].elapsedMsecs - perCPU[cpu].lastResched) >= TIMESLICE) {
-		perCPU[cpu].lastResched = perCPU[cpu].elapsedMsecs;
-		res = true;
+void TimerBase::siftDown(PerCPU *pc,size_t i) {
+	Listener *l = pc->heap[i];
+	while(true) {
+		size_t child = i * 2 + 1;
+		if(child >= pc->count)
+			break;
+		if(child + 1 < pc->count && pc->heap[child + 1]->time < pc->heap[child]->time)
+			child++;
+		if(l->time <= pc->heap[child]->time)
+			break;
+		place(pc,pc->heap[child],i);
+		i = child;
 	}
-	return res;
+	place(pc,l,i);
 }
 
 void TimerBase::print(OStream &os) {
+	uint64_t now = getTimestamp();
 	os.writef("Timer-Listener:\n");
-	time_t time = 0;
-	for(Listener *l = listener; l != NULL; l = l->next) {
-		time += l->time;
-		os.writef("	diff=%u ms, rem=%u ms, thread=%d(%s), block=%d\n",l->time,time,l->tid,
-				Thread::getById(l->tid)->getProc()->getProgram(),l->block);
+	for(size_t cpu = 0; cpu < SMP::getCPUCount(); ++cpu) {
+		PerCPU *pc = perCPU + cpu;
+		os.writef("	CPU %zu (deadline=%Lu us):\n",cpu,pc->deadline);
+		for(size_t i = 0; i < pc->count; ++i) {
+			Listener *l = pc->heap[i];
+			os.writef("		time=%Lu us, rem=%Lu us, thread=%d(%s), block=%d\n",l->time,
+				l->time > now ? l->time - now : 0,l->thread->getTid(),
+				l->thread->getProc()->getProgram(),l->block);
+		}
 	}
 }
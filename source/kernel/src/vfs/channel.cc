@@ -40,6 +40,8 @@
 #include <string.h>
 #include <video.h>
 
+ObjCache VFSChannel::msgCache("Message",sizeof(VFSChannel::Message) + VFSChannel::Message::CACHED_SIZE);
+
 VFSChannel::VFSChannel(const fs::User &u,VFSNode *p,bool &success)
 		/* permissions are basically irrelevant here since the userland can't open a channel directly. */
 		/* but in order to allow devices to be created by non-root users, give permissions for everyone */
@@ -66,8 +68,16 @@ void VFSChannel::invalidate() {
 	static_cast<VFSDevice*>(getParent())->chanRemoved(this);
 
 	// we only get here if the node has no references left. so it's safe to access the lists.
-	recvList.deleteAll();
-	sendList.deleteAll();
+	destroyAll(recvList);
+	destroyAll(sendList);
+}
+
+void VFSChannel::destroyAll(esc::SList<Message> &list) {
+	for(auto it = list.begin(); it != list.end(); ) {
+		auto old = it++;
+		Message::destroy(&*old);
+	}
+	list.clear();
 }
 
 int VFSChannel::isSupported(int op) const {
@@ -500,6 +510,14 @@ ssize_t VFSChannel::receive(ushort flags,msgid_t *id,void *data,size_t size) {
 	return static_cast<VFSDevice*>(parent)->receive(this,flags,id,data,size);
 }
 
+ssize_t VFSChannel::sendv(ushort flags,struct msgvec *vec,size_t count) {
+	return static_cast<VFSDevice*>(parent)->sendv(this,flags,vec,count);
+}
+
+ssize_t VFSChannel::receivev(ushort flags,struct msgvec *vec,size_t count) {
+	return static_cast<VFSDevice*>(parent)->receivev(this,flags,vec,count);
+}
+
 void VFSChannel::print(OStream &os) const {
 	const esc::SList<Message> *lists[] = {&sendList,&recvList};
 	os.writef("%-8s: snd=%zu rcv=%zu closed=%d handler=%d fd=%02d shm=%zuK\n",
@@ -224,12 +224,7 @@ int VFSDevice::send(VFSChannel *chan,ushort flags,msgid_t id,USER const void *da
 
 		if(~flags & VFS_DEVICE) {
 			/* for clients, we generate a new unique request-id */
-			id &= 0xFFFF;
-			/* prevent to set the MSB. otherwise the return-value would be negative (on 32-bit) */
-			id |= ((nextRid++) & 0x7FFF) << 16;
-			/* it can't be 0. this is a special value */
-			if(id >> 16 == 0)
-				id |= 0x00010000;
+			id = genRequestId(id);
 
 			/* notify driver */
 			addMsgs(1);
@@ -268,19 +263,190 @@ int VFSDevice::send(VFSChannel *chan,ushort flags,msgid_t id,USER const void *da
 	return id;
 
 errorMsg2:
-	delete msg2;
+	VFSChannel::Message::destroy(msg2);
 errorMsg1:
-	delete msg1;
+	VFSChannel::Message::destroy(msg1);
+	return res;
+}
+
+ssize_t VFSDevice::sendv(VFSChannel *chan,ushort flags,struct msgvec *vec,size_t count) {
+	VFSChannel::Message *msgs[MAX_MSGV_COUNT];
+	esc::SList<VFSChannel::Message> *list;
+	ssize_t res;
+	size_t i;
+
+	if(EXPECT_FALSE(!isAlive()))
+		return -EDESTROYED;
+	if(EXPECT_FALSE(count == 0 || count > MAX_MSGV_COUNT))
+		return -EINVAL;
+
+	/* devices write to the receive-list, other processes to the send-list (see send()) */
+	list = (flags & VFS_DEVICE) ? &chan->recvList : &chan->sendList;
+
+	/* create all messages first, because copying the data might fail or cause page faults */
+	for(i = 0; i < count; ++i) {
+		if(EXPECT_FALSE(vec[i].size > VFSChannel::Message::MAX_SIZE)) {
+			res = -EINVAL;
+			goto error;
+		}
+
+		msgs[i] = new (vec[i].size) VFSChannel::Message(vec[i].size);
+		if(EXPECT_FALSE(msgs[i] == NULL)) {
+			res = -ENOMEM;
+			goto error;
+		}
+
+		if(EXPECT_TRUE(vec[i].data)) {
+			if(EXPECT_FALSE((res = UserAccess::read(msgs[i] + 1,vec[i].data,vec[i].size)) < 0)) {
+				VFSChannel::Message::destroy(msgs[i]);
+				goto error;
+			}
+		}
+	}
+
+	{
+		/* now append them all at once, so that the receiver is woken up only once */
+		LockGuard<SpinLock> g(&msgLock);
+
+		for(i = 0; i < count; ++i) {
+			if(~flags & VFS_DEVICE)
+				vec[i].id = genRequestId(vec[i].id);
+			msgs[i]->id = vec[i].id;
+			list->append(msgs[i]);
+		}
+
+		if(~flags & VFS_DEVICE) {
+			addMsgs(count);
+			Sched::wakeup(EV_CLIENT,(evobj_t)this,true);
+		}
+		else
+			Sched::wakeup(EV_RECEIVED_MSG,(evobj_t)chan,true);
+	}
+	return count;
+
+error:
+	while(i-- > 0)
+		VFSChannel::Message::destroy(msgs[i]);
 	return res;
 }
 
 ssize_t VFSDevice::receive(VFSChannel *chan,ushort flags,msgid_t *id,USER void *data,size_t size) {
+	VFSChannel::Message *msg;
+	ssize_t res;
+
+	if(EXPECT_FALSE((res = waitMsg(chan,flags,*id,&msg)) < 0))
+		return res;
+
+	if(flags & VFS_DEVICE)
+		remMsgs(1);
+	msgLock.up();
+
+#if PRINT_MSGS
+	Thread *t = Thread::getRunning();
+	Proc *p = Proc::getByPid(pid);
+	Log::get().writef("%2d:%2d(%-12.12s) <- %5u:%5u (%4d b) %#x (%s)\n",
+			t->getTid(),pid,p ? p->getProgram() : "??",msg->id >> 16,msg->id & 0xFFFF,
+			msg->length,chan,getPath());
+#endif
+
+	if(EXPECT_FALSE(data && msg->length > size)) {
+		Log::get().writef("INVALID: len=%zu, size=%zu\n",msg->length,size);
+		VFSChannel::Message::destroy(msg);
+		return -EINVAL;
+	}
+
+	/* copy data and id */
+	if(EXPECT_TRUE(data)) {
+		if(EXPECT_FALSE((res = UserAccess::write(data,msg + 1,msg->length)) < 0)) {
+			VFSChannel::Message::destroy(msg);
+			return res;
+		}
+	}
+	if(EXPECT_TRUE(id))
+		*id = msg->id;
+
+	res = msg->length;
+	VFSChannel::Message::destroy(msg);
+	return res;
+}
+
+ssize_t VFSDevice::receivev(VFSChannel *chan,ushort flags,struct msgvec *vec,size_t count) {
+	VFSChannel::Message *msgs[MAX_MSGV_COUNT];
+	VFSChannel::Message *msg;
+	ssize_t res;
+	size_t n = 0;
+
+	/* only the driver can receive multiple messages, because clients wait for specific ids */
+	if(EXPECT_FALSE(~flags & VFS_DEVICE))
+		return -EINVAL;
+	if(EXPECT_FALSE(count == 0 || count > MAX_MSGV_COUNT))
+		return -EINVAL;
+
+	if(EXPECT_FALSE((res = waitMsg(chan,flags,0,&msg)) < 0))
+		return res;
+
+	/* take all messages that are already there and fit into the buffers. if the first one doesn't
+	 * fit, we take only that one and fail below, as receive() does. a message with the same id as
+	 * its predecessor carries the data of it (see send()) and is left for the handler of that
+	 * request, which fetches it via receive() */
+	msgs[n++] = msg;
+	if(EXPECT_TRUE(!vec[0].data || msg->length <= vec[0].size)) {
+		while(n < count && chan->sendList.length() > 0) {
+			const VFSChannel::Message *next = &*chan->sendList.begin();
+			if(next->id == msgs[n - 1]->id || (vec[n].data && next->length > vec[n].size))
+				break;
+			msgs[n++] = chan->sendList.removeFirst();
+		}
+	}
+	remMsgs(n);
+	msgLock.up();
+
+	if(EXPECT_FALSE(vec[0].data && msgs[0]->length > vec[0].size)) {
+		Log::get().writef("INVALID: len=%zu, size=%zu\n",msgs[0]->length,vec[0].size);
+		VFSChannel::Message::destroy(msgs[0]);
+		return -EINVAL;
+	}
+
+	/* copy data, ids and sizes */
+	size_t i;
+	for(i = 0; i < n; ++i) {
+		if(EXPECT_TRUE(vec[i].data)) {
+			if(EXPECT_FALSE((res = UserAccess::write(vec[i].data,msgs[i] + 1,msgs[i]->length)) < 0))
+				break;
+		}
+		vec[i].id = msgs[i]->id;
+		vec[i].size = msgs[i]->length;
+		VFSChannel::Message::destroy(msgs[i]);
+	}
+
+	/* if that failed, put the remaining messages back in front of the list, so that they are not
+	 * lost. the caller gets the messages that have been copied so far, if any */
+	if(EXPECT_FALSE(i < n)) {
+		LockGuard<SpinLock> g(&msgLock);
+		for(size_t j = n; j-- > i; )
+			chan->sendList.insert(NULL,msgs[j]);
+		addMsgs(n - i);
+		Sched::wakeup(EV_CLIENT,(evobj_t)this,true);
+		return i > 0 ? static_cast<ssize_t>(i) : res;
+	}
+	return n;
+}
+
+msgid_t VFSDevice::genRequestId(msgid_t id) {
+	id &= 0xFFFF;
+	/* prevent to set the MSB. otherwise the return-value would be negative (on 32-bit) */
+	id |= ((nextRid++) & 0x7FFF) << 16;
+	/* it can't be 0. this is a special value */
+	if(id >> 16 == 0)
+		id |= 0x00010000;
+	return id;
+}
+
+int VFSDevice::waitMsg(VFSChannel *chan,ushort flags,msgid_t mid,VFSChannel::Message **msg) {
 	esc::SList<VFSChannel::Message> *list;
 	Thread *t = Thread::getRunning();
 	VFSNode *waitNode;
-	VFSChannel::Message *msg;
 	size_t event;
-	ssize_t res;
 
 	/* determine list and event to use */
 	if(flags & VFS_DEVICE) {
@@ -296,7 +462,7 @@ ssize_t VFSDevice::receive(VFSChannel *chan,ushort flags,msgid_t *id,USER void *
 
 	/* wait until a message arrives */
 	msgLock.down();
-	while((msg = getMsg(list,*id,flags)) == NULL) {
+	while((*msg = getMsg(list,mid,flags)) == NULL) {
 		if(EXPECT_FALSE((flags & (VFS_NOBLOCK | VFS_BLOCK)) == VFS_NOBLOCK)) {
 			msgLock.up();
 			return -EWOULDBLOCK;
@@ -324,35 +490,8 @@ ssize_t VFSDevice::receive(VFSChannel *chan,ushort flags,msgid_t *id,USER void *
 			return -EDESTROYED;
 		}
 	}
-
-	if(event == EV_CLIENT)
-		remMsgs(1);
-	msgLock.up();
-
-#if PRINT_MSGS
-	Proc *p = Proc::getByPid(pid);
-	Log::get().writef("%2d:%2d(%-12.12s) <- %5u:%5u (%4d b) %#x (%s)\n",
-			t->getTid(),pid,p ? p->getProgram() : "??",msg->id >> 16,msg->id & 0xFFFF,
-			msg->length,chan,getPath());
-#endif
-
-	if(EXPECT_FALSE(data && msg->length > size)) {
-		Log::get().writef("INVALID: len=%zu, size=%zu\n",msg->length,size);
-		delete msg;
-		return -EINVAL;
-	}
-
-	/* copy data and id */
-	if(EXPECT_TRUE(data)) {
-		if(EXPECT_FALSE((res = UserAccess::write(data,msg + 1,msg->length)) < 0))
-			return res;
-	}
-	if(EXPECT_TRUE(id))
-		*id = msg->id;
-
-	res = msg->length;
-	delete msg;
-	return res;
+	/* the caller releases the lock */
+	return 0;
 }
 
 VFSChannel::Message *VFSDevice::getMsg(esc::SList<VFSChannel::Message> *list,msgid_t mid,ushort flags) {
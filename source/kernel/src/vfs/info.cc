@@ -200,7 +200,7 @@ void VFSInfo::statsReadCallback(A_UNUSED VFSNode *node,size_t *dataSize,void **b
 		"Threads:",Thread::getCount(),
 		"Interrupts:",Interrupts::getCount(),
 		"CPUCycles:",cycles.val64,
-		"UpTime:",Timer::getIntrptCount() / Timer::FREQUENCY_DIV
+		"UpTime:",(size_t)(Timer::getTimestamp() / 1000000)
 	);
 	*buffer = os.keepString();
 	*dataSize = os.getLength();
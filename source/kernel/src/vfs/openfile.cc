@@ -377,6 +377,29 @@ ssize_t OpenFile::receiveMsg(msgid_t *id,USER void *data,size_t size,uint fflags
 	return static_cast<VFSChannel*>(node)->receive(newflags,id,data,size);
 }
 
+ssize_t OpenFile::sendMsgv(struct msgvec *vec,size_t count) {
+	if(EXPECT_FALSE(!IS_CHANNEL(node->getMode())))
+		return -ENOTSUP;
+
+	/* see sendMsg() */
+	if(EXPECT_FALSE(!(flags & (VFS_MSGS | VFS_DEVICE)))) {
+		for(size_t i = 0; i < count; ++i) {
+			if(!isDeviceMsg(vec[i].id & 0xFFFF))
+				return -EACCES;
+		}
+	}
+
+	return static_cast<VFSChannel*>(node)->sendv(flags,vec,count);
+}
+
+ssize_t OpenFile::receiveMsgv(struct msgvec *vec,size_t count,uint fflags) {
+	if(EXPECT_FALSE(!IS_CHANNEL(node->getMode())))
+		return -ENOTSUP;
+
+	uint newflags = (flags & ~fflags) | fflags;
+	return static_cast<VFSChannel*>(node)->receivev(newflags,vec,count);
+}
+
 int OpenFile::truncate(off_t length) {
 	if(EXPECT_FALSE(!(flags & VFS_WRITE)))
 		return -EACCES;
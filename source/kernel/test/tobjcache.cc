@@ -0,0 +1,111 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include <mem/objcache.h>
+#include <sys/test.h>
+#include <common.h>
+#include <string.h>
+
+#include "testutils.h"
+
+/* forward declarations */
+static void test_objcache();
+static void test_objcache_reuse();
+static void test_objcache_align();
+static void test_objcache_ctor();
+
+static const uint TEST_COUNT    = 100;
+
+/* our test-module */
+sTestModule tModObjCache = {
+	"Object cache",
+	&test_objcache
+};
+
+static void test_ctor(void *obj) {
+	memset(obj,0x55,24);
+}
+
+static ObjCache reuseCache("test-reuse",20);
+static ObjCache alignCache("test-align",40,64);
+static ObjCache ctorCache("test-ctor",24,sizeof(ulong),test_ctor);
+
+static void test_objcache() {
+	test_objcache_reuse();
+	test_objcache_align();
+	test_objcache_ctor();
+}
+
+static void test_objcache_reuse() {
+	void *objs[TEST_COUNT];
+	test_caseStart("Allocating and freeing objects");
+
+	for(uint i = 0; i < TEST_COUNT; ++i) {
+		objs[i] = reuseCache.alloc();
+		test_assertTrue(objs[i] != NULL);
+		memset(objs[i],i,reuseCache.getObjSize());
+	}
+	for(uint i = 0; i < TEST_COUNT; ++i) {
+		uint8_t *bytes = (uint8_t*)objs[i];
+		for(size_t j = 0; j < reuseCache.getObjSize(); ++j)
+			test_assertUInt(bytes[j],i & 0xFF);
+	}
+	size_t occ = reuseCache.getOccMem();
+	for(uint i = 0; i < TEST_COUNT; ++i)
+		reuseCache.free(objs[i]);
+
+	/* the objects should be reused */
+	for(uint i = 0; i < TEST_COUNT; ++i)
+		objs[i] = reuseCache.alloc();
+	test_assertSize(reuseCache.getOccMem(),occ);
+	for(uint i = 0; i < TEST_COUNT; ++i)
+		reuseCache.free(objs[i]);
+
+	test_caseSucceeded();
+}
+
+static void test_objcache_align() {
+	void *objs[TEST_COUNT];
+	test_caseStart("Alignment of objects");
+
+	for(uint i = 0; i < TEST_COUNT; ++i) {
+		objs[i] = alignCache.alloc();
+		test_assertTrue(objs[i] != NULL);
+		test_assertSize((uintptr_t)objs[i] & 63,0);
+	}
+	for(uint i = 0; i < TEST_COUNT; ++i)
+		alignCache.free(objs[i]);
+
+	test_caseSucceeded();
+}
+
+static void test_objcache_ctor() {
+	test_caseStart("Constructor is called for every object");
+
+	for(uint i = 0; i < TEST_COUNT; ++i) {
+		uint8_t *obj = (uint8_t*)ctorCache.alloc();
+		test_assertTrue(obj != NULL);
+		for(size_t j = 0; j < 24; ++j)
+			test_assertUInt(obj[j],0x55);
+		/* destroy it to see whether the constructor is called again */
+		memset(obj,0,24);
+		ctorCache.free(obj);
+	}
+
+	test_caseSucceeded();
+}
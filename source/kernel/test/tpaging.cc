@@ -32,6 +32,7 @@
 /* forward declarations */
 static void test_paging();
 static void test_paging_foreign();
+static void test_paging_large();
 static bool test_paging_cycle(uintptr_t addr,size_t count);
 static void test_paging_allocate(uintptr_t addr,size_t count);
 static void test_paging_access(uintptr_t addr,size_t count);
@@ -56,6 +57,7 @@ static void test_paging() {
 	}
 
 	test_paging_foreign();
+	test_paging_large();
 }
 
 static void test_paging_foreign() {
@@ -119,6 +121,59 @@ static void test_paging_foreign() {
 #endif
 }
 
+static void test_paging_large() {
+	PageDir *pdir = Proc::getCurPageDir();
+	PageTables::NoAllocator noalloc;
+	size_t large = PageTables::LARGE_PAGE_COUNT;
+	uintptr_t addr = 0x40000000;
+	/* map physical memory that starts at an aligned frame; we only look at the mappings */
+	frameno_t frame = large;
+	size_t count = large * 2 + 3;
+	if(!PageTables::LARGE_PAGE_SIZE)
+		return;
+
+	test_caseStart("Mapping %zu pages to %p with large pages",count,addr);
+	checkMemoryBefore(true);
+
+	size_t pages = pdir->getPageCount();
+	PageTables::RangeAllocator ralloc(frame);
+	test_assertInt(pdir->map(addr,count,ralloc,PG_PRESENT),0);
+	test_assertSize(pdir->getPageCount(),pages + count);
+	for(size_t i = 0; i < count; i += 7)
+		test_assertSize(pdir->getFrameNo(addr + i * PAGE_SIZE),frame + i);
+
+	/* change the flags of a single page, which splits the first large page */
+	test_assertInt(pdir->map(addr + PAGE_SIZE,1,noalloc,PG_PRESENT | PG_WRITABLE),0);
+	test_assertSize(pdir->getPageCount(),pages + count);
+	for(size_t i = 0; i < large; i += 7)
+		test_assertSize(pdir->getFrameNo(addr + i * PAGE_SIZE),frame + i);
+
+	/* remove a part of the second large page */
+	test_assertInt(pdir->unmap(addr + (large + 1) * PAGE_SIZE,2,noalloc),0);
+	test_assertTrue(pdir->isPresent(addr + large * PAGE_SIZE));
+	test_assertFalse(pdir->isPresent(addr + (large + 1) * PAGE_SIZE));
+	test_assertFalse(pdir->isPresent(addr + (large + 2) * PAGE_SIZE));
+	test_assertSize(pdir->getFrameNo(addr + (large + 3) * PAGE_SIZE),frame + large + 3);
+	test_assertSize(pdir->getPageCount(),pages + count - 2);
+
+	pdir->unmap(addr,count,noalloc);
+	test_assertSize(pdir->getPageCount(),pages);
+
+	/* a page-table without present pages (e.g., for demand-loading) is replaced by a large page */
+	test_assertInt(pdir->map(addr,large,noalloc,0),0);
+	test_assertFalse(pdir->isLargePage(addr));
+	PageTables::RangeAllocator ralloc2(frame);
+	test_assertInt(pdir->map(addr,large,ralloc2,PG_PRESENT),0);
+	test_assertTrue(pdir->isLargePage(addr));
+	test_assertSize(pdir->getFrameNo(addr + 5 * PAGE_SIZE),frame + 5);
+	test_assertSize(pdir->getPageCount(),pages + large);
+	pdir->unmap(addr,large,noalloc);
+	test_assertSize(pdir->getPageCount(),pages);
+
+	checkMemoryAfter(true);
+	test_caseSucceeded();
+}
+
 static bool test_paging_cycle(uintptr_t addr,size_t count) {
 	Thread *t = Thread::getRunning();
 	test_caseStart("Mapping %zu pages to %p",count,addr);
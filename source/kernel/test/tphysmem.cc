@@ -28,8 +28,10 @@
 /* forward declarations */
 static void test_mm();
 static void test_default();
+static void test_bulk();
 static void test_contiguous();
 static void test_contiguous_align();
+static void test_contiguous_coalesce();
 static void test_mm_allocate();
 static void test_mm_free();
 
@@ -43,8 +45,10 @@ static frameno_t frames[FRAME_COUNT];
 
 static void test_mm() {
 	test_default();
+	test_bulk();
 	test_contiguous();
 	test_contiguous_align();
+	test_contiguous_coalesce();
 }
 
 static void test_default() {
@@ -58,6 +62,18 @@ static void test_default() {
 	test_caseSucceeded();
 }
 
+static void test_bulk() {
+	test_caseStart("Requesting and freeing %d frames at once",FRAME_COUNT);
+
+	checkMemoryBefore(false);
+	size_t count = PhysMem::allocate(PhysMem::KERN,FRAME_COUNT,frames);
+	test_assertSize(count,FRAME_COUNT);
+	PhysMem::free(frames,count,PhysMem::KERN);
+	checkMemoryAfter(false);
+
+	test_caseSucceeded();
+}
+
 static void test_contiguous() {
 	ssize_t res1,res2,res3,res4;
 
@@ -166,6 +182,38 @@ static void test_contiguous_align() {
 	test_caseSucceeded();
 }
 
+static void test_contiguous_coalesce() {
+	ssize_t res[8];
+
+	test_caseStart("[Coalesce] Request pieces, free in mixed order and request all at once");
+	checkMemoryBefore(false);
+	res[0] = PhysMem::allocateContiguous(64,64);
+	test_assertTrue(res[0] >= 0 && (res[0] % 64) == 0);
+	PhysMem::freeContiguous(res[0],64);
+	for(size_t i = 0; i < ARRAY_SIZE(res); ++i) {
+		res[i] = PhysMem::allocateContiguous(8,8);
+		test_assertTrue(res[i] >= 0 && (res[i] % 8) == 0);
+	}
+	for(size_t i = 0; i < ARRAY_SIZE(res); i += 2)
+		PhysMem::freeContiguous(res[i],8);
+	for(size_t i = 1; i < ARRAY_SIZE(res); i += 2)
+		PhysMem::freeContiguous(res[i],8);
+	res[0] = PhysMem::allocateContiguous(64,64);
+	test_assertTrue(res[0] >= 0 && (res[0] % 64) == 0);
+	PhysMem::freeContiguous(res[0],64);
+	checkMemoryAfter(false);
+	test_caseSucceeded();
+
+	test_caseStart("[Coalesce] Free single frames of a contiguous range");
+	checkMemoryBefore(false);
+	res[0] = PhysMem::allocateContiguous(7,1);
+	test_assertTrue(res[0] >= 0);
+	for(ssize_t i = 6; i >= 0; --i)
+		PhysMem::freeContiguous(res[0] + i,1);
+	checkMemoryAfter(false);
+	test_caseSucceeded();
+}
+
 static void test_mm_allocate() {
 	ssize_t i = 0;
 	while(i < FRAME_COUNT) {
@@ -48,6 +48,7 @@ extern sTestModule tModSwapMap;
 extern sTestModule tModVmm;
 extern sTestModule tModPmemAreas;
 extern sTestModule tModCache;
+extern sTestModule tModObjCache;
 
 EXTERN_C void unittest_run();
 EXTERN_C void unittest_start();
@@ -84,6 +85,7 @@ void unittest_run() {
 	test_register(&tModVmm);
 	test_register(&tModPmemAreas);
 	test_register(&tModCache);
+	test_register(&tModObjCache);
 	test_start();
 
 	/* stay here */
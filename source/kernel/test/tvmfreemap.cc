@@ -33,6 +33,7 @@ static void test_vmfree_inOrder();
 static void test_vmfree_revOrder();
 static void test_vmfree_randOrder();
 static void test_vmfree_allocAt();
+static void test_vmfree_allocAligned();
 static void test_vmfree_allocNFree(size_t *sizes,size_t *freeIndices,const char *msg);
 
 /* our test-module */
@@ -46,6 +47,7 @@ static void test_vmfree() {
 	test_vmfree_revOrder();
 	test_vmfree_randOrder();
 	test_vmfree_allocAt();
+	test_vmfree_allocAligned();
 }
 
 static void test_vmfree_inOrder() {
@@ -121,6 +123,37 @@ static void test_vmfree_allocAt() {
 	test_caseSucceeded();
 }
 
+static void test_vmfree_allocAligned() {
+	size_t areas,size = TOTAL_SIZE;
+	test_caseStart("Allocating aligned areas");
+	checkMemoryBefore(false);
+
+	{
+		VMFreeMap map(PAGE_SIZE,size);
+
+		test_assertUIntPtr(map.allocate(2 * PAGE_SIZE,8 * PAGE_SIZE),8 * PAGE_SIZE);
+		test_assertUIntPtr(map.allocate(3 * PAGE_SIZE,8 * PAGE_SIZE),16 * PAGE_SIZE);
+		test_assertUIntPtr(map.allocate(1 * PAGE_SIZE),1 * PAGE_SIZE);
+		/* the gap in front of an aligned area is still usable */
+		test_assertUIntPtr(map.allocate(5 * PAGE_SIZE),2 * PAGE_SIZE);
+		test_assertUIntPtr(map.allocate(4 * PAGE_SIZE,4 * PAGE_SIZE),12 * PAGE_SIZE);
+		/* there is no area at an aligned address with this size */
+		test_assertUIntPtr(map.allocate(TOTAL_SIZE - 16 * PAGE_SIZE,16 * PAGE_SIZE),0);
+
+		map.free(8 * PAGE_SIZE,2 * PAGE_SIZE);
+		map.free(16 * PAGE_SIZE,3 * PAGE_SIZE);
+		map.free(1 * PAGE_SIZE,1 * PAGE_SIZE);
+		map.free(2 * PAGE_SIZE,5 * PAGE_SIZE);
+		map.free(12 * PAGE_SIZE,4 * PAGE_SIZE);
+
+		test_assertSize(map.getSize(&areas),size);
+		test_assertSize(areas,1);
+	}
+
+	checkMemoryAfter(false);
+	test_caseSucceeded();
+}
+
 static void test_vmfree_allocNFree(size_t *sizes,size_t *freeIndices,const char *msg) {
 	size_t areas;
 	uintptr_t addrs[AREA_COUNT];
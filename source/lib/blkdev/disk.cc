@@ -0,0 +1,53 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <blkdev/disk.h>
+#include <esc/ipc/ipcstream.h>
+#include <esc/proto/file.h>
+#include <sys/common.h>
+#include <stdio.h>
+
+namespace blkdev {
+
+void Disk::finish(uint slot,const Request &req,bool success) {
+	if(req.split && !req.split->finish(&success)) {
+		release(slot);
+		return;
+	}
+
+	ulong buf[IPC_DEF_SIZE / sizeof(ulong)];
+	esc::IPCStream is(req.fd,buf,sizeof(buf),req.mid);
+	/* like the ATA driver, report failed transfers with a count of 0 */
+	size_t res = success ? req.count : 0;
+	try {
+		if(req.op == OP_READ) {
+			is << esc::FileRead::Response::success(res) << esc::Reply();
+			if(req.bounce && res > 0)
+				is << esc::ReplyData(bounce(slot),res);
+		}
+		else
+			is << esc::FileWrite::Response::success(res) << esc::Reply();
+	}
+	catch(const std::exception &e) {
+		printe("Unable to answer client %d: %s",req.fd,e.what());
+	}
+	release(slot);
+}
+
+}
@@ -0,0 +1,285 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <blkdev/partdevice.h>
+#include <esc/proto/file.h>
+#include <esc/util.h>
+#include <sys/common.h>
+#include <sys/driver.h>
+#include <sys/messages.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/thread.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace esc;
+
+namespace blkdev {
+
+static std::vector<PartitionDevice*> devs;
+
+PartitionDevice::PartitionDevice(Disk *disk,const Partition *part,const char *name,mode_t mode)
+	: ClientDevice(name,mode,DEV_TYPE_BLOCK,
+		DEV_OPEN | DEV_DELEGATE | DEV_READ | DEV_WRITE | DEV_SIZE | DEV_CLOSE),
+	  _disk(disk), _part(part) {
+	set(MSG_DEV_DELEGATE,std::make_memfun(this,&PartitionDevice::delegate));
+	set(MSG_FILE_READ,std::make_memfun(this,&PartitionDevice::read));
+	set(MSG_FILE_WRITE,std::make_memfun(this,&PartitionDevice::write));
+	set(MSG_FILE_SIZE,std::make_memfun(this,&PartitionDevice::size));
+}
+
+void PartitionDevice::delegate(IPCStream &is) {
+	BlockClient *c = get(is.fd());
+	DevDelegate::Request r;
+	is >> r;
+	assert(c->shm() == NULL && !is.error());
+
+	/* the memory has to stay in place, because the disk accesses it directly. thus, populate and
+	 * lock it and remember the physical address of each page for the transfers. if the disk can't
+	 * reach all pages, we refuse it and the client sends the data via messages instead, which end
+	 * up in the bounce buffers. */
+	int res = -EINVAL;
+	if(r.arg == DEL_ARG_SHFILE) {
+		res = joinshm(c,r.nfd,MAP_POPULATE | MAP_NOSWAP | MAP_LOCKED);
+		if(res == 0) {
+			size_t count = Util::round_page_up(c->sharedmem()->size) / PAGE_SIZE;
+			c->pages = std::vector<uintptr_t>(count);
+			res = mphys(c->shm(),count,c->pages.data());
+			if(res == 0 && !_disk->canAccess(c->pages.data(),count))
+				res = -ENOTSUP;
+			if(res < 0) {
+				c->pages.clear();
+				c->sharedmem(std::shared_ptr<SharedMemory>());
+			}
+		}
+	}
+	is << DevDelegate::Response(res) << Reply();
+}
+
+void PartitionDevice::read(IPCStream &is) {
+	BlockClient *c = get(is.fd());
+	FileRead::Request r;
+	is >> r;
+	assert(!is.error());
+
+	transfer(is,c,Disk::OP_READ,r.offset,r.count,r.shmemoff,_disk->acquire());
+}
+
+void PartitionDevice::write(IPCStream &is) {
+	BlockClient *c = get(is.fd());
+	FileWrite::Request r;
+	is >> r;
+
+	uint slot = _disk->acquire();
+	if(r.shmemoff == -1) {
+		try {
+			is >> ReceiveData(_disk->bounce(slot),Disk::BOUNCE_SIZE);
+		}
+		catch(...) {
+			_disk->release(slot);
+			throw;
+		}
+	}
+	assert(!is.error());
+
+	transfer(is,c,Disk::OP_WRITE,r.offset,r.count,r.shmemoff,slot);
+}
+
+void PartitionDevice::size(IPCStream &is) {
+	is << FileSize::Response::success(_part->size * _disk->secSize()) << Reply();
+}
+
+void PartitionDevice::transfer(IPCStream &is,BlockClient *c,uint op,size_t offset,size_t count,
+		ssize_t shmemoff,uint slot) {
+	size_t secSize = _disk->secSize();
+	uint64_t partBytes = _part->size * secSize;
+
+	if(count == 0) {
+		_disk->release(slot);
+		is << FileRead::Response::success(0) << Reply();
+		return;
+	}
+
+	/* reads are rounded up to whole sectors, writes have to consist of whole sectors */
+	size_t rcount = Util::round_up(count,secSize);
+	bool valid = rcount >= count && (offset % secSize) == 0 &&
+		(op == Disk::OP_READ || rcount == count) &&
+		rcount <= partBytes && offset <= partBytes - rcount;
+
+	Disk::Request req;
+	req.fd = is.fd();
+	req.mid = is.msgid();
+	req.op = op;
+	req.count = count;
+	req.bounce = shmemoff == -1;
+
+	const uintptr_t *pages = NULL;
+	if(shmemoff == -1) {
+		valid = valid && rcount <= Disk::BOUNCE_SIZE;
+		shmemoff = 0;
+	}
+	else {
+		/* DMA needs at least word-aligned buffers */
+		req.shm = c->sharedmem();
+		valid = valid && req.shm && !c->pages.empty() && shmemoff >= 0 && (shmemoff & 1) == 0 &&
+			rcount <= req.shm->size && static_cast<size_t>(shmemoff) <= req.shm->size - rcount;
+		pages = c->pages.data();
+	}
+
+	/* a single transfer can only span a limited number of pages and sectors. thus, larger
+	 * requests are split into multiple parts, each in its own slot */
+	size_t parts = 0;
+	for(size_t rem = rcount, off = shmemoff; valid && rem > 0; ++parts) {
+		size_t bytes = partSize(off,rem,pages != NULL);
+		valid = bytes > 0;
+		off += bytes;
+		rem -= bytes;
+	}
+	if(parts > 1)
+		req.split = std::make_shared<Disk::Split>(parts);
+
+	uint64_t lba = _part->start + offset / secSize;
+	for(size_t i = 0, rem = rcount; valid; ++i) {
+		size_t bytes = partSize(shmemoff,rem,pages != NULL);
+		if(!_disk->submit(slot,lba,bytes / secSize,pages,shmemoff,req)) {
+			if(i == 0)
+				break;
+			/* the parts before are in flight. thus, fail this one and the remaining ones, so
+			 * that the last finished part answers the client */
+			req.split->cancel(parts - i - 1);
+			_disk->finish(slot,req,false);
+			return;
+		}
+
+		rem -= bytes;
+		if(rem == 0)
+			return;
+		lba += bytes / secSize;
+		shmemoff += bytes;
+		slot = _disk->acquire();
+	}
+
+	print("Invalid %s-request: offset=%zu, count=%zu, shmemoff=%zd, partSize=%Lu",
+		op == Disk::OP_READ ? "read" : "write",offset,count,shmemoff,partBytes);
+	_disk->release(slot);
+	is << FileRead::Response::error(-EINVAL) << Reply();
+}
+
+size_t PartitionDevice::partSize(size_t offset,size_t count,bool pages) const {
+	size_t secSize = _disk->secSize();
+	size_t bytes = Util::min(count,_disk->maxSectors() * secSize);
+	/* the first page is only partially covered, if the offset is not page aligned */
+	if(pages)
+		bytes = Util::min(bytes,_disk->maxPages() * PAGE_SIZE - (offset & (PAGE_SIZE - 1)));
+	return bytes - bytes % secSize;
+}
+
+static int deviceThread(void *arg) {
+	PartitionDevice *dev = reinterpret_cast<PartitionDevice*>(arg);
+	dev->bindto(gettid());
+	dev->loop();
+	return 0;
+}
+
+static void createVFSEntry(const Disk *disk,const Partition *part,const char *name) {
+	char path[MAX_PATH_LEN];
+	snprintf(path,sizeof(path),"/sys/dev/%s",name);
+
+	/* open and create file */
+	FILE *f = fopen(path,"w");
+	if(f == NULL) {
+		printe("Unable to open '%s'",path);
+		return;
+	}
+
+	if(part == NULL)
+		disk->printInfo(f);
+	else {
+		fprintf(f,"%-15s%Lu\n","Start:",part->start);
+		fprintf(f,"%-15s%Lu\n","Sectors:",part->size);
+	}
+
+	fclose(f);
+}
+
+static void registerDevices(const std::vector<Disk*> &disks,const char *prefix) {
+	char path[MAX_PATH_LEN] = "/dev/";
+	char *name = path + SSTRLEN("/dev/");
+	size_t namelen = sizeof(path) - SSTRLEN("/dev/");
+	char letter = 'a';
+	for(auto it = disks.begin(); it != disks.end(); ++it, ++letter) {
+		Disk *disk = *it;
+		snprintf(name,namelen,"%s%c",prefix,letter);
+		createVFSEntry(disk,NULL,name);
+
+		/* register device for every partition */
+		for(size_t p = 0; p < Partition::COUNT; p++) {
+			const Partition *part = disk->partitions() + p;
+			if(!part->present)
+				continue;
+
+			snprintf(name,namelen,"%s%c%zu",prefix,letter,p + 1);
+			try {
+				devs.push_back(new PartitionDevice(disk,part,path,0770));
+				print("Registered device '%s' (partition %zu)",name,p + 1);
+				createVFSEntry(disk,part,name);
+			}
+			catch(const std::exception &) {
+				printe("Partition %zu: Unable to register device '%s'",p + 1,name);
+			}
+		}
+	}
+}
+
+void serve(const std::vector<Disk*> &disks,const char *prefix,const char *wait) {
+	registerDevices(disks,prefix);
+	/* flush prints */
+	fflush(stdout);
+
+	/* we're ready now, so create a dummy-vfs-node that tells fs that all devices are registered */
+	{
+		FILE *f = fopen(wait,"w");
+		if(f)
+			fclose(f);
+	}
+
+	/* start device threads */
+	for(size_t i = 1; i < devs.size(); i++) {
+		if(startthread(deviceThread,devs[i]) < 0)
+			error("Unable to start thread");
+	}
+
+	/* mlock all regions to prevent that we're swapped out */
+	if(mlockall() < 0)
+		error("Unable to mlock regions");
+
+	if(devs.size() > 0)
+		deviceThread(devs[0]);
+	else
+		print("No devices. Exiting");
+
+	for(auto it = devs.begin(); it != devs.end(); ++it)
+		delete *it;
+	devs.clear();
+}
+
+}
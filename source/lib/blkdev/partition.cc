@@ -17,49 +17,38 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <blkdev/partition.h>
 #include <sys/common.h>
-#include <stdio.h>
 
-#include "partition.h"
+namespace blkdev {
 
 /* offset of partition-table in MBR */
 static const size_t PART_TABLE_OFFSET	= 0x1BE;
 
-/* a partition on the disk */
-typedef struct {
-	/* Boot indicator bit flag: 0 = no, 0x80 = bootable (or "active") */
+/* a partition entry on the disk */
+struct DiskPart {
 	uint8_t bootable;
-	/* start: Cylinder, Head, Sector */
 	uint8_t startHead;
 	uint16_t startSector : 6,
 		startCylinder: 10;
 	uint8_t systemId;
-	/* end: Cylinder, Head, Sector */
 	uint8_t endHead;
 	uint16_t endSector : 6,
 		endCylinder : 10;
-	/* Relative Sector (to start of partition -- also equals the partition's starting LBA value) */
+	/* the first sector (LBA) */
 	uint32_t start;
-	/* Total Sectors in partition */
+	/* the number of sectors */
 	uint32_t size;
-} A_PACKED sDiskPart;
+} A_PACKED;
 
-void part_fillPartitions(sPartition *table,void *mbr) {
-	size_t i;
-	sDiskPart *src = (sDiskPart*)((uintptr_t)mbr + PART_TABLE_OFFSET);
-	for(i = 0; i < PARTITION_COUNT; i++) {
-		table->present = src->systemId != 0;
-		table->start = src->start;
-		table->size = src->size;
-		table++;
-		src++;
+void Partition::fill(Partition *table,const void *mbr) {
+	const DiskPart *src = reinterpret_cast<const DiskPart*>(
+		reinterpret_cast<uintptr_t>(mbr) + PART_TABLE_OFFSET);
+	for(size_t i = 0; i < COUNT; i++) {
+		table[i].present = src[i].systemId != 0;
+		table[i].start = src[i].start;
+		table[i].size = src[i].size;
 	}
 }
 
-void part_print(sPartition *table) {
-	size_t i;
-	for(i = 0; i < PARTITION_COUNT; i++) {
-		printf("%zu: present=%d start=%zu size=%zu\n",i,table->present,table->start,table->size);
-		table++;
-	}
 }
@@ -24,6 +24,7 @@
 
 int __cxa_atexit(void (*f)(void *),void *p,void *d);
 void __cxa_finalize(void *d);
+extern void exitHeap(void);
 
 int atexit(fExitFunc func) {
 	return __cxa_atexit(func,NULL,NULL);
@@ -34,6 +35,13 @@ void exit(int status) {
 	_exit(status);
 }
 
+void _exit(int status) {
+	/* the thread cache would be lost otherwise */
+	exitHeap();
+	syscall1(SYSCALL_EXIT,status);
+	A_UNREACHED;
+}
+
 void _Exit(int status) {
 	_exit(status);
 }
@@ -23,11 +23,24 @@
 #include <sys/debug.h>
 #include <sys/mman.h>
 #include <sys/sync.h>
+#include <sys/tls.h>
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * The heap uses segregated size classes: every allocation is rounded up to one of CLASS_COUNT
+ * sizes and all free blocks of one class are kept in a singly linked list. Thus, malloc and free
+ * are O(1). Each thread has a cache with such lists, which is used without locking. Only if the
+ * cache runs empty or gets too large, a batch of blocks is moved from or to the global lists,
+ * which are protected by heapSem. Blocks that are larger than the largest class are mapped and
+ * unmapped separately.
+ *
+ * Every block starts with the class, the requested size and a guard and ends with another guard.
+ * Free blocks have FREE_MAGIC as the class and the pointer to the next one as the size.
+ */
+
 #if DEBUGGING
 #define DEBUG_ALLOC_N_FREE		0
 #define DEBUG_ALLOC_N_FREE_PID	27	/* -1 = all */
@@ -39,127 +52,204 @@
 #define GUARD_MAGIC				0xDEADBEEF
 #define FREE_MAGIC				0xFEEEFEEE
 
+/* the class, the size and the guards */
+#define OVERHEAD				(sizeof(ulong) * 4)
+
 #define MIN_MMAP_SIZE			(16 * PAGE_SIZE)
 #define MAX_MMAP_SIZE			(8192 * PAGE_SIZE)
 
-#define MIN_AREA_SIZE			PAGE_SIZE
-#define MAX_AREA_SIZE			(64 * PAGE_SIZE)
-
-/* an area in memory */
-typedef struct sMemArea sMemArea;
-struct sMemArea {
-	size_t size;
-	void *address;
-	sMemArea *next;
+/* 8 classes in steps of 16 bytes up to 128 and 4 classes per power of two above */
+#define CLASS_COUNT				40
+#define CLASS_ALIGN				16
+#define MAX_CLASS_SIZE			32768
+/* the class of blocks that have been mapped separately */
+#define LARGE_CLASS				CLASS_COUNT
+
+/* the number of bytes that are moved between a thread cache and the global lists at once */
+#define BATCH_BYTES				(8 * PAGE_SIZE)
+#define MAX_BATCH				32
+
+/* the free blocks of one thread */
+typedef struct sHeapCache sHeapCache;
+struct sHeapCache {
+	ulong *lists[CLASS_COUNT];
+	size_t counts[CLASS_COUNT];
+	/* the total size of the blocks in the lists */
+	size_t bytes;
+	bool used;
+	sHeapCache *next;
 };
 
 void initHeap(void);
+void exitHeap(void);
 
 /**
- * Allocates a new page for areas
+ * Returns the cache of the current thread and creates it, if necessary
  */
-static bool loadNewAreas(void);
+static sHeapCache *getCache(void);
 
 /**
- * Allocates new space for alloation
+ * Takes a block of class <cls> from the global lists or the current chunk
  */
-static bool loadNewSpace(size_t size);
+static ulong *globalAlloc(size_t cls);
+
+/**
+ * Puts <block> of class <cls> into the global lists
+ */
+static void globalFree(ulong *block,size_t cls);
+
+/**
+ * Moves a batch of blocks of class <cls> from the global lists into <cache>
+ */
+static void refill(sHeapCache *cache,size_t cls);
+
+/**
+ * Moves <count> blocks of class <cls> from <cache> back to the global lists
+ */
+static void drain(sHeapCache *cache,size_t cls,size_t count);
+
+/**
+ * Takes <size> bytes from the current chunk, which are not returned anymore
+ */
+static void *allocRaw(size_t size);
 
 /**
- * Adds memory areas from given memory.
+ * Maps a new chunk with at least <size> bytes
  */
-static void initAreas(void *addr,size_t size);
+static bool loadNewSpace(size_t size);
 
-/* a linked list of free and usable areas. That means the areas have an address and size */
-static sMemArea *usableList = NULL;
-/* a linked list of free but not usable areas. That means the areas have no address and size */
-static sMemArea *freeList = NULL;
+/* the sizes of the classes, including the overhead */
+static size_t classSizes[CLASS_COUNT];
+/* the number of blocks per class that are moved at once */
+static size_t classBatch[CLASS_COUNT];
+/* the global lists of free blocks */
+static ulong *freeLists[CLASS_COUNT];
+static size_t freeCounts[CLASS_COUNT];
+/* the unused rest of the chunk we're currently taking the blocks from */
+static char *chunkPos = NULL;
+static char *chunkEnd = NULL;
+/* the size of the global lists and the rest of the chunk */
+static size_t freeBytes = 0;
+/* all thread caches */
+static sHeapCache *caches = NULL;
+/* the TLS slot with the cache of the current thread */
+static size_t cacheSlot;
 /* total number of pages we're using */
 static size_t pageCount = 0;
 /* current allocation sizes */
 static size_t nextSize = MIN_MMAP_SIZE;
-static size_t nextAreaSize = MIN_AREA_SIZE;
 
 /* the lock for the heap */
 static tUserSem heapSem;
 static bool initialized = false;
 
+static inline size_t sizeToClass(size_t size) {
+	if(size <= 128)
+		return (size - 1) / CLASS_ALIGN;
+
+	/* size - 1 is in (2^p, 2^(p+1)], which is divided into 4 classes */
+	size_t p = sizeof(ulong) * 8 - 1 - __builtin_clzl(size - 1);
+	size_t step = (size_t)1 << (p - 2);
+	return 8 + (p - 7) * 4 + (size - 1 - ((size_t)1 << p)) / step;
+}
+
+static inline void push(ulong **list,ulong *block) {
+	block[0] = FREE_MAGIC;
+	block[1] = (ulong)*list;
+	*list = block;
+}
+
+static inline ulong *pop(ulong **list) {
+	ulong *block = *list;
+	*list = (ulong*)block[1];
+	return block;
+}
+
 void initHeap(void) {
+	size_t i;
 	if(initialized)
 		return;
 
+	for(i = 0; i < CLASS_COUNT; ++i) {
+		if(i < 8)
+			classSizes[i] = (i + 1) * CLASS_ALIGN;
+		else {
+			size_t p = 7 + (i - 8) / 4;
+			classSizes[i] = ((size_t)1 << p) + ((size_t)1 << (p - 2)) * ((i - 8) % 4 + 1);
+		}
+		classBatch[i] = MIN(MAX(BATCH_BYTES / classSizes[i],1),MAX_BATCH);
+	}
+	assert(classSizes[CLASS_COUNT - 1] == MAX_CLASS_SIZE);
+
 	if(usemcrt(&heapSem,1) < 0)
 		error("Unable to create heap lock");
+	cacheSlot = tlsadd();
 	initialized = true;
 }
 
+void exitHeap(void) {
+	size_t i;
+	if(!tlsready())
+		return;
+
+	/* give the blocks back, so that other threads can use them */
+	sHeapCache *cache = (sHeapCache*)tlsget(cacheSlot);
+	if(cache) {
+		usemdown(&heapSem);
+		for(i = 0; i < CLASS_COUNT; ++i)
+			drain(cache,i,cache->counts[i]);
+		cache->used = false;
+		usemup(&heapSem);
+		tlsset(cacheSlot,0);
+	}
+}
+
 void *malloc(size_t size) {
 	ulong *begin;
-	sMemArea *area,*prev,*narea;
+	size_t cls;
 
 	if(size == 0)
 		return NULL;
 
-	usemdown(&heapSem);
-
-	/* align and we need 3 ulongs for the guards */
-	size = ROUND_UP(size,sizeof(ulong)) + sizeof(ulong) * 4;
+	/* align and we need 4 ulongs for the class, size and guards */
+	size = ROUND_UP(size,sizeof(ulong)) + OVERHEAD;
+	if(size < OVERHEAD)
+		return NULL;
 
-	/* find a suitable area */
-	prev = NULL;
-	area = usableList;
-	while(area != NULL) {
-		if(area->size >= size)
-			break;
-		prev = area;
-		area = area->next;
-	}
-
-	/* no area found? */
-	if(area == NULL) {
-		if(!loadNewSpace(size)) {
-			usemup(&heapSem);
-			return NULL;
-		}
-		/* we can assume that it fits */
-		area = usableList;
-		/* remove from usable-list */
-		usableList = area->next;
+	if(EXPECT_FALSE(size > MAX_CLASS_SIZE)) {
+		cls = LARGE_CLASS;
+		begin = (ulong*)mmap(NULL,ROUND_UP(size,PAGE_SIZE),0,PROT_READ | PROT_WRITE,MAP_PRIVATE,-1,0);
 	}
 	else {
-		/* remove from usable-list */
-		if(prev == NULL)
-			usableList = area->next;
-		else
-			prev->next = area->next;
-	}
-
-	/* is there space left? */
-	if(size < area->size) {
-		if(freeList == NULL) {
-			if(!loadNewAreas()) {
-				/* TODO we may have changed something... */
+		cls = sizeToClass(size);
+		sHeapCache *cache = getCache();
+		if(EXPECT_TRUE(cache)) {
+			if(EXPECT_FALSE(cache->lists[cls] == NULL)) {
+				usemdown(&heapSem);
+				refill(cache,cls);
 				usemup(&heapSem);
-				return NULL;
+			}
+			begin = NULL;
+			if(EXPECT_TRUE(cache->lists[cls])) {
+				begin = pop(cache->lists + cls);
+				cache->counts[cls]--;
+				cache->bytes -= classSizes[cls];
 			}
 		}
-
-		/* split the area */
-		narea = freeList;
-		freeList = freeList->next;
-		narea->address = (void*)((uintptr_t)area->address + size);
-		narea->size = area->size - size;
-		area->size = size;
-		/* insert in usable-list */
-		narea->next = usableList;
-		usableList = narea;
+		else {
+			usemdown(&heapSem);
+			begin = globalAlloc(cls);
+			usemup(&heapSem);
+		}
 	}
+	if(begin == NULL)
+		return NULL;
 
 #if DEBUG_ALLOC_N_FREE
 	if(DEBUG_ALLOC_N_FREE_PID == -1 || getpid() == DEBUG_ALLOC_N_FREE_PID) {
 		size_t i = 0;
 		uintptr_t *trace = getStackTrace();
-		debugf("[A] %x %d ",(char*)area->address + 3,area->size);
+		debugf("[A] %x %d ",begin + 3,size);
 		while(*trace && i++ < 10) {
 			debugf("%x",*trace);
 			if(trace[1])
@@ -171,12 +261,10 @@ void *malloc(size_t size) {
 #endif
 
 	/* add guards */
-	begin = (ulong*)area->address;
-	begin[0] = (ulong)area;
-	begin[1] = size - sizeof(ulong) * 4;
+	begin[0] = cls;
+	begin[1] = size - OVERHEAD;
 	begin[2] = GUARD_MAGIC;
 	begin[size / sizeof(ulong) - 1] = GUARD_MAGIC;
-	usemup(&heapSem);
 	return begin + 3;
 }
 
@@ -191,7 +279,7 @@ void *calloc(size_t num,size_t size) {
 
 void free(void *addr) {
 	ulong *begin;
-	sMemArea *area,*a,*prev,*next,*nprev,*pprev,*tprev;
+	size_t cls;
 
 	/* addr may be null */
 	if(addr == NULL)
@@ -199,44 +287,17 @@ void free(void *addr) {
 
 	/* check guards */
 	begin = (ulong*)addr - 3;
-	area = (sMemArea*)begin[0];
 	vassert(begin[0] != FREE_MAGIC,"Duplicate free of %p?",addr);
+	assert(begin[0] <= LARGE_CLASS);
 	assert(begin[2] == GUARD_MAGIC);
 	assert(begin[begin[1] / sizeof(ulong) + 3] == GUARD_MAGIC);
-
-	usemdown(&heapSem);
-
-	/* mark as free */
-	begin[0] = FREE_MAGIC;
-
-	/* find the previous and next free areas */
-	prev = NULL;
-	next = NULL;
-	tprev = NULL;
-	pprev = NULL;
-	nprev = NULL;
-	a = usableList;
-	while(a != NULL) {
-		if((uintptr_t)a->address + a->size == (uintptr_t)begin) {
-			prev = a;
-			pprev = tprev;
-		}
-		if((uintptr_t)a->address == (uintptr_t)begin + area->size) {
-			next = a;
-			nprev = tprev;
-		}
-		/* do we have both? */
-		if(prev && next)
-			break;
-		tprev = a;
-		a = a->next;
-	}
+	cls = begin[0];
 
 #if DEBUG_ALLOC_N_FREE
 	if(DEBUG_ALLOC_N_FREE_PID == -1 || getpid() == DEBUG_ALLOC_N_FREE_PID) {
 		size_t i = 0;
 		uintptr_t *trace = getStackTrace();
-		debugf("[F] %x %d ",addr,area->size);
+		debugf("[F] %x %d ",addr,begin[1] + OVERHEAD);
 		while(*trace && i++ < 10) {
 			debugf("%x",*trace);
 			if(trace[1])
@@ -247,136 +308,65 @@ void free(void *addr) {
 	}
 #endif
 
-	/* see what we have to merge */
-	if(prev && next) {
-		/* merge prev & area & next */
-		area->size += prev->size + next->size;
-		area->address = prev->address;
-		/* remove prev and next from the list */
-		if(nprev)
-			nprev->next = next->next;
-		else
-			usableList = next->next;
-		/* special-case if next is the previous of prev */
-		if(pprev == next) {
-			if(nprev)
-				nprev->next = prev->next;
-			else
-				usableList = prev->next;
-		}
-		else {
-			if(pprev)
-				pprev->next = prev->next;
-			else
-				usableList = prev->next;
-		}
-		/* put area on the usable-list */
-		area->next = usableList;
-		usableList = area;
-		/* put prev and next on the freelist */
-		prev->next = next;
-		next->next = freeList;
-		freeList = prev;
-	}
-	else if(prev) {
-		/* merge preg & area */
-		prev->size += area->size;
-		/* put area on the freelist */
-		area->next = freeList;
-		freeList = area;
+	if(EXPECT_FALSE(cls == LARGE_CLASS)) {
+		begin[0] = FREE_MAGIC;
+		munmap(begin);
+		return;
 	}
-	else if(next) {
-		/* merge area & next */
-		next->address = area->address;
-		next->size += area->size;
-		/* put area on the freelist */
-		area->next = freeList;
-		freeList = area;
+
+	sHeapCache *cache = getCache();
+	if(EXPECT_TRUE(cache)) {
+		push(cache->lists + cls,begin);
+		cache->bytes += classSizes[cls];
+		/* keep at most two batches; one to serve the next allocations and one to free into */
+		if(EXPECT_FALSE(++cache->counts[cls] > classBatch[cls] * 2)) {
+			usemdown(&heapSem);
+			drain(cache,cls,classBatch[cls]);
+			usemup(&heapSem);
+		}
 	}
 	else {
-		/* insert area in usableList */
-		area->next = usableList;
-		usableList = area;
+		usemdown(&heapSem);
+		globalFree(begin,cls);
+		usemup(&heapSem);
 	}
-
-	usemup(&heapSem);
 }
 
 void *realloc(void *addr,size_t size) {
 	ulong *begin;
-	sMemArea *area,*a,*prev;
+	size_t avail;
+	void *a;
 	if(addr == NULL)
 		return malloc(size);
 
 	begin = (ulong*)addr - 3;
-	area = (sMemArea*)begin[0];
 	/* check guards */
 	vassert(begin[0] != FREE_MAGIC,"Duplicate free?");
+	assert(begin[0] <= LARGE_CLASS);
 	assert(begin[2] == GUARD_MAGIC);
 	assert(begin[begin[1] / sizeof(ulong) + 3] == GUARD_MAGIC);
 
-	usemdown(&heapSem);
-
-	/* align and we need 3 ulongs for the guards */
-	size = ROUND_UP(size,sizeof(ulong)) + sizeof(ulong) * 4;
-
-	/* ignore shrinks */
-	if(size < area->size) {
-		usemup(&heapSem);
+	/* align and we need 4 ulongs for the class, size and guards */
+	size = ROUND_UP(size,sizeof(ulong)) + OVERHEAD;
+
+	/* if it still fits into the block, we can simply stay here */
+	if(begin[0] == LARGE_CLASS)
+		avail = ROUND_UP(begin[1] + OVERHEAD,PAGE_SIZE);
+	else
+		avail = classSizes[begin[0]];
+	if(size >= OVERHEAD && size <= avail) {
+		begin[1] = size - OVERHEAD;
+		begin[size / sizeof(ulong) - 1] = GUARD_MAGIC;
 		return addr;
 	}
 
-	a = usableList;
-	prev = NULL;
-	while(a != NULL) {
-		/* found the area behind? */
-		if((uintptr_t)a->address == (uintptr_t)area->address + area->size) {
-			/* if the size of both is big enough we can use them */
-			if(area->size + a->size >= size) {
-				/* space left? */
-				if(size < area->size + a->size) {
-					/* so move the area forward */
-					a->address = (void*)((uintptr_t)area->address + size);
-					a->size = (area->size + a->size) - size;
-				}
-				/* otherwise we don't need a anymore */
-				else {
-					/* remove a from usable-list */
-					if(prev == NULL)
-						usableList = a->next;
-					else
-						prev->next = a->next;
-					/* free a */
-					a->next = freeList;
-					freeList = a;
-				}
-
-				area->size = size;
-				/* reset guards */
-				begin[0] = (ulong)area;
-				begin[1] = size - sizeof(ulong) * 4;
-				begin[2] = GUARD_MAGIC;
-				begin[size / sizeof(ulong) - 1] = GUARD_MAGIC;
-				usemup(&heapSem);
-				return begin + 3;
-			}
-
-			/* makes no sense to continue since we've found the area behind */
-			break;
-		}
-		prev = a;
-		a = a->next;
-	}
-
-	usemup(&heapSem);
-
-	/* the areas are not big enough, so allocate a new one */
-	a = malloc(size);
+	/* otherwise, allocate a new one */
+	a = malloc(size - OVERHEAD);
 	if(a == NULL)
 		return NULL;
 
 	/* copy the old data and free it */
-	memcpy(a,addr,area->size - sizeof(ulong) * 4);
+	memcpy(a,addr,begin[1]);
 	free(addr);
 	return a;
 }
@@ -386,87 +376,130 @@ void *memalign(A_UNUSED size_t align,A_UNUSED size_t size) {
 	return NULL;
 }
 
-static bool loadNewSpace(size_t size) {
-	size_t orgsize = size;
-	size = MAX(nextSize,size);
-	if(nextSize < MAX_MMAP_SIZE)
-		nextSize *= 2;
+static sHeapCache *getCache(void) {
+	/* initTLS uses calloc to create the TLS */
+	if(EXPECT_FALSE(!tlsready()))
+		return NULL;
 
-	size = ROUND_UP(size,PAGE_SIZE);
-	/* if we need new areas, allocate a page more */
-	if(freeList == NULL)
-		size += nextAreaSize;
-	/* check for overflow */
-	if(size < orgsize)
-		return false;
+	sHeapCache *cache = (sHeapCache*)tlsget(cacheSlot);
+	if(EXPECT_TRUE(cache))
+		return cache;
 
-	/* allocate the required pages */
-	void *res = mmap(NULL,size,0,PROT_READ | PROT_WRITE,MAP_PRIVATE,-1,0);
-	if(res == NULL)
-		return false;
+	/* reuse the cache of an exited thread, if possible */
+	usemdown(&heapSem);
+	for(cache = caches; cache != NULL; cache = cache->next) {
+		if(!cache->used)
+			break;
+	}
+	if(cache == NULL) {
+		cache = (sHeapCache*)allocRaw(sizeof(sHeapCache));
+		if(cache) {
+			memclear(cache,sizeof(sHeapCache));
+			cache->next = caches;
+			caches = cache;
+		}
+	}
+	if(cache)
+		cache->used = true;
+	usemup(&heapSem);
 
-	pageCount += size / PAGE_SIZE;
+	if(cache)
+		tlsset(cacheSlot,(ulong)cache);
+	return cache;
+}
 
-	if(freeList == NULL) {
-		initAreas(res,nextAreaSize);
+static ulong *globalAlloc(size_t cls) {
+	size_t size = classSizes[cls];
+	if(freeLists[cls]) {
+		freeCounts[cls]--;
+		freeBytes -= size;
+		return pop(freeLists + cls);
+	}
+	return (ulong*)allocRaw(size);
+}
 
-		res = (void*)((char*)res + nextAreaSize);
-		size -= nextAreaSize;
+static void globalFree(ulong *block,size_t cls) {
+	push(freeLists + cls,block);
+	freeCounts[cls]++;
+	freeBytes += classSizes[cls];
+}
 
-		if(nextAreaSize < MAX_AREA_SIZE)
-			nextAreaSize *= 2;
+static void refill(sHeapCache *cache,size_t cls) {
+	size_t i;
+	for(i = 0; i < classBatch[cls]; ++i) {
+		ulong *block = globalAlloc(cls);
+		if(block == NULL)
+			break;
+		push(cache->lists + cls,block);
+		cache->counts[cls]++;
+		cache->bytes += classSizes[cls];
 	}
+}
 
-	/* take one area from the freelist and put the memory in it */
-	sMemArea *area = freeList;
-	freeList = freeList->next;
-	area->address = res;
-	area->size = size;
-	/* put area in the usable-list */
-	area->next = usableList;
-	usableList = area;
-	return true;
+static void drain(sHeapCache *cache,size_t cls,size_t count) {
+	while(count-- > 0 && cache->lists[cls]) {
+		globalFree(pop(cache->lists + cls),cls);
+		cache->counts[cls]--;
+		cache->bytes -= classSizes[cls];
+	}
 }
 
-static void initAreas(void *addr,size_t size) {
-	sMemArea *area = (sMemArea*)addr;
-	sMemArea *end = area + (size / sizeof(sMemArea));
-
-	/* put all areas in the freelist */
-	freeList = area;
-	area->next = NULL;
-	area++;
-	while(area < end) {
-		area->next = freeList;
-		freeList = area;
-		area++;
+static void *allocRaw(size_t size) {
+	size = ROUND_UP(size,CLASS_ALIGN);
+	if((size_t)(chunkEnd - chunkPos) < size) {
+		if(!loadNewSpace(size))
+			return NULL;
 	}
+
+	void *res = chunkPos;
+	chunkPos += size;
+	freeBytes -= size;
+	return res;
 }
 
-static bool loadNewAreas(void) {
-	size_t size = MAX(nextAreaSize,PAGE_SIZE);
-	if(nextAreaSize < MAX_AREA_SIZE)
-		nextAreaSize *= 2;
+static bool loadNewSpace(size_t size) {
+	ssize_t cls;
+	size_t orgsize = size;
+	size = MAX(nextSize,size);
+	if(nextSize < MAX_MMAP_SIZE)
+		nextSize *= 2;
+
+	size = ROUND_UP(size,PAGE_SIZE);
+	/* check for overflow */
+	if(size < orgsize)
+		return false;
 
-	/* allocate one page for area-structs */
+	/* allocate the required pages */
 	void *res = mmap(NULL,size,0,PROT_READ | PROT_WRITE,MAP_PRIVATE,-1,0);
 	if(res == NULL)
 		return false;
 
 	pageCount += size / PAGE_SIZE;
 
-	initAreas(res,size);
+	/* put the rest of the old chunk into the lists, starting with the largest class that fits.
+	 * the rest is always a multiple of the smallest class */
+	for(cls = CLASS_COUNT - 1; cls >= 0 && chunkPos < chunkEnd; --cls) {
+		while((size_t)(chunkEnd - chunkPos) >= classSizes[cls]) {
+			push(freeLists + cls,(ulong*)chunkPos);
+			freeCounts[cls]++;
+			chunkPos += classSizes[cls];
+		}
+	}
+
+	chunkPos = (char*)res;
+	chunkEnd = chunkPos + size;
+	freeBytes += size;
 	return true;
 }
 
 size_t heapspace(void) {
-	sMemArea *area;
-	size_t c = 0;
-	area = usableList;
-	while(area != NULL) {
-		c += area->size;
-		area = area->next;
-	}
+	sHeapCache *cache;
+	size_t c;
+	usemdown(&heapSem);
+	c = freeBytes;
+	for(cache = caches; cache != NULL; cache = cache->next)
+		c += cache->bytes;
+	usemup(&heapSem);
 	return c;
 }
 
@@ -474,22 +507,19 @@ size_t heapspace(void) {
 #if DEBUGGING
 
 void printheap(void) {
-	sMemArea *area;
-
-	printf("PageCount=%d\n",pageCount);
-	printf("UsableList:\n");
-	area = usableList;
-	while(area != NULL) {
-		printf("\t%p: addr=%p, size=0x%x, next=%p\n",area,area->address,area->size,area->next);
-		area = area->next;
+	sHeapCache *cache;
+	size_t i;
+
+	printf("PageCount=%zu\n",pageCount);
+	printf("Chunk: %p .. %p\n",chunkPos,chunkEnd);
+	printf("Classes:\n");
+	for(i = 0; i < CLASS_COUNT; ++i) {
+		if(freeCounts[i] > 0)
+			printf("\t%5zu: %zu free\n",classSizes[i],freeCounts[i]);
 	}
-
-	/*printf("FreeList:\n");
-	area = freeList;
-	while(area != NULL) {
-		printf("\t0x%x: addr=0x%x, size=0x%x, next=0x%x\n",area,area->address,area->size,area->next);
-		area = area->next;
-	}*/
+	printf("Caches:\n");
+	for(cache = caches; cache != NULL; cache = cache->next)
+		printf("\t%p: used=%d, bytes=%zu\n",cache,cache->used,cache->bytes);
 }
 
 #endif
@@ -128,6 +128,9 @@ const struct Syscall syscalls[] = {
 	{"utime",			"%d,%p"						},
 	{"truncate",		"%d,%u"						},
 	{"symlink",			"%s,%d,%s"					},
+	{"sendv",			"%d,%p,%x"					},
+	{"getworkv",		"%W,%p,%p"					},
+	{"mphys",			"%p,%x,%p"					},
 #if defined(__x86__)
 	{"reqports",   		"%d,%d"						},
 	{"relports",    	"%d,%d"						},
@@ -151,6 +154,7 @@ static const char *fileMsgs[] = {
 	"DEV_CANCEL",
 	"DEV_DELEGATE",
 	"DEV_OBTAIN",
+	"DEV_RING",
 };
 
 static const char *fsMsgs[] = {
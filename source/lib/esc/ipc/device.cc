@@ -54,10 +54,18 @@ void Device::unset(msgid_t op) {
 }
 
 void Device::loop() {
-	ulong buf[IPC_DEF_SIZE / sizeof(ulong)];
+	/* fetch a few messages at once to save system calls if a client has sent multiple requests */
+	static const size_t BATCH = 4;
+	ulong bufs[BATCH][IPC_DEF_SIZE / sizeof(ulong)];
+	struct msgvec vec[BATCH];
 	while(_run) {
-		msgid_t mid;
-		int fd = getwork(_id,&mid,buf,sizeof(buf),0);
+		size_t count = BATCH;
+		for(size_t i = 0; i < BATCH; ++i) {
+			vec[i].data = bufs[i];
+			vec[i].size = sizeof(bufs[i]);
+		}
+
+		int fd = getworkv(_id,vec,&count,0);
 		if(EXPECT_FALSE(fd < 0)) {
 			/* just log that it failed. maybe a client has sent a message that was too big */
 			if(fd != -EINTR)
@@ -65,8 +73,10 @@ void Device::loop() {
 			continue;
 		}
 
-		IPCStream is(fd,buf,sizeof(buf),mid);
-		handleMsg(mid,is);
+		for(size_t i = 0; i < count; ++i) {
+			IPCStream is(fd,bufs[i],sizeof(bufs[i]),vec[i].id);
+			handleMsg(vec[i].id,is);
+		}
 	}
 }
 
@@ -0,0 +1,126 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include <esc/ipc/ring.h>
+#include <esc/vthrow.h>
+#include <sys/common.h>
+#include <sys/io.h>
+
+namespace esc {
+
+RingChannel::RingChannel(int fd,size_t count,size_t slotsize)
+	: _fd(fd), _client(true), _count(count), _inflight(), _size(), _mem(), _owner(true),
+	  _out(), _in() {
+	/* keep the slots aligned */
+	slotsize = (slotsize + sizeof(RingQueue::Slot) + sizeof(ulong) - 1) & ~(sizeof(ulong) - 1);
+	if(count == 0)
+		VTHROWE("Invalid slot count",-EINVAL);
+	_size = bytes(count,slotsize);
+
+	int shmfd = createbuf(_size,&_mem,0);
+	if(shmfd < 0)
+		VTHROWE("createbuf(" << _size << ")",shmfd);
+
+	Layout *l = static_cast<Layout*>(_mem);
+	memset(l,0,sizeof(*l));
+	l->magic = MAGIC;
+	l->count = count;
+	l->slotsize = slotsize;
+	attach(_mem,true);
+
+	int res = delegate(fd,shmfd,O_RDWR,DEL_ARG_SHRING);
+	close(shmfd);
+	if(res < 0) {
+		destroybuf(_mem);
+		VTHROWE("delegate(" << fd << ")",res);
+	}
+}
+
+RingChannel::RingChannel(int fd,void *mem,size_t size)
+	: _fd(fd), _client(false), _count(), _inflight(), _size(size), _mem(mem), _owner(false),
+	  _out(), _in() {
+	const Layout *l = static_cast<const Layout*>(mem);
+	/* don't trust the client; the values are read only once */
+	if(size < sizeof(Layout) || l->magic != MAGIC)
+		VTHROWE("Invalid ring channel",-EINVAL);
+	_count = l->count;
+	size_t slotsize = l->slotsize;
+	if(_count == 0 || slotsize <= sizeof(RingQueue::Slot) || slotsize % sizeof(ulong) != 0 ||
+			_count > size / slotsize || bytes(_count,slotsize) > size)
+		VTHROWE("Invalid ring channel",-EINVAL);
+	attach(mem,false);
+}
+
+RingChannel::~RingChannel() {
+	if(_owner)
+		destroybuf(_mem);
+}
+
+void RingChannel::attach(void *mem,bool client) {
+	Layout *l = static_cast<Layout*>(mem);
+	size_t slotsize = l->slotsize;
+	char *reqslots = reinterpret_cast<char*>(l + 1);
+	char *respslots = reqslots + _count * slotsize;
+	RingQueue req(&l->req,reqslots,_count,slotsize);
+	RingQueue resp(&l->resp,respslots,_count,slotsize);
+	_out = client ? req : resp;
+	_in = client ? resp : req;
+}
+
+int RingChannel::send(msgid_t mid,const void *data,size_t len) {
+	if(EXPECT_FALSE(len > _out.maxsize()))
+		return -EINVAL;
+	if(_client) {
+		/* this ensures that the driver has always room for the responses */
+		if(EXPECT_FALSE(_inflight == _count))
+			return -EAGAIN;
+		_inflight++;
+	}
+
+	if(_out.push(mid,data,len)) {
+		ssize_t res = ::send(_fd,MSG_DEV_RING,NULL,0);
+		if(EXPECT_FALSE(res < 0))
+			return res;
+	}
+	return 0;
+}
+
+ssize_t RingChannel::receive(msgid_t *mid,void *buf,size_t size,bool block) {
+	while(true) {
+		ssize_t res = _in.pop(mid,buf,size);
+		if(res != -EWOULDBLOCK) {
+			if(_client && _inflight > 0)
+				_inflight--;
+			return res;
+		}
+		if(!block)
+			return res;
+
+		/* wait for a MSG_DEV_RING message from the other side */
+		if(_in.sleep()) {
+			msgid_t wmid = 0;
+			res = ::receive(_fd,&wmid,NULL,0);
+			if(EXPECT_FALSE(res < 0))
+				return res;
+		}
+	}
+}
+
+}
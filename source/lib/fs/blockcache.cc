@@ -25,6 +25,8 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #define ALLOC_LOCK	0xF7180000
 
@@ -32,15 +34,24 @@ namespace fs {
 
 BlockCache::BlockCache(int fd,size_t blocks,size_t bsize)
 		: _blockCacheSize(blocks), _blockSize(bsize), _hashmap(new CBlock*[HASH_SIZE]()),
-		  _oldestBlock(NULL), _newestBlock(NULL), _freeBlocks(NULL),
-		  _blockCache(new CBlock[blocks]), _blockmem(), _hits(), _misses() {
+		  _inList(), _mainList(), _inMax(esc::Util::max<size_t>(1,blocks * IN_RATIO / 100)),
+		  _freeBlocks(NULL), _ghosts(), _ghostmap(new Ghost*[HASH_SIZE]()),
+		  _ghostCount(esc::Util::max<size_t>(1,blocks * GHOST_RATIO / 100)), _ghostPos(),
+		  _dirtyFirst(NULL), _dirtyLast(NULL), _dirtyCount(), _blockCache(new CBlock[blocks]),
+		  _blockmem(), _batchmem(), _inHits(), _mainHits(), _ghostHits(), _misses(),
+		  _prefetched(), _writes(), _written(), _flusherRun(false), _flusherTid(-1),
+		  _jobs(new PrefetchJob[PREFETCH_JOBS]), _jobFirst(), _jobCount(), _jobSem(),
+		  _prefetcherRun(false), _prefetcherTid(-1) {
 	size_t i;
 	CBlock *bentry;
-	if(sharebuf(fd,_blockCacheSize * _blockSize,&_blockmem,0) < 0) {
+	if(sharebuf(fd,(_blockCacheSize + MAX_BATCH) * _blockSize,&_blockmem,0) < 0) {
 		if(_blockmem == NULL)
 			VTHROW("Unable to create block cache");
-		printe("Unable to share buffer with disk driver");
+		if(fd >= 0)
+			printe("Unable to share buffer with disk driver");
 	}
+	_ghosts = new Ghost[_ghostCount]();
+	_batchmem = (char*)_blockmem + _blockCacheSize * _blockSize;
 	bentry = _blockCache;
 	for(i = 0; i < _blockCacheSize; i++) {
 		bentry->blockNo = 0;
@@ -50,37 +61,280 @@ BlockCache::BlockCache(int fd,size_t blocks,size_t bsize)
 		bentry->prev = (i < _blockCacheSize - 1) ? bentry + 1 : NULL;
 		bentry->next = _freeBlocks;
 		bentry->hnext = NULL;
+		bentry->dprev = NULL;
+		bentry->dnext = NULL;
+		bentry->dirtyTime = 0;
+		bentry->frequent = false;
 		_freeBlocks = bentry;
 		bentry++;
 	}
 }
 
 BlockCache::~BlockCache() {
+	stopFlusher();
+	stopPrefetcher();
 	destroybuf(_blockmem);
+	delete[] _jobs;
 	delete[] _hashmap;
+	delete[] _ghostmap;
+	delete[] _ghosts;
 	delete[] _blockCache;
 }
 
+static int compareBlocks(const void *a,const void *b) {
+	const CBlock *b1 = *(const CBlock**)a;
+	const CBlock *b2 = *(const CBlock**)b;
+	return b1->blockNo < b2->blockNo ? -1 : (b1->blockNo > b2->blockNo ? 1 : 0);
+}
+
 void BlockCache::flush() {
-	CBlock *bentry = _newestBlock;
-	while(bentry != NULL) {
-		sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
-		if(bentry->dirty) {
-			acquire(bentry,READ);
-			writeBlocks(bentry->buffer,bentry->blockNo,1);
-			bentry->dirty = false;
-			doRelease(bentry,false);
-		}
+	sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+	if(_dirtyCount == 0) {
 		sassert(tpool_unlock(ALLOC_LOCK) == 0);
-		bentry = bentry->next;
+		return;
+	}
+
+	/* write them in ascending order to keep the disk head moving in one direction */
+	CBlock **blocks = new CBlock*[_dirtyCount];
+	size_t count = 0;
+	for(CBlock *b = _dirtyFirst; b != NULL; b = b->dnext)
+		blocks[count++] = b;
+	qsort(blocks,count,sizeof(CBlock*),compareBlocks);
+
+	for(size_t i = 0; i < count; ++i) {
+		/* it might have been written already as part of a cluster */
+		if(blocks[i]->dirty)
+			writeCluster(blocks[i]);
+	}
+	sassert(tpool_unlock(ALLOC_LOCK) == 0);
+	delete[] blocks;
+}
+
+void BlockCache::markDirty(CBlock *b) {
+	sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+	if(!b->dirty) {
+		b->dirty = true;
+		b->dirtyTime = time(NULL);
+		/* append to the dirty list, which is therefore ordered by age */
+		b->dnext = NULL;
+		b->dprev = _dirtyLast;
+		if(_dirtyLast)
+			_dirtyLast->dnext = b;
+		else
+			_dirtyFirst = b;
+		_dirtyLast = b;
+		_dirtyCount++;
+	}
+	sassert(tpool_unlock(ALLOC_LOCK) == 0);
+}
+
+void BlockCache::markClean(CBlock *b) {
+	assert(b->dirty);
+	if(b->dprev)
+		b->dprev->dnext = b->dnext;
+	else
+		_dirtyFirst = b->dnext;
+	if(b->dnext)
+		b->dnext->dprev = b->dprev;
+	else
+		_dirtyLast = b->dprev;
+	b->dprev = b->dnext = NULL;
+	b->dirty = false;
+	_dirtyCount--;
+}
+
+bool BlockCache::writeCluster(CBlock *b) {
+	/* extend the cluster in both directions by dirty blocks that are not in use at the moment.
+	 * the hashmap tells us quickly whether the neighbors are in the cache. if <b> is in use, we
+	 * write it alone, because we have to wait for it without holding other locks */
+	CBlock *cblocks[MAX_BATCH];
+	block_t start = b->blockNo;
+	size_t n = 1;
+	while(b->refs == 0 && n < MAX_BATCH && start > 0) {
+		CBlock *nb = lookup(start - 1);
+		if(!nb || !nb->dirty || nb->refs > 0)
+			break;
+		start--;
+		n++;
+	}
+	while(b->refs == 0 && n < MAX_BATCH) {
+		CBlock *nb = lookup(start + n);
+		if(!nb || !nb->dirty || nb->refs > 0)
+			break;
+		n++;
+	}
+
+	/* pin the blocks, so that they are not evicted, and write them without holding ALLOC_LOCK.
+	 * the shared lock ensures that they are not changed in the meantime. nobody holds the lock
+	 * of unused blocks, so that we can take it right away */
+	bool inuse = b->refs > 0;
+	for(size_t i = 0; i < n; ++i) {
+		cblocks[i] = lookup(start + i);
+		cblocks[i]->refs++;
+		if(!inuse)
+			sassert(tpool_lock((ulong)cblocks[i],0) == 0);
+	}
+	sassert(tpool_unlock(ALLOC_LOCK) == 0);
+	if(inuse)
+		sassert(tpool_lock((ulong)b,0) == 0);
+
+	bool res;
+	if(n == 1)
+		res = writeBlocks(b->buffer,b->blockNo,1) == 0;
+	else {
+		sassert(tpool_lock((ulong)_batchmem,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+		for(size_t i = 0; i < n; ++i)
+			memcpy((char*)_batchmem + i * _blockSize,cblocks[i]->buffer,_blockSize);
+		res = writeBlocks(_batchmem,start,n) == 0;
+		sassert(tpool_unlock((ulong)_batchmem) == 0);
 	}
+
+	/* somebody else might have written some of them as well in the meantime */
+	sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+	for(size_t i = 0; i < n; ++i) {
+		if(res && cblocks[i]->dirty)
+			markClean(cblocks[i]);
+		cblocks[i]->refs--;
+		sassert(tpool_unlock((ulong)cblocks[i]) == 0);
+	}
+	if(res) {
+		_writes++;
+		_written += n;
+	}
+	return res;
 }
 
-void BlockCache::acquire(CBlock *b,A_UNUSED uint mode) {
-	assert(!(mode & WRITE) || b->refs == 0);
+void BlockCache::writeback() {
+	sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+	while(true) {
+		time_t now = time(NULL);
+		bool tooMany = _dirtyCount * 100 > _blockCacheSize * DIRTY_RATIO;
+
+		/* the list is ordered by age. thus, if there are not too many, we can stop at the
+		 * first block that is young enough. blocks that are in use are skipped. */
+		CBlock *b = _dirtyFirst;
+		while(b && b->refs > 0)
+			b = b->dnext;
+		if(!b || (!tooMany && now - b->dirtyTime < DIRTY_EXPIRE))
+			break;
+
+		/* the lock is released during the write to let requests through */
+		if(!writeCluster(b))
+			break;
+	}
+	sassert(tpool_unlock(ALLOC_LOCK) == 0);
+}
+
+int BlockCache::flusher(void *arg) {
+	BlockCache *cache = static_cast<BlockCache*>(arg);
+	while(cache->_flusherRun) {
+		usleep(FLUSH_INTERVAL);
+		cache->writeback();
+	}
+	return 0;
+}
+
+int BlockCache::startFlusher() {
+	_flusherRun = true;
+	_flusherTid = startthread(flusher,this);
+	if(_flusherTid < 0) {
+		_flusherRun = false;
+		return _flusherTid;
+	}
+	return 0;
+}
+
+void BlockCache::stopFlusher() {
+	if(_flusherTid >= 0) {
+		_flusherRun = false;
+		IGNSIGS(join(_flusherTid));
+		_flusherTid = -1;
+	}
+}
+
+int BlockCache::prefetcher(void *arg) {
+	BlockCache *cache = static_cast<BlockCache*>(arg);
+	while(true) {
+		usemdown(&cache->_jobSem);
+		if(!cache->_prefetcherRun)
+			break;
+
+		/* take the job out of the ring to let the readers add new ones meanwhile */
+		PrefetchJob job;
+		sassert(tpool_lock((ulong)cache->_jobs,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+		job = cache->_jobs[cache->_jobFirst];
+		cache->_jobFirst = (cache->_jobFirst + 1) % PREFETCH_JOBS;
+		cache->_jobCount--;
+		sassert(tpool_unlock((ulong)cache->_jobs) == 0);
+
+		cache->prefetch(job.blocks,job.count);
+	}
+	return 0;
+}
+
+int BlockCache::startPrefetcher() {
+	int res = usemcrt(&_jobSem,0);
+	if(res < 0)
+		return res;
+	_prefetcherRun = true;
+	_prefetcherTid = startthread(prefetcher,this);
+	if(_prefetcherTid < 0) {
+		_prefetcherRun = false;
+		usemdestr(&_jobSem);
+		return _prefetcherTid;
+	}
+	return 0;
+}
+
+void BlockCache::stopPrefetcher() {
+	if(_prefetcherTid >= 0) {
+		_prefetcherRun = false;
+		usemup(&_jobSem);
+		IGNSIGS(join(_prefetcherTid));
+		_prefetcherTid = -1;
+		usemdestr(&_jobSem);
+	}
+}
+
+void BlockCache::prefetchAsync(const block_t *blocks,size_t count) {
+	if(_prefetcherTid < 0) {
+		prefetch(blocks,count);
+		return;
+	}
+
+	while(count > 0) {
+		size_t n = esc::Util::min(count,MAX_BATCH);
+		sassert(tpool_lock((ulong)_jobs,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+		/* readahead is only a hint; if the prefetcher can't keep up, the reader will fetch the
+		 * blocks itself */
+		if(_jobCount == PREFETCH_JOBS) {
+			sassert(tpool_unlock((ulong)_jobs) == 0);
+			return;
+		}
+		PrefetchJob *job = _jobs + (_jobFirst + _jobCount) % PREFETCH_JOBS;
+		memcpy(job->blocks,blocks,n * sizeof(block_t));
+		job->count = n;
+		_jobCount++;
+		sassert(tpool_unlock((ulong)_jobs) == 0);
+		usemup(&_jobSem);
+
+		blocks += n;
+		count -= n;
+	}
+}
+
+void BlockCache::acquire(CBlock *b,uint mode) {
+	b->refs++;
+	sassert(tpool_unlock(ALLOC_LOCK) == 0);
+	sassert(tpool_lock((ulong)b,(mode & WRITE) ? LOCK_EXCLUSIVE : 0) == 0);
+}
+
+void BlockCache::acquireNew(CBlock *b) {
+	/* nobody else uses the block. so, we take the lock before releasing ALLOC_LOCK to make sure
+	 * that nobody that finds it in the hashmap uses it before it's ready */
 	b->refs++;
+	sassert(tpool_lock((ulong)b,LOCK_EXCLUSIVE) == 0);
 	sassert(tpool_unlock(ALLOC_LOCK) == 0);
-	sassert(tpool_lock((uint)b,(mode & WRITE) ? LOCK_EXCLUSIVE : 0) == 0);
 }
 
 void BlockCache::doRelease(CBlock *b,bool unlockAlloc) {
@@ -89,7 +343,16 @@ void BlockCache::doRelease(CBlock *b,bool unlockAlloc) {
 	b->refs--;
 	if(unlockAlloc)
 		sassert(tpool_unlock(ALLOC_LOCK) == 0);
-	sassert(tpool_unlock((uint)b) == 0);
+	sassert(tpool_unlock((ulong)b) == 0);
+}
+
+void BlockCache::discard(CBlock *b) {
+	/* the block stays in its list and will be reused soon, because it is unused */
+	unhash(b);
+	b->blockNo = 0;
+	b->refs--;
+	if(b->dirty)
+		markClean(b);
 }
 
 CBlock *BlockCache::doRequest(block_t blockNo,bool doRead,uint mode) {
@@ -98,157 +361,304 @@ CBlock *BlockCache::doRequest(block_t blockNo,bool doRead,uint mode) {
 	/* acquire tpool_lock for getting a block */
 	sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
 
-	/* search for the block. perhaps it's already in cache */
-	bentry = _hashmap[blockNo % HASH_SIZE];
-	while(bentry != NULL) {
-		if(bentry->blockNo == blockNo) {
-			/* remove from list and put at the beginning of the usedlist because it was
-			 * used most recently */
-			if(bentry->prev != NULL) {
-				/* update oldest */
-				if(_oldestBlock == bentry)
-					_oldestBlock = bentry->prev;
-				/* remove */
-				bentry->prev->next = bentry->next;
-				if(bentry->next)
-					bentry->next->prev = bentry->prev;
-				/* put at the beginning */
-				bentry->prev = NULL;
-				bentry->next = _newestBlock;
-				bentry->next->prev = bentry;
-				_newestBlock = bentry;
+	while(true) {
+		/* search for the block. perhaps it's already in cache */
+		bentry = lookup(blockNo);
+		if(bentry != NULL) {
+			/* blocks in Am are moved to the front because they were used most recently. A1in
+			 * is a FIFO; repeated accesses shortly after the first one don't count */
+			if(bentry->frequent) {
+				_mainList.remove(bentry);
+				_mainList.prepend(bentry);
+				_mainHits++;
 			}
+			else
+				_inHits++;
 			acquire(bentry,mode);
-			_hits++;
-			return bentry;
+
+			/* if reading it failed while we were waiting, try again */
+			if(EXPECT_TRUE(bentry->blockNo == blockNo))
+				return bentry;
+			doRelease(bentry,false);
+			continue;
 		}
-		bentry = bentry->hnext;
+
+		/* get a cached block. this fails if somebody else has added it in the meantime */
+		block = getBlock(blockNo);
+		if(block != NULL)
+			break;
 	}
 
 	/* init cached block */
-	block = getBlock(blockNo);
 	block->blockNo = blockNo;
 	block->dirty = false;
 	block->refs = 0;
+	_misses++;
+
+	/* we need always a write-tpool_lock because we have to read the content into it */
+	acquireNew(block);
 
 	/* now read from disk */
 	if(doRead) {
-		/* we need always a write-tpool_lock because we have to read the content into it */
-		acquire(block,WRITE);
 		if(readBlocks(block->buffer,blockNo,1) != 0) {
-			block->blockNo = 0;
-			doRelease(block,true);
+			sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+			discard(block);
+			sassert(tpool_unlock(ALLOC_LOCK) == 0);
+			sassert(tpool_unlock((ulong)block) == 0);
 			return NULL;
 		}
-		doRelease(block,false);
 	}
 
-	acquire(block,mode);
-	_misses++;
+	/* the block is ready; downgrade the lock if we want to read only */
+	if(~mode & WRITE) {
+		sassert(tpool_unlock((ulong)block) == 0);
+		sassert(tpool_lock((ulong)block,0) == 0);
+	}
 	return block;
 }
 
+void BlockCache::prefetch(const block_t *blocks,size_t count) {
+	CBlock *cblocks[MAX_BATCH];
+	size_t i = 0;
+	while(i < count) {
+		sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+
+		/* skip holes and blocks that we have already */
+		if(blocks[i] == 0 || lookup(blocks[i])) {
+			sassert(tpool_unlock(ALLOC_LOCK) == 0);
+			i++;
+			continue;
+		}
+
+		/* collect the missing blocks that follow on disk */
+		size_t n = 1;
+		while(i + n < count && n < MAX_BATCH && blocks[i + n] == blocks[i] + n &&
+				!lookup(blocks[i + n]))
+			n++;
+
+		/* grab the blocks first and lock them, so that nobody uses them until they are read */
+		for(size_t j = 0; j < n; ++j) {
+			cblocks[j] = getBlock(blocks[i] + j);
+			if(cblocks[j] == NULL) {
+				n = j;
+				break;
+			}
+			cblocks[j]->blockNo = blocks[i] + j;
+			cblocks[j]->dirty = false;
+			cblocks[j]->refs = 1;
+			sassert(tpool_lock((ulong)cblocks[j],LOCK_EXCLUSIVE) == 0);
+		}
+		sassert(tpool_unlock(ALLOC_LOCK) == 0);
+		if(n == 0) {
+			i++;
+			continue;
+		}
+
+		/* a single block is read into the cache directly. otherwise, we read them all at once
+		 * and distribute them afterwards */
+		bool res;
+		if(n == 1)
+			res = readBlocks(cblocks[0]->buffer,blocks[i],1) == 0;
+		else {
+			sassert(tpool_lock((ulong)_batchmem,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+			res = readBlocks(_batchmem,blocks[i],n) == 0;
+			if(res) {
+				for(size_t j = 0; j < n; ++j)
+					memcpy(cblocks[j]->buffer,(char*)_batchmem + j * _blockSize,_blockSize);
+			}
+			sassert(tpool_unlock((ulong)_batchmem) == 0);
+		}
+
+		sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+		for(size_t j = 0; j < n; ++j) {
+			if(res)
+				cblocks[j]->refs--;
+			else
+				discard(cblocks[j]);
+		}
+		if(res)
+			_prefetched += n;
+		sassert(tpool_unlock(ALLOC_LOCK) == 0);
+		for(size_t j = 0; j < n; ++j)
+			sassert(tpool_unlock((ulong)cblocks[j]) == 0);
+
+		if(!res)
+			return;
+		i += n;
+	}
+}
+
+CBlock *BlockCache::lookup(block_t blockNo) {
+	CBlock *bentry = _hashmap[blockNo % HASH_SIZE];
+	while(bentry != NULL) {
+		if(bentry->blockNo == blockNo)
+			return bentry;
+		bentry = bentry->hnext;
+	}
+	return NULL;
+}
+
 CBlock *BlockCache::getBlock(block_t blockNo) {
 	CBlock *block = _freeBlocks;
-	if(block != NULL) {
-		/* remove from freelist and put in usedlist */
+	if(block != NULL)
 		_freeBlocks = block->next;
-		if(_freeBlocks)
-			_freeBlocks->prev = NULL;
-		/* block->prev is already NULL */
-		block->next = _newestBlock;
-		if(block->next)
-			block->next->prev = block;
-		_newestBlock = block;
-		/* update oldest */
-		if(_oldestBlock == NULL)
-			_oldestBlock = block;
-		/* insert into hashmap */
-		CBlock **list = &_hashmap[blockNo % HASH_SIZE];
-		block->hnext = *list;
-		*list = block;
-		return block;
-	}
-
-	/* take the oldest one */
-	block = _oldestBlock;
-	assert(block->refs == 0);
-	_oldestBlock = block->prev;
-	_oldestBlock->next = NULL;
-	/* remove from hashmap */
-	bool diffhash = block->blockNo % HASH_SIZE != blockNo % HASH_SIZE;
-	if(diffhash) {
-		CBlock **list = &_hashmap[block->blockNo % HASH_SIZE];
-		CBlock *b = *list, *p = NULL;
-		while(b != NULL) {
-			if(b == block) {
-				if(p)
-					p->hnext = b->hnext;
-				else
-					*list = b->hnext;
-				break;
-			}
-			p = b;
-			b = b->hnext;
+	else {
+		block = evict();
+		/* evicting a dirty block releases the lock temporarily */
+		if(lookup(blockNo)) {
+			block->next = _freeBlocks;
+			_freeBlocks = block;
+			return NULL;
 		}
 	}
-	/* put at beginning of usedlist */
-	block->prev = NULL;
-	block->next = _newestBlock;
-	if(block->next)
-		block->next->prev = block;
-	_newestBlock = block;
+
+	/* if we have evicted the block recently, it is used frequently */
+	block->frequent = removeGhost(blockNo);
+	if(block->frequent) {
+		_mainList.prepend(block);
+		_ghostHits++;
+	}
+	else
+		_inList.prepend(block);
+
 	/* insert into hashmap */
-	if(diffhash) {
-		CBlock **list = &_hashmap[blockNo % HASH_SIZE];
-		block->hnext = *list;
-		*list = block;
+	CBlock **list = &_hashmap[blockNo % HASH_SIZE];
+	block->hnext = *list;
+	*list = block;
+	return block;
+}
+
+void BlockCache::unhash(CBlock *block) {
+	CBlock **list = &_hashmap[block->blockNo % HASH_SIZE];
+	CBlock *b = *list, *p = NULL;
+	while(b != NULL) {
+		if(b == block) {
+			if(p)
+				p->hnext = b->hnext;
+			else
+				*list = b->hnext;
+			break;
+		}
+		p = b;
+		b = b->hnext;
 	}
-	/* if it is dirty we have to write it first to disk */
-	if(block->dirty) {
-		acquire(block,READ);
-		writeBlocks(block->buffer,block->blockNo,1);
-		doRelease(block,false);
+	block->hnext = NULL;
+}
+
+CBlock *BlockCache::chooseVictim(CBlockList *list) {
+	/* take the oldest one that is clean, if there is one among the last few. this way, we can
+	 * leave the dirty ones to the flusher, which writes them in clusters */
+	CBlock *block = list->oldest;
+	for(size_t i = 0; i < EVICT_SCAN && block; ++i) {
+		if(block->refs == 0 && !block->dirty)
+			return block;
+		block = block->prev;
 	}
+	/* otherwise the oldest one that is not in use */
+	for(block = list->oldest; block != NULL; block = block->prev) {
+		if(block->refs == 0)
+			return block;
+	}
+	return NULL;
+}
+
+CBlock *BlockCache::evict() {
+	CBlock *block;
+	while(true) {
+		/* take the blocks from A1in as long as it exceeds its share */
+		CBlockList *first = &_mainList, *second = &_inList;
+		if(_inList.count > _inMax || _mainList.count == 0)
+			std::swap(first,second);
+
+		block = chooseVictim(first);
+		if(block == NULL)
+			block = chooseVictim(second);
+		vassert(block != NULL,"All blocks of the block cache are in use");
+
+		if(!block->dirty)
+			break;
+
+		/* if it is dirty we have to write it first to disk. if that fails, we drop it. the lock
+		 * is released in the meantime, so that we have to check again whether we can use it */
+		if(!writeCluster(block) && block->dirty)
+			markClean(block);
+		if(block->refs == 0 && !block->dirty)
+			break;
+	}
+
+	(block->frequent ? &_mainList : &_inList)->remove(block);
+	unhash(block);
+	if(!block->frequent && block->blockNo != 0)
+		addGhost(block->blockNo);
 	return block;
 }
 
+void BlockCache::addGhost(block_t blockNo) {
+	Ghost *g = _ghosts + _ghostPos;
+	_ghostPos = (_ghostPos + 1) % _ghostCount;
+	/* forget the oldest one, if necessary */
+	if(g->blockNo != 0)
+		removeGhost(g->blockNo);
+
+	g->blockNo = blockNo;
+	Ghost **list = &_ghostmap[blockNo % HASH_SIZE];
+	g->hnext = *list;
+	*list = g;
+}
+
+bool BlockCache::removeGhost(block_t blockNo) {
+	Ghost **list = &_ghostmap[blockNo % HASH_SIZE];
+	Ghost *g = *list, *p = NULL;
+	while(g != NULL) {
+		if(g->blockNo == blockNo) {
+			if(p)
+				p->hnext = g->hnext;
+			else
+				*list = g->hnext;
+			g->blockNo = 0;
+			return true;
+		}
+		p = g;
+		g = g->hnext;
+	}
+	return false;
+}
+
 void BlockCache::printStats(FILE *f) {
 	float hitrate;
-	size_t used = 0,dirty = 0;
-	CBlock *bentry = _newestBlock;
-	while(bentry != NULL) {
-		used++;
-		if(bentry->dirty)
-			dirty++;
-		bentry = bentry->next;
-	}
+	sassert(tpool_lock(ALLOC_LOCK,LOCK_EXCLUSIVE | LOCK_KEEP) == 0);
+	ulong hits = _inHits + _mainHits;
 	fprintf(f,"\tTotal blocks: %zu\n",_blockCacheSize);
-	fprintf(f,"\tUsed blocks: %zu\n",used);
-	fprintf(f,"\tDirty blocks: %zu\n",dirty);
-	fprintf(f,"\tHits: %lu\n",_hits);
-	fprintf(f,"\tMisses: %lu\n",_misses);
-	if(_hits == 0)
+	fprintf(f,"\tUsed blocks: %zu (A1in: %zu, Am: %zu)\n",
+		_inList.count + _mainList.count,_inList.count,_mainList.count);
+	fprintf(f,"\tDirty blocks: %zu\n",_dirtyCount);
+	fprintf(f,"\tHits: %lu (A1in: %lu, Am: %lu)\n",hits,_inHits,_mainHits);
+	fprintf(f,"\tMisses: %lu (A1out: %lu)\n",_misses,_ghostHits);
+	fprintf(f,"\tPrefetched: %lu\n",_prefetched);
+	fprintf(f,"\tWrites: %lu\n",_writes);
+	fprintf(f,"\tWritten blocks: %lu\n",_written);
+	if(hits == 0)
 		hitrate = 0;
 	else
-		hitrate = 100.0f / ((float)(_misses + _hits) / _hits);
+		hitrate = 100.0f / ((float)(_misses + hits) / hits);
 	fprintf(f,"\tHitrate: %.3f%%\n",hitrate);
+	sassert(tpool_unlock(ALLOC_LOCK) == 0);
 }
 
 #if DEBUGGING
 
 void BlockCache::print() {
-	size_t i = 0;
-	CBlock *block;
-	printf("Used blocks:\n\t");
-	block = _newestBlock;
-	while(block != NULL) {
-		if(++i % 8 == 0)
-			printf("\n\t");
-		printf("%zu ",block->blockNo);
-		block = block->next;
-	}
-	printf("\n");
+	const CBlockList *lists[] = {&_inList,&_mainList};
+	for(size_t l = 0; l < ARRAY_SIZE(lists); ++l) {
+		size_t i = 0;
+		printf("%s blocks:\n\t",l == 0 ? "A1in" : "Am");
+		for(CBlock *block = lists[l]->newest; block != NULL; block = block->next) {
+			if(++i % 8 == 0)
+				printf("\n\t");
+			printf("%zu ",block->blockNo);
+		}
+		printf("\n");
+	}
 }
 
 #endif
@@ -0,0 +1,187 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include <fs/common.h>
+#include <sys/common.h>
+#include <sys/io.h>
+#include <sys/sync.h>
+#include <sys/thread.h>
+#include <assert.h>
+#include <errno.h>
+#include <mutex>
+
+/* the locks are kept in a hashmap, protected by a single mutex. contended locks get a kernel
+ * semaphore to block on, which is kept when the lock is put on the freelist */
+
+struct TPoolLock {
+	ulong ident;
+	/* the thread that holds the lock exclusively and how often it acquired it */
+	tid_t writer;
+	uint depth;
+	uint readers;
+	/* the number of threads that wait for the semaphore and have not been woken up yet */
+	uint waiting;
+	/* the number of threads that hold or wait for the lock */
+	uint users;
+	bool keep;
+	int sem;
+	TPoolLock *next;
+};
+
+static const size_t HASH_SIZE	= 256;
+static const tid_t NO_WRITER	= -1;
+
+static std::mutex mutex;
+static TPoolLock *locks[HASH_SIZE];
+static TPoolLock *freeList;
+
+static TPoolLock **getList(ulong ident) {
+	return locks + ((ident ^ (ident >> 8)) % HASH_SIZE);
+}
+
+static TPoolLock *find(ulong ident) {
+	for(TPoolLock *l = *getList(ident); l != NULL; l = l->next) {
+		if(l->ident == ident)
+			return l;
+	}
+	return NULL;
+}
+
+static TPoolLock *get(ulong ident) {
+	TPoolLock *l = find(ident);
+	if(l)
+		return l;
+
+	if(freeList) {
+		l = freeList;
+		freeList = l->next;
+	}
+	else {
+		l = new TPoolLock;
+		l->sem = -1;
+	}
+	l->ident = ident;
+	l->writer = NO_WRITER;
+	l->depth = 0;
+	l->readers = 0;
+	l->waiting = 0;
+	l->users = 0;
+	l->keep = false;
+
+	TPoolLock **list = getList(ident);
+	l->next = *list;
+	*list = l;
+	return l;
+}
+
+static void put(TPoolLock *l) {
+	if(l->users > 0 || l->keep)
+		return;
+
+	TPoolLock **list = getList(l->ident);
+	TPoolLock *p = NULL;
+	for(TPoolLock *i = *list; i != l; p = i, i = i->next)
+		;
+	if(p)
+		p->next = l->next;
+	else
+		*list = l->next;
+	l->next = freeList;
+	freeList = l;
+}
+
+static void wakeup(TPoolLock *l) {
+	for(; l->waiting > 0; l->waiting--)
+		semup(l->sem);
+}
+
+int tpool_lock(ulong ident,uint flags) {
+	tid_t tid = NO_WRITER;
+	mutex.lock();
+
+	TPoolLock *l = get(ident);
+	if(flags & LOCK_KEEP)
+		l->keep = true;
+	l->users++;
+
+	while(true) {
+		if(l->writer != NO_WRITER) {
+			if(tid == NO_WRITER)
+				tid = gettid();
+			/* the writer may acquire the lock again, in both modes */
+			if(l->writer == tid) {
+				l->depth++;
+				break;
+			}
+		}
+		else if(~flags & LOCK_EXCLUSIVE) {
+			l->readers++;
+			break;
+		}
+		else if(l->readers == 0) {
+			l->writer = tid == NO_WRITER ? gettid() : tid;
+			l->depth = 1;
+			break;
+		}
+
+		/* we have to wait */
+		if(l->sem < 0) {
+			l->sem = semcrt(0);
+			if(l->sem < 0) {
+				int res = l->sem;
+				l->users--;
+				put(l);
+				mutex.unlock();
+				return res;
+			}
+		}
+		l->waiting++;
+		mutex.unlock();
+		IGNSIGS(semdown(l->sem));
+		mutex.lock();
+	}
+
+	mutex.unlock();
+	return 0;
+}
+
+int tpool_unlock(ulong ident) {
+	std::lock_guard<std::mutex> guard(mutex);
+	TPoolLock *l = find(ident);
+	if(l == NULL)
+		return -EINVAL;
+
+	/* if there is a writer, it's us, because we hold the lock */
+	if(l->writer != NO_WRITER) {
+		if(--l->depth == 0) {
+			l->writer = NO_WRITER;
+			wakeup(l);
+		}
+	}
+	else {
+		assert(l->readers > 0);
+		if(--l->readers == 0)
+			wakeup(l);
+	}
+
+	l->users--;
+	put(l);
+	return 0;
+}
@@ -74,6 +74,13 @@ def create_disk(image, parts, offset, flat, nogrub):
 			copy_files(image, block_offset(parts, offset, i), p[2])
 		i += 1
 
+	# index the directories of filesystems with dir_index
+	i = 0
+	for p in parts:
+		if p[0] == 'ext2' or p[0] == 'ext3' or p[0] == 'ext4':
+			index_dirs(image, block_offset(parts, offset, i))
+		i += 1
+
 	if not nogrub:
 		# mount root fs
 		tmpdir = subprocess.check_output(["mktemp", "-d"]).rstrip()
@@ -149,6 +156,13 @@ def create_fs(image, offset, fs, blocks):
 		print "Unsupported filesystem"
 	free_loop(lodev)
 
+# builds the hash index for all directories that span more than one block in the filesystem of
+# partition @ <offset> in <image>
+def index_dirs(image, offset):
+	lodev = create_loop(image, offset * 1024)
+	subprocess.call(["sudo", "e2fsck", "-fyD", lodev])
+	free_loop(lodev)
+
 # copies the directory <directory> into the filesystem of partition @ <offset> in <image>,
 def copy_files(image, offset, directory):
 	tmpdir = subprocess.check_output(["mktemp", "-d"]).rstrip()
@@ -72,7 +72,11 @@ void load_initHeap(void) {
 #ifndef NDEBUG
 	/* allocate a lot of memory at the beginning to make the beginning of shared libraries more
 	 * predictable */
-	free(malloc(MAX_MEM));
+	void *blocks[MAX_MEM / RESERVE_SIZE];
+	for(size_t i = 0; i < ARRAY_SIZE(blocks); ++i)
+		blocks[i] = malloc(RESERVE_SIZE);
+	for(size_t i = 0; i < ARRAY_SIZE(blocks); ++i)
+		free(blocks[i]);
 #endif
 }
 
@@ -34,6 +34,8 @@
 #endif
 
 #define MAX_MEM			(1024 * 64)
+/* the heap maps larger blocks separately, so that we reserve MAX_MEM in blocks of this size */
+#define RESERVE_SIZE	(1024 * 16)
 
 typedef struct sSharedLib sSharedLib;
 
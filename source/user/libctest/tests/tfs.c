@@ -19,6 +19,7 @@
 
 #include <sys/common.h>
 #include <sys/io.h>
+#include <sys/mount.h>
 #include <sys/proc.h>
 #include <sys/stat.h>
 #include <sys/test.h>
@@ -33,6 +34,7 @@ static void test_perms(void);
 static void test_rename(void);
 static void test_largeFile(void);
 static void test_symlinks(void);
+static void test_htree(void);
 static void test_assertCan(const char *path,uint mode);
 static void test_assertCanNot(const char *path,uint mode,int err);
 static void fs_createFile(const char *name,const char *content);
@@ -64,6 +66,7 @@ static void test_fs(void) {
 	test_rename();
 	test_largeFile();
 	test_symlinks();
+	test_htree();
 }
 
 static void test_basics(void) {
@@ -376,6 +379,87 @@ static void test_symlinks(void) {
 	test_caseSucceeded();
 }
 
+/* the second partition of the disk image is an ext2 filesystem with dir_index and filetype, which
+ * contains the indexed directory "indexed" with HTREE_IMG_FILES files (see boot/x86/images.sh) */
+#define HTREE_MNT			"/mnt/htree"
+#define HTREE_DIR			HTREE_MNT "/indexed"
+#define HTREE_IMG_FILES		64
+/* enough entries to fill the root of the index, so that a second level is required */
+#define HTREE_NEW_FILES		2000
+
+static void test_htree(void) {
+	static const char *devs[] = {"/dev/hda2","/dev/sda2","/dev/vda2"};
+	char path[MAX_PATH_LEN];
+	struct stat info;
+	sExitState state;
+	const char *dev = NULL;
+
+	for(size_t i = 0; i < ARRAY_SIZE(devs); ++i) {
+		if(stat(devs[i],&info) == 0) {
+			dev = devs[i];
+			break;
+		}
+	}
+	if(dev == NULL) {
+		printf("No disk with a second partition found; skipping the htree test\n\n");
+		return;
+	}
+
+	test_caseStart("Testing hash-indexed directories");
+
+	test_assertInt(mkdir(HTREE_MNT,DIR_DEF_MODE),0);
+	int pid = fork();
+	if(pid == 0) {
+		const char *args[] = {"/bin/mount",dev,HTREE_MNT,"/sbin/ext2",NULL};
+		execv(args[0],args);
+		exit(EXIT_FAILURE);
+	}
+	test_assertInt(waitchild(&state,pid,0),0);
+	test_assertInt(state.exitCode,EXIT_SUCCESS);
+
+	/* the entries of the image have a file type in the upper byte of the name length */
+	for(int i = 0; i < HTREE_IMG_FILES; ++i) {
+		snprintf(path,sizeof(path),HTREE_DIR "/entry-with-a-fairly-long-name-for-the-index-%04d",i);
+		test_assertInt(stat(path,&info),0);
+	}
+
+	/* add entries until leaves have been split and the index got a second level. use hardlinks,
+	 * because the filesystem does not have enough inodes */
+	for(int i = HTREE_IMG_FILES; i < HTREE_IMG_FILES + HTREE_NEW_FILES; ++i) {
+		snprintf(path,sizeof(path),HTREE_DIR "/entry-with-a-fairly-long-name-for-the-index-%04d",i);
+		test_assertInt(link(HTREE_DIR "/entry-with-a-fairly-long-name-for-the-index-0000",path),0);
+	}
+	for(int i = 0; i < HTREE_IMG_FILES + HTREE_NEW_FILES; ++i) {
+		snprintf(path,sizeof(path),HTREE_DIR "/entry-with-a-fairly-long-name-for-the-index-%04d",i);
+		test_assertInt(stat(path,&info),0);
+	}
+	test_assertUInt(info.st_nlink,HTREE_NEW_FILES + 1);
+
+	/* remove them again */
+	for(int i = HTREE_IMG_FILES; i < HTREE_IMG_FILES + HTREE_NEW_FILES; ++i) {
+		snprintf(path,sizeof(path),HTREE_DIR "/entry-with-a-fairly-long-name-for-the-index-%04d",i);
+		test_assertInt(unlink(path),0);
+		test_assertInt(stat(path,&info),-ENOENT);
+	}
+	for(int i = 0; i < HTREE_IMG_FILES; ++i) {
+		snprintf(path,sizeof(path),HTREE_DIR "/entry-with-a-fairly-long-name-for-the-index-%04d",i);
+		test_assertInt(stat(path,&info),0);
+	}
+
+	int fd = open(HTREE_DIR,O_RDONLY);
+	test_assertTrue(fd >= 0);
+	test_assertInt(syncfs(fd),0);
+	close(fd);
+
+	int ms = open("/sys/pid/self/ms",O_WRITE);
+	test_assertTrue(ms >= 0);
+	test_assertInt(unmount(ms,HTREE_MNT),0);
+	close(ms);
+	test_assertInt(rmdir(HTREE_MNT),0);
+
+	test_caseSucceeded();
+}
+
 static void test_assertCan(const char *path,uint mode) {
 	int fd = open(path,mode);
 	test_assertTrue(fd >= 0);
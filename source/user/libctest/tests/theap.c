@@ -17,13 +17,20 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <sys/atomic.h>
 #include <sys/common.h>
+#include <sys/io.h>
+#include <sys/sync.h>
 #include <sys/test.h>
+#include <sys/thread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #define SINGLE_BYTE_COUNT 10000
+#define THREAD_COUNT		4
+#define THREAD_ROUNDS		2000
+#define HANDOFF_COUNT		16
 
 /* forward declarations */
 static void test_heap(void);
@@ -35,6 +42,8 @@ static void test_heap_t1v3(void);
 static void test_heap_t1v4(void);
 static void test_heap_t2(void);
 static void test_heap_t3(void);
+static void test_heap_t4(void);
+static void test_heap_t5(void);
 
 /* our test-module */
 sTestModule tModHeap = {
@@ -51,6 +60,11 @@ size_t randFree2[] = {3,4,1,5,6,0,7,2};
 
 size_t oldFree, newFree;
 
+/* blocks that are passed between the threads, so that they are freed by a different thread */
+static uint *handoff[HANDOFF_COUNT];
+static tUserSem handoffSem;
+static long volatile heapErrors;
+
 static void test_heap(void) {
 	void (*tests[])(void) = {
 		&test_heap_t1v1,
@@ -59,6 +73,8 @@ static void test_heap(void) {
 		&test_heap_t1v4,
 		&test_heap_t2,
 		&test_heap_t3,
+		&test_heap_t4,
+		&test_heap_t5,
 	};
 
 	size_t i;
@@ -197,3 +213,96 @@ static void test_heap_t3(void) {
 	}
 	test_check();
 }
+
+/* grow an area step by step, across all size classes */
+static void test_heap_t4(void) {
+	size_t i,size;
+	uint *p = NULL;
+	test_init("Reallocate up to %d bytes",sizes[ARRAY_SIZE(sizes) - 1] * 16 * sizeof(uint));
+	for(size = 1; size <= sizes[ARRAY_SIZE(sizes) - 1] * 16; size += size / 2 + 1) {
+		p = (uint*)realloc(p,size * sizeof(uint));
+		if(!test_assertTrue(p != NULL))
+			break;
+		/* the old content has to be preserved */
+		for(i = 0; i < size / 2; i++) {
+			if(p[i] != i) {
+				test_assertUInt(p[i],i);
+				break;
+			}
+		}
+		for(i = 0; i < size; i++)
+			p[i] = i;
+	}
+	free(p);
+	test_check();
+}
+
+static bool test_checkBlock(uint *p) {
+	size_t i;
+	/* the first word is the number of words, all others are the owner */
+	for(i = 1; i < p[0]; i++) {
+		if(p[i] != p[1])
+			return false;
+	}
+	return true;
+}
+
+static int test_heapThread(void *arg) {
+	uint id = (uint)(uintptr_t)arg;
+	size_t i,r;
+	for(r = 0; r < THREAD_ROUNDS; r++) {
+		/* cover small and large classes */
+		size_t words = 2 + (r * 37 + id * 101) % 3000;
+		uint *p = (uint*)malloc(words * sizeof(uint));
+		if(p == NULL) {
+			atomic_add(&heapErrors,+1);
+			break;
+		}
+		p[0] = words;
+		for(i = 1; i < words; i++)
+			p[i] = id;
+
+		/* exchange it with a block of a (probably) different thread and free that one */
+		size_t slot = (r * 7 + id) % HANDOFF_COUNT;
+		usemdown(&handoffSem);
+		uint *old = handoff[slot];
+		handoff[slot] = p;
+		usemup(&handoffSem);
+		if(old) {
+			if(!test_checkBlock(old))
+				atomic_add(&heapErrors,+1);
+			free(old);
+		}
+	}
+	return 0;
+}
+
+/* allocate and free from multiple threads at once; blocks are freed by other threads */
+static void test_heap_t5(void) {
+	int tids[THREAD_COUNT];
+	size_t i;
+	test_init("Allocate and free with %d threads",THREAD_COUNT);
+
+	heapErrors = 0;
+	if(!test_assertInt(usemcrt(&handoffSem,1),0))
+		return;
+	for(i = 0; i < THREAD_COUNT; i++) {
+		tids[i] = startthread(test_heapThread,(void*)(uintptr_t)i);
+		test_assertTrue(tids[i] >= 0);
+	}
+	for(i = 0; i < THREAD_COUNT; i++) {
+		if(tids[i] >= 0)
+			IGNSIGS(join(tids[i]));
+	}
+
+	for(i = 0; i < HANDOFF_COUNT; i++) {
+		if(handoff[i]) {
+			test_assertTrue(test_checkBlock(handoff[i]));
+			free(handoff[i]);
+			handoff[i] = NULL;
+		}
+	}
+	usemdestr(&handoffSem);
+	test_assertLInt(heapErrors,0);
+	test_check();
+}
@@ -0,0 +1,215 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <esc/ipc/ring.h>
+#include <esc/vthrow.h>
+#include <sys/common.h>
+#include <sys/io.h>
+#include <sys/mman.h>
+#include <sys/test.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace esc;
+
+/* forward declarations */
+static void test_ring();
+static void test_wraparound();
+static void test_invalid();
+static void test_sleep();
+static void test_attach();
+
+/* our test-module */
+sTestModule tModRing = {
+	"Ring channel",
+	&test_ring
+};
+
+static const size_t SLOT_COUNT	= 4;
+static const size_t SLOT_SIZE	= 64;
+static const size_t MEM_SIZE	= sizeof(RingQueue::Header) + SLOT_COUNT * SLOT_SIZE;
+
+/**
+ * A shared memory region that is mapped twice, once for the producer and once for the consumer.
+ */
+struct SharedRegion {
+	explicit SharedRegion() : fd(), prod(), cons() {
+		fd = createbuf(MEM_SIZE,&prod,0);
+		if(fd < 0)
+			VTHROWE("createbuf(" << MEM_SIZE << ")",fd);
+		memset(prod,0,MEM_SIZE);
+		cons = mmap(NULL,MEM_SIZE,0,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+		if(!cons)
+			VTHROWE("mmap(" << fd << ")",-errno);
+	}
+	~SharedRegion() {
+		munmap(cons);
+		destroybuf(prod);
+		close(fd);
+	}
+
+	RingQueue queue(void *mem) {
+		RingQueue::Header *hdr = static_cast<RingQueue::Header*>(mem);
+		return RingQueue(hdr,reinterpret_cast<char*>(hdr + 1),SLOT_COUNT,SLOT_SIZE);
+	}
+
+	int fd;
+	void *prod;
+	void *cons;
+};
+
+static void test_ring() {
+	test_wraparound();
+	test_invalid();
+	test_sleep();
+	test_attach();
+}
+
+static void test_wraparound() {
+	test_caseStart("Push & pop with wraparound");
+
+	{
+		SharedRegion reg;
+		RingQueue prod = reg.queue(reg.prod);
+		RingQueue cons = reg.queue(reg.cons);
+		test_assertTrue(cons.empty());
+
+		/* fill the queue completely a few times with different fill levels, so that head and tail
+		 * wrap around at different slots */
+		size_t next = 0,expected = 0;
+		for(size_t round = 0; round < 5; ++round) {
+			size_t n = round % SLOT_COUNT + 1;
+			for(size_t i = 0; i < n; ++i) {
+				char msg[32];
+				size_t len = snprintf(msg,sizeof(msg),"message %zu",next);
+				test_assertFalse(prod.push(next,msg,len + 1));
+				next++;
+			}
+
+			for(size_t i = 0; i < n; ++i) {
+				char buf[32],exp[32];
+				msgid_t mid;
+				snprintf(exp,sizeof(exp),"message %zu",expected);
+				ssize_t res = cons.pop(&mid,buf,sizeof(buf));
+				test_assertSSize(res,strlen(exp) + 1);
+				test_assertUInt(mid,expected);
+				test_assertStr(buf,exp);
+				expected++;
+			}
+			test_assertTrue(cons.empty());
+		}
+
+		msgid_t mid;
+		char buf[32];
+		test_assertSSize(cons.pop(&mid,buf,sizeof(buf)),-EWOULDBLOCK);
+	}
+
+	test_caseSucceeded();
+}
+
+static void test_invalid() {
+	test_caseStart("Pop invalid messages");
+
+	{
+		SharedRegion reg;
+		RingQueue prod = reg.queue(reg.prod);
+		RingQueue cons = reg.queue(reg.cons);
+
+		/* too large for the buffer: it's dropped */
+		char data[SLOT_SIZE] = "foobar";
+		prod.push(1,data,prod.maxsize());
+		prod.push(2,data,7);
+		msgid_t mid;
+		char buf[16];
+		test_assertSSize(cons.pop(&mid,buf,sizeof(buf)),-EINVAL);
+		test_assertUInt(mid,1);
+		test_assertSSize(cons.pop(&mid,buf,sizeof(buf)),7);
+		test_assertUInt(mid,2);
+		test_assertStr(buf,"foobar");
+
+		/* the producer lies about the length */
+		prod.push(3,data,4);
+		RingQueue::Header *hdr = static_cast<RingQueue::Header*>(reg.prod);
+		RingQueue::Slot *slot = reinterpret_cast<RingQueue::Slot*>(
+			reinterpret_cast<char*>(hdr + 1) + (hdr->head % SLOT_COUNT) * SLOT_SIZE);
+		slot->length = SLOT_SIZE * 2;
+		char large[SLOT_SIZE * 4];
+		test_assertSSize(cons.pop(&mid,large,sizeof(large)),-EINVAL);
+		test_assertTrue(cons.empty());
+	}
+
+	test_caseSucceeded();
+}
+
+static void test_sleep() {
+	test_caseStart("Sleep & wakeup");
+
+	{
+		SharedRegion reg;
+		RingQueue prod = reg.queue(reg.prod);
+		RingQueue cons = reg.queue(reg.cons);
+
+		/* the consumer sleeps, so that the first push needs a wakeup, the second one not */
+		test_assertTrue(cons.sleep());
+		test_assertTrue(prod.push(1,"a",1));
+		test_assertFalse(prod.push(2,"b",1));
+
+		/* there is something to consume, so that we don't sleep */
+		test_assertFalse(cons.sleep());
+		test_assertFalse(prod.push(3,"c",1));
+
+		msgid_t mid;
+		char buf[4];
+		for(int i = 1; i <= 3; ++i) {
+			test_assertSSize(cons.pop(&mid,buf,sizeof(buf)),1);
+			test_assertUInt(mid,i);
+		}
+		test_assertTrue(cons.sleep());
+	}
+
+	test_caseSucceeded();
+}
+
+static void test_attach() {
+	test_caseStart("Attach to invalid ring channels");
+
+	{
+		SharedRegion reg;
+		/* no valid layout */
+		try {
+			RingChannel ring(-1,reg.cons,MEM_SIZE);
+			test_caseFailed("Attaching to an empty region succeeded");
+		}
+		catch(const default_error &e) {
+			test_assertInt(e.error(),-EINVAL);
+		}
+
+		/* too small */
+		try {
+			RingChannel ring(-1,reg.cons,1);
+			test_caseFailed("Attaching to a too small region succeeded");
+		}
+		catch(const default_error &e) {
+			test_assertInt(e.error(),-EINVAL);
+		}
+	}
+
+	test_caseSucceeded();
+}
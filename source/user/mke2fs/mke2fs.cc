@@ -231,13 +231,13 @@ static void createRootDir(uint32_t bno) {
 
 	Ext2DirEntry *e = (Ext2DirEntry*)entries;
 	e->inode = cputole32(EXT2_ROOT_INO);
-	e->nameLen = cputole16(1);
+	e->nameLen = 1;
 	memcpy(e->name,".",1);
 	e->recLen = cputole16(getDirESize(1));
 
 	e = (Ext2DirEntry*)(entries + le16tocpu(e->recLen));
 	e->inode = cputole32(EXT2_ROOT_INO);
-	e->nameLen = cputole16(2);
+	e->nameLen = 2;
 	memcpy(e->name,"..",2);
 	e->recLen = cputole16(blockSize - getDirESize(1));
 
@@ -36,3 +36,4 @@ extern int mod_chgsize(int,char**);
 extern int mod_pagefault(int,char**);
 extern int mod_heap(int,char**);
 extern int mod_stdio(int,char**);
+EXTERN_C int mod_bcache(int,char**);
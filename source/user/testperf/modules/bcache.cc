@@ -0,0 +1,92 @@
+/**
+ * $Id$
+ * Copyright (C) 2008 - 2014 Nils Asmussen
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include <fs/blockcache.h>
+#include <sys/common.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../modules.h"
+
+static const size_t CACHE_SIZE		= 256;
+static const size_t BLOCK_SIZE		= 1024;
+/* the number of "metadata" blocks, which are used over and over again */
+static const size_t META_BLOCKS		= 96;
+/* the number of blocks of a large file that are read once after each metadata access. this
+ * makes the reuse distance of the metadata blocks larger than the cache, so that LRU misses */
+static const size_t SCAN_BLOCKS		= 2;
+static const size_t ROUNDS			= 100;
+
+/* the disk is simulated; we only count the reads */
+class MemCache : public fs::BlockCache {
+public:
+	explicit MemCache() : fs::BlockCache(-1,CACHE_SIZE,BLOCK_SIZE), metaReads(), scanReads() {
+	}
+
+	virtual bool readBlocks(void *,block_t start,size_t blockCount) {
+		for(size_t i = 0; i < blockCount; ++i) {
+			if(start + i <= META_BLOCKS)
+				metaReads++;
+			else
+				scanReads++;
+		}
+		return 0;
+	}
+	virtual bool writeBlocks(const void *,size_t,size_t) {
+		return 0;
+	}
+
+	ulong metaReads;
+	ulong scanReads;
+};
+
+static void doAccess(MemCache &cache,block_t blockNo,uint64_t *total) {
+	uint64_t start = rdtsc();
+	fs::CBlock *b = cache.request(blockNo,fs::BlockCache::READ);
+	*total += rdtsc() - start;
+	if(b)
+		cache.release(b);
+}
+
+int mod_bcache(A_UNUSED int argc,A_UNUSED char *argv[]) {
+	MemCache cache;
+	uint64_t total = 0;
+	block_t next = META_BLOCKS + 1;
+
+	/* every round touches all metadata blocks while continuing a large sequential scan */
+	for(size_t r = 0; r < ROUNDS; ++r) {
+		for(block_t m = 1; m <= META_BLOCKS; ++m) {
+			doAccess(cache,m,&total);
+			for(size_t i = 0; i < SCAN_BLOCKS; ++i)
+				doAccess(cache,next++,&total);
+		}
+	}
+
+	size_t metaAcc = ROUNDS * META_BLOCKS;
+	printf("Cache: %zu blocks, metadata: %zu blocks, scan: %zu blocks per access, %zu rounds\n",
+		CACHE_SIZE,META_BLOCKS,SCAN_BLOCKS,ROUNDS);
+	printf("Metadata hitrate: %.3f%% (%lu reads)\n",
+		100.0f * (float)(metaAcc - cache.metaReads) / metaAcc,cache.metaReads);
+	printf("Scan reads: %lu\n",cache.scanReads);
+	printf("Per request: %Lu cycles\n",total / (ROUNDS * META_BLOCKS * (1 + SCAN_BLOCKS)));
+	cache.printStats(stdout);
+	return 0;
+}
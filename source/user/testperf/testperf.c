@@ -51,6 +51,7 @@ static sTestModule modules[] = {
 	{"pagefault",	mod_pagefault},
 	{"heap",		mod_heap},
 	{"stdio",		mod_stdio},
+	{"bcache",		mod_bcache},
 };
 
 int main(int argc,char *argv[]) {